@@ -53,6 +53,24 @@ int no_arrays;
 arrayinfo *arrays;
 static memory_list arrays_memlist;
 
+/*  Every dynamic array, named or not (the "box" and "random" statements
+    make unnamed ones), is a block of the dynamic array area starting at
+    the offset its references carry. With $DYNAMIC_ARRAY_ORDER set, the
+    blocks the game may write to are moved together, next to the global
+    variables, before the story file is made; then every array offset
+    is relocated as it is backpatched.                                       */
+
+typedef struct arrayblock_s {
+    int32 start;     /* Offset in dynamic_array_area as compiled           */
+    int32 writes;    /* Places in the code which may write to it           */
+    int32 moved_to;  /* Offset once the layout has been planned            */
+} arrayblock;
+
+static arrayblock *array_blocks;
+static memory_list array_blocks_memlist;
+static int no_array_blocks;
+static int array_layout_planned;
+
 static int array_entry_size,           /* 1 for byte array, 2 for word array */
            array_base;                 /* Offset in dynamic array area of the
                                           array being constructed.  During the
@@ -90,6 +108,81 @@ int globalv_z_sender;
 int zcode_user_global_start_no;
 int zcode_highest_allowed_global;
 
+static void note_array_block(int32 start)
+{
+    ensure_memory_list_available(&array_blocks_memlist, no_array_blocks+1);
+    array_blocks[no_array_blocks].start = start;
+    array_blocks[no_array_blocks].writes = 0;
+    array_blocks[no_array_blocks].moved_to = start;
+    no_array_blocks++;
+}
+
+/*  The block containing the given offset, or -1 if it lies before them
+    all (that is, among the Z-code global variables).                        */
+
+static int find_array_block(int32 offset)
+{   int lo = 0, hi = no_array_blocks, mid;
+    while (lo < hi)
+    {   mid = (lo + hi)/2;
+        if (array_blocks[mid].start <= offset) lo = mid+1; else hi = mid;
+    }
+    return lo-1;
+}
+
+extern void note_array_write(int32 offset)
+{   int k;
+    if (!DYNAMIC_ARRAY_ORDER) return;
+    k = find_array_block(offset);
+    if ((k >= 0) && (array_blocks[k].start == offset))
+        array_blocks[k].writes++;
+}
+
+/*  Rearrange the dynamic array area: first the blocks which may be written
+    to, then the rest, each in declaration order.                            */
+
+extern void plan_dynamic_array_layout(void)
+{   uchar *old_area;
+    int32 base, mark, size;
+    int k, pass;
+
+    if (!DYNAMIC_ARRAY_ORDER || array_layout_planned || no_array_blocks == 0)
+        return;
+
+    base = array_blocks[0].start;
+    size = dynamic_array_area_size - base;
+    old_area = my_malloc(size, "dynamic array area copy");
+    memcpy(old_area, dynamic_array_area + base, size);
+
+    mark = base;
+    for (pass = 0; pass < 2; pass++)
+    {   for (k = 0; k < no_array_blocks; k++)
+        {   int32 end = (k+1 < no_array_blocks)
+                ? array_blocks[k+1].start : dynamic_array_area_size;
+            if ((array_blocks[k].writes != 0) != (pass == 0)) continue;
+            array_blocks[k].moved_to = mark;
+            memcpy(dynamic_array_area + mark,
+                old_area + (array_blocks[k].start - base),
+                end - array_blocks[k].start);
+            mark += end - array_blocks[k].start;
+        }
+    }
+
+    my_free(&old_area, "dynamic array area copy");
+    array_layout_planned = TRUE;
+}
+
+/*  Where an offset in the dynamic array area ends up after
+    plan_dynamic_array_layout().                                             */
+
+extern int32 relocated_array_offset(int32 offset)
+{   int k;
+    if (!array_layout_planned || offset >= dynamic_array_area_size)
+        return offset;
+    k = find_array_block(offset);
+    if (k < 0) return offset;
+    return array_blocks[k].moved_to + (offset - array_blocks[k].start);
+}
+
 /* Complete the array. Fill in the size field (if it has one) and 
    advance foo_array_area_size.
 */
@@ -309,6 +402,90 @@ extern void ensure_builtin_globals(void)
 #define ASCII_AI        2
 #define BRACKET_AI      3
 
+/* ------------------------------------------------------------------------- */
+/*   Folding of constant globals.                                            */
+/*                                                                           */
+/*   If $FOLD_CONSTANT_GLOBALS is set, the analysis pass notes every global  */
+/*   variable which any instruction might write to (including through       */
+/*   "#g$", "#globals_array" or a variable number in assembly language).     */
+/*   In the main pass, a global which is read but never written is then      */
+/*   declared as a constant with its initial value, so that it takes no      */
+/*   variable slot and can be folded into constant expressions.             */
+/* ------------------------------------------------------------------------- */
+
+static int global_folds_to_constant(int symbol)
+{   analysedsymbol *as;
+
+    if (!FOLD_CONSTANT_GLOBALS || analysis_pass || define_INFIX_switch)
+        return FALSE;
+    /*  In version 3, the first three globals are shown on the status line  */
+    if (!glulx_mode && (version_number <= 3) && (no_globals < 3))
+        return FALSE;
+
+    as = find_analysed_symbol(symbols[symbol].name);
+    if ((as == NULL) || (as->type != GLOBAL_VARIABLE_T)) return FALSE;
+    if (as->flags & ASSIGNED_UFLAG) return FALSE;
+    /*  An unused global is left alone, to be warned about as usual  */
+    if (as->refs == 0) return FALSE;
+    return TRUE;
+}
+
+static void make_folded_global(int symbol,
+    debug_location_beginning beginning_debug_location)
+{   assembly_operand AO;
+
+    directive_keywords.enabled = TRUE;
+    get_next_token();
+    directive_keywords.enabled = FALSE;
+
+    if (((token_type==SEP_TT)&&(token_value==ARROW_SEP))
+        || ((token_type==SEP_TT)&&(token_value==DARROW_SEP))
+        || ((token_type==DIR_KEYWORD_TT)&&(token_value==STRING_DK))
+        || ((token_type==DIR_KEYWORD_TT)&&(token_value==TABLE_DK))
+        || ((token_type==DIR_KEYWORD_TT)&&(token_value==BUFFER_DK)))
+    {
+        error("use 'Array' to define arrays, not 'Global'");
+        return;
+    }
+
+    if ((token_type == SEP_TT) && (token_value == SEMICOLON_SEP))
+    {   put_token_back();
+        AO = zero_operand;
+    }
+    else
+    {   /* Skip "=" if present. */
+        if (!((token_type == SEP_TT) && (token_value == SETEQUALS_SEP)))
+            put_token_back();
+        AO = parse_expression(CONSTANT_CONTEXT);
+    }
+
+    if (AO.marker != 0)
+    {   assign_marked_symbol(symbol, AO.marker, AO.value, CONSTANT_T);
+        symbols[symbol].flags |= CHANGE_SFLAG;
+    }
+    else
+        assign_symbol(symbol, AO.value, CONSTANT_T);
+
+    if (debugfile_switch)
+    {   debug_file_printf("<constant>");
+        debug_file_printf("<identifier>%s</identifier>",
+            symbols[symbol].name);
+        write_debug_symbol_optional_backpatch(symbol);
+        write_debug_locations
+            (get_token_location_end(beginning_debug_location));
+        debug_file_printf("</constant>");
+    }
+
+    if (FOLD_CONSTANT_GLOBALS >= 2)
+    {   if (AO.marker != 0)
+            printf("Global variable \"%s\" folded to a constant\n",
+                symbols[symbol].name);
+        else
+            printf("Global variable \"%s\" folded to the constant %d\n",
+                symbols[symbol].name, AO.value);
+    }
+}
+
 extern void make_global()
 {
     int32 i;
@@ -367,6 +544,11 @@ extern void make_global()
     else {
         put_token_back();
     }
+
+    if (global_folds_to_constant(i))
+    {   make_folded_global(i, beginning_debug_location);
+        return;
+    }
     
     if (!glulx_mode && ZCODE_COMPACT_GLOBALS && version_number <= 3 && no_globals == 3) {
         /* Special handling for ZCODE_COMPACT_GLOBALS in z3.
@@ -594,6 +776,7 @@ extern void make_array()
     
     if (!is_static) {
         array_base = dynamic_array_area_size;
+        note_array_block(array_base);
         dynamic_array_area_size += extraspace;
     }
     else {
@@ -806,6 +989,7 @@ extern int32 begin_table_array(void)
 
     array_base = dynamic_array_area_size;
     array_entry_size = WORDSIZE;
+    note_array_block(array_base);
 
     /*  Leave room to write the array size in later                          */
 
@@ -822,6 +1006,7 @@ extern int32 begin_word_array(void)
 
     array_base = dynamic_array_area_size;
     array_entry_size = WORDSIZE;
+    note_array_block(array_base);
 
     return array_base;
 }
@@ -834,6 +1019,7 @@ extern void init_arrays_vars(void)
 {   dynamic_array_area = NULL;
     static_array_area = NULL;
     arrays = NULL;
+    array_blocks = NULL;
     global_initial_value = NULL;
     variables = NULL;
 
@@ -901,6 +1087,8 @@ extern void arrays_begin_pass(void)
     int ix, totalvar;
     
     no_arrays = 0; 
+    no_array_blocks = 0;
+    array_layout_planned = FALSE;
     if (!glulx_mode) {
         no_globals = zcode_user_global_start_no;
         /* The compiler-defined globals start at 239 and go down...
@@ -909,8 +1097,9 @@ extern void arrays_begin_pass(void)
         totalvar = MAX_ZCODE_GLOBAL_VARS;
     }
     else {
-        /* The compiler-defined globals run from 0 to 10. */
-        no_globals = 11;
+        /* The compiler-defined globals run from 0 to 10 (or to 11,
+           with $SNAPSHOT_INIT). */
+        no_globals = (SNAPSHOT_INIT) ? 12 : 11;
         totalvar = no_globals;
     }
     
@@ -955,6 +1144,9 @@ extern void arrays_allocate_arrays(void)
     initialise_memory_list(&arrays_memlist,
         sizeof(arrayinfo), 64, (void**)&arrays,
         "array info");
+    initialise_memory_list(&array_blocks_memlist,
+        sizeof(arrayblock), 64, (void**)&array_blocks,
+        "dynamic array blocks");
     initialise_memory_list(&global_initial_value_memlist,
         sizeof(int32), 200, (void**)&global_initial_value,
         "global variable values");
@@ -969,6 +1161,7 @@ extern void arrays_free_arrays(void)
     deallocate_memory_list(&dynamic_array_area_memlist);
     deallocate_memory_list(&static_array_area_memlist);
     deallocate_memory_list(&arrays_memlist);
+    deallocate_memory_list(&array_blocks_memlist);
     deallocate_memory_list(&global_initial_value_memlist);
     deallocate_memory_list(&current_array_name);
 }
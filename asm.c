@@ -85,6 +85,19 @@ static memory_list current_routine_name; /* The name of the routine currently
 
 static int32 routine_start_pc;
 
+/*  For $STACK_ANALYSIS: the evaluation stack depth (in words) along the
+    routine being assembled, and the extremes it has reached             */
+
+static int32 stack_depth, stack_depth_max, stack_depth_min;
+static int routine_calls_indirectly;    /* through a variable or number */
+static int stack_depth_lost;       /* Code since a jump or return, which
+                                      runs only if a label is reached    */
+static int32 *label_stack_depths;  /* For each label, 1 + the greatest
+                                      depth at a branch to it so far, or
+                                      0 if there has been none           */
+static memory_list label_stack_depths_memlist;
+static int label_stack_depths_size; /* Entries up to here are initialized */
+
 int32 *named_routine_symbols;      /* Allocated up to no_named_routines      */
 static memory_list named_routine_symbols_memlist;
 
@@ -112,6 +125,125 @@ static sequencepointinfo *sequence_points; /* Allocated to next_sequence_point.
                                               is set.                        */
 static memory_list sequence_points_memlist;
 
+/* ------------------------------------------------------------------------- */
+/*   Opcode usage records (for -s and $!OPCODES)                             */
+/* ------------------------------------------------------------------------- */
+
+/* One record is made for each instruction emitted in the final pass, if
+   statistics are wanted. The offset and length start out as positions in
+   the holding area; when the routine is transferred, they are replaced by
+   the final address and the length after branch shortening. */
+
+typedef struct opcodeuse_s {
+    int32 offset;       /* Holding-area offset, later zcode_area address */
+    int32 length;       /* Bytes used by the instruction */
+    int32 oplen;        /* Bytes before the operand types (or modes) */
+    int internal_number;
+    int form;           /* One of the *_OUSE values below */
+    int operands;       /* Number of typed operands */
+    uint32 modes;       /* 2 bits (Z-code) or 4 bits (Glulx) per operand */
+    int veneer;         /* Set if compiled in veneer_mode */
+} opcodeuse;
+
+#define LONG_OUSE   0   /* Z-code instruction forms */
+#define SHORT_OUSE  1
+#define VAR_OUSE    2
+#define EXT_OUSE    3
+#define GLULX_OUSE  4   /* Glulx: 4 + (opcode bytes) */
+
+static opcodeuse *opcode_uses;
+static memory_list opcode_uses_memlist;
+static int32 no_opcode_uses;
+static int32 opcode_uses_start;   /* First record of the current routine */
+
+static int recording_opcode_uses(void)
+{   return (!analysis_pass && (statistics_switch || list_opcodes_setting));
+}
+
+static void note_opcode_use(int internal_number, int32 offset, int32 oplen,
+    int form, int operands, uint32 modes)
+{   opcodeuse *ou;
+    ensure_memory_list_available(&opcode_uses_memlist, no_opcode_uses+1);
+    ou = &opcode_uses[no_opcode_uses++];
+    ou->offset = offset;
+    ou->length = zcode_ha_size - offset;
+    ou->oplen = oplen;
+    ou->internal_number = internal_number;
+    ou->form = form;
+    ou->operands = operands;
+    ou->modes = modes;
+    ou->veneer = veneer_mode;
+}
+
+/* Called from transfer_routine_z/g() once the branch and jump decisions
+   have been made (DELETED_MV bytes marked), but before the holding area is
+   copied out. */
+
+static void finish_opcode_uses(int32 rstart_pc)
+{   int32 i, n, keep, new_pc;
+
+    i = 0; new_pc = rstart_pc; keep = opcode_uses_start;
+    for (n=opcode_uses_start; n<no_opcode_uses; n++)
+    {   opcodeuse ou = opcode_uses[n];
+        int32 end = ou.offset + ou.length, len = 0;
+        int k;
+
+        for (; i<ou.offset; i++)
+            if (zcode_markers[i] != DELETED_MV) new_pc++;
+
+        if (glulx_mode)
+        {   /* Branch shortening rewrites the addressing modes, so read
+               them back from the holding area. */
+            ou.modes = 0;
+            for (k=0; k<ou.operands; k++)
+            {   int b = zcode_holding_area[ou.offset + ou.oplen + k/2];
+                ou.modes |= ((uint32) ((k & 1) ? (b >> 4) : (b & 15))) << (4*k);
+            }
+        }
+
+        ou.offset = new_pc;
+        for (; i<end; i++)
+            if (zcode_markers[i] != DELETED_MV) { new_pc++; len++; }
+
+        /* A jump to the very next instruction is deleted entirely */
+        if (len == 0) continue;
+        ou.length = len;
+        opcode_uses[keep++] = ou;
+    }
+    no_opcode_uses = keep;
+    opcode_uses_start = keep;
+}
+
+/* ------------------------------------------------------------------------- */
+/*   Cold blocks (only if $REORDER_BLOCKS)                                   */
+/* ------------------------------------------------------------------------- */
+
+typedef struct coldblock_s {
+    int32 guard;        /* Holding-area offset of the branch around it      */
+    int32 start, end;   /* The block itself, as holding-area offsets; end
+                           is -1 until the block is known to be movable     */
+    int resume;         /* Does the block run on into the code after it?    */
+    int32 tail_start, tail_end;  /* The jump back added if it does          */
+} coldblock;
+
+static coldblock *cold_blocks;
+static memory_list cold_blocks_memlist;
+static int no_cold_blocks;
+
+static int32 last_instruction_start;  /* Holding-area offset of the latest
+                                         instruction, or -1 if none      */
+static int last_instruction_leaves;   /* Did it leave the routine (a
+                                         return or quit, not a jump)?    */
+
+static int32 *layout_positions;       /* Workspace for move_cold_blocks() */
+static memory_list layout_positions_memlist;
+static uchar *layout_bytes;
+static memory_list layout_bytes_memlist;
+static uchar *layout_markers;
+static memory_list layout_markers_memlist;
+static int *layout_labels;
+static memory_list layout_labels_memlist;
+
 /* ------------------------------------------------------------------------- */
 /*   Label management                                                        */
 /* ------------------------------------------------------------------------- */
@@ -335,6 +467,8 @@ extern char *variable_name(int32 i)
       case 8: return "sys__glob1";
       case 9: return "sys__glob2";
       case 10: return "sys_statusline_flag";
+      case 11: if (SNAPSHOT_INIT) return "sys_snapshot_taken";
+               break;
       }
     }
 
@@ -1000,17 +1134,74 @@ static void write_operand(assembly_operand op)
 
 #define MAX_TRACE_STRING_LEN (35)
 
+/*  During the analysis pass, note every global variable which an
+    instruction may write to, for $FOLD_CONSTANT_GLOBALS.  This is done
+    before the "never reached" test, to be on the safe side.  Opcodes whose
+    first operand is a variable number (such as @inc or @load) count
+    whether they read or write it, and an indirect one ("@inc [x]") could
+    reach any global.                                                      */
+
+static void note_assigned_variables_z(const assembly_instruction *AI)
+{   opcodez opco = internal_number_to_opcode_z(AI->internal_number);
+
+    if (AI->store_variable_number != -1)
+        note_global_assignment(AI->store_variable_number);
+    if ((opco.op_rules == VARIAB) && (AI->operand_count > 0))
+    {   if (AI->operand[0].type == SHORT_CONSTANT_OT)
+            note_global_assignment(AI->operand[0].value);
+        else
+            note_global_assignment(-1);
+    }
+}
+
+static void note_assigned_variables_g(const assembly_instruction *AI)
+{   opcodeg opco = internal_number_to_opcode_g(AI->internal_number);
+    int ix, n = AI->operand_count;
+
+    for (ix=0; ix<n; ix++)
+    {   if (AI->operand[ix].type != GLOBALVAR_OT) continue;
+        if (((opco.flags & St)
+             && (ix == ((opco.flags & Br) ? n-2 : n-1)))
+            || ((opco.flags & St2) && (ix == n-2)))
+            note_global_assignment(AI->operand[ix].value);
+    }
+}
+
+/* For $DYNAMIC_ARRAY_ORDER: a dynamic array whose address is handed to
+   anything other than an array access (a routine, an input opcode, a
+   variable, the veneer) may be written to through it. Array accesses
+   themselves, and the veneer's run-time checks of them, are counted by
+   the expression compiler, which can tell loads from stores. */
+
+static void note_array_references(const assembly_instruction *AI, int access)
+{   int ix;
+    if (access) return;
+    if ((AI->operand_count > 0) && (AI->operand[0].marker == VROUTINE_MV))
+    {   switch (AI->operand[0].value)
+        {   case RT__ChLDB_VR: case RT__ChLDW_VR:
+            case RT__ChSTB_VR: case RT__ChSTW_VR:
+                return;
+        }
+    }
+    for (ix=0; ix<AI->operand_count; ix++)
+        if (AI->operand[ix].marker == ARRAY_MV)
+            note_array_write(AI->operand[ix].value);
+}
+
 extern void assemblez_instruction(const assembly_instruction *AI)
 {
     int32 operands_pc;
     int32 start_pc;
     int32 offset, j, topbits=0, types_byte1, types_byte2;
     int operand_rules, min=0, max=0, no_operands_given, at_seq_point = FALSE;
+    int form = LONG_OUSE;
     assembly_operand o1, o2;
     opcodez opco;
 
     ASSERT_ZCODE();
 
+    if (analysis_pass) note_assigned_variables_z(AI);
+
     if (execution_never_reaches_here) {
         if (!(execution_never_reaches_here & EXECSTATE_NOWARN)) {
             warning("This statement can never be reached");
@@ -1024,6 +1215,13 @@ extern void assemblez_instruction(const assembly_instruction *AI)
 
     no_instructions++;
 
+    if (DYNAMIC_ARRAY_ORDER)
+        note_array_references(AI,
+            (AI->internal_number == loadw_zc)
+            || (AI->internal_number == loadb_zc)
+            || (AI->internal_number == storew_zc)
+            || (AI->internal_number == storeb_zc));
+
     if (veneer_mode) sequence_point_follows = FALSE;
     if (sequence_point_follows)
     {   sequence_point_follows = FALSE; at_seq_point = TRUE;
@@ -1047,6 +1245,9 @@ extern void assemblez_instruction(const assembly_instruction *AI)
 
     operand_rules = opco.op_rules;
     execution_never_reaches_here = ((opco.flags & Rf) ? EXECSTATE_UNREACHABLE : EXECSTATE_REACHABLE);
+    last_instruction_start = zcode_ha_size;
+    last_instruction_leaves = ((opco.flags & Rf)
+        && (AI->internal_number != jump_zc));
 
     if (opco.flags2_set != 0) flags2_requirements[opco.flags2_set] = 1;
 
@@ -1060,14 +1261,14 @@ extern void assemblez_instruction(const assembly_instruction *AI)
     start_pc = zcode_ha_size;
 
     switch(opco.no)
-    {   case VAR_LONG: topbits=0xc0; min=0; max=8; break;
-        case VAR:      topbits=0xc0; min=0; max=4; break;
-        case ZERO:     topbits=0xb0; min=0; max=0; break;
-        case ONE:      topbits=0x80; min=1; max=1; break;
-        case TWO:      topbits=0x00; min=2; max=2; break;
-        case EXT:      topbits=0x00; min=0; max=4;
+    {   case VAR_LONG: topbits=0xc0; min=0; max=8; form=VAR_OUSE; break;
+        case VAR:      topbits=0xc0; min=0; max=4; form=VAR_OUSE; break;
+        case ZERO:     topbits=0xb0; min=0; max=0; form=SHORT_OUSE; break;
+        case ONE:      topbits=0x80; min=1; max=1; form=SHORT_OUSE; break;
+        case TWO:      topbits=0x00; min=2; max=2; form=LONG_OUSE; break;
+        case EXT:      topbits=0x00; min=0; max=4; form=EXT_OUSE;
                        byteout(0xbe, 0); opco.no=VAR; break;
-        case EXT_LONG: topbits=0x00; min=0; max=8;
+        case EXT_LONG: topbits=0x00; min=0; max=8; form=EXT_OUSE;
                        byteout(0xbe, 0); opco.no=VAR_LONG; break;
     }
     byteout(opco.code + topbits, 0);
@@ -1146,6 +1347,7 @@ extern void assemblez_instruction(const assembly_instruction *AI)
             if ((o1.type==LONG_CONSTANT_OT)||(o2.type==LONG_CONSTANT_OT))
             {   zcode_holding_area[start_pc] += 0xc0;
                 byteout(o1.type*0x40 + o2.type*0x10 + 0x0f, 0);
+                form = VAR_OUSE;
             }
             else
             {   if (o1.type==VARIABLE_OT) zcode_holding_area[start_pc] += 0x40;
@@ -1205,6 +1407,18 @@ extern void assemblez_instruction(const assembly_instruction *AI)
 
     Instruction_Done:
 
+    if (recording_opcode_uses())
+    {   uint32 modes = 0;
+        int i, count = 0;
+        if ((operand_rules != LABEL) && (operand_rules != TEXT))
+        {   count = no_operands_given;
+            for (i=0; i<count; i++)
+                modes |= ((uint32) (AI->operand[i].type & 3)) << (2*i);
+        }
+        note_opcode_use(AI->internal_number, start_pc,
+            operands_pc - start_pc, form, count, modes);
+    }
+
     if (asm_trace_level > 0)
     {   int i;
         printf("%5d  +%05lx %3s %-12s ", ErrorReport.line_number,
@@ -1377,6 +1591,90 @@ static void assembleg_macro(const assembly_instruction *AI)
     error_named("Assembly mistake: syntax is", opcode_syntax_string);
 }
 
+/*  Follow the evaluation stack through one Glulx instruction, for
+    $STACK_ANALYSIS. The depth is taken along the code in order; a forward
+    branch records its depth at the label, and when the label is reached
+    the depth there is the greatest of those and the depth falling through
+    (if the code can fall through). A label which only later code branches
+    back to keeps the depth of the code before it. Calls to veneer
+    routines are passed on to the dead-function map, which otherwise
+    knows nothing of them.                                                   */
+
+static void note_stack_at_branch_g(int label)
+{
+    ensure_memory_list_available(&label_stack_depths_memlist, label+1);
+    for (; label_stack_depths_size < label+1; label_stack_depths_size++)
+        label_stack_depths[label_stack_depths_size] = 0;
+    if (label_stack_depths[label] < stack_depth + 1)
+        label_stack_depths[label] = stack_depth + 1;
+}
+
+static void note_stack_at_label_g(int label)
+{   int32 depth = 0;
+    if ((label >= 0) && (label < label_stack_depths_size))
+        depth = label_stack_depths[label];
+    if ((depth > 0) && (stack_depth_lost || (depth - 1 > stack_depth)))
+        stack_depth = depth - 1;
+    stack_depth_lost = FALSE;
+}
+
+static void note_stack_use_g(const assembly_instruction *AI, opcodeg opco)
+{   int ix, no = AI->operand_count, store_ix = -1;
+    int32 pops = 0, pushes = 0;
+    const assembly_operand *AO;
+
+    if (opco.flags & St) store_ix = (opco.flags & Br) ? no-2 : no-1;
+    for (ix=0; ix<no; ix++)
+    {   AO = &AI->operand[ix];
+        if ((opco.flags & Br) && (ix == no-1)) continue;
+        if (AO->marker == VROUTINE_MV) df_note_veneer_call(AO->value);
+        if ((AO->type != LOCALVAR_OT) || (AO->value != 0)) continue;
+        if ((ix == store_ix) || ((opco.flags & St2) && (ix == no-2)))
+            pushes++;
+        else
+            pops++;
+    }
+
+    switch (opco.code)
+    {   case 0x30: case 0x34:               /* call, tailcall */
+        case 0x160: case 0x161: case 0x162: case 0x163:
+            AO = &AI->operand[0];
+            if (!is_constant_ot(AO->type)
+                || ((AO->marker != IROUTINE_MV) && (AO->marker != VROUTINE_MV)
+                    && (AO->marker != SYMBOL_MV) && (AO->marker != MAIN_MV)))
+                routine_calls_indirectly = TRUE;
+            if (opco.code >= 0x160) break;
+            /* FALLTHROUGH */
+        case 0x130:                         /* glk, or a call: operand 1
+                                               is the argument count */
+            AO = &AI->operand[1];
+            if (is_constant_ot(AO->type) && (AO->marker == 0))
+                pops += AO->value;
+            break;
+        case 0x54:                          /* stkcopy */
+            AO = &AI->operand[0];
+            if (is_constant_ot(AO->type) && (AO->marker == 0))
+                pushes += AO->value;
+            break;
+    }
+
+    stack_depth -= pops;
+    if (stack_depth < stack_depth_min) stack_depth_min = stack_depth;
+    stack_depth += pushes;
+    if (stack_depth > stack_depth_max) stack_depth_max = stack_depth;
+
+    if ((opco.flags & Br) && (AI->operand[no-1].value >= 0))
+        note_stack_at_branch_g(AI->operand[no-1].value);
+    switch (opco.code)
+    {   case 0x20: case 0x31: case 0x33: case 0x34:  /* jump, return,
+                                                        throw, tailcall */
+        case 0x104: case 0x120: case 0x122:          /* jumpabs, quit,
+                                                        restart */
+            stack_depth_lost = TRUE;
+            break;
+    }
+}
+
 extern void assembleg_instruction(const assembly_instruction *AI)
 {
     int32 opmodes_pc;
@@ -1388,6 +1686,8 @@ extern void assembleg_instruction(const assembly_instruction *AI)
 
     ASSERT_GLULX();
 
+    if (analysis_pass) note_assigned_variables_g(AI);
+
     if (execution_never_reaches_here) {
         if (!(execution_never_reaches_here & EXECSTATE_NOWARN)) {
             warning("This statement can never be reached");
@@ -1401,6 +1701,10 @@ extern void assembleg_instruction(const assembly_instruction *AI)
 
     no_instructions++;
 
+    if (DYNAMIC_ARRAY_ORDER)
+        note_array_references(AI, (AI->internal_number >= aload_gc)
+            && (AI->internal_number <= astorebit_gc));
+
     if (veneer_mode) sequence_point_follows = FALSE;
     if (sequence_point_follows)
     {   sequence_point_follows = FALSE; at_seq_point = TRUE;
@@ -1418,6 +1722,10 @@ extern void assembleg_instruction(const assembly_instruction *AI)
     opco = internal_number_to_opcode_g(AI->internal_number);
 
     execution_never_reaches_here = ((opco.flags & Rf) ? EXECSTATE_UNREACHABLE : EXECSTATE_REACHABLE);
+    last_instruction_start = zcode_ha_size;
+    last_instruction_leaves = ((opco.flags & Rf)
+        && (AI->internal_number != jump_gc)
+        && (AI->internal_number != jumpabs_gc));
 
     if (opco.op_rules & GOP_Unicode) {
         uses_unicode_features = TRUE;
@@ -1637,6 +1945,14 @@ extern void assembleg_instruction(const assembly_instruction *AI)
       zcode_holding_area[opmodes_pc+ix/2] |= j;
     }
 
+    if (STACK_ANALYSIS && track_unused_routines)
+        note_stack_use_g(AI, opco);
+
+    if (recording_opcode_uses())
+        note_opcode_use(AI->internal_number, start_pc,
+            opmodes_pc - start_pc, GLULX_OUSE + (opmodes_pc - start_pc),
+            opco.no, 0);
+
     /* Print assembly trace. */
     if (asm_trace_level > 0) {
       int i;
@@ -1710,6 +2026,8 @@ extern void assemble_label_no(int n)
         printf("%5d  +%05lx    .L%d\n", ErrorReport.line_number,
             ((long int) zmachine_pc), n);
     set_label_offset(n, zmachine_pc);
+    if (glulx_mode && STACK_ANALYSIS && track_unused_routines)
+        note_stack_at_label_g(n);
     execution_never_reaches_here = EXECSTATE_REACHABLE;
 }
 
@@ -1742,6 +2060,223 @@ extern void define_symbol_label(int symbol)
     labels[label].symbol = symbol;
 }
 
+/* ------------------------------------------------------------------------- */
+/*   With $REORDER_BLOCKS, blocks of code which are rarely run are moved to  */
+/*   the end of the routine, so that the usual path runs straight on rather  */
+/*   than branching around them. Such a block must be entered only by       */
+/*   falling through a conditional branch which otherwise skips it. That     */
+/*   branch is turned round to jump into the block instead:                  */
+/*                                                                           */
+/*          @jz x ?L1;                       @jnz x ?L2;                     */
+/*          <rarely run>                 .L1;                                */
+/*      .L1;                     ==>         ...                             */
+/*          ...                          .L2;                                */
+/*                                           <rarely run>                    */
+/*                                           @jump L1;  (unless it returns)  */
+/*                                                                           */
+/*   The code generator brackets each candidate with begin_cold_block() and  */
+/*   end_cold_block(). Nothing moves until the routine is complete, when     */
+/*   move_cold_blocks() rearranges the holding area and the labels; the      */
+/*   branches are then shortened by transfer_routine_z/g() as usual.         */
+/* ------------------------------------------------------------------------- */
+
+extern int begin_cold_block(void)
+{   /*  Called just after the conditional branch which skips the block.
+        Returns a number to pass to end_cold_block(), or -1 if there is no
+        such branch.                                                         */
+
+    int32 s = zcode_ha_size;
+    coldblock *cb;
+
+    if ((!REORDER_BLOCKS) || execution_never_reaches_here
+        || (last_instruction_start < 0))
+        return -1;
+
+    if (!glulx_mode)
+    {   if ((s < 2) || (zcode_markers[s-2] != BRANCH_MV)) return -1;
+    }
+    else
+    {   int op = zcode_holding_area[last_instruction_start];
+        if ((s < 4) || (zcode_markers[s-4] < BRANCH_MV)
+            || (zcode_markers[s-4] >= BRANCHMAX_MV))
+            return -1;
+        /*  jz/jnz, jeq/jne, jlt/jge, jgt/jle, jltu/jgeu and jgtu/jleu are
+            the opcodes 0x22 to 0x2D, and each pair differs only in bit 0.  */
+        if ((op < 0x22) || (op > 0x2D)) return -1;
+    }
+
+    ensure_memory_list_available(&cold_blocks_memlist, no_cold_blocks+1);
+    cb = &cold_blocks[no_cold_blocks];
+    cb->guard = last_instruction_start;
+    cb->start = s;
+    cb->end = -1;
+    cb->resume = FALSE;
+    cb->tail_start = cb->tail_end = s;
+    return no_cold_blocks++;
+}
+
+extern void end_cold_block(int block, int must_leave)
+{   /*  Called at the end of the block, before any label is placed there.
+        If must_leave is set, the block is only taken to be rarely run if
+        it ends by leaving the routine (a return or a quit, not a jump).     */
+
+    coldblock *cb;
+    int i;
+
+    if (block < 0) return;
+    cb = &cold_blocks[block];
+    if (zcode_ha_size == cb->start) return;
+    if (must_leave
+        && !(execution_never_reaches_here && last_instruction_leaves))
+        return;
+
+    cb->end = zcode_ha_size;
+    cb->resume = !execution_never_reaches_here;
+
+    /*  Any block begun since lies inside this one, and moves with it.       */
+    for (i=block+1; i<no_cold_blocks; i++) cold_blocks[i].end = -1;
+}
+
+static int label_offset_compare(const void *a, const void *b)
+{   int la = *((const int *) a), lb = *((const int *) b);
+    if (labels[la].offset != labels[lb].offset)
+        return (labels[la].offset < labels[lb].offset) ? -1 : 1;
+    return la - lb;
+}
+
+static int opcode_use_offset_compare(const void *a, const void *b)
+{   int32 oa = ((const opcodeuse *) a)->offset,
+          ob = ((const opcodeuse *) b)->offset;
+    return (oa < ob) ? -1 : ((oa > ob) ? 1 : 0);
+}
+
+static void move_cold_blocks(void)
+{   int32 base, hot_size, hot_end, s, e, p, pos, j;
+    int b, n, label, moved;
+    coldblock *cb;
+
+    base = zmachine_pc - zcode_ha_size; hot_size = zcode_ha_size;
+
+    /*  (1) Check that each block is still skipped by its branch, which is
+            to say that the branch goes to a label at the block's end, and
+            turn the branch round to go to a new label at its start. A block
+            which can run on is given a jump back, added at the very end.    */
+
+    moved = 0;
+    for (b=0, p=0; b<no_cold_blocks; b++)
+    {   cb = &cold_blocks[b];
+        s = cb->start; e = cb->end;
+        if ((e < 0) || (cb->guard < p)) { cb->end = -1; continue; }
+
+        if (!glulx_mode)
+            label = ((zcode_holding_area[s-2] & 0x7f) << 8)
+                + zcode_holding_area[s-1];
+        else
+            label = (zcode_holding_area[s-4] << 24)
+                + (zcode_holding_area[s-3] << 16)
+                + (zcode_holding_area[s-2] << 8) + zcode_holding_area[s-1];
+        if ((label < 0) || (label >= next_label)
+            || (labels[label].offset != base + e))
+        {   cb->end = -1; continue;
+        }
+
+        n = next_label++;
+        set_label_offset(n, base + s);
+        if (!glulx_mode)
+        {   zcode_holding_area[s-2] = ((zcode_holding_area[s-2] & 0x80) ^ 0x80)
+                + ((n >> 8) & 0x7f);
+            zcode_holding_area[s-1] = n & 0xff;
+        }
+        else
+        {   zcode_holding_area[cb->guard] ^= 1;
+            zcode_holding_area[s-4] = (n >> 24) & 0xff;
+            zcode_holding_area[s-3] = (n >> 16) & 0xff;
+            zcode_holding_area[s-2] = (n >> 8) & 0xff;
+            zcode_holding_area[s-1] = n & 0xff;
+        }
+
+        if (cb->resume)
+        {   int saved_state = execution_never_reaches_here,
+                saved_point = sequence_point_follows;
+            execution_never_reaches_here = EXECSTATE_REACHABLE;
+            sequence_point_follows = FALSE;
+            cb->tail_start = zcode_ha_size;
+            assemble_jump(label);
+            cb->tail_end = zcode_ha_size;
+            execution_never_reaches_here = saved_state;
+            sequence_point_follows = saved_point;
+        }
+        moved++;
+        p = e;
+    }
+
+    if (moved == 0) { no_cold_blocks = 0; return; }
+
+    if (asm_trace_level >= 3)
+        printf("Moving %d rarely run block%s to the end of the routine\n",
+            moved, (moved == 1) ? "" : "s");
+
+    /*  (2) Work out where each byte goes: first the code which stays, closed
+            up, then the blocks in order, each followed by its jump back.    */
+
+    ensure_memory_list_available(&layout_positions_memlist, zcode_ha_size);
+    pos = 0; p = 0;
+    for (b=0; b<no_cold_blocks; b++)
+    {   cb = &cold_blocks[b];
+        if (cb->end < 0) continue;
+        for (; p<cb->start; p++) layout_positions[p] = pos++;
+        p = cb->end;
+    }
+    for (; p<hot_size; p++) layout_positions[p] = pos++;
+    hot_end = pos;
+    for (b=0; b<no_cold_blocks; b++)
+    {   cb = &cold_blocks[b];
+        if (cb->end < 0) continue;
+        for (p=cb->start; p<cb->end; p++) layout_positions[p] = pos++;
+        for (p=cb->tail_start; p<cb->tail_end; p++)
+            layout_positions[p] = pos++;
+    }
+    no_cold_blocks = 0;
+
+    /*  (3) Move the code and its markers.                                   */
+
+    ensure_memory_list_available(&layout_bytes_memlist, zcode_ha_size);
+    ensure_memory_list_available(&layout_markers_memlist, zcode_ha_size);
+    for (p=0; p<zcode_ha_size; p++)
+    {   layout_bytes[layout_positions[p]] = zcode_holding_area[p];
+        layout_markers[layout_positions[p]] = zcode_markers[p];
+    }
+    for (p=0; p<zcode_ha_size; p++)
+    {   zcode_holding_area[p] = layout_bytes[p];
+        zcode_markers[p] = layout_markers[p];
+    }
+
+    /*  (4) Move the labels (sequence points included), and put the list of
+            them back into increasing PC order.                              */
+
+    n = 0;
+    for (label = first_label; label != -1; label = labels[label].next)
+    {   ensure_memory_list_available(&layout_labels_memlist, n+1);
+        layout_labels[n++] = label;
+        p = labels[label].offset - base;
+        labels[label].offset = base
+            + ((p >= hot_size) ? hot_end : layout_positions[p]);
+    }
+    qsort(layout_labels, n, sizeof(int), label_offset_compare);
+    for (j=0; j<n; j++)
+    {   labels[layout_labels[j]].prev = (j > 0) ? layout_labels[j-1] : -1;
+        labels[layout_labels[j]].next = (j < n-1) ? layout_labels[j+1] : -1;
+    }
+    first_label = layout_labels[0]; last_label = layout_labels[n-1];
+
+    /*  (5) And the opcode usage records, if any are being kept.             */
+
+    for (j=opcode_uses_start; j<no_opcode_uses; j++)
+        opcode_uses[j].offset = layout_positions[opcode_uses[j].offset];
+    qsort(opcode_uses + opcode_uses_start, no_opcode_uses - opcode_uses_start,
+        sizeof(opcodeuse), opcode_use_offset_compare);
+}
+
 /* The local variables must already be set up; no_locals indicates
    how many exist. */
 extern int32 assemble_routine_header(int routine_asterisked, char *name,
@@ -1751,6 +2286,7 @@ extern int32 assemble_routine_header(int routine_asterisked, char *name,
     int name_length;
 
     execution_never_reaches_here = EXECSTATE_REACHABLE;
+    no_cold_blocks = 0; last_instruction_start = -1;
 
     ensure_memory_list_available(&variables_memlist, MAX_LOCAL_VARIABLES);
     for (i=0; i<MAX_LOCAL_VARIABLES; i++) variables[i].usage = FALSE;
@@ -1771,6 +2307,9 @@ extern int32 assemble_routine_header(int routine_asterisked, char *name,
     }
 
     routine_start_pc = zmachine_pc;
+    stack_depth = 0; stack_depth_max = 0; stack_depth_min = 0;
+    routine_calls_indirectly = FALSE;
+    stack_depth_lost = FALSE; label_stack_depths_size = 0;
 
     if (track_unused_routines) {
         /* The name of an embedded function is in a temporary buffer,
@@ -2010,6 +2549,8 @@ void assemble_routine_end(int embedded_flag, debug_locations locations)
       }
     }
 
+    if (REORDER_BLOCKS) move_cold_blocks();
+
     /* Dump the contents of the current routine into longer-term Z-code
        storage                                                               */
 
@@ -2019,7 +2560,14 @@ void assemble_routine_end(int embedded_flag, debug_locations locations)
       transfer_routine_g();
 
     if (track_unused_routines)
+    {   /* A Glulx call frame is 8 bytes of header, 4 of locals format
+           and the locals themselves; the caller's stub adds 16 more    */
+        if (glulx_mode && STACK_ANALYSIS)
+            df_note_function_stack(12 + 4*no_locals
+                + 4*(stack_depth_max - stack_depth_min),
+                routine_calls_indirectly);
         df_note_function_end(zmachine_pc);
+    }
 
     /* Tell the debugging file about the routine just ended.                 */
 
@@ -2184,6 +2732,8 @@ static void transfer_routine_z(void)
         }
     }
 
+    if (recording_opcode_uses()) finish_opcode_uses(rstart_pc);
+
     /*  (2) Calculate the new positions of the labels.  Note that since the
             long/short decision was taken on the basis of the old labels,
             and since the new labels are slightly closer together because
@@ -2411,6 +2961,8 @@ static void transfer_routine_g(void)
       }
     }
 
+    if (recording_opcode_uses()) finish_opcode_uses(rstart_pc);
+
     /*  (2) Calculate the new positions of the labels.  Note that since the
             long/short decision was taken on the basis of the old labels,
             and since the new labels are slightly closer together because
@@ -3660,8 +4212,11 @@ S (store), SS (two stores), R (execution never continues)");
     if (!error_flag) {
         if (is_macro)
             assembleg_macro(&AI);
-        else
+        else {
+            if (AI.internal_number == astore_gc)
+                check_object_tree_write(AI.operand[0], AI.operand[1]);
             assembleg_instruction(&AI);
+        }
     }
 
     if (error_flag) {
@@ -3679,6 +4234,243 @@ extern void parse_assembly(void)
     parse_assembly_g();
 }
 
+/* ========================================================================= */
+/*   Reporting opcode usage: a histogram of the instructions emitted, by     */
+/*   opcode, form, operand types and final length                            */
+/* ------------------------------------------------------------------------- */
+
+typedef struct opcodeusegroup_s {
+    opcodeuse key;        /* The offset and veneer fields are not used */
+    int32 game_count;
+    int32 veneer_count;
+    int32 bytes;
+} opcodeusegroup;
+
+static int opcode_use_key_compare(const opcodeuse *x, const opcodeuse *y)
+{   if (x->internal_number != y->internal_number)
+        return (x->internal_number < y->internal_number) ? -1 : 1;
+    if (x->form != y->form) return (x->form < y->form) ? -1 : 1;
+    if (x->operands != y->operands)
+        return (x->operands < y->operands) ? -1 : 1;
+    if (x->modes != y->modes) return (x->modes < y->modes) ? -1 : 1;
+    if (x->length != y->length) return (x->length < y->length) ? -1 : 1;
+    return 0;
+}
+
+static int opcode_use_compare(const void *a, const void *b)
+{   return opcode_use_key_compare((const opcodeuse *) a,
+        (const opcodeuse *) b);
+}
+
+/* Most bytes first; ties are broken by the key, so the order is stable */
+static int opcode_use_group_compare(const void *a, const void *b)
+{   const opcodeusegroup *x = a, *y = b;
+    if (x->bytes != y->bytes) return (x->bytes > y->bytes) ? -1 : 1;
+    return opcode_use_key_compare(&x->key, &y->key);
+}
+
+static char *opcode_use_name(int internal_number)
+{   if (internal_number == -1) return "(custom)";
+    if (!glulx_mode)
+        return (char *) internal_number_to_opcode_z(internal_number).name;
+    return (char *) internal_number_to_opcode_g(internal_number).name;
+}
+
+static char *opcode_use_form(int form)
+{   switch (form)
+    {   case LONG_OUSE:  return "long";
+        case SHORT_OUSE: return "short";
+        case VAR_OUSE:   return "var";
+        case EXT_OUSE:   return "ext";
+        case GLULX_OUSE+1: return "op1";
+        case GLULX_OUSE+2: return "op2";
+        case GLULX_OUSE+4: return "op4";
+    }
+    return "?";
+}
+
+/* Z-code operand types are written L (large constant), S (small constant)
+   or V (variable). Glulx addressing modes are written as 0 (zero), c1/c2/c4
+   (constant), a1/a2/a4 (address), sp (stack), l1/l2/l4 (local) and
+   r1/r2/r4 (RAM), following the Glulx specification's mode table. */
+
+static void describe_opcode_use_operands(const opcodeuse *ou, char *buf)
+{   static char *zmodes[4] = { "L", "S", "V", "?" };
+    static char *gmodes[16] = { "0", "c1", "c2", "c4", "?", "a1", "a2", "a4",
+        "sp", "l1", "l2", "l4", "?", "r1", "r2", "r4" };
+    int k;
+
+    buf[0] = 0;
+    for (k=0; k<ou->operands; k++)
+    {   if (k > 0 && glulx_mode) strcat(buf, " ");
+        if (!glulx_mode)
+            strcat(buf, zmodes[(ou->modes >> (2*k)) & 3]);
+        else
+            strcat(buf, gmodes[(ou->modes >> (4*k)) & 15]);
+    }
+    if (ou->operands == 0) strcat(buf, "-");
+}
+
+extern void list_opcode_usage(int json)
+{   opcodeusegroup *groups;
+    int32 i, j, no_groups = 0;
+    int32 total_count = 0, total_veneer = 0, total_bytes = 0,
+        veneer_bytes = 0;
+    char buf[64];
+
+    /* Drop the records for routines which were stripped from the output */
+    if (OMIT_UNUSED_ROUTINES)
+    {   for (i=0, j=0; i<no_opcode_uses; i++)
+        {   int stripped;
+            df_stripped_offset_for_code_offset(opcode_uses[i].offset,
+                &stripped);
+            if (!stripped) opcode_uses[j++] = opcode_uses[i];
+        }
+        no_opcode_uses = j;
+    }
+
+    qsort(opcode_uses, no_opcode_uses, sizeof(opcodeuse), opcode_use_compare);
+
+    groups = my_calloc(sizeof(opcodeusegroup), no_opcode_uses+1,
+        "opcode usage groups");
+    for (i=0; i<no_opcode_uses; i++)
+    {   opcodeuse *ou = &opcode_uses[i];
+        opcodeusegroup *g;
+        if (no_groups == 0
+            || opcode_use_key_compare(ou, &groups[no_groups-1].key) != 0)
+        {   g = &groups[no_groups++];
+            g->key = *ou;
+        }
+        else g = &groups[no_groups-1];
+        if (ou->veneer) g->veneer_count++; else g->game_count++;
+        g->bytes += ou->length;
+
+        total_count++;
+        total_bytes += ou->length;
+        if (ou->veneer) { total_veneer++; veneer_bytes += ou->length; }
+    }
+    qsort(groups, no_groups, sizeof(opcodeusegroup),
+        opcode_use_group_compare);
+
+    if (json)
+    {   printf("{\n  \"target\": \"%s\",\n", (glulx_mode)?"glulx":"zcode");
+        printf("  \"instructions\": %ld,\n  \"bytes\": %ld,\n",
+            (long int) total_count, (long int) total_bytes);
+        printf("  \"veneer_instructions\": %ld,\n  \"veneer_bytes\": %ld,\n",
+            (long int) total_veneer, (long int) veneer_bytes);
+        printf("  \"opcodes\": [");
+        for (i=0; i<no_groups; i++)
+        {   opcodeusegroup *g = &groups[i];
+            describe_opcode_use_operands(&g->key, buf);
+            printf("%s\n    { \"opcode\": \"%s\", \"form\": \"%s\", \
+\"operands\": \"%s\", \"length\": %ld, \"game\": %ld, \"veneer\": %ld, \
+\"bytes\": %ld }", (i>0)?",":"",
+                opcode_use_name(g->key.internal_number),
+                opcode_use_form(g->key.form), buf, (long int) g->key.length,
+                (long int) g->game_count, (long int) g->veneer_count,
+                (long int) g->bytes);
+        }
+        printf("\n  ]\n}\n");
+    }
+    else
+    {   printf("\nEmitted instructions by opcode, form, operands and length:\n\n");
+        printf("  %-16s %-5s %-20s %4s %8s %8s %8s\n",
+            "Opcode", "Form", "Operands", "Len", "Game", "Veneer", "Bytes");
+        for (i=0; i<no_groups; i++)
+        {   opcodeusegroup *g = &groups[i];
+            describe_opcode_use_operands(&g->key, buf);
+            printf("  %-16s %-5s %-20s %4ld %8ld %8ld %8ld\n",
+                opcode_use_name(g->key.internal_number),
+                opcode_use_form(g->key.form), buf, (long int) g->key.length,
+                (long int) g->game_count, (long int) g->veneer_count,
+                (long int) g->bytes);
+        }
+        printf("\n%6ld instructions (%ld in veneer) in %ld bytes (%ld in veneer)\n",
+            (long int) total_count, (long int) total_veneer,
+            (long int) total_bytes, (long int) veneer_bytes);
+    }
+
+    my_free(&groups, "opcode usage groups");
+}
+
+/* ------------------------------------------------------------------------- */
+/*   Decoding the instructions of a finished Glulx story file: used by the   */
+/*   translation into C ("ctrans.c") and by the snapshot of SnapshotInit     */
+/*   ("snapshot.c"), both of which read the code back from the image.        */
+/* ------------------------------------------------------------------------- */
+
+static short int opcode_index_g[0x240]; /* Opcode number to table entry, or
+                                           -1 if there is no such opcode     */
+
+static uint32 read_image_bytes(const uchar *mem, uint32 addr, int size)
+{   uint32 v = 0;
+    while (size-- > 0) v = (v << 8) | mem[addr++];
+    return v;
+}
+
+/*  Decodes the instruction at mem[addr], where mem[] is length bytes long,
+    into *gi, and returns the address of the next instruction. Operands are
+    marked as loads, stores or branches, and constants are sign-extended.
+    If the instruction cannot be decoded, -1 is returned and *problem says
+    why.                                                                     */
+
+extern int32 decode_glulx_instruction(const uchar *mem, uint32 length,
+    uint32 addr, glulx_instruction *gi, char **problem)
+{   uint32 modes;
+    int32 code;
+    int i, size, index;
+    const opcodeg *op;
+
+    *problem = "instruction beyond the end of memory";
+    if (addr >= length) return -1;
+    code = mem[addr];
+    if (code < 0x80) addr += 1;
+    else if (code < 0xC0)
+    {   if (addr + 1 >= length) return -1;
+        code = read_image_bytes(mem, addr, 2) - 0x8000; addr += 2;
+    }
+    else { *problem = "four-byte opcode"; return -1; }
+
+    index = (code < 0x240) ? opcode_index_g[code] : -1;
+    if (index < 0) { *problem = "unknown opcode"; return -1; }
+    op = &opcodes_table_g[index];
+    gi->code = code;
+    gi->name = (char *) op->name;
+    gi->no = op->no;
+
+    modes = addr;
+    addr += (op->no + 1)/2;
+    for (i=0; i<op->no; i++)
+    {   glulx_operand *o = &gi->ops[i];
+        if (modes + i/2 >= length)
+        {   *problem = "instruction beyond the end of memory"; return -1;
+        }
+        o->mode = (mem[modes + i/2] >> (4*(i%2))) & 15;
+        o->kind = 'L';
+        if (code == 0x32) o->kind = (i == 0) ? 'S' : 'B';
+        else
+        {   if ((op->flags & Br) && (i == op->no-1)) o->kind = 'B';
+            if ((op->flags & St) && (i == op->no-1)) o->kind = 'S';
+            if ((op->flags & St2) && (i == op->no-2)) o->kind = 'S';
+        }
+        switch (o->mode)
+        {   case 0: case 8: size = 0; break;
+            case 1: case 5: case 9: case 13: size = 1; break;
+            case 2: case 6: case 10: case 14: size = 2; break;
+            case 3: case 7: case 11: case 15: size = 4; break;
+            default: *problem = "bad operand mode"; return -1;
+        }
+        if ((addr > length) || ((uint32) size > length - addr))
+        {   *problem = "instruction beyond the end of memory"; return -1;
+        }
+        o->value = read_image_bytes(mem, addr, size);
+        if ((o->mode == 1) && (o->value & 0x80)) o->value |= 0xFFFFFF00;
+        if ((o->mode == 2) && (o->value & 0x8000)) o->value |= 0xFFFF0000;
+        addr += size;
+    }
+    return addr;
+}
+
 /* ========================================================================= */
 /*   Data structure management routines                                      */
 /* ------------------------------------------------------------------------- */
@@ -3688,6 +4480,11 @@ extern void init_asm_vars(void)
 
     for (i=0;i<16;i++) flags2_requirements[i]=0;
 
+    for (i=0; i<0x240; i++) opcode_index_g[i] = -1;
+    for (i=0; i<(int) (sizeof(opcodes_table_g)/sizeof(opcodeg)); i++)
+        if (opcodes_table_g[i].code < 0x240)
+            opcode_index_g[opcodes_table_g[i].code] = i;
+
     uses_unicode_features = FALSE;
     uses_memheap_features = FALSE;
     uses_acceleration_features = FALSE;
@@ -3697,6 +4494,10 @@ extern void init_asm_vars(void)
 
     labels = NULL;
     sequence_points = NULL;
+    opcode_uses = NULL;
+    cold_blocks = NULL;
+    layout_positions = NULL; layout_bytes = NULL; layout_markers = NULL;
+    layout_labels = NULL;
     sequence_point_follows = TRUE;
     label_moved_error_already_given = FALSE;
 
@@ -3711,6 +4512,10 @@ extern void asm_begin_pass(void)
     labeluse_size = 0;
     next_sequence_point = 0;
     zcode_ha_size = 0;
+    no_opcode_uses = 0;
+    opcode_uses_start = 0;
+    no_cold_blocks = 0;
+    last_instruction_start = -1;
     execution_never_reaches_here = EXECSTATE_REACHABLE;
 }
 
@@ -3726,9 +4531,30 @@ extern void asm_allocate_arrays(void)
     initialise_memory_list(&labeluse_memlist,
         sizeof(int), 1000, (void**)&labeluse,
         "labeluse");
+    initialise_memory_list(&label_stack_depths_memlist,
+        sizeof(int32), 1000, (void**)&label_stack_depths,
+        "label stack depths");
     initialise_memory_list(&sequence_points_memlist,
         sizeof(sequencepointinfo), 1000, (void**)&sequence_points,
         "sequence points");
+    initialise_memory_list(&opcode_uses_memlist,
+        sizeof(opcodeuse), 1000, (void**)&opcode_uses,
+        "opcode usage records");
+    initialise_memory_list(&cold_blocks_memlist,
+        sizeof(coldblock), 64, (void**)&cold_blocks,
+        "rarely run blocks");
+    initialise_memory_list(&layout_positions_memlist,
+        sizeof(int32), 2000, (void**)&layout_positions,
+        "block layout workspace");
+    initialise_memory_list(&layout_bytes_memlist,
+        sizeof(uchar), 2000, (void**)&layout_bytes,
+        "block layout workspace");
+    initialise_memory_list(&layout_markers_memlist,
+        sizeof(uchar), 2000, (void**)&layout_markers,
+        "block layout workspace");
+    initialise_memory_list(&layout_labels_memlist,
+        sizeof(int), 1000, (void**)&layout_labels,
+        "block layout workspace");
 
     initialise_memory_list(&zcode_holding_area_memlist,
         sizeof(uchar), 2000, (void**)&zcode_holding_area,
@@ -3755,7 +4581,15 @@ extern void asm_free_arrays(void)
     deallocate_memory_list(&variables_memlist);
 
     deallocate_memory_list(&labels_memlist);
+    deallocate_memory_list(&labeluse_memlist);
+    deallocate_memory_list(&label_stack_depths_memlist);
     deallocate_memory_list(&sequence_points_memlist);
+    deallocate_memory_list(&opcode_uses_memlist);
+    deallocate_memory_list(&cold_blocks_memlist);
+    deallocate_memory_list(&layout_positions_memlist);
+    deallocate_memory_list(&layout_bytes_memlist);
+    deallocate_memory_list(&layout_markers_memlist);
+    deallocate_memory_list(&layout_labels_memlist);
 
     deallocate_memory_list(&zcode_holding_area_memlist);
     deallocate_memory_list(&zcode_markers_memlist);
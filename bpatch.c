@@ -116,6 +116,7 @@ static int32 backpatch_value_z(int32 value)
     {   case STRING_MV:
             value += strings_offset/scale_factor; break;
         case ARRAY_MV:
+            value = relocated_array_offset(value);
             value += variables_offset - zcode_compact_globals_adjustment; break;
         case STATIC_ARRAY_MV:
             value += static_arrays_offset; break;
@@ -276,13 +277,14 @@ static int32 backpatch_value_g(int32 value)
             value += code_offset;
             break;
         case ARRAY_MV:
+            value = relocated_array_offset(value);
             value += arrays_offset; break;
         case STATIC_ARRAY_MV:
             value += static_arrays_offset; break;
         case VARIABLE_MV:
             value = variables_offset + (4*value); break;
         case OBJECT_MV:
-            value = object_tree_offset + (OBJECT_BYTE_LENGTH*(value-1)); 
+            value = object_tree_offset + object_offset_g(value);
             break;
         case VROUTINE_MV:
             if ((value<0) || (value>=VENEER_ROUTINES))
@@ -323,7 +325,8 @@ static int32 backpatch_value_g(int32 value)
                 value = sorted_actions[value].internal_to_ext;
             break;
         case INHERIT_MV:
-            valaddr = (prop_values_offset - Write_RAM_At) + value;
+            valaddr = (prop_values_offset - Write_RAM_At)
+                + relocated_property_offset_g(value);
             value = ReadInt32(zmachine_paged_memory + valaddr);
             break;
         case INHERIT_INDIV_MV:
@@ -397,8 +400,7 @@ static int32 backpatch_value_g(int32 value)
                     case STATIC_ARRAY_T: value += static_arrays_offset; break;
                     case OBJECT_T:
                     case CLASS_T:
-                      value = object_tree_offset + 
-                        (OBJECT_BYTE_LENGTH*(value-1)); 
+                      value = object_tree_offset + object_offset_g(value);
                       break;
                     case ATTRIBUTE_T:
                       /* value is unchanged */
@@ -502,7 +504,9 @@ extern void backpatch_zmachine_image_z(void)
         {   case PROP_DEFAULTS_ZA:   addr = prop_defaults_offset; break;
             case PROP_ZA:            addr = prop_values_offset; break;
             case INDIVIDUAL_PROP_ZA: addr = individuals_offset; break;
-            case DYNAMIC_ARRAY_ZA:   addr = variables_offset; break;
+            case DYNAMIC_ARRAY_ZA:   addr = variables_offset;
+                                     offset = relocated_array_offset(offset);
+                                     break;
             case STATIC_ARRAY_ZA:    addr = static_arrays_offset; break;
             default:
                 if (compiler_error("Illegal area to backpatch"))
@@ -548,9 +552,13 @@ extern void backpatch_zmachine_image_g(void)
 
             switch(zmachine_area) {   
         case PROP_DEFAULTS_ZA:   addr = prop_defaults_offset+4; break;
-        case PROP_ZA:            addr = prop_values_offset; break;
+        case PROP_ZA:            addr = prop_values_offset;
+                                 offset = relocated_property_offset_g(offset);
+                                 break;
         case INDIVIDUAL_PROP_ZA: addr = individuals_offset; break;
-        case DYNAMIC_ARRAY_ZA:   addr = arrays_offset; break;
+        case DYNAMIC_ARRAY_ZA:   addr = arrays_offset;
+                                 offset = relocated_array_offset(offset);
+                                 break;
         case GLOBALVAR_ZA:       addr = variables_offset; break;
         /* STATIC_ARRAY_ZA is in ROM and therefore not handled here */
         default:
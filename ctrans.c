@@ -0,0 +1,479 @@
+/* ------------------------------------------------------------------------- */
+/*   "ctrans" : Translation of the finished Glulx code area into C           */
+/*              ($GLULX_C_OUTPUT)                                            */
+/*                                                                           */
+/*   Part of Inform 6.43                                                     */
+/*   copyright (c) Graham Nelson 1993 - 2024                                 */
+/*                                                                           */
+/*   This works from the story file as written, so that every backpatch has  */
+/*   been made and any stripped routines are gone. The code area contains    */
+/*   only functions, and Inform never uses a four-byte opcode, so a byte     */
+/*   $C0 or $C1 where an instruction would begin is the start of the next    */
+/*   function. Each function becomes a C function and each branch a goto;    */
+/*   the value stack, memory, calls by address and everything else are left  */
+/*   to the runtime in tools/glulxc, whose header "glulxc.h" the output      */
+/*   includes. Instructions are decoded by decode_glulx_instruction() in     */
+/*   "asm.c".                                                                */
+/* ------------------------------------------------------------------------- */
+
+#include "header.h"
+
+static uchar *ct_image;            /* The story file                         */
+static int32 ct_length, ct_code_start, ct_code_end, ct_ramstart;
+static uchar *ct_flags;            /* One per byte of the code area:         */
+#define CT_FUNCTION 1              /*   a function starts here               */
+#define CT_INSTRUCTION 2           /*   an instruction starts here           */
+#define CT_TARGET 4                /*   a branch or jump lands here          */
+static FILE *ct_file;
+static int ct_failed;
+
+static void ct_error(char *msg, int32 addr)
+{   if (!ct_failed)
+        error_fmt("Cannot translate the story file to C: %s at $%06lx",
+            msg, (long int) addr);
+    ct_failed = TRUE;
+}
+
+static uint32 ct_read(int32 addr, int size)
+{   uint32 v = 0;
+    while (size-- > 0) v = (v << 8) | ct_image[addr++];
+    return v;
+}
+
+/*  Decodes the instruction at addr into *gi, and returns the address of
+    the next instruction, or -1 if it cannot be translated.                  */
+
+static int32 ct_decode(int32 addr, glulx_instruction *gi)
+{   int32 next;
+    int i;
+    char *problem;
+
+    next = decode_glulx_instruction(ct_image, ct_length, addr, gi, &problem);
+    if (next < 0) { ct_error(problem, addr); return -1; }
+
+    for (i=0; i<gi->no; i++)
+    {   glulx_operand *o = &gi->ops[i];
+        if ((o->kind == 'S') && (o->mode >= 1) && (o->mode <= 3))
+        {   ct_error("store to a constant", addr); return -1;
+        }
+        if ((o->mode >= 9) && (o->mode <= 11) && (o->value % 4))
+        {   ct_error("local variable not on a word boundary", addr);
+            return -1;
+        }
+        if ((o->kind == 'B') && (o->mode > 3))
+        {   ct_error("computed branch", addr); return -1;
+        }
+    }
+    return next;
+}
+
+/*  Returns the address a branch operand leads to, or 0 or 1 for a return. */
+
+static int32 ct_branch_target(const glulx_operand *o, int32 next)
+{   if ((o->value == 0) || (o->value == 1)) return o->value;
+    return next + o->value - 2;
+}
+
+static int32 ct_function_body(int32 addr, int32 *no_locals)
+{   int32 n = 0;
+    for (addr++; (ct_image[addr] != 0) || (ct_image[addr+1] != 0); addr += 2)
+    {   if (ct_image[addr] != 4)
+        {   ct_error("locals which are not four bytes wide", addr);
+            return -1;
+        }
+        n += ct_image[addr+1];
+    }
+    *no_locals = n;
+    return addr+2;
+}
+
+/*  Finds the functions, instructions and branch targets in the code area. */
+
+static void ct_scan(void)
+{   int32 addr = ct_code_start, next, n;
+    glulx_instruction gi;
+    int i;
+
+    while ((addr < ct_code_end) && !ct_failed)
+    {   if ((ct_image[addr] != 0xC0) && (ct_image[addr] != 0xC1))
+        {   ct_error("expected the start of a function", addr); return;
+        }
+        ct_flags[addr - ct_code_start] |= CT_FUNCTION;
+        addr = ct_function_body(addr, &n);
+        while ((addr >= 0) && (addr < ct_code_end)
+               && (ct_image[addr] != 0xC0) && (ct_image[addr] != 0xC1))
+        {   ct_flags[addr - ct_code_start] |= CT_INSTRUCTION;
+            next = ct_decode(addr, &gi);
+            if (next < 0) return;
+            for (i=0; i<gi.no; i++)
+            {   int32 target;
+                if (gi.ops[i].kind == 'B')
+                    target = ct_branch_target(&gi.ops[i], next);
+                else if ((gi.code == 0x104) && (gi.ops[i].mode >= 1)
+                    && (gi.ops[i].mode <= 3)) target = gi.ops[i].value;
+                else continue;
+                if ((target >= ct_code_start) && (target < ct_code_end))
+                    ct_flags[target - ct_code_start] |= CT_TARGET;
+                else if ((target != 0) && (target != 1))
+                {   ct_error("branch out of the code area", addr); return;
+                }
+            }
+            addr = next;
+        }
+    }
+}
+
+static int ct_is_function(uint32 addr)
+{   return (addr >= (uint32) ct_code_start) && (addr < (uint32) ct_code_end)
+        && (ct_flags[addr - ct_code_start] & CT_FUNCTION);
+}
+
+/*  Writes a C expression for loading operand o, read with the given width
+    if it refers to memory. The stack, locals and constants are truncated
+    to that width (Inform never uses locals with @copys or @copyb).          */
+
+static void ct_load(const glulx_operand *o, int width)
+{   char *mem = (width == 4) ? "MEM4" : (width == 2) ? "MEM2" : "MEM1";
+    char *mask = (width == 4) ? "" : (width == 2) ? " & 0xFFFF" : " & 0xFF";
+    switch (o->mode)
+    {   case 0: fprintf(ct_file, "0"); return;
+        case 1: case 2: case 3:
+            fprintf(ct_file, "0x%lxU", (unsigned long) ((width == 4)
+                ? o->value : (width == 2) ? (o->value & 0xFFFF)
+                : (o->value & 0xFF)));
+            return;
+        case 5: case 6: case 7:
+            fprintf(ct_file, "%s(0x%lxU)", mem, (unsigned long) o->value);
+            return;
+        case 8:
+            if (width == 4) fprintf(ct_file, "POP()");
+            else fprintf(ct_file, "(POP()%s)", mask);
+            return;
+        case 9: case 10: case 11:
+            if (width == 4)
+                fprintf(ct_file, "LOC(%lu)", (unsigned long) o->value/4);
+            else fprintf(ct_file, "(LOC(%lu)%s)",
+                (unsigned long) o->value/4, mask);
+            return;
+        default:
+            fprintf(ct_file, "%s(0x%lxU)", mem,
+                (unsigned long) (ct_ramstart + o->value));
+            return;
+    }
+}
+
+static void ct_store(const glulx_operand *o, char *value, int width)
+{   char *w = (width == 4) ? "W4" : (width == 2) ? "W2" : "W1";
+    char *mask = (width == 4) ? "" : (width == 2) ? " & 0xFFFF" : " & 0xFF";
+    switch (o->mode)
+    {   case 0: return;
+        case 5: case 6: case 7:
+            fprintf(ct_file, "    %s(0x%lxU, %s);\n", w,
+                (unsigned long) o->value, value);
+            return;
+        case 8: fprintf(ct_file, "    PUSH(%s%s);\n", value, mask); return;
+        case 9: case 10: case 11:
+            fprintf(ct_file, "    LOC(%lu) = %s%s;\n",
+                (unsigned long) o->value/4, value, mask);
+            return;
+        default:
+            fprintf(ct_file, "    %s(0x%lxU, %s);\n", w,
+                (unsigned long) (ct_ramstart + o->value), value);
+            return;
+    }
+}
+
+static int32 ct_body, ct_end;      /* Extent of the function being written */
+
+static void ct_goto(int32 target, int32 addr)
+{   if ((target < ct_body) || (target >= ct_end)
+        || !(ct_flags[target - ct_code_start] & CT_INSTRUCTION))
+        ct_error("branch outside its function", addr);
+    fprintf(ct_file, "goto L_%06lX;\n", (long int) target);
+}
+
+static void ct_branch(const glulx_operand *o, int32 addr, int32 next)
+{   int32 target = ct_branch_target(o, next);
+    if ((target == 0) || (target == 1))
+        fprintf(ct_file, "{ LEAVE(fp); return %ld; }\n", (long int) target);
+    else ct_goto(target, addr);
+}
+
+/*  Writes the C for a call to operand o, with the argument count given.    */
+
+static void ct_call(const glulx_operand *o, char *argc)
+{   if ((o->mode >= 1) && (o->mode <= 3) && ct_is_function(o->value))
+        fprintf(ct_file, "    v = F_%06lX(%s, glc_args);\n",
+            (unsigned long) o->value, argc);
+    else
+        fprintf(ct_file, "    v = glc_call(a0, %s, glc_args);\n", argc);
+}
+
+static void ct_instruction(int32 addr, int32 next, glulx_instruction *gi,
+    int32 no_locals)
+{   glulx_operand *ops = gi->ops, *st = NULL, *st2 = NULL, *br = NULL;
+    int i, loads = 0, width = 4;
+    int32 code = gi->code;
+
+    if ((code == 0x41) || (code == 0x42)) width = (code == 0x41) ? 2 : 1;
+
+    for (i=0; i<gi->no; i++)
+    {   switch (ops[i].kind)
+        {   case 'L':
+                fprintf(ct_file, "    a%d = ", loads++);
+                ct_load(&ops[i], width);
+                fprintf(ct_file, ";\n");
+                break;
+            case 'S': if (st == NULL) st = &ops[i]; else st2 = &ops[i]; break;
+            case 'B': br = &ops[i]; break;
+        }
+    }
+
+    #define CT_V(e) fprintf(ct_file, "    v = %s;\n", e)
+    #define CT_IF(e) fprintf(ct_file, "    if (%s) ", e)
+
+    switch (code)
+    {   case 0x00: break;
+        case 0x10: CT_V("a0 + a1"); break;
+        case 0x11: CT_V("a0 - a1"); break;
+        case 0x12: CT_V("a0 * a1"); break;
+        case 0x13: CT_V("glc_div(a0, a1)"); break;
+        case 0x14: CT_V("glc_mod(a0, a1)"); break;
+        case 0x15: CT_V("0 - a0"); break;
+        case 0x18: CT_V("a0 & a1"); break;
+        case 0x19: CT_V("a0 | a1"); break;
+        case 0x1A: CT_V("a0 ^ a1"); break;
+        case 0x1B: CT_V("~a0"); break;
+        case 0x1C: CT_V("(a1 < 32) ? (a0 << a1) : 0"); break;
+        case 0x1D: CT_V("glc_sshiftr(a0, a1)"); break;
+        case 0x1E: CT_V("(a1 < 32) ? (a0 >> a1) : 0"); break;
+        case 0x20: fprintf(ct_file, "    "); break;
+        case 0x22: CT_IF("a0 == 0"); break;
+        case 0x23: CT_IF("a0 != 0"); break;
+        case 0x24: CT_IF("a0 == a1"); break;
+        case 0x25: CT_IF("a0 != a1"); break;
+        case 0x26: CT_IF("(glsi32) a0 < (glsi32) a1"); break;
+        case 0x27: CT_IF("(glsi32) a0 >= (glsi32) a1"); break;
+        case 0x28: CT_IF("(glsi32) a0 > (glsi32) a1"); break;
+        case 0x29: CT_IF("(glsi32) a0 <= (glsi32) a1"); break;
+        case 0x2A: CT_IF("a0 < a1"); break;
+        case 0x2B: CT_IF("a0 >= a1"); break;
+        case 0x2C: CT_IF("a0 > a1"); break;
+        case 0x2D: CT_IF("a0 <= a1"); break;
+        case 0x30:
+            fprintf(ct_file, "    glc_pop_args(a1);\n");
+            ct_call(&ops[0], "a1");
+            break;
+        case 0x31: fprintf(ct_file, "    LEAVE(fp); return a0;\n"); break;
+        case 0x32:
+            fprintf(ct_file, "    t = glc_catch();\n");
+            fprintf(ct_file, "    if (setjmp(glc_catches[t-1]->jb) == 0) {\n");
+            fprintf(ct_file, "    v = t;\n");
+            ct_store(st, "v", 4);
+            fprintf(ct_file, "    ");
+            ct_branch(br, addr, next);
+            fprintf(ct_file, "    }\n    v = glc_thrown;\n");
+            br = NULL;
+            break;
+        case 0x33: fprintf(ct_file, "    glc_throw(a0, a1);\n"); break;
+        case 0x34:
+            fprintf(ct_file, "    glc_pop_args(a1);\n");
+            ct_call(&ops[0], "a1");
+            fprintf(ct_file, "    LEAVE(fp); return v;\n");
+            break;
+        case 0x40: case 0x41: case 0x42: CT_V("a0"); break;
+        case 0x44:
+            CT_V("(a0 & 0x8000) ? (a0 | 0xFFFF0000) : (a0 & 0xFFFF)"); break;
+        case 0x45:
+            CT_V("(a0 & 0x80) ? (a0 | 0xFFFFFF00) : (a0 & 0xFF)"); break;
+        case 0x48:
+            fprintf(ct_file, "    t = a0 + 4*a1;\n"); CT_V("MEM4(t)"); break;
+        case 0x49:
+            fprintf(ct_file, "    t = a0 + 2*a1;\n"); CT_V("MEM2(t)"); break;
+        case 0x4A:
+            fprintf(ct_file, "    t = a0 + a1;\n"); CT_V("MEM1(t)"); break;
+        case 0x4B: CT_V("glc_aloadbit(a0, a1)"); break;
+        case 0x4C:
+            fprintf(ct_file, "    t = a0 + 4*a1;\n    W4(t, a2);\n"); break;
+        case 0x4D:
+            fprintf(ct_file, "    t = a0 + 2*a1;\n    W2(t, a2);\n"); break;
+        case 0x4E:
+            fprintf(ct_file, "    t = a0 + a1;\n    W1(t, a2);\n"); break;
+        case 0x4F: fprintf(ct_file, "    glc_astorebit(a0, a1, a2);\n"); break;
+        case 0x50:
+            fprintf(ct_file, "    v = glc_sp - (fp + %ld);\n",
+                (long int) no_locals);
+            break;
+        case 0x51:
+            fprintf(ct_file, "    v = glc_stkpeek(fp + %ld, a0);\n",
+                (long int) no_locals);
+            break;
+        case 0x52:
+            fprintf(ct_file, "    glc_stkswap(fp + %ld);\n",
+                (long int) no_locals);
+            break;
+        case 0x53:
+            fprintf(ct_file, "    glc_stkroll(fp + %ld, a0, a1);\n",
+                (long int) no_locals);
+            break;
+        case 0x54:
+            fprintf(ct_file, "    glc_stkcopy(fp + %ld, a0);\n",
+                (long int) no_locals);
+            break;
+        case 0x70: fprintf(ct_file, "    glc_streamchar(a0);\n"); break;
+        case 0x71: fprintf(ct_file, "    glc_streamnum(a0);\n"); break;
+        case 0x72: fprintf(ct_file, "    glc_streamstr(a0);\n"); break;
+        case 0x73: fprintf(ct_file, "    glc_streamunichar(a0);\n"); break;
+        case 0x100: CT_V("glc_gestalt(a0, a1)"); break;
+        case 0x101:
+            fprintf(ct_file, "    glc_fatal(\"@debugtrap\");\n"); break;
+        case 0x102: CT_V("glc_memsize"); break;
+        case 0x103: CT_V("glc_setmemsize(a0)"); break;
+        case 0x104:
+            if ((ops[0].mode < 1) || (ops[0].mode > 3))
+            {   ct_error("computed @jumpabs", addr); return;
+            }
+            fprintf(ct_file, "    ");
+            ct_goto(ops[0].value, addr);
+            break;
+        case 0x110: CT_V("glc_random(a0)"); break;
+        case 0x111: fprintf(ct_file, "    glc_setrandom(a0);\n"); break;
+        case 0x120: fprintf(ct_file, "    glc_quit();\n"); break;
+        case 0x121: CT_V("0"); break;
+        case 0x122: fprintf(ct_file, "    glc_restart();\n"); break;
+        case 0x123: case 0x124: case 0x125: case 0x126: case 0x128:
+            CT_V("1"); break;
+        case 0x127: fprintf(ct_file, "    glc_protect(a0, a1);\n"); break;
+        case 0x129: break;
+        case 0x130: CT_V("glc_glk(a0, a1)"); break;
+        case 0x140: CT_V("glc_stringtbl"); break;
+        case 0x141: fprintf(ct_file, "    glc_stringtbl = a0;\n"); break;
+        case 0x148: CT_V("glc_iosys_mode");
+            fprintf(ct_file, "    w = glc_iosys_rock;\n"); break;
+        case 0x149: fprintf(ct_file, "    glc_setiosys(a0, a1);\n"); break;
+        case 0x150:
+            CT_V("glc_linearsearch(a0, a1, a2, a3, a4, a5, a6)"); break;
+        case 0x151:
+            CT_V("glc_binarysearch(a0, a1, a2, a3, a4, a5, a6)"); break;
+        case 0x152: CT_V("glc_linkedsearch(a0, a1, a2, a3, a4, a5)"); break;
+        case 0x160: case 0x161: case 0x162: case 0x163:
+            for (i=1; i<loads; i++)
+                fprintf(ct_file, "    glc_args[%d] = a%d;\n", i-1, i);
+            {   char n[16];
+                sprintf(n, "%d", loads-1);
+                ct_call(&ops[0], n);
+            }
+            break;
+        case 0x170: fprintf(ct_file, "    glc_mzero(a0, a1);\n"); break;
+        case 0x171: fprintf(ct_file, "    glc_mcopy(a0, a1, a2);\n"); break;
+        case 0x178: CT_V("0"); break;
+        case 0x179: case 0x180: case 0x181: break;
+        default:
+            if ((code >= 0x190) && (code < 0x240))
+            {   fprintf(ct_file, "    t = glc_fop(0x%lx", (long int) code);
+                for (i=0; i<6; i++)
+                {   if (i < loads) fprintf(ct_file, ", a%d", i);
+                    else fprintf(ct_file, ", 0");
+                }
+                fprintf(ct_file, ", &v, &w);\n");
+                if (br) CT_IF("t");
+                break;
+            }
+            ct_error("opcode not supported", addr);
+            return;
+    }
+
+    #undef CT_V
+    #undef CT_IF
+
+    if (st) ct_store(st, "v", width);
+    if (st2) ct_store(st2, "w", width);
+    if (br) ct_branch(br, addr, next);
+}
+
+static void ct_function(int32 addr)
+{   int32 no_locals, next;
+    glulx_instruction gi;
+
+    ct_body = ct_function_body(addr, &no_locals);
+    for (ct_end = ct_body; ct_end < ct_code_end; ct_end++)
+        if (ct_flags[ct_end - ct_code_start] & CT_FUNCTION) break;
+
+    fprintf(ct_file, "\nstatic glui32 F_%06lX(glui32 argc, glui32 *argv)\n",
+        (long int) addr);
+    fprintf(ct_file, "{   glui32 fp = %s(%ld, argc, argv);\n",
+        (ct_image[addr] == 0xC0) ? "glc_enter_stk" : "glc_enter",
+        (long int) no_locals);
+    fprintf(ct_file, "    glui32 a0, a1, a2, a3, a4, a5, a6, t, v, w;\n");
+    fprintf(ct_file, "    (void) a0; (void) a1; (void) a2; (void) a3; \
+(void) a4; (void) a5;\n    (void) a6; (void) t; (void) v; (void) w;\n");
+
+    for (addr = ct_body; (addr < ct_end) && !ct_failed; addr = next)
+    {   if (ct_flags[addr - ct_code_start] & CT_TARGET)
+            fprintf(ct_file, "  L_%06lX:\n", (long int) addr);
+        next = ct_decode(addr, &gi);
+        if (next < 0) return;
+        ct_instruction(addr, next, &gi, no_locals);
+    }
+    fprintf(ct_file, "    glc_fatal(\"Fell off the end of a function\");\n");
+    fprintf(ct_file, "    return 0;\n}\n");
+}
+
+/*  Writes the C translation of the story file image[0..length) to the
+    named file. The code area is image[code_start..code_end).                */
+
+extern void translate_code_to_c(uchar *image, int32 length,
+    int32 code_start, int32 code_end, char *filename)
+{   int32 i, no_functions = 0;
+
+    ct_image = image; ct_length = length;
+    ct_code_start = code_start; ct_code_end = code_end;
+    ct_ramstart = ct_read(8, 4);
+    ct_failed = FALSE;
+    ct_flags = my_calloc(sizeof(uchar), code_end - code_start + 1,
+        "C translation flags");
+
+    ct_scan();
+
+    if (!ct_failed)
+    {   ct_file = fopen(filename, "w");
+        if (ct_file == NULL)
+            fatalerror_named("Couldn't open C translation file", filename);
+
+        fprintf(ct_file, "/* C translation of a Glulx story file, made by \
+Inform %d.%d%d */\n\n", (VNUMBER/100)%10, (VNUMBER/10)%10, VNUMBER%10);
+        fprintf(ct_file, "#include \"glulxc.h\"\n\n");
+
+        for (i=code_start; i<code_end; i++)
+            if (ct_flags[i - code_start] & CT_FUNCTION)
+            {   fprintf(ct_file, "static glui32 F_%06lX(glui32, glui32 *);\n",
+                    (long int) i);
+                no_functions++;
+            }
+
+        for (i=code_start; (i<code_end) && !ct_failed; i++)
+            if (ct_flags[i - code_start] & CT_FUNCTION) ct_function(i);
+
+        fprintf(ct_file, "\nconst glc_entry glc_functions[] = {\n");
+        for (i=code_start; i<code_end; i++)
+            if (ct_flags[i - code_start] & CT_FUNCTION)
+                fprintf(ct_file, "    { 0x%lx, F_%06lX },\n", (long int) i,
+                    (long int) i);
+        fprintf(ct_file, "};\nconst glui32 glc_function_count = %ld;\n",
+            (long int) no_functions);
+
+        fprintf(ct_file, "\nconst glui32 glc_image_length = %ld;\n",
+            (long int) length);
+        fprintf(ct_file, "const unsigned char glc_image[] = {");
+        for (i=0; i<length; i++)
+            fprintf(ct_file, "%s%d,", (i%20 == 0) ? "\n" : "", image[i]);
+        fprintf(ct_file, "\n};\n");
+
+        if (ferror(ct_file))
+            fatalerror("I/O failure: couldn't write to C translation file");
+        fclose(ct_file);
+        if (ct_failed) remove(filename);
+    }
+
+    my_free(&ct_flags, "C translation flags");
+}
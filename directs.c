@@ -412,6 +412,7 @@ it is too late to change the grammar version.");
             }
         }
 
+        note_symbol_usage_flag(token_value, IFDEF_UFLAG);
         if (symbols[token_value].flags & UNKNOWN_SFLAG) flag = (flag)?FALSE:TRUE;
         else symbols[token_value].flags |= USED_SFLAG;
         goto HashIfCondition;
@@ -624,6 +625,7 @@ it is too late to change the grammar version.");
         directive_keywords.enabled = FALSE;
         if (token_type == DQ_TT)
         {   int i;
+            if (analysis_pass) break;
             if (hash_printed_since_newline) printf("\n");
             for (i=0; token_text[i]!=0; i++)
             {   if (token_text[i] == '^') printf("\n");
@@ -1063,6 +1065,8 @@ it is too late to change the grammar version.");
             break;
         }
         
+        if (analysis_pass) break;
+
         if (trace_level == NULL && j == 0) {
             warning_named("Trace directive to display table at 'off' level has no effect: table", trace_keywords.keywords[i]);
             break;
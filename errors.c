@@ -20,6 +20,39 @@ ErrorPosition ErrorReport;             /*  Maintained by "lexer.c"           */
 
 static char other_pos_buff[ERROR_BUFLEN+1];       /* Used by location_text() */
 
+/*  While result_cache_active is set, the text of every diagnostic printed
+    is also kept, so that a hit in the result cache can print it again.      */
+
+static memory_list diagnostics_memlist;
+char *diagnostics_text;
+int32 diagnostics_length;
+static int diagnostics_ready;
+
+static void diagnostic_printf(const char *format, ...)
+{   va_list argument_pointer;
+    int n;
+
+    if (!(result_cache_active && diagnostics_ready))
+    {   va_start(argument_pointer, format);
+        vprintf(format, argument_pointer);
+        va_end(argument_pointer);
+        return;
+    }
+
+    va_start(argument_pointer, format);
+    n = vsnprintf(NULL, 0, format, argument_pointer);
+    va_end(argument_pointer);
+    if (n < 0) return;
+    ensure_memory_list_available(&diagnostics_memlist,
+        diagnostics_length+n+1);
+    va_start(argument_pointer, format);
+    vsnprintf(diagnostics_text+diagnostics_length, n+1, format,
+        argument_pointer);
+    va_end(argument_pointer);
+    printf("%s", diagnostics_text+diagnostics_length);
+    diagnostics_length += n;
+}
+
 static void print_preamble(void)
 {
     /*  Only really prints the preamble to an error or warning message:
@@ -41,8 +74,8 @@ static void print_preamble(void)
     {
         case 0:  /* RISC OS error message format */
 
-            if (!(ErrorReport.main_flag)) printf("\"%s\", ", p);
-            printf("line %d: ", ErrorReport.line_number);
+            if (!(ErrorReport.main_flag)) diagnostic_printf("\"%s\", ", p);
+            diagnostic_printf("line %d: ", ErrorReport.line_number);
             
             if (ErrorReport.orig_file) {
                 char *op;
@@ -50,14 +83,14 @@ static void print_preamble(void)
                     op = ErrorReport.orig_source;
                 else
                     op = InputFiles[ErrorReport.orig_file-1].filename;
-                printf("(\"%s\"", op);
+                diagnostic_printf("(\"%s\"", op);
                 if (ErrorReport.orig_line) {
-                    printf(", %d", ErrorReport.orig_line);
+                    diagnostic_printf(", %d", ErrorReport.orig_line);
                     if (ErrorReport.orig_char) {
-                        printf(":%d", ErrorReport.orig_char);
+                        diagnostic_printf(":%d", ErrorReport.orig_char);
                     }
                 }
-                printf("): ");
+                diagnostic_printf("): ");
             }
             break;
 
@@ -67,9 +100,10 @@ static void print_preamble(void)
             {   if (p[j] == FN_SEP) with_extension_flag = TRUE;
                 if (p[j] == '.') with_extension_flag = FALSE;
             }
-            printf("%s", p);
-            if (with_extension_flag) printf("%s", Source_Extension);
-            printf("(%d)", ErrorReport.line_number);
+            diagnostic_printf("%s", p);
+            if (with_extension_flag)
+                diagnostic_printf("%s", Source_Extension);
+            diagnostic_printf("(%d)", ErrorReport.line_number);
             
             if (ErrorReport.orig_file) {
                 char *op;
@@ -77,22 +111,23 @@ static void print_preamble(void)
                     op = ErrorReport.orig_source;
                 else
                     op = InputFiles[ErrorReport.orig_file-1].filename;
-                printf("|%s", op);
+                diagnostic_printf("|%s", op);
                 if (ErrorReport.orig_line) {
-                    printf("(%d", ErrorReport.orig_line);
+                    diagnostic_printf("(%d", ErrorReport.orig_line);
                     if (ErrorReport.orig_char) {
-                        printf(":%d", ErrorReport.orig_char);
+                        diagnostic_printf(":%d", ErrorReport.orig_char);
                     }
-                    printf(")");
+                    diagnostic_printf(")");
                 }
             }
             
-            printf(": ");
+            diagnostic_printf(": ");
             break;
 
         case 2:  /* Macintosh Programmer's Workshop error message format */
 
-            printf("File \"%s\"; Line %d", p, ErrorReport.line_number);
+            diagnostic_printf("File \"%s\"; Line %d", p,
+                ErrorReport.line_number);
             
             if (ErrorReport.orig_file) {
                 char *op;
@@ -100,17 +135,17 @@ static void print_preamble(void)
                     op = ErrorReport.orig_source;
                 else
                     op = InputFiles[ErrorReport.orig_file-1].filename;
-                printf(": (\"%s\"", op);
+                diagnostic_printf(": (\"%s\"", op);
                 if (ErrorReport.orig_line) {
-                    printf("; Line %d", ErrorReport.orig_line);
+                    diagnostic_printf("; Line %d", ErrorReport.orig_line);
                     if (ErrorReport.orig_char) {
-                        printf("; Char %d", ErrorReport.orig_char);
+                        diagnostic_printf("; Char %d", ErrorReport.orig_char);
                     }
                 }
-                printf(")");
+                diagnostic_printf(")");
             }
 
-            printf("\t# ");
+            diagnostic_printf("\t# ");
             break;
     }
 }
@@ -238,22 +273,37 @@ extern void fatalerror_memory_out(int32 size, int32 howmany, char *name)
 
 int no_errors, no_warnings, no_suppressed_warnings, no_compiler_errors;
 
+int suppress_repeat_messages;       /* Set while code is being compiled for
+                                       the second time (see states.c), so
+                                       that its diagnostics, already given,
+                                       are neither printed nor counted again */
+
 char *forerrors_buff;
 int  forerrors_pointer;
 
 static void message(int style, char *s)
 {
+    if (suppress_repeat_messages) return;
+    if (analysis_pass)
+    {   /* Count, but don't report: the main pass will do that. */
+        switch(style)
+        {   case 1: case 3: no_errors++; break;
+            case 2: no_warnings++; break;
+            case 4: no_compiler_errors++; break;
+        }
+        return;
+    }
     if (hash_printed_since_newline) printf("\n");
     hash_printed_since_newline = FALSE;
     print_preamble();
     switch(style)
-    {   case 1: printf("Error: "); no_errors++; break;
-        case 2: printf("Warning: "); no_warnings++; break;
-        case 3: printf("Error:  [linking]  "); no_errors++; break;
-        case 4: printf("*** Compiler error: ");
+    {   case 1: diagnostic_printf("Error: "); no_errors++; break;
+        case 2: diagnostic_printf("Warning: "); no_warnings++; break;
+        case 3: diagnostic_printf("Error:  [linking]  "); no_errors++; break;
+        case 4: diagnostic_printf("*** Compiler error: ");
                 no_compiler_errors++; break;
     }
-    printf(" %s\n", s);
+    diagnostic_printf(" %s\n", s);
 #ifdef ARC_THROWBACK
     throwback(((style <= 2) ? style : 1), s);
 #endif
@@ -269,7 +319,7 @@ static void message(int style, char *s)
     if ((!concise_switch) && (forerrors_pointer > 0) && (style <= 2))
     {   forerrors_buff[forerrors_pointer] = 0;
         sprintf(forerrors_buff+68,"  ...etc");
-        printf("> %s\n",forerrors_buff);
+        diagnostic_printf("> %s\n",forerrors_buff);
     }
 }
 
@@ -278,7 +328,7 @@ static void message(int style, char *s)
 /* ------------------------------------------------------------------------- */
 
 extern void error(char *s)
-{   if (no_errors == MAX_ERRORS)
+{   if (no_errors == MAX_ERRORS && !analysis_pass)
         fatalerror("Too many errors: giving up");
     message(1,s);
 }
@@ -541,7 +591,7 @@ extern void print_sorry_message(void)
 extern int compiler_error(char *s)
 {
     if (no_errors > 0) return FALSE;
-    if (no_compiler_errors==MAX_ERRORS)
+    if (no_compiler_errors==MAX_ERRORS && !analysis_pass)
         fatalerror("Too many compiler errors: giving up");
     message(4,s);
     return TRUE;
@@ -612,6 +662,10 @@ extern void init_errors_vars(void)
 {   forerrors_buff = NULL;
     no_errors = 0; no_warnings = 0; no_suppressed_warnings = 0;
     no_compiler_errors = 0;
+    suppress_repeat_messages = FALSE;
+    diagnostics_text = NULL;
+    diagnostics_length = 0;
+    diagnostics_ready = FALSE;
 }
 
 extern void errors_begin_pass(void)
@@ -627,10 +681,18 @@ extern void errors_begin_pass(void)
 
 extern void errors_allocate_arrays(void)
 {   forerrors_buff = my_malloc(FORERRORS_SIZE, "errors buffer");
+    initialise_memory_list(&diagnostics_memlist,
+        sizeof(char), 1024, (void**)&diagnostics_text,
+        "diagnostics kept for the result cache");
+    diagnostics_length = 0;
+    diagnostics_ready = TRUE;
 }
 
 extern void errors_free_arrays(void)
 {   my_free(&forerrors_buff, "errors buffer");
+    deallocate_memory_list(&diagnostics_memlist);
+    diagnostics_length = 0;
+    diagnostics_ready = FALSE;
 }
 
 /* ========================================================================= */
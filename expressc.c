@@ -462,6 +462,8 @@ static void access_memory_z(int oc, assembly_operand AO1, assembly_operand AO2,
         if (arrays[y].loc && !read_flag) {
             error("Cannot write to a static array");
         }
+        if ((AO1.marker == ARRAY_MV) && !read_flag)
+            note_array_write(AO1.value);
 
         if (size_ao.value==-1) {
             /* This case was originally meant for module linking.
@@ -504,6 +506,7 @@ static void access_memory_z(int oc, assembly_operand AO1, assembly_operand AO2,
     {   
         int passed_label = next_label++, failed_label = next_label++,
             final_label = next_label++; 
+        int cold;
         /* Calculate the largest permitted array entry + 1
            Here "size_ao.value" = largest permitted entry of its own kind */
         max_ao = size_ao;
@@ -552,6 +555,7 @@ static void access_memory_z(int oc, assembly_operand AO1, assembly_operand AO2,
         assemblez_2_branch(jl_zc, index_ao, zero_ao, failed_label, TRUE);
         assemblez_2_branch(jl_zc, index_ao, max_ao, passed_label, TRUE);
         assemble_label_no(failed_label);
+        cold = begin_cold_block();
         an_ao = zero_ao; an_ao.value = y;
         assemblez_6(call_vn2_zc, veneer_routine(RT__Err_VR), en_ao,
             index_ao, size_ao, type_ao, an_ao);
@@ -569,6 +573,7 @@ static void access_memory_z(int oc, assembly_operand AO1, assembly_operand AO2,
             else pop_zm_stack();
         }
         assemblez_jump(final_label);
+        end_cold_block(cold, FALSE);
 
         assemble_label_no(passed_label);
         if ((oc == loadb_zc) || (oc == loadw_zc))
@@ -598,7 +603,7 @@ static void access_memory_z(int oc, assembly_operand AO1, assembly_operand AO2,
 static assembly_operand check_nonzero_at_runtime_z(assembly_operand AO1,
         int error_label, int rte_number)
 {   assembly_operand AO2, AO3;
-    int check_sp = FALSE, passed_label, failed_label, last_label;
+    int check_sp = FALSE, passed_label, failed_label, last_label, cold;
     if (veneer_mode) return AO1;
 
     /*  Assemble to code to check that the operand AO1 is ofclass Object:
@@ -663,6 +668,7 @@ static assembly_operand check_nonzero_at_runtime_z(assembly_operand AO1,
     }
 
     assemble_label_no(failed_label);
+    cold = begin_cold_block();
     INITAOTV(&AO2, SHORT_CONSTANT_OT, rte_number);
     if (version_number >= 5)
       assemblez_3(call_vn_zc, veneer_routine(RT__Err_VR), AO2, AO1);
@@ -688,12 +694,14 @@ static assembly_operand check_nonzero_at_runtime_z(assembly_operand AO1,
             AO3 = temp_var2; assemblez_store(AO3, AO2);
             last_label = next_label++;
             assemblez_jump(last_label);
+            end_cold_block(cold, FALSE);
             assemble_label_no(passed_label);
             assemblez_store(AO3, AO1);
             assemble_label_no(last_label);
             return AO3;
         }
     }
+    end_cold_block(cold, FALSE);
     assemble_label_no(passed_label);
     return AO1;
 }
@@ -743,6 +751,7 @@ static void compile_conditional_z(int oc,
                     /* Fall through */
                 case VARIABLE_OT:
                 {   int pa_label = next_label++, fa_label = next_label++;
+                    int cold;
                     assembly_operand en_ao, zero_ao, max_ao;
                     assemblez_store(temp_var1, AO1);
                     if ((AO1.type == VARIABLE_OT)&&(AO1.value == 0))
@@ -756,11 +765,13 @@ static void compile_conditional_z(int oc,
                     assemblez_2_branch(jl_zc,temp_var2,zero_ao,fa_label,TRUE);
                     assemblez_2_branch(jl_zc,temp_var2,max_ao,pa_label,TRUE);
                     assemble_label_no(fa_label);
+                    cold = begin_cold_block();
                     en_ao = zero_ao; en_ao.value = 19;
                     assemblez_4(call_vn_zc, veneer_routine(RT__Err_VR),
                         en_ao, temp_var1, temp_var2);
                     va_flag = TRUE; va_label = next_label++;
                     assemblez_jump(va_label);
+                    end_cold_block(cold, FALSE);
                     assemble_label_no(pa_label);
                 }
             }
@@ -782,6 +793,22 @@ static void compile_conditional_z(int oc,
     assemblez_1_branch(jz_zc, AO3, label, !flag);
 }
 
+static int message_send_routine_z(int below)
+{   /*  Choose the veneer routine for a Z-code message send, whose operands
+        (object, property and then any arguments) run along the sibling
+        chain from "below": CA__Pr counts its arguments at run time, but
+        CA__Pr0 to CA__Pr6 each expect an exact number of them.            */
+
+    int n = -2;
+
+    if ((!SPECIALISE_MESSAGE_CALLS) || (version_number == 3))
+        return CA__Pr_VR;
+
+    for (; below != -1; below = ET[below].right) n++;
+    if ((n >= 0) && (n <= 6)) return CA__Pr0_VR + n;
+    return CA__Pr_VR;
+}
+
 static void value_in_void_context_g(assembly_operand AO)
 {   char *t;
 
@@ -815,13 +842,73 @@ static void write_result_g(assembly_operand to, assembly_operand from)
     assembleg_store(to, from);
 }
 
+extern int reusable_operand_g(assembly_operand AO)
+{   /*  With $GLULX_DIRECT_OPERANDS, can AO be read more than once, giving
+        the same value each time, rather than first being copied to one of
+        the temporary globals? Constants and local variables can; the stack
+        pointer cannot, and nor can a global, which a call might change.    */
+
+    if (!GLULX_DIRECT_OPERANDS) return FALSE;
+    if (is_constant_ot(AO.type)) return TRUE;
+    return ((AO.type == LOCALVAR_OT) && (AO.value != 0));
+}
+
+extern void check_object_tree_write(assembly_operand base,
+    assembly_operand AO)
+{   /*  With GLULX_PREV_SIBLING set, code outside the veneer which relinks
+        the object tree by writing a sibling or child field will leave the
+        previous-sibling fields out of date. base-->AO is the word written.
+        The field is recognised if AO is the constant GOBJFIELD_SIBLING or
+        GOBJFIELD_CHILD, or if a named object's word is written at a number
+        equal to one of them. A number used with any other base is taken
+        to be an array index, so such writes through a variable are not
+        caught.                                                              */
+    char *field;
+    if (!GLULX_PREV_SIBLING || veneer_mode) return;
+    if (AO.symindex >= 0)
+    {   if ((AO.symindex == get_symbol_index("GOBJFIELD_SIBLING"))
+            || (AO.symindex == get_symbol_index("GOBJFIELD_CHILD")))
+            warning_named("With $GLULX_PREV_SIBLING set, writing this \
+field directly leaves GOBJFIELD_PREVSIB out of date:",
+                symbols[AO.symindex].name);
+        return;
+    }
+    if (!is_constant_ot(AO.type) || (AO.marker != 0)
+        || !is_constant_ot(base.type) || (base.marker != OBJECT_MV)) return;
+    if (AO.value == GOBJFIELD_SIBLING()) field = "GOBJFIELD_SIBLING";
+    else if (AO.value == GOBJFIELD_CHILD()) field = "GOBJFIELD_CHILD";
+    else return;
+    warning_named("With $GLULX_PREV_SIBLING set, writing this field \
+directly leaves GOBJFIELD_PREVSIB out of date:", field);
+}
+
+extern int attribute_unit_g(int32 lo, int32 hi, int *width, int32 *index)
+{   /*  With GLULX_FUSE_ATTRIBUTES set, attributes lo to hi are read or
+        written together if their bits lie in one byte of the object, or
+        in one 16- or 32-bit unit aligned with its start. This finds the
+        unit's width in bytes and its index (as the second operand of
+        aloadb, aloads or aload), or returns FALSE.                          */
+    int32 first = 1 + lo/8, last = 1 + hi/8;
+    if (first == last) { *width = 1; *index = first; return TRUE; }
+    if (first/2 == last/2) { *width = 2; *index = first/2; return TRUE; }
+    if (first/4 == last/4) { *width = 4; *index = first/4; return TRUE; }
+    return FALSE;
+}
+
+extern uint32 attribute_unit_bit_g(int32 attr, int width, int32 index)
+{   /*  The bit for attribute attr in the unit found above: Glulx memory
+        is big-endian, so the unit's first byte is its most significant.    */
+    int32 position = 1 + attr/8 - index*width;
+    return ((uint32) 1) << (8*(width-1-position) + (attr & 7));
+}
+
 static void access_memory_g(int oc, assembly_operand AO1, assembly_operand AO2,
     assembly_operand AO3)
 {   int vr = 0;
     int data_len, read_flag; 
     assembly_operand zero_ao, max_ao, size_ao, en_ao, type_ao, an_ao,
         index_ao, five_ao;
-    int passed_label, failed_label, final_label, x = 0, y = 0;
+    int passed_label, failed_label, final_label, x = 0, y = 0, cold;
 
     if ((oc == aloadb_gc) || (oc == astoreb_gc)) data_len = 1;
     else if ((oc == aloads_gc) || (oc == astores_gc)) data_len = 2;
@@ -832,6 +919,8 @@ static void access_memory_g(int oc, assembly_operand AO1, assembly_operand AO2,
     else 
       read_flag = FALSE;
 
+    if (oc == astore_gc) check_object_tree_write(AO1, AO2);
+
     INITAO(&zero_ao);
     INITAO(&size_ao);
     INITAO(&type_ao);
@@ -852,6 +941,8 @@ static void access_memory_g(int oc, assembly_operand AO1, assembly_operand AO2,
         if (arrays[y].loc && !read_flag) {
             error("Cannot write to a static array");
         }
+        if ((AO1.marker == ARRAY_MV) && !read_flag)
+            note_array_write(AO1.value);
 
         if ((!is_systemfile()))
         {   if (data_len == 1)
@@ -937,13 +1028,18 @@ static void access_memory_g(int oc, assembly_operand AO1, assembly_operand AO2,
 
         index_ao = AO2;
         if ((AO2.type == LOCALVAR_OT)&&(AO2.value == 0))
-        {   assembleg_store(temp_var2, AO2); /* ### could peek */
-            assembleg_store(AO2, temp_var2);
+        {   if (GLULX_DIRECT_OPERANDS)
+                assembleg_2(stkpeek_gc, zero_operand, temp_var2);
+            else
+            {   assembleg_store(temp_var2, AO2); /* ### could peek */
+                assembleg_store(AO2, temp_var2);
+            }
             index_ao = temp_var2;
         }
         assembleg_2_branch(jlt_gc, index_ao, zero_ao, failed_label);
         assembleg_2_branch(jlt_gc, index_ao, max_ao, passed_label);
         assemble_label_no(failed_label);
+        cold = begin_cold_block();
 
         an_ao = zero_ao; an_ao.value = y;
         set_constant_ot(&an_ao);
@@ -974,6 +1070,7 @@ static void access_memory_g(int oc, assembly_operand AO1, assembly_operand AO2,
             else assembleg_2(copy_gc, stack_pointer, zero_operand);
         }
         assembleg_jump(final_label);
+        end_cold_block(cold, FALSE);
 
         assemble_label_no(passed_label);
         assembleg_3(oc, AO1, AO2, AO3);
@@ -998,13 +1095,32 @@ static void access_memory_g(int oc, assembly_operand AO1, assembly_operand AO2,
       assembleg_call_3(veneer_routine(vr), AO1, AO2, AO3, zero_operand);
 }
 
+static int step_array_entry_g(int load_oc, int store_oc,
+    assembly_operand AO1, assembly_operand AO2, int step_oc, int post_flag,
+    int void_flag, assembly_operand Result)
+{   /*  Compile "AO1->AO2++" and the like (with step_oc add_gc or sub_gc)
+        by using the array and index directly, and passing the entry's value
+        on the stack, rather than through temp_var1 to temp_var3. Returns
+        FALSE, having done nothing, if this cannot be done.                 */
+
+    if (!(reusable_operand_g(AO1) && reusable_operand_g(AO2))) return FALSE;
+
+    access_memory_g(load_oc, AO1, AO2, stack_pointer);
+    if ((!void_flag) && post_flag) assembleg_1(stkcopy_gc, one_operand);
+    assembleg_3(step_oc, stack_pointer, one_operand, stack_pointer);
+    if ((!void_flag) && (!post_flag)) assembleg_1(stkcopy_gc, one_operand);
+    access_memory_g(store_oc, AO1, AO2, stack_pointer);
+    if (!void_flag) write_result_g(Result, stack_pointer);
+    return TRUE;
+}
+
 static assembly_operand check_nonzero_at_runtime_g(assembly_operand AO1,
         int error_label, int rte_number)
 {
   assembly_operand AO, AO2, AO3;
   int ln;
   int check_sp = FALSE, passed_label, failed_label, last_label;
-  int pre_unreach;
+  int pre_unreach, cold;
   
   if (veneer_mode) 
     return AO1;
@@ -1035,8 +1151,12 @@ static assembly_operand check_nonzero_at_runtime_g(assembly_operand AO1,
   if ((AO1.type == LOCALVAR_OT) && (AO1.value == 0) && (AO1.marker == 0)) {
     /* That is, if AO1 is the stack pointer */
     check_sp = TRUE;
-    assembleg_store(temp_var2, stack_pointer);
-    assembleg_store(stack_pointer, temp_var2);
+    if (GLULX_DIRECT_OPERANDS)
+      assembleg_2(stkpeek_gc, zero_operand, temp_var2);
+    else {
+      assembleg_store(temp_var2, stack_pointer);
+      assembleg_store(stack_pointer, temp_var2);
+    }
     AO = temp_var2;
   }
   else {
@@ -1086,6 +1206,7 @@ static assembly_operand check_nonzero_at_runtime_g(assembly_operand AO1,
   }
   
   assemble_label_no(failed_label);
+  cold = begin_cold_block();
   INITAO(&AO2);
   AO2.value = rte_number; 
   set_constant_ot(&AO2);
@@ -1119,6 +1240,7 @@ static assembly_operand check_nonzero_at_runtime_g(assembly_operand AO1,
       assembleg_store(temp_var2, AO2);
       last_label = next_label++;
       assembleg_jump(last_label);
+      end_cold_block(cold, FALSE);
       assemble_label_no(passed_label);
       assembleg_store(temp_var2, AO1);
       assemble_label_no(last_label);
@@ -1126,6 +1248,7 @@ static assembly_operand check_nonzero_at_runtime_g(assembly_operand AO1,
     }
   }
     
+  end_cold_block(cold, FALSE);
   assemble_label_no(passed_label);
   return AO1;
 }
@@ -1157,6 +1280,7 @@ static void compile_conditional_g(condclass *cc,
           }
           else {
             int pa_label = next_label++, fa_label = next_label++;
+            int cold;
             assembly_operand en_ao, max_ao;
 
             if ((AO1.type == LOCALVAR_OT) && (AO1.value == 0)) {
@@ -1185,6 +1309,7 @@ static void compile_conditional_g(condclass *cc,
             assembleg_2_branch(jlt_gc, temp_var2, zero_operand, fa_label);
             assembleg_2_branch(jlt_gc, temp_var2, max_ao, pa_label);
             assemble_label_no(fa_label);
+            cold = begin_cold_block();
             INITAO(&en_ao);
             en_ao.value = 19; /* INVALIDATTR_RTE */
             set_constant_ot(&en_ao);
@@ -1196,6 +1321,7 @@ static void compile_conditional_g(condclass *cc,
             va_flag = TRUE; 
             va_label = next_label++;
             assembleg_jump(va_label);
+            end_cold_block(cold, FALSE);
             assemble_label_no(pa_label);
           }
         }
@@ -1269,6 +1395,130 @@ static void compile_conditional_g(condclass *cc,
     if (va_flag) assemble_label_no(va_label);
 }
 
+/* --- Fused attribute tests (Glulx) --------------------------------------- */
+
+#define MAX_FUSED_ATTRIBUTES 32
+
+static int no_fused_attributes;
+static int32 fused_attribute[MAX_FUSED_ATTRIBUTES];
+static int fused_attribute_has[MAX_FUSED_ATTRIBUTES];
+static assembly_operand fused_object;
+
+static int note_fused_attribute(assembly_operand obj, assembly_operand attr,
+    int has)
+{   /*  Adds "obj has attr" (or hasnt) to the tests being fused, provided
+        attr is a constant and obj is the same plain variable or constant
+        as in the tests so far.                                              */
+    int i;
+
+    if ((obj.type == LOCALVAR_OT) && (obj.value == 0)) return FALSE;
+    if ((obj.type != LOCALVAR_OT) && (obj.type != GLOBALVAR_OT)
+        && (!is_constant_ot(obj.type))) return FALSE;
+    if ((!is_constant_ot(attr.type)) || (attr.marker != 0)
+        || (attr.value < 0) || (attr.value >= NUM_ATTR_BYTES*8))
+        return FALSE;
+
+    if (no_fused_attributes == 0) fused_object = obj;
+    else
+    {   if ((obj.value != fused_object.value)
+            || (obj.marker != fused_object.marker)) return FALSE;
+        if (is_constant_ot(obj.type))
+        {   if (!is_constant_ot(fused_object.type)) return FALSE;
+        }
+        else if (obj.type != fused_object.type) return FALSE;
+    }
+
+    for (i=0; i<no_fused_attributes; i++)
+        if (fused_attribute[i] == attr.value)
+            return (fused_attribute_has[i] == has);
+    if (no_fused_attributes == MAX_FUSED_ATTRIBUTES) return FALSE;
+    fused_attribute[no_fused_attributes] = attr.value;
+    fused_attribute_has[no_fused_attributes++] = has;
+    return TRUE;
+}
+
+static int note_fused_attribute_tree(int n, int opnum)
+{   /*  Adds the tests in a tree of && (or of ||) nodes, whose leaves must
+        all be "has" or "hasnt" tests with one attribute.                    */
+    int below = ET[n].down, i;
+
+    if (below == -1) return FALSE;
+    if (ET[n].operator_number == opnum)
+        return (note_fused_attribute_tree(below, opnum)
+            && note_fused_attribute_tree(ET[below].right, opnum));
+    if ((ET[n].operator_number != HAS_OP)
+        && (ET[n].operator_number != HASNT_OP)) return FALSE;
+    i = ET[below].right;
+    if ((ET[below].down != -1) || (ET[i].down != -1) || (ET[i].right != -1))
+        return FALSE;
+    return note_fused_attribute(ET[below].value, ET[i].value,
+        (ET[n].operator_number == HAS_OP));
+}
+
+static int compile_fused_attribute_test_g(int n, int conjunction)
+{   /*  The condition at node n is the conjunction (or, if not, the
+        disjunction) of the tests noted above. If their attributes share
+        a unit of the object, compile it as one load of the unit and one
+        comparison of its masked value, branching to the node's labels as
+        a conditional term would, and return TRUE.                           */
+    int32 lo, hi, index;
+    uint32 mask = 0, wanted = 0, bit;
+    int width, i, flag = TRUE, a, b;
+    assembly_operand AO2;
+
+    if (no_fused_attributes < 2) return FALSE;
+
+    /*  With run-time checking, each test of an object which may be nothing
+        reports its own error: so leave those to be compiled one by one.    */
+
+    if (runtime_error_checking_switch && (!veneer_mode)
+        && ((fused_object.marker != OBJECT_MV) || (fused_object.value < 1)
+            || (fused_object.value > no_objects))) return FALSE;
+    lo = hi = fused_attribute[0];
+    for (i=1; i<no_fused_attributes; i++)
+    {   if (fused_attribute[i] < lo) lo = fused_attribute[i];
+        if (fused_attribute[i] > hi) hi = fused_attribute[i];
+    }
+    if (!attribute_unit_g(lo, hi, &width, &index)) return FALSE;
+
+    /*  A conjunction holds when (unit & mask) == wanted, where wanted has
+        the bits of the "has" tests; a disjunction holds unless it equals
+        the value which fails every test.                                    */
+
+    for (i=0; i<no_fused_attributes; i++)
+    {   bit = attribute_unit_bit_g(fused_attribute[i], width, index);
+        mask |= bit;
+        if (conjunction ? fused_attribute_has[i] : !fused_attribute_has[i])
+            wanted |= bit;
+    }
+
+    a = ET[n].true_label; b = ET[n].false_label;
+    if (a == -1) { a = b; b = -1; flag = FALSE; }
+
+    INITAO(&AO2);
+    AO2.value = index;
+    set_constant_ot(&AO2);
+    assembleg_3((width == 1) ? aloadb_gc : ((width == 2) ? aloads_gc
+        : aload_gc), fused_object, AO2, stack_pointer);
+    AO2.value = (int32) mask;
+    set_constant_ot(&AO2);
+    assembleg_3(bitand_gc, stack_pointer, AO2, stack_pointer);
+
+    /*  Branch to a when the condition has truth state flag              */
+
+    if (wanted == 0)
+        assembleg_1_branch((flag ? conjunction : !conjunction) ? jz_gc
+            : jnz_gc, stack_pointer, a);
+    else
+    {   AO2.value = (int32) wanted;
+        set_constant_ot(&AO2);
+        assembleg_2_branch((flag ? conjunction : !conjunction) ? jeq_gc
+            : jne_gc, stack_pointer, AO2, a);
+    }
+    if (b != -1) assembleg_jump(b);
+    return TRUE;
+}
+
 static void value_in_void_context(assembly_operand AO)
 {
   if (!glulx_mode)
@@ -1310,7 +1560,13 @@ static void generate_code_from(int n, int void_flag)
     }
 
     if ((opnum == LOGAND_OP) || (opnum == LOGOR_OP))
-    {   generate_code_from(below, FALSE);
+    {   if (glulx_mode && GLULX_FUSE_ATTRIBUTES)
+        {   no_fused_attributes = 0;
+            if (note_fused_attribute_tree(n, opnum)
+                && compile_fused_attribute_test_g(n, (opnum == LOGAND_OP)))
+                goto OperatorGenerated;
+        }
+        generate_code_from(below, FALSE);
         if (execution_never_reaches_here) {
             /* If the condition never falls through to here, then it
                was an "... && 0 && ..." test. Our convention is to skip
@@ -1527,6 +1783,21 @@ static void generate_code_from(int n, int void_flag)
       condclass *cc = &condclasses[(ccode-FIRST_CC) / 2];
       flag = (ccode & 1) ? 0 : 1;
 
+      /*  "x has a or b" is a disjunction of "has" tests; "x hasnt a or b"
+          is its negation, a conjunction of "hasnt" tests.  */
+
+      if (GLULX_FUSE_ATTRIBUTES && (arity > 2)
+          && ((opnum == HAS_OP) || (opnum == HASNT_OP))) {
+        no_fused_attributes = 0;
+        for (i = ET[below].right; i != -1; i = ET[i].right)
+          if (!note_fused_attribute(ET[below].value, ET[i].value,
+            (opnum == HAS_OP)))
+            break;
+        if ((i == -1)
+            && compile_fused_attribute_test_g(n, (opnum == HASNT_OP)))
+          goto OperatorGenerated;
+      }
+
       /*  If the comparison is "equal to (constant) 0", change it
           to the simple "zero" test. Unfortunately, this doesn't
           work for the commutative form "(constant) 0 is equal to". 
@@ -1769,7 +2040,8 @@ static void generate_code_from(int n, int void_flag)
         case MESSAGE_OP:
              check_warn_symbol_type(&ET[below].value, OBJECT_T, CLASS_T, "\".\" expression");
              check_warn_symbol_type(&ET[ET[below].right].value, PROPERTY_T, INDIVIDUAL_PROPERTY_T, "\".\" expression");
-             j=1; AI.operand[0] = veneer_routine(RV__Pr_VR);
+             j=1; AI.operand[0]
+                 = property_read_routine(ET[ET[below].right].value);
              goto GenFunctionCallZ;
         case MPROP_ADD_OP:
              check_warn_symbol_type(&ET[below].value, OBJECT_T, CLASS_T, "\".&\" expression");
@@ -1812,12 +2084,14 @@ static void generate_code_from(int n, int void_flag)
         case PROP_CALL_OP:
              check_warn_symbol_has_metaclass(&ET[below].value, "\".()\" expression");
              check_warn_symbol_type(&ET[ET[below].right].value, PROPERTY_T, INDIVIDUAL_PROPERTY_T, "\".()\" expression");
-             j=1; AI.operand[0] = veneer_routine(CA__Pr_VR);
+             j=1; AI.operand[0]
+                 = veneer_routine(message_send_routine_z(below));
              goto GenFunctionCallZ;
         case MESSAGE_CALL_OP:
              check_warn_symbol_has_metaclass(&ET[below].value, "\".()\" expression");
              check_warn_symbol_type(&ET[ET[below].right].value, PROPERTY_T, INDIVIDUAL_PROPERTY_T, "\".()\" expression");
-             j=1; AI.operand[0] = veneer_routine(CA__Pr_VR);
+             j=1; AI.operand[0]
+                 = veneer_routine(message_send_routine_z(below));
              goto GenFunctionCallZ;
 
 
@@ -2277,6 +2551,23 @@ static void generate_code_from(int n, int void_flag)
                     && is_constant_ot(by_ao.type))
                     assembleg_3(o_n, ET[below].value,
                         by_ao, Result);
+                else if (reusable_operand_g(by_ao))
+                {   /*  Test the divisor where it is, and on failure divide
+                        by 1 instead                                         */
+                    int ln2;
+                    ln = next_label++; ln2 = next_label++;
+                    assembleg_1_branch(jnz_gc, by_ao, ln);
+                    INITAO(&error_ao);
+                    error_ao.value = DBYZERO_RTE;
+                    set_constant_ot(&error_ao);
+                    assembleg_call_1(veneer_routine(RT__Err_VR),
+                      error_ao, zero_operand);
+                    assembleg_3(o_n, ET[below].value, one_operand, Result);
+                    assembleg_jump(ln2);
+                    assemble_label_no(ln);
+                    assembleg_3(o_n, ET[below].value, by_ao, Result);
+                    assemble_label_no(ln2);
+                }
                 else
                 {   assembleg_store(temp_var1, ET[below].value);
                     assembleg_store(temp_var2, by_ao);
@@ -2336,12 +2627,14 @@ static void generate_code_from(int n, int void_flag)
 
         case ARROW_SETEQUALS_OP:
              if (!void_flag)
-             {   assembleg_store(temp_var1,
-                     ET[ET[ET[below].right].right].value);
+             {   AO = ET[ET[ET[below].right].right].value;
+                 if (!reusable_operand_g(AO))
+                 {   assembleg_store(temp_var1, AO);
+                     AO = temp_var1;
+                 }
                  access_memory_g(astoreb_gc, ET[below].value,
-                     ET[ET[below].right].value,
-                     temp_var1);
-                 write_result_g(Result, temp_var1);
+                     ET[ET[below].right].value, AO);
+                 write_result_g(Result, AO);
              }
              else access_memory_g(astoreb_gc, ET[below].value,
                      ET[ET[below].right].value,
@@ -2350,12 +2643,14 @@ static void generate_code_from(int n, int void_flag)
 
         case DARROW_SETEQUALS_OP:
              if (!void_flag)
-             {   assembleg_store(temp_var1,
-                     ET[ET[ET[below].right].right].value);
+             {   AO = ET[ET[ET[below].right].right].value;
+                 if (!reusable_operand_g(AO))
+                 {   assembleg_store(temp_var1, AO);
+                     AO = temp_var1;
+                 }
                  access_memory_g(astore_gc, ET[below].value,
-                     ET[ET[below].right].value,
-                     temp_var1);
-                 write_result_g(Result, temp_var1);
+                     ET[ET[below].right].value, AO);
+                 write_result_g(Result, AO);
              }
              else
                  access_memory_g(astore_gc, ET[below].value,
@@ -2381,6 +2676,9 @@ static void generate_code_from(int n, int void_flag)
              break;
 
         case ARROW_INC_OP:
+             if (step_array_entry_g(aloadb_gc, astoreb_gc, ET[below].value,
+                 ET[ET[below].right].value, add_gc, FALSE, void_flag, Result))
+                 break;
              assembleg_store(temp_var1, ET[below].value);
              assembleg_store(temp_var2, ET[ET[below].right].value);
              access_memory_g(aloadb_gc, temp_var1, temp_var2, temp_var3);
@@ -2390,6 +2688,9 @@ static void generate_code_from(int n, int void_flag)
              break;
 
         case ARROW_DEC_OP:
+             if (step_array_entry_g(aloadb_gc, astoreb_gc, ET[below].value,
+                 ET[ET[below].right].value, sub_gc, FALSE, void_flag, Result))
+                 break;
              assembleg_store(temp_var1, ET[below].value);
              assembleg_store(temp_var2, ET[ET[below].right].value);
              access_memory_g(aloadb_gc, temp_var1, temp_var2, temp_var3);
@@ -2399,6 +2700,9 @@ static void generate_code_from(int n, int void_flag)
              break;
 
         case ARROW_POST_INC_OP:
+             if (step_array_entry_g(aloadb_gc, astoreb_gc, ET[below].value,
+                 ET[ET[below].right].value, add_gc, TRUE, void_flag, Result))
+                 break;
              assembleg_store(temp_var1, ET[below].value);
              assembleg_store(temp_var2, ET[ET[below].right].value);
              access_memory_g(aloadb_gc, temp_var1, temp_var2, temp_var3);
@@ -2408,6 +2712,9 @@ static void generate_code_from(int n, int void_flag)
              break;
 
         case ARROW_POST_DEC_OP:
+             if (step_array_entry_g(aloadb_gc, astoreb_gc, ET[below].value,
+                 ET[ET[below].right].value, sub_gc, TRUE, void_flag, Result))
+                 break;
              assembleg_store(temp_var1, ET[below].value);
              assembleg_store(temp_var2, ET[ET[below].right].value);
              access_memory_g(aloadb_gc, temp_var1, temp_var2, temp_var3);
@@ -2417,6 +2724,9 @@ static void generate_code_from(int n, int void_flag)
              break;
 
         case DARROW_INC_OP:
+             if (step_array_entry_g(aload_gc, astore_gc, ET[below].value,
+                 ET[ET[below].right].value, add_gc, FALSE, void_flag, Result))
+                 break;
              assembleg_store(temp_var1, ET[below].value);
              assembleg_store(temp_var2, ET[ET[below].right].value);
              access_memory_g(aload_gc, temp_var1, temp_var2, temp_var3);
@@ -2426,6 +2736,9 @@ static void generate_code_from(int n, int void_flag)
              break;
 
         case DARROW_DEC_OP:
+             if (step_array_entry_g(aload_gc, astore_gc, ET[below].value,
+                 ET[ET[below].right].value, sub_gc, FALSE, void_flag, Result))
+                 break;
              assembleg_store(temp_var1, ET[below].value);
              assembleg_store(temp_var2, ET[ET[below].right].value);
              access_memory_g(aload_gc, temp_var1, temp_var2, temp_var3);
@@ -2435,6 +2748,9 @@ static void generate_code_from(int n, int void_flag)
              break;
 
         case DARROW_POST_INC_OP:
+             if (step_array_entry_g(aload_gc, astore_gc, ET[below].value,
+                 ET[ET[below].right].value, add_gc, TRUE, void_flag, Result))
+                 break;
              assembleg_store(temp_var1, ET[below].value);
              assembleg_store(temp_var2, ET[ET[below].right].value);
              access_memory_g(aload_gc, temp_var1, temp_var2, temp_var3);
@@ -2444,6 +2760,9 @@ static void generate_code_from(int n, int void_flag)
              break;
 
         case DARROW_POST_DEC_OP:
+             if (step_array_entry_g(aload_gc, astore_gc, ET[below].value,
+                 ET[ET[below].right].value, sub_gc, TRUE, void_flag, Result))
+                 break;
              assembleg_store(temp_var1, ET[below].value);
              assembleg_store(temp_var2, ET[ET[below].right].value);
              access_memory_g(aload_gc, temp_var1, temp_var2, temp_var3);
@@ -2456,7 +2775,7 @@ static void generate_code_from(int n, int void_flag)
         case MESSAGE_OP:
              check_warn_symbol_type(&ET[below].value, OBJECT_T, CLASS_T, "\".\" expression");
              check_warn_symbol_type(&ET[ET[below].right].value, PROPERTY_T, INDIVIDUAL_PROPERTY_T, "\".\" expression");
-             AO = veneer_routine(RV__Pr_VR);
+             AO = property_read_routine(ET[ET[below].right].value);
              goto TwoArgFunctionCall;
         case MPROP_ADD_OP:
         case PROP_ADD_OP:
@@ -2670,17 +2989,21 @@ static void generate_code_from(int n, int void_flag)
                          else {
                            /* One argument, not known at compile time */
                            int ln, ln2;
-                           assembleg_store(temp_var1, ET[ET[below].right].value);
+                           assembly_operand AO3 = temp_var1;
+                           if (reusable_operand_g(ET[ET[below].right].value))
+                             AO3 = ET[ET[below].right].value;
+                           else
+                             assembleg_store(AO3, ET[ET[below].right].value);
                            ln = next_label++;
                            ln2 = next_label++;
-                           assembleg_2_branch(jle_gc, temp_var1, zero_operand, ln);
+                           assembleg_2_branch(jle_gc, AO3, zero_operand, ln);
                            assembleg_2(random_gc,
-                             temp_var1, stack_pointer);
+                             AO3, stack_pointer);
                            assembleg_3(add_gc, stack_pointer, one_operand,
                              Result);
                            assembleg_0_branch(jump_gc, ln2);
                            assemble_label_no(ln);
-                           assembleg_2(neg_gc, temp_var1, stack_pointer);
+                           assembleg_2(neg_gc, AO3, stack_pointer);
                            assembleg_1(setrandom_gc,
                              stack_pointer);
                            assembleg_store(Result, zero_operand);
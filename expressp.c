@@ -55,6 +55,7 @@ static int comma_allowed, arrow_allowed, superclass_allowed,
 int system_function_usage[NUMBER_SYSTEM_FUNCTIONS];
 
 static void check_system_constant_available(int);
+static int fold_pure_call(int arity, int32 *x);
 
 static int get_next_etoken(void)
 {   int v, symbol = 0, mark_symbol_as_used = FALSE,
@@ -122,6 +123,7 @@ but not used as a value:", unicode);
             symbol = current_token.value;
 
             mark_symbol_as_used = TRUE;
+            note_symbol_usage(symbol);
 
             v = symbols[symbol].value;
 
@@ -327,6 +329,7 @@ but not used as a value:", unicode);
                         break;
                     }
                     mark_symbol_as_used = TRUE;
+                    note_global_assignment(symbols[symbol].value);
                     current_token.value = symbols[symbol].value - MAX_LOCAL_VARIABLES;
                     current_token.marker = 0;
                     if (!glulx_mode) {
@@ -387,6 +390,8 @@ but not used as a value:", unicode);
                     else
                     {
                         check_system_constant_available(token_value);
+                        if (token_value == globals_array_SC)
+                            note_global_assignment(-1);
                         current_token.type   = token_type;
                         current_token.value  = token_value;
                         current_token.text   = token_text;
@@ -751,6 +756,10 @@ static int32 value_of_system_constant_z(int t)
             if (!GRAMMAR_META_FLAG)
                 error_named("Must set $GRAMMAR_META_FLAG to use option:", system_constants.keywords[t]);
             return (no_meta_actions-1) & 0xFFFF;
+        case grammar_index_table_SC:
+            if (!GRAMMAR_INDEX)
+                error_named("Must set $GRAMMAR_INDEX to use option:", system_constants.keywords[t]);
+            return grammar_index_offset;
     }
 
     error_named("System constant not implemented in Z-code",
@@ -818,6 +827,10 @@ static int32 value_of_system_constant_g(int t)
     if (!GRAMMAR_META_FLAG)
       error_named("Must set $GRAMMAR_META_FLAG to use option:", system_constants.keywords[t]);
     return no_meta_actions-1;
+  case grammar_index_table_SC:
+    if (!GRAMMAR_INDEX)
+      error_named("Must set $GRAMMAR_INDEX to use option:", system_constants.keywords[t]);
+    return grammar_index_offset;
   }
 
   error_named("System constant not implemented in Glulx",
@@ -1283,6 +1296,10 @@ static void emit_token(const token_data *t)
         }
     }
 
+    if ((t->value == FCALL_OP) && (FOLD_PURE_ROUTINES)
+        && fold_pure_call(arity, &x))
+        goto FoldConstant;
+
     switch(arity)
     {   case 1:
             o1 = emitter_stack[emitter_sp - 1].op;
@@ -1679,6 +1696,15 @@ static void check_lvalues(int from_node)
                   goto LvalueError;
               }
 
+              /*  Note a property named in the source as written to, so
+                  that $PROMOTE_INDIV_PROPS leaves it alone               */
+              if ((opnum_below == PROPERTY_OP) || (opnum_below == MESSAGE_OP))
+              {   i = ET[ET[below].down].right;
+                  if ((ET[i].down == -1) && (ET[i].value.symindex >= 0))
+                      note_symbol_usage_flag(ET[i].value.symindex,
+                          ASSIGNED_UFLAG);
+              }
+
               /*  Transform  from_node                     from_node
                                |      \                       | \\\  \
                              below    value       to                 value
@@ -2185,6 +2211,90 @@ extern int test_for_incdec(assembly_operand AO)
     return s*(ET[ET[AO.value].down].value.value);
 }
 
+/* --- Keeping a parse tree while a code block is compiled ----------------- */
+
+/*  The expression tree space is cleared at the start of every statement, so
+    a tree which must be compiled again after a loop body (see "for" and
+    "while" with $ROTATE_LOOPS) is copied out with save_expression() and
+    copied back in with restore_expression().  The copy must be taken before
+    the tree is first compiled, since code generation annotates the tree.    */
+
+static int count_tree_nodes(int n)
+{   int i, count = 1;
+    for (i = ET[n].down; i != -1; i = ET[i].right)
+        count += count_tree_nodes(i);
+    return count;
+}
+
+static int copy_tree_nodes(int n, int up, expression_tree_node *to,
+    int *count)
+{   int i, j, k, previous = -1;
+    k = (*count)++;
+    to[k] = ET[n];
+    to[k].up = up; to[k].down = -1; to[k].right = -1;
+    for (i = ET[n].down; i != -1; i = ET[i].right)
+    {   j = copy_tree_nodes(i, k, to, count);
+        if (previous == -1) to[k].down = j; else to[previous].right = j;
+        previous = j;
+    }
+    return k;
+}
+
+extern expression_tree_node *save_expression(assembly_operand AO,
+    int *count)
+{   expression_tree_node *saved;
+    *count = 0;
+    if (AO.type != EXPRESSION_OT) return NULL;
+    saved = my_calloc(sizeof(expression_tree_node),
+        count_tree_nodes(AO.value), "saved expression tree");
+    copy_tree_nodes(AO.value, -1, saved, count);
+    return saved;
+}
+
+extern assembly_operand restore_expression(assembly_operand AO,
+    expression_tree_node *saved, int count)
+{   int i, base;
+    if (saved == NULL) return AO;
+    ensure_memory_list_available(&ET_memlist, ET_used+count);
+    base = ET_used;
+    for (i=0; i<count; i++)
+    {   ET[base+i] = saved[i];
+        if (saved[i].up != -1) ET[base+i].up += base;
+        if (saved[i].down != -1) ET[base+i].down += base;
+        if (saved[i].right != -1) ET[base+i].right += base;
+    }
+    ET_used += count;
+    my_free(&saved, "saved expression tree");
+    AO.value = base;
+    return AO;
+}
+
+/*  Can the condition AO (as returned by parse_expression() in a condition
+    context, and not yet compiled) be reversed by negate_expression()?       */
+
+extern int test_for_negatable(assembly_operand AO)
+{   if (AO.type == EXPRESSION_OT)
+        return (operators[ET[AO.value].operator_number].negation != 0);
+    return ((AO.type != OMITTED_OT) && (!is_constant_ot(AO.type)));
+}
+
+extern assembly_operand negate_expression(assembly_operand AO)
+{   int n;
+    if (AO.type == EXPRESSION_OT)
+    {   negate_condition(AO.value);
+        return AO;
+    }
+    ensure_memory_list_available(&ET_memlist, ET_used+2);
+    n = ET_used; ET_used += 2;
+    ET[n].up = -1; ET[n].down = n+1; ET[n].right = -1;
+    ET[n].operator_number = ZERO_OP;
+    ET[n+1].up = n; ET[n+1].down = -1; ET[n+1].right = -1;
+    ET[n+1].value = AO;
+    INITAOT(&AO, EXPRESSION_OT);
+    AO.value = n;
+    return AO;
+}
+
 
 /* Determine if the operand (a parsed expression) is a constant (as
    per is_constant_ot()) or a comma-separated list of such constants.
@@ -2259,6 +2369,292 @@ extern int test_constant_op_list(const assembly_operand *AO, assembly_operand *o
     }
 }
 
+/* --- Folding calls to pure routines ($FOLD_PURE_ROUTINES) --------------- */
+
+/*  A routine whose whole body is "return <expression>;", where the
+    expression uses only its own locals, constants, arithmetic, comparisons
+    and calls to routines already found to be pure, is pure: a call to it
+    with constant arguments can be replaced by the value it would return.
+    Its expression tree is kept for the rest of the compilation. Calls can
+    only be to routines defined earlier, so there is no recursion and no
+    loop, and evaluation always finishes.                                   */
+
+typedef struct pure_routine_s {
+    int symbol;                     /* The routine's symbol                 */
+    assembly_operand AO;            /* The return value, if not a tree      */
+    expression_tree_node *tree;     /* Otherwise its tree, rooted at 0      */
+} pure_routine;
+
+static pure_routine *pure_routines; /* Allocated to no_pure_routines        */
+static memory_list pure_routines_memlist;
+static int no_pure_routines;
+
+static int pure_candidate;          /* Symbol of the routine being compiled
+                                       if it may yet be pure, or -1         */
+static int pure_statements;         /* Statements in its body so far        */
+static assembly_operand pure_AO;    /* What its return statement returns    */
+static expression_tree_node *pure_tree;
+static int pure_count;
+
+/*  The arrays of locals and arguments below have a fixed size, since
+    MAX_LOCAL_VARIABLES is only known at run time; select_target() never
+    lets it exceed MAX_KEYWORD_GROUP_SIZE.                                  */
+
+#define MAX_PURE_LOCALS (MAX_KEYWORD_GROUP_SIZE)
+
+static pure_routine *find_pure_routine(int symbol)
+{   int i;
+    if (symbol < 0) return NULL;
+    for (i=0; i<no_pure_routines; i++)
+        if (pure_routines[i].symbol == symbol) return &(pure_routines[i]);
+    return NULL;
+}
+
+/*  Converts between stored values and signed ones for the current VM.    */
+
+static int32 pure_signed(int32 x)
+{   if (!glulx_mode) return (x >= 0x8000) ? (x - 0x10000) : x;
+    return x;
+}
+
+static int32 pure_stored(uint32 x)
+{   if (!glulx_mode) return (int32) (x & 0xffff);
+    return (int32) (x & 0xffffffff);
+}
+
+static int pure_local(const assembly_operand *AO)
+{   if ((!glulx_mode) && (AO->type == VARIABLE_OT)
+        && (AO->value >= 1) && (AO->value < 16)) return AO->value;
+    if ((glulx_mode) && (AO->type == LOCALVAR_OT)
+        && (AO->value >= 1) && (AO->value < MAX_LOCAL_VARIABLES))
+        return AO->value;
+    return 0;
+}
+
+static int pure_operand(const assembly_operand *AO)
+{   if (is_constant_ot(AO->type)) return (AO->marker == 0);
+    return (pure_local(AO) != 0);
+}
+
+static int pure_node(expression_tree_node *tree, int n)
+{   int i, arity = 0;
+    if (tree[n].down == -1) return pure_operand(&(tree[n].value));
+    for (i = tree[n].down; i != -1; i = tree[i].right) arity++;
+    switch (tree[n].operator_number)
+    {   case LOGNOT_OP: case ZERO_OP: case NONZERO_OP:
+        case ARTNOT_OP: case UNARY_MINUS_OP:
+            if (arity != 1) return FALSE;
+            break;
+        case LOGAND_OP: case LOGOR_OP:
+        case GE_OP: case GREATER_OP: case LE_OP: case LESS_OP:
+        case PLUS_OP: case MINUS_OP: case TIMES_OP:
+        case DIVIDE_OP: case REMAINDER_OP: case ARTAND_OP: case ARTOR_OP:
+            if (arity != 2) return FALSE;
+            break;
+        case CONDEQUALS_OP: case NOTEQUAL_OP:
+            if (arity < 2) return FALSE;
+            break;
+        case FCALL_OP:
+            i = tree[n].down;
+            if ((tree[i].down != -1) || (tree[i].value.marker != IROUTINE_MV)
+                || (find_pure_routine(tree[i].value.symindex) == NULL))
+                return FALSE;
+            if (arity > MAX_LOCAL_VARIABLES) return FALSE;
+            for (i = tree[i].right; i != -1; i = tree[i].right)
+                if (!pure_node(tree, i)) return FALSE;
+            return TRUE;
+        default:
+            return FALSE;
+    }
+    for (i = tree[n].down; i != -1; i = tree[i].right)
+        if (!pure_node(tree, i)) return FALSE;
+    return TRUE;
+}
+
+static int evaluate_pure_call(pure_routine *r, int32 *args, int argc,
+    int32 *x);
+
+/*  Evaluates node n of a pure routine's tree with the given locals, giving
+    FALSE if the value can't be known at compile time (division by zero).  */
+
+static int evaluate_pure_node(expression_tree_node *tree, int n,
+    int32 *locals, int32 *x)
+{   int i, j, argc;
+    int32 v[2], args[MAX_PURE_LOCALS];
+    uint32 a, b;
+
+    if (tree[n].down == -1)
+    {   if ((j = pure_local(&(tree[n].value))) != 0) *x = locals[j];
+        else *x = pure_stored(tree[n].value.value);
+        return TRUE;
+    }
+
+    i = tree[n].down;
+    switch (tree[n].operator_number)
+    {   case LOGAND_OP: case LOGOR_OP:
+            if (!evaluate_pure_node(tree, i, locals, v)) return FALSE;
+            if ((tree[n].operator_number == LOGAND_OP) ? (v[0] == 0)
+                                                      : (v[0] != 0))
+            {   *x = (v[0] != 0); return TRUE;
+            }
+            if (!evaluate_pure_node(tree, tree[i].right, locals, v))
+                return FALSE;
+            *x = (v[0] != 0);
+            return TRUE;
+        case CONDEQUALS_OP: case NOTEQUAL_OP:
+            if (!evaluate_pure_node(tree, i, locals, v)) return FALSE;
+            *x = 0;
+            for (i = tree[i].right; i != -1; i = tree[i].right)
+            {   if (!evaluate_pure_node(tree, i, locals, v+1)) return FALSE;
+                if (v[0] == v[1]) *x = 1;
+            }
+            if (tree[n].operator_number == NOTEQUAL_OP) *x = !(*x);
+            return TRUE;
+        case FCALL_OP:
+            argc = 0;
+            for (j = tree[i].right; j != -1; j = tree[j].right)
+                if (!evaluate_pure_node(tree, j, locals, args + argc++))
+                    return FALSE;
+            return evaluate_pure_call(
+                find_pure_routine(tree[i].value.symindex), args, argc, x);
+    }
+
+    if (!evaluate_pure_node(tree, i, locals, v)) return FALSE;
+    if (tree[i].right != -1)
+    {   if (!evaluate_pure_node(tree, tree[i].right, locals, v+1))
+            return FALSE;
+    }
+    switch (tree[n].operator_number)
+    {   case LOGNOT_OP: case ZERO_OP: *x = (v[0] == 0); return TRUE;
+        case NONZERO_OP: *x = (v[0] != 0); return TRUE;
+        case ARTNOT_OP: *x = pure_stored(~((uint32) v[0])); return TRUE;
+        case UNARY_MINUS_OP: *x = pure_stored(0 - (uint32) v[0]); return TRUE;
+        case PLUS_OP: *x = pure_stored((uint32) v[0] + (uint32) v[1]);
+            return TRUE;
+        case MINUS_OP: *x = pure_stored((uint32) v[0] - (uint32) v[1]);
+            return TRUE;
+        case TIMES_OP: *x = pure_stored((uint32) v[0] * (uint32) v[1]);
+            return TRUE;
+        case ARTAND_OP: *x = v[0] & v[1]; return TRUE;
+        case ARTOR_OP: *x = v[0] | v[1]; return TRUE;
+    }
+    v[0] = pure_signed(v[0]); v[1] = pure_signed(v[1]);
+    switch (tree[n].operator_number)
+    {   case GE_OP: *x = (v[0] >= v[1]); return TRUE;
+        case GREATER_OP: *x = (v[0] > v[1]); return TRUE;
+        case LE_OP: *x = (v[0] <= v[1]); return TRUE;
+        case LESS_OP: *x = (v[0] < v[1]); return TRUE;
+        case DIVIDE_OP: case REMAINDER_OP:
+            /*  The interpreter halts on division by zero, and dividing the
+                most negative number by -1 overflows: leave both to it      */
+            if (v[1] == 0) return FALSE;
+            if (glulx_mode && (v[1] == -1) && (v[0] == -0x7fffffff-1))
+                return FALSE;
+            a = (v[0] < 0) ? 0 - (uint32) v[0] : (uint32) v[0];
+            b = (v[1] < 0) ? 0 - (uint32) v[1] : (uint32) v[1];
+            if (tree[n].operator_number == DIVIDE_OP)
+            {   a = a / b;
+                if ((v[0] < 0) != (v[1] < 0)) a = 0 - a;
+            }
+            else
+            {   a = a % b;
+                if (v[0] < 0) a = 0 - a;
+            }
+            *x = pure_stored(a);
+            return TRUE;
+    }
+    return FALSE;
+}
+
+static int evaluate_pure_call(pure_routine *r, int32 *args, int argc,
+    int32 *x)
+{   int32 locals[MAX_PURE_LOCALS];
+    int i;
+    if (r == NULL) return FALSE;
+    for (i=0; i<MAX_LOCAL_VARIABLES; i++)
+        locals[i] = (i >= 1 && i <= argc) ? args[i-1] : 0;
+    if (r->tree == NULL)
+    {   if ((i = pure_local(&(r->AO))) != 0) *x = locals[i];
+        else *x = pure_stored(r->AO.value);
+        return TRUE;
+    }
+    return evaluate_pure_node(r->tree, 0, locals, x);
+}
+
+/*  Called as each routine begins, with its symbol if it is a candidate
+    (named, not embedded, not in the veneer and not traced) or -1.          */
+
+extern void begin_pure_routine(int symbol)
+{   if (pure_tree) my_free(&pure_tree, "saved expression tree");
+    pure_candidate = (FOLD_PURE_ROUTINES) ? symbol : -1;
+    pure_statements = 0;
+    pure_AO = zero_operand;
+}
+
+/*  Called before each statement at the top level of a routine.             */
+
+extern void note_routine_statement(int is_return)
+{   if (pure_candidate < 0) return;
+    if ((++pure_statements > 1) || (!is_return)) pure_candidate = -1;
+}
+
+/*  Called with the parsed (but not yet compiled) expression of every
+    "return" statement.                                                      */
+
+extern void note_return_expression(assembly_operand AO)
+{   if ((pure_candidate < 0) || (pure_statements != 1)) return;
+    if (pure_tree) my_free(&pure_tree, "saved expression tree");
+    pure_AO = AO;
+    pure_tree = save_expression(AO, &pure_count);
+    if (pure_tree == NULL)
+    {   if ((AO.type == OMITTED_OT) || (!pure_operand(&AO)))
+            pure_candidate = -1;
+    }
+    else if (!pure_node(pure_tree, 0))
+        pure_candidate = -1;
+    /*  A routine which has already returned isn't looked at again          */
+    pure_statements++;
+}
+
+/*  Called as each routine ends: ok is FALSE if the body had some shape
+    (such as switch cases) which note_routine_statement() didn't see.       */
+
+extern void end_pure_routine(int ok)
+{   if ((pure_candidate >= 0) && ok && (pure_statements == 2))
+    {   ensure_memory_list_available(&pure_routines_memlist,
+            no_pure_routines+1);
+        pure_routines[no_pure_routines].symbol = pure_candidate;
+        pure_routines[no_pure_routines].AO = pure_AO;
+        pure_routines[no_pure_routines].tree = pure_tree;
+        no_pure_routines++;
+        pure_tree = NULL;
+    }
+    if (pure_tree) my_free(&pure_tree, "saved expression tree");
+    pure_candidate = -1;
+}
+
+/*  Called by the emitter for a function call: if it is to a pure routine
+    and every argument is a constant, *x is set to the value of the call.  */
+
+static int fold_pure_call(int arity, int32 *x)
+{   int32 args[MAX_PURE_LOCALS];
+    assembly_operand *o;
+    int i;
+    pure_routine *r;
+
+    o = &(emitter_stack[emitter_sp-arity].op);
+    if ((o->marker != IROUTINE_MV) || (arity > MAX_LOCAL_VARIABLES))
+        return FALSE;
+    r = find_pure_routine(o->symindex);
+    if (r == NULL) return FALSE;
+    for (i=1; i<arity; i++)
+    {   o = &(emitter_stack[emitter_sp-arity+i].op);
+        if ((!is_constant_ot(o->type)) || (o->marker != 0)) return FALSE;
+        args[i-1] = pure_stored(o->value);
+    }
+    return evaluate_pure_call(r, args, arity-1, x);
+}
+
 /* ========================================================================= */
 /*   Data structure management routines                                      */
 /* ------------------------------------------------------------------------- */
@@ -2273,6 +2669,10 @@ extern void init_expressp_vars(void)
     ET = NULL;
     emitter_stack = NULL;
     sr_stack = NULL;
+    pure_routines = NULL;
+    no_pure_routines = 0;
+    pure_candidate = -1;
+    pure_tree = NULL;
 }
 
 extern void expressp_begin_pass(void)
@@ -2292,15 +2692,26 @@ extern void expressp_allocate_arrays(void)
     initialise_memory_list(&sr_stack_memlist,
         sizeof(token_data), 100, (void**)&sr_stack,
         "shift-reduce parser stack");
+
+    initialise_memory_list(&pure_routines_memlist,
+        sizeof(pure_routine), 16, (void**)&pure_routines,
+        "pure routines");
 }
 
 extern void expressp_free_arrays(void)
-{
+{   int i;
+
     deallocate_memory_list(&ET_memlist);
     
     deallocate_memory_list(&emitter_stack_memlist);
 
     deallocate_memory_list(&sr_stack_memlist);
+
+    for (i=0; i<no_pure_routines; i++)
+        if (pure_routines[i].tree)
+            my_free(&(pure_routines[i].tree), "saved expression tree");
+    deallocate_memory_list(&pure_routines_memlist);
+    if (pure_tree) my_free(&pure_tree, "saved expression tree");
 }
 
 /* ========================================================================= */
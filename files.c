@@ -85,6 +85,399 @@ char *realpath(const char *path, char *resolved_path)
 }
 #endif
 
+static void note_sourcefile_closed(int file_number)
+{
+    if (files_trace_setting > 0) {
+        char *str = (InputFiles[file_number-1].initial_buffering ? " (in initial buffering)" : "");
+        printf("Closing file \"%s\"%s\n", InputFiles[file_number-1].filename, str);
+    }
+}
+
+#ifdef READ_AHEAD
+
+/* ------------------------------------------------------------------------- */
+/*   Background read-ahead (only if READ_AHEAD is defined; see "header.h")   */
+/*                                                                           */
+/*   A single I/O thread reads source files into memory ahead of the lexer.  */
+/*   Once load_sourcefile() has a file open, the thread takes over the       */
+/*   handle and reads the whole file; file_load_chars() copies out of the    */
+/*   buffer, waiting only if the thread has not yet got that far.            */
+/*                                                                           */
+/*   As text arrives it is scanned for lines beginning "Include", and the    */
+/*   files they name are opened and read speculatively. When the directive   */
+/*   is actually compiled, load_sourcefile() claims the prefetched copy      */
+/*   instead of searching the include path itself. A speculative prefetch   */
+/*   which is never claimed (because the Include was in a comment, or was    */
+/*   skipped by #Ifdef) costs only some memory and I/O.                      */
+/*                                                                           */
+/*   The buffers are allocated with malloc() rather than my_malloc(), since  */
+/*   the memory accounting in "memory.c" is not thread-safe.                 */
+/* ------------------------------------------------------------------------- */
+
+#include <pthread.h>
+
+#define READ_AHEAD_CHUNK        16384
+#define READ_AHEAD_SPECULATIVE     32   /* Most unclaimed prefetches at once */
+
+#define RA_OPENING  0               /* Prefetch not yet opened */
+#define RA_READING  1
+#define RA_DONE     2
+#define RA_FAILED   3               /* Prefetch could not be opened */
+
+typedef struct readahead_s {
+    char *given;                    /* Include name as given, or NULL if
+                                       load_sourcefile() opened the file   */
+    int same_directory_flag;
+    char *candidates;               /* Translated names to try in order,
+                                       each null-terminated, ending with
+                                       an empty string                      */
+    char name[PATHLEN];             /* The name actually opened             */
+    FILE *handle;                   /* Owned by the I/O thread              */
+    char *buffer;
+    int32 size;                     /* Bytes read so far                    */
+    int32 capacity;                 /* Bytes allocated                      */
+    int32 pos;                      /* Bytes handed on to the lexer         */
+    int32 scanned;                  /* Bytes scanned for Include lines      */
+    int state;
+    int io_error, memory_error;
+    int32 claimed;                  /* 0, or the order in which it was
+                                       attached to an InputFiles entry      */
+    struct readahead_s *next;
+} readahead;
+
+static readahead *readahead_list;   /* All jobs, in the order queued */
+static readahead **readahead_files; /* By file number - 1, or NULL */
+static memory_list readahead_files_memlist;
+static int no_readahead_files;
+static int32 readahead_claims;
+
+static pthread_t readahead_thread;
+static pthread_mutex_t readahead_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t readahead_wake = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t readahead_progress = PTHREAD_COND_INITIALIZER;
+static int readahead_running, readahead_unavailable, readahead_quit;
+
+/*  The I/O thread works on the most recently claimed unfinished file (the
+    one the lexer is reading, or will be when it returns from an inner
+    Include), and otherwise on the oldest prefetch. It works a chunk at a
+    time, so a newly claimed file never waits long behind a prefetch.        */
+
+static readahead *readahead_next_job(void)
+{   readahead *ra, *best = NULL;
+    for (ra = readahead_list; ra; ra = ra->next)
+    {   if ((ra->state == RA_DONE) || (ra->state == RA_FAILED)) continue;
+        if ((best == NULL)
+            || (ra->claimed > best->claimed)) best = ra;
+    }
+    return best;
+}
+
+static void *readahead_main(void *unused)
+{   static char chunk[READ_AHEAD_CHUNK];
+
+    (void) unused;
+    pthread_mutex_lock(&readahead_mutex);
+    while (!readahead_quit)
+    {   readahead *ra = readahead_next_job();
+        if (ra == NULL)
+        {   pthread_cond_wait(&readahead_wake, &readahead_mutex);
+            continue;
+        }
+
+        if (ra->state == RA_OPENING)
+        {   char *p; FILE *handle = NULL;
+            pthread_mutex_unlock(&readahead_mutex);
+            for (p = ra->candidates; *p != 0; p += strlen(p)+1)
+            {   handle = fopen(p, "rb");
+                if (handle != NULL) break;
+            }
+            pthread_mutex_lock(&readahead_mutex);
+            if (handle != NULL)
+            {   strcpy(ra->name, p);
+                ra->handle = handle;
+                ra->state = RA_READING;
+            }
+            else ra->state = RA_FAILED;
+        }
+        else
+        {   FILE *handle = ra->handle;
+            size_t n;
+            pthread_mutex_unlock(&readahead_mutex);
+            n = fread(chunk, 1, READ_AHEAD_CHUNK, handle);
+            pthread_mutex_lock(&readahead_mutex);
+            if (ra->size + (int32) n > ra->capacity)
+            {   int32 capacity = 2*ra->capacity + READ_AHEAD_CHUNK;
+                char *buffer = realloc(ra->buffer, capacity);
+                if (buffer == NULL)
+                {   ra->memory_error = TRUE; n = 0;
+                }
+                else
+                {   ra->buffer = buffer; ra->capacity = capacity;
+                }
+            }
+            if (n > 0) memcpy(ra->buffer + ra->size, chunk, n);
+            ra->size += n;
+            if ((n < READ_AHEAD_CHUNK) || ra->memory_error)
+            {   if (ferror(handle)) ra->io_error = TRUE;
+                fclose(handle);
+                ra->handle = NULL;
+                ra->state = RA_DONE;
+            }
+        }
+        pthread_cond_broadcast(&readahead_progress);
+    }
+    pthread_mutex_unlock(&readahead_mutex);
+    return NULL;
+}
+
+/*  Start the I/O thread if it isn't running; FALSE if it can't be.         */
+
+static int readahead_start(void)
+{   if (readahead_running) return TRUE;
+    if (readahead_unavailable) return FALSE;
+    readahead_quit = FALSE;
+    if (pthread_create(&readahead_thread, NULL, readahead_main, NULL) != 0)
+    {   readahead_unavailable = TRUE;
+        return FALSE;
+    }
+    readahead_running = TRUE;
+    return TRUE;
+}
+
+/*  Not my_malloc(): buffers grow on the I/O thread, and it isn't safe there */
+
+static readahead *readahead_new(void)
+{   readahead *ra = calloc(1, sizeof(readahead));
+    readahead **p;
+    if (ra == NULL) return NULL;
+    for (p = &readahead_list; *p; p = &((*p)->next)) ;
+    *p = ra;
+    return ra;
+}
+
+static void readahead_discard(readahead *ra)
+{   readahead **p;
+    for (p = &readahead_list; *p; p = &((*p)->next))
+        if (*p == ra) { *p = ra->next; break; }
+    if (ra->handle != NULL) fclose(ra->handle);
+    free(ra->given);
+    free(ra->candidates);
+    free(ra->buffer);
+    free(ra);
+}
+
+/*  Queue a speculative prefetch of an Include file. The candidate names are
+    worked out now (on the main thread) exactly as load_sourcefile() would
+    work them out; only the fopen() calls happen on the I/O thread.
+    Called with the mutex held.                                              */
+
+static void readahead_prefetch(char *given, int same_directory_flag)
+{   readahead *ra;
+    char name[PATHLEN];
+    char *candidates = NULL;
+    size_t len = 0;
+    int x = 0, unclaimed = 0;
+
+    for (ra = readahead_list; ra; ra = ra->next)
+    {   if (ra->given == NULL) continue;
+        if ((ra->same_directory_flag == same_directory_flag)
+            && (strcmp(ra->given, given) == 0)) return;
+        if (!ra->claimed) unclaimed++;
+    }
+    if (unclaimed >= READ_AHEAD_SPECULATIVE) return;
+
+    do
+    {   char *more;
+        x = translate_in_filename(x, name, given, same_directory_flag, 0);
+        more = realloc(candidates, len + strlen(name) + 2);
+        if (more == NULL) { free(candidates); return; }
+        candidates = more;
+        strcpy(candidates + len, name);
+        len += strlen(name) + 1;
+    } while (x != 0);
+    candidates[len] = 0;
+
+    ra = readahead_new();
+    if (ra == NULL) { free(candidates); return; }
+    ra->given = malloc(strlen(given)+1);
+    if (ra->given == NULL)
+    {   free(candidates); readahead_discard(ra); return;
+    }
+    strcpy(ra->given, given);
+    ra->same_directory_flag = same_directory_flag;
+    ra->candidates = candidates;
+    ra->state = RA_OPENING;
+    pthread_cond_signal(&readahead_wake);
+}
+
+/*  Scan complete lines of newly arrived text for Include directives. This
+    is deliberately crude: the directive must begin its line.
+    Called with the mutex held.                                              */
+
+static void readahead_scan(readahead *ra)
+{   int32 i = ra->scanned, end = ra->size;
+    char given[PATHLEN];
+
+    if (ra->state == RA_READING)
+        while ((end > i) && (ra->buffer[end-1] != '\n')) end--;
+
+    while (i < end)
+    {   char *p = ra->buffer + i, *q;
+        int32 j = i, k;
+        while ((j < end) && (ra->buffer[j] != '\n')) j++;
+        q = ra->buffer + j;
+        i = j+1;
+
+        while ((p < q) && ((*p == ' ') || (*p == '\t'))) p++;
+        if ((p < q) && (*p == '#')) p++;
+        for (k=0; (k<7) && (p+k < q); k++)
+            if (tolower((uchar) p[k]) != "include"[k]) break;
+        if (k < 7) continue;
+        p += 7;
+        if ((p == q) || ((*p != ' ') && (*p != '\t'))) continue;
+        while ((p < q) && ((*p == ' ') || (*p == '\t'))) p++;
+        if ((p == q) || (*p++ != '"')) continue;
+        for (k=0; (p+k < q) && (p[k] != '"'); k++) ;
+        if ((p+k == q) || (k >= PATHLEN-1)) continue;
+        memcpy(given, p, k);
+        given[k] = 0;
+
+        if (strcmp(given, "language__") == 0)
+            readahead_prefetch(Language_Name, 0);
+        else if (given[0] == '>')
+            readahead_prefetch(given+1, 1);
+        else if (given[0] != 0)
+            readahead_prefetch(given, 0);
+    }
+    if (end > ra->scanned) ra->scanned = end;
+}
+
+/*  load_sourcefile() asks for a prefetched copy of an Include file. Returns
+    NULL if there is none, or if it could not be opened (in which case the
+    usual search will fail in the usual way). Otherwise the translated name
+    is written to name.                                                      */
+
+static readahead *readahead_claim(char *given, int same_directory_flag,
+    char *name)
+{   readahead *ra;
+
+    if (!readahead_running) return NULL;
+
+    pthread_mutex_lock(&readahead_mutex);
+    for (ra = readahead_list; ra; ra = ra->next)
+        if ((ra->given != NULL) && (!ra->claimed)
+            && (ra->same_directory_flag == same_directory_flag)
+            && (strcmp(ra->given, given) == 0)) break;
+    if (ra != NULL)
+    {   ra->claimed = ++readahead_claims;
+        pthread_cond_signal(&readahead_wake);
+        while (ra->state == RA_OPENING)
+            pthread_cond_wait(&readahead_progress, &readahead_mutex);
+        if (ra->state == RA_FAILED)
+        {   readahead_discard(ra);
+            ra = NULL;
+        }
+        else strcpy(name, ra->name);
+    }
+    pthread_mutex_unlock(&readahead_mutex);
+    return ra;
+}
+
+/*  Hand a file which load_sourcefile() has opened to the I/O thread.
+    Returns NULL (and the caller keeps the handle) if there is no thread.    */
+
+static readahead *readahead_adopt(FILE *handle, char *name)
+{   readahead *ra;
+
+    pthread_mutex_lock(&readahead_mutex);
+    ra = NULL;
+    if (readahead_start()) ra = readahead_new();
+    if (ra != NULL)
+    {   strcpy(ra->name, name);
+        ra->handle = handle;
+        ra->state = RA_READING;
+        ra->claimed = ++readahead_claims;
+        pthread_cond_signal(&readahead_wake);
+    }
+    pthread_mutex_unlock(&readahead_mutex);
+    return ra;
+}
+
+static void readahead_set_file(int file_number, readahead *ra)
+{   ensure_memory_list_available(&readahead_files_memlist, file_number);
+    while (no_readahead_files < file_number)
+        readahead_files[no_readahead_files++] = NULL;
+    readahead_files[file_number-1] = ra;
+}
+
+static readahead *readahead_for_file(int file_number)
+{   if ((file_number < 1) || (file_number > no_readahead_files)) return NULL;
+    return readahead_files[file_number-1];
+}
+
+/*  The equivalent of fread() for a file being read ahead.                  */
+
+static int readahead_load_chars(readahead *ra, char *buffer, int length)
+{   int32 read_in;
+
+    pthread_mutex_lock(&readahead_mutex);
+    while ((ra->state == RA_READING) && (ra->size - ra->pos < length))
+        pthread_cond_wait(&readahead_progress, &readahead_mutex);
+    read_in = ra->size - ra->pos;
+    if (read_in > length) read_in = length;
+    memcpy(buffer, ra->buffer + ra->pos, read_in);
+    ra->pos += read_in;
+    readahead_scan(ra);
+    pthread_mutex_unlock(&readahead_mutex);
+    return read_in;
+}
+
+/*  The equivalent of fclose() for a file being read ahead: TRUE if it was
+    one.                                                                     */
+
+static int readahead_release(int file_number)
+{   readahead *ra = readahead_for_file(file_number);
+    int io_error, memory_error;
+
+    if (ra == NULL) return FALSE;
+
+    pthread_mutex_lock(&readahead_mutex);
+    while (ra->state == RA_READING)
+        pthread_cond_wait(&readahead_progress, &readahead_mutex);
+    io_error = ra->io_error; memory_error = ra->memory_error;
+    readahead_discard(ra);
+    pthread_mutex_unlock(&readahead_mutex);
+    readahead_files[file_number-1] = NULL;
+
+    if (io_error)
+        fatalerror_named("I/O failure: couldn't read from source file",
+            InputFiles[file_number-1].filename);
+    if (memory_error)
+        fatalerror_named("Out of memory reading ahead source file",
+            InputFiles[file_number-1].filename);
+
+    note_sourcefile_closed(file_number);
+    return TRUE;
+}
+
+/*  Stop the I/O thread and throw away any prefetches never claimed.        */
+
+static void readahead_stop(void)
+{   if (readahead_running)
+    {   pthread_mutex_lock(&readahead_mutex);
+        readahead_quit = TRUE;
+        pthread_cond_signal(&readahead_wake);
+        pthread_mutex_unlock(&readahead_mutex);
+        pthread_join(readahead_thread, NULL);
+        readahead_running = FALSE;
+    }
+    while (readahead_list != NULL) readahead_discard(readahead_list);
+    no_readahead_files = 0;
+    readahead_claims = 0;
+}
+
+#endif
+
 extern void load_sourcefile(char *filename_given, int same_directory_flag)
 {
     /*  Meaning: open a new file of Inform source.  (The lexer picks up on
@@ -95,10 +488,18 @@ extern void load_sourcefile(char *filename_given, int same_directory_flag)
     char absolute_name[PATHLEN];
 #endif
     int x = 0;
-    FILE *handle;
+    FILE *handle = NULL;
+#ifdef READ_AHEAD
+    readahead *ra = NULL;
+#endif
 
     ensure_memory_list_available(&InputFiles_memlist, total_files+1);
 
+#ifdef READ_AHEAD
+    if (total_files > 0)
+        ra = readahead_claim(filename_given, same_directory_flag, name);
+    if (ra == NULL)
+#endif
     do
     {   x = translate_in_filename(x, name, filename_given, same_directory_flag,
                 (total_files==0)?1:0);
@@ -108,6 +509,10 @@ extern void load_sourcefile(char *filename_given, int same_directory_flag)
     InputFiles[total_files].filename = my_malloc(strlen(name)+1, "filename storage");
     strcpy(InputFiles[total_files].filename, name);
 
+    if (result_cache_active)
+        result_cache_note_source(name, filename_given, same_directory_flag,
+            (total_files==0)?1:0);
+
     if (debugfile_switch)
     {   debug_file_printf("<source index=\"%d\">", total_files);
         debug_file_printf("<given-path>");
@@ -125,6 +530,15 @@ extern void load_sourcefile(char *filename_given, int same_directory_flag)
     }
 
     InputFiles[total_files].handle = handle;
+#ifdef READ_AHEAD
+    if ((ra == NULL) && (handle != NULL))
+        ra = readahead_adopt(handle, name);
+    if (ra != NULL)
+    {   InputFiles[total_files].handle = NULL;
+        readahead_set_file(total_files+1, ra);
+    }
+    else
+#endif
     if (InputFiles[total_files].handle==NULL)
         fatalerror_named("Couldn't open source file", name);
 
@@ -141,6 +555,9 @@ extern void load_sourcefile(char *filename_given, int same_directory_flag)
 
 static void close_sourcefile(int file_number)
 {
+#ifdef READ_AHEAD
+    if (readahead_release(file_number)) return;
+#endif
     if (InputFiles[file_number-1].handle == NULL) return;
 
     /*  Close this file. But keep the InputFiles entry around, including
@@ -154,15 +571,15 @@ static void close_sourcefile(int file_number)
 
     InputFiles[file_number-1].handle = NULL;
 
-    if (files_trace_setting > 0) {
-        char *str = (InputFiles[file_number-1].initial_buffering ? " (in initial buffering)" : "");
-        printf("Closing file \"%s\"%s\n", InputFiles[file_number-1].filename, str);
-    }
+    note_sourcefile_closed(file_number);
 }
 
 extern void close_all_source(void)
 {   int i;
     for (i=0; i<total_files; i++) close_sourcefile(i+1);
+#ifdef READ_AHEAD
+    readahead_stop();
+#endif
 }
 
 /* ------------------------------------------------------------------------- */
@@ -228,15 +645,25 @@ extern int register_orig_sourcefile(char *filename)
 extern int file_load_chars(int file_number, char *buffer, int length)
 {
     int read_in; FILE *handle;
+#ifdef READ_AHEAD
+    readahead *ra;
+#endif
 
     if (file_number-1 > total_files)
     {   buffer[0] = 0; return 1; }
 
-    handle = InputFiles[file_number-1].handle;
-    if (handle == NULL)
-    {   buffer[0] = 0; return 1; }
+#ifdef READ_AHEAD
+    ra = readahead_for_file(file_number);
+    if (ra != NULL)
+        read_in = readahead_load_chars(ra, buffer, length);
+    else
+#endif
+    {   handle = InputFiles[file_number-1].handle;
+        if (handle == NULL)
+        {   buffer[0] = 0; return 1; }
 
-    read_in = fread(buffer, 1, length, handle);
+        read_in = fread(buffer, 1, length, handle);
+    }
     total_chars_read += read_in;
 
     if (read_in == length) return length;
@@ -304,7 +731,7 @@ static void sf_put(int c)
       
     }
 
-    fputc(c, sf_handle);
+    if (sf_handle != NULL) fputc(c, sf_handle);
 }
 
 /* Recursive procedure to generate the Glulx compression table. */
@@ -405,21 +832,28 @@ static void output_file_z(void)
 
     translate_out_filename(new_name, Code_Name);
 
-    sf_handle = fopen(new_name,"wb");
-    if (sf_handle == NULL)
-        fatalerror_named("Couldn't open output file", new_name);
+    /*  In check-only mode, everything below is done except for writing:
+        backpatching may still find errors.                                  */
+
+    sf_handle = NULL;
+    if (!CHECK_ONLY)
+    {   sf_handle = fopen(new_name,"wb");
+        if (sf_handle == NULL)
+            fatalerror_named("Couldn't open output file", new_name);
 
 #ifdef MAC_MPW
-    /*  Set the type and creator to Andrew Plotkin's MaxZip, a popular
-        Z-code interpreter on the Macintosh  */
+        /*  Set the type and creator to Andrew Plotkin's MaxZip, a popular
+            Z-code interpreter on the Macintosh  */
 
-    fsetfileinfo(new_name, 'mxZR', 'ZCOD');
+        fsetfileinfo(new_name, 'mxZR', 'ZCOD');
 #endif
+    }
 
     /*  (1)  Output the paged memory.                                        */
 
-    for (i=0;i<64;i++)
-        fputc(zmachine_paged_memory[i], sf_handle);
+    if (sf_handle != NULL)
+        for (i=0;i<64;i++)
+            fputc(zmachine_paged_memory[i], sf_handle);
     size = 64;
     checksum_low_byte = 0;
     checksum_high_byte = 0;
@@ -562,6 +996,8 @@ static void output_file_z(void)
 
     while (blanks>0) { sf_put(0); blanks--; }
 
+    if (sf_handle == NULL) return;
+
     if (ferror(sf_handle))
         fatalerror("I/O failure: couldn't write to story file");
 
@@ -609,9 +1045,101 @@ static void output_file_z(void)
 #endif
 }
 
+/*  Reads back the story file just written and translates it into C, in a
+    file named like the story file but ending ".c".                          */
+
+static void write_c_translation(char *story_name)
+{   char c_name[PATHLEN];
+    uchar *image;
+    int i, dot = -1;
+
+    for (i=0; story_name[i]; i++)
+    {   if (story_name[i] == '.') dot = i;
+        if (story_name[i] == FN_SEP) dot = -1;
+    }
+    if (dot < 0) dot = i;
+    if (dot + 3 > PATHLEN)
+        fatalerror_named("C translation file name too long", story_name);
+    memcpy(c_name, story_name, dot);
+    strcpy(c_name+dot, ".c");
+
+    image = my_malloc(Out_Size, "story file image");
+    fseek(sf_handle, 0L, SEEK_SET);
+    if (fread(image, 1, Out_Size, sf_handle) != (size_t) Out_Size)
+        fatalerror("I/O failure: couldn't read back story file");
+    translate_code_to_c(image, Out_Size, Write_Code_At, Write_Strings_At,
+        c_name);
+    my_free(&image, "story file image");
+}
+
+/*  Finds the code offset of the game's SnapshotInit routine, or returns -1
+    (with an error or warning) if there is no snapshot to take. This is
+    called before the story file is opened, so that an error leaves no
+    story file behind.                                                       */
+
+static int32 snapshot_init_offset(void)
+{   int32 addr;
+    int symbol, stripped = FALSE;
+
+    symbol = get_symbol_index("SnapshotInit");
+    if ((symbol < 0) || (symbols[symbol].flags & UNKNOWN_SFLAG)
+        || (symbols[symbol].type != ROUTINE_T))
+    {   error("$SNAPSHOT_INIT is set, but the game has no routine called \
+'SnapshotInit'");
+        return -1;
+    }
+    addr = symbols[symbol].value;
+    if (OMIT_UNUSED_ROUTINES)
+        addr = df_stripped_offset_for_code_offset(addr, &stripped);
+    if (stripped)
+    {   warning("SnapshotInit was omitted as unused, so there is no snapshot \
+to take");
+        return -1;
+    }
+    return addr;
+}
+
+/*  Reads back the story file just written, runs its SnapshotInit routine
+    (at code offset addr) and, if that runs to completion, sets the global
+    sys_snapshot_taken and writes back the RAM it leaves behind, together
+    with a corrected checksum.                                               */
+
+static void write_snapshot(int32 addr)
+{   uchar *image;
+    uint32 checksum = 0, v;
+    int32 i;
+
+    image = my_malloc(Out_Size, "story file image");
+    fseek(sf_handle, 0L, SEEK_SET);
+    if (fread(image, 1, Out_Size, sf_handle) != (size_t) Out_Size)
+        fatalerror("I/O failure: couldn't read back story file");
+
+    if (run_snapshot_init(image, Out_Size, code_offset + addr))
+    {   i = variables_offset + 4*11;    /*  sys_snapshot_taken = 1       */
+        image[i] = 0; image[i+1] = 0; image[i+2] = 0; image[i+3] = 1;
+        for (i=32; i<36; i++) image[i] = 0;
+        for (i=0; i+3<Out_Size; i+=4)
+        {   v = (image[i] << 24) | (image[i+1] << 16) | (image[i+2] << 8)
+                | image[i+3];
+            checksum += v;
+        }
+        image[32] = (checksum >> 24) & 0xFF;
+        image[33] = (checksum >> 16) & 0xFF;
+        image[34] = (checksum >> 8) & 0xFF;
+        image[35] = (checksum) & 0xFF;
+        fseek(sf_handle, 32L, SEEK_SET);
+        fwrite(image+32, 1, 4, sf_handle);
+        fseek(sf_handle, (long int) Write_RAM_At, SEEK_SET);
+        fwrite(image+Write_RAM_At, 1, Out_Size - Write_RAM_At, sf_handle);
+        if (ferror(sf_handle))
+            fatalerror("I/O failure: couldn't write snapshot to story file");
+    }
+    my_free(&image, "story file image");
+}
+
 static void output_file_g(void)
 {   char new_name[PATHLEN];
-    int32 i;
+    int32 i, snapshot_addr = -1;
     uint32 j, offset;
     uint32 size, code_length, size_before_code, next_cons_check;
     int use_function;
@@ -623,16 +1151,26 @@ static void output_file_g(void)
 
     translate_out_filename(new_name, Code_Name);
 
-    sf_handle = fopen(new_name,"wb+");
-    if (sf_handle == NULL)
-        fatalerror_named("Couldn't open output file", new_name);
+    if (SNAPSHOT_INIT)
+    {   snapshot_addr = snapshot_init_offset();
+        if (no_errors > 0) return;
+    }
+
+    /*  As in Z-code, check-only mode does everything but write.            */
+
+    sf_handle = NULL;
+    if (!CHECK_ONLY)
+    {   sf_handle = fopen(new_name,"wb+");
+        if (sf_handle == NULL)
+            fatalerror_named("Couldn't open output file", new_name);
 
 #ifdef MAC_MPW
-    /*  Set the type and creator to Andrew Plotkin's MaxZip, a popular
-        Z-code interpreter on the Macintosh  */
+        /*  Set the type and creator to Andrew Plotkin's MaxZip, a popular
+            Z-code interpreter on the Macintosh  */
 
-    fsetfileinfo(new_name, 'mxZR', 'GLUL');
+        fsetfileinfo(new_name, 'mxZR', 'GLUL');
 #endif
+    }
 
     checksum_long = 0;
     checksum_count = 0;
@@ -1107,6 +1645,8 @@ static void output_file_g(void)
     {   sf_put(zmachine_paged_memory[i]); size++;
     }
 
+    if (sf_handle == NULL) return;
+
     if (ferror(sf_handle))
         fatalerror("I/O failure: couldn't write to story file");
 
@@ -1119,6 +1659,9 @@ static void output_file_g(void)
     if (ferror(sf_handle))
       fatalerror("I/O failure: couldn't backtrack on story file for checksum");
 
+    if (snapshot_addr >= 0) write_snapshot(snapshot_addr);
+    if (GLULX_C_OUTPUT) write_c_translation(new_name);
+
     /*  Write a copy of the first 64 bytes into the debugging information file
         (mainly so that it can be used to identify which story file matches with
         which debugging info file).  */
@@ -1528,7 +2071,7 @@ extern void write_debug_object_backpatch(int32 object_number)
 }
 
 static int32 backpatch_object_address(int32 index)
-{   return object_tree_offset + OBJECT_BYTE_LENGTH * index;
+{   return object_tree_offset + object_offset_g(index+1);
 }
 
 extern void write_debug_packed_code_backpatch(int32 offset)
@@ -1574,7 +2117,8 @@ extern void write_debug_array_backpatch(int32 offset)
 }
 
 static int32 backpatch_array_address(int32 offset)
-{   return (glulx_mode ? arrays_offset : variables_offset) + offset;
+{   return (glulx_mode ? arrays_offset : variables_offset)
+        + relocated_array_offset(offset);
 }
 
 extern void write_debug_grammar_backpatch(int32 offset)
@@ -1709,6 +2253,331 @@ extern void end_debug_file()
     close_debug_file();
 }
 
+/* ------------------------------------------------------------------------- */
+/*   The result cache (used only if the "cache_path" is set).                */
+/*                                                                           */
+/*   A compilation is identified by a key: a hash of the compiler version,   */
+/*   every ICL command given so far (switches, settings, paths), the name    */
+/*   of the main source file, the serial number which would be written and   */
+/*   the contents of any character set map. Under that key the cache holds   */
+/*   a copy of the story file, a copy of the debugging information file if   */
+/*   -k is set, and a manifest listing every source file read, with a hash   */
+/*   of its contents. If every file in the manifest is unchanged, the story  */
+/*   file (and debugging file) are copied out and nothing is compiled.       */
+/*                                                                           */
+/*   The manifest also lists the names tried, and not found, before each     */
+/*   source file along its search path: if one of those has since appeared,  */
+/*   it would now be read instead, so the entry is out of date. The text of  */
+/*   the warnings given is kept alongside, to be printed again on a hit.     */
+/*                                                                           */
+/*   Since the serial number is part of the key, a date-stamped story file   */
+/*   is only reused on the same day: set $SERIAL, or SOURCE_DATE_EPOCH in    */
+/*   the environment, for a build whose output is fully deterministic.       */
+/* ------------------------------------------------------------------------- */
+
+typedef struct cache_hash_s
+{   uint32 hi, lo;                      /*  64-bit FNV-1a, in two halves     */
+} cache_hash;
+
+static cache_hash settings_hash;        /*  Hash of all ICL commands so far  */
+static int settings_hash_started = FALSE;
+
+static char cache_key[17];              /*  Key of the current compilation   */
+static char cache_target[8];            /*  Target of a cached story file    */
+
+int result_cache_active;                /*  Set while compiling a result
+                                            which will be stored             */
+
+static memory_list absent_files_memlist;
+static char **absent_files;             /*  Names tried and not found on the
+                                            way to a source file             */
+static int no_absent_files;
+
+#define CACHE_ABSENT "----------------"
+
+static void cache_hash_start(cache_hash *h)
+{   h->hi = 0xcbf29ce4; h->lo = 0x84222325;
+}
+
+static void cache_hash_bytes(cache_hash *h, uchar *p, int32 n)
+{   uint32 a, b, lo;
+    for (; n>0; n--, p++)
+    {   lo = (h->lo ^ *p) & 0xFFFFFFFF;
+        /*  Multiply by the FNV prime 2^40 + 0x1b3, keeping 64 bits          */
+        a = (lo & 0xFFFF) * 0x1b3;
+        b = (lo >> 16) * 0x1b3 + (a >> 16);
+        h->lo = (((b & 0xFFFF) << 16) | (a & 0xFFFF)) & 0xFFFFFFFF;
+        h->hi = (h->hi * 0x1b3 + (b >> 16) + (lo << 8)) & 0xFFFFFFFF;
+    }
+}
+
+static void cache_hash_string(cache_hash *h, char *text)
+{   cache_hash_bytes(h, (uchar *) text, strlen(text)+1);
+}
+
+static void cache_hash_text(cache_hash *h, char *buffer)
+{   sprintf(buffer, "%08lx%08lx",
+        (unsigned long) h->hi, (unsigned long) h->lo);
+}
+
+/*  Hash the contents of a file, returning FALSE if it can't be read.        */
+static int cache_hash_file(cache_hash *h, char *filename)
+{   uchar buffer[4096];
+    size_t n;
+    FILE *handle = fopen(filename, "rb");
+    if (handle == NULL) return FALSE;
+    while ((n = fread(buffer, 1, sizeof(buffer), handle)) > 0)
+        cache_hash_bytes(h, buffer, (int32) n);
+    n = ferror(handle);
+    fclose(handle);
+    return (n == 0);
+}
+
+static int cache_copy_file(char *from, char *to)
+{   uchar buffer[4096];
+    size_t n;
+    int ok = TRUE;
+    FILE *in, *out;
+    in = fopen(from, "rb");
+    if (in == NULL) return FALSE;
+    out = fopen(to, "wb");
+    if (out == NULL) { fclose(in); return FALSE; }
+    while ((n = fread(buffer, 1, sizeof(buffer), in)) > 0)
+        if (fwrite(buffer, 1, n, out) != n) { ok = FALSE; break; }
+    if (ferror(in)) ok = FALSE;
+    fclose(in);
+    if (fclose(out) != 0) ok = FALSE;
+    return ok;
+}
+
+static void cache_filename(char *name, char *cache_path, char *suffix)
+{   if (strlen(cache_path)+strlen(cache_key)+strlen(suffix) >= PATHLEN)
+        fatalerror("The result cache path is too long");
+    sprintf(name, "%s%s%s", cache_path, cache_key, suffix);
+}
+
+/*  Called for every ICL command, from whatever source.                     */
+extern void result_cache_note_command(char *command)
+{   if (!settings_hash_started)
+    {   cache_hash_start(&settings_hash);
+        settings_hash_started = TRUE;
+    }
+    cache_hash_string(&settings_hash, command);
+}
+
+/*  Called when the source file "name" has been opened, to record the names
+    which load_sourcefile() tried, and failed to open, before it.           */
+extern void result_cache_note_source(char *name, char *given,
+    int same_directory_flag, int command_line_flag)
+{   char candidate[PATHLEN];
+    int i, x = 0;
+
+    do
+    {   x = translate_in_filename(x, candidate, given, same_directory_flag,
+            command_line_flag);
+        if (strcmp(candidate, name) == 0) return;
+        for (i=0; i<no_absent_files; i++)
+            if (strcmp(absent_files[i], candidate) == 0) break;
+        if (i < no_absent_files) continue;
+        ensure_memory_list_available(&absent_files_memlist,
+            no_absent_files+1);
+        absent_files[no_absent_files] =
+            my_malloc(strlen(candidate)+1, "absent file name");
+        strcpy(absent_files[no_absent_files++], candidate);
+    } while (x != 0);
+}
+
+/*  Update and print the hit and miss counts kept in the cache directory.   */
+static void result_cache_statistics(char *cache_path, int hit)
+{   char name[PATHLEN];
+    long hits = 0, misses = 0;
+    FILE *handle;
+
+    if (strlen(cache_path)+6 >= PATHLEN)
+        fatalerror("The result cache path is too long");
+    sprintf(name, "%sstats", cache_path);
+    handle = fopen(name, "r");
+    if (handle != NULL)
+    {   if (fscanf(handle, "%ld %ld", &hits, &misses) != 2)
+            hits = misses = 0;
+        fclose(handle);
+    }
+    if (hit) hits++; else misses++;
+    handle = fopen(name, "w");
+    if (handle != NULL)
+    {   fprintf(handle, "%ld %ld\n", hits, misses);
+        fclose(handle);
+    }
+    printf("[Result cache %s: %ld hit%s and %ld miss%s so far]\n",
+        (hit)?"hit":"miss", hits, (hits==1)?"":"s",
+        misses, (misses==1)?"":"es");
+}
+
+/*  Work out the key for compiling source_name as things stand, and if the
+    cache holds an up-to-date result for it, copy that out as the story file
+    (and debugging file) and return TRUE. Otherwise return FALSE, and the
+    caller should compile as usual and then call result_cache_store().      */
+extern int result_cache_fetch(char *cache_path, char *source_name)
+{   char name[PATHLEN], new_name[PATHLEN], line[PATHLEN+32];
+    char serial[7];
+    cache_hash key, h;
+    FILE *manifest, *messages;
+    int hit = FALSE, i, warnings = 0, suppressed = 0;
+
+    cache_hash_start(&key);
+    cache_hash_string(&key, banner_line);
+    if (settings_hash_started)
+    {   cache_hash_text(&settings_hash, name);
+        cache_hash_string(&key, name);
+    }
+    cache_hash_string(&key, source_name);
+    write_serial_number(serial);
+    cache_hash_bytes(&key, (uchar *) serial, 6);
+    if (Charset_Map[0] != 0)
+        cache_hash_file(&key, Charset_Map);
+    cache_hash_text(&key, cache_key);
+
+    cache_filename(name, cache_path, ".man");
+    manifest = fopen(name, "r");
+    if (manifest != NULL)
+    {   /*  The first line gives the target; the rest, one per source file,
+            give the hash of its contents and then its name.                 */
+        if (fgets(line, PATHLEN+32, manifest) != NULL)
+        {   for (i=0; (line[i]!=0) && (line[i]!='\n') && (i<7); i++)
+                cache_target[i] = line[i];
+            cache_target[i] = 0;
+            hit = TRUE;
+        }
+        while (hit && (fgets(line, PATHLEN+32, manifest) != NULL))
+        {   FILE *handle;
+            i = strlen(line);
+            if ((i > 0) && (line[i-1] == '\n')) line[--i] = 0;
+            if ((i < 18) || (line[16] != ' ')) { hit = FALSE; break; }
+            if (strncmp(line, CACHE_ABSENT, 16) == 0)
+            {   handle = fopen(line+17, "rb");
+                if (handle != NULL) { fclose(handle); hit = FALSE; }
+                continue;
+            }
+            cache_hash_start(&h);
+            if (!cache_hash_file(&h, line+17)) { hit = FALSE; break; }
+            cache_hash_text(&h, name);
+            if (strncmp(name, line, 16) != 0) hit = FALSE;
+        }
+        fclose(manifest);
+    }
+
+    if (hit)
+    {   /*  The output filename's extension depends on the version, which
+            the source may have changed with a Switches directive.           */
+        int saved_version = version_number;
+        if ((!glulx_mode) && (cache_target[0] == 'Z'))
+            version_number = cache_target[1] - '0';
+        translate_out_filename(new_name, Code_Name);
+        version_number = saved_version;
+
+        cache_filename(name, cache_path, ".story");
+        if (!cache_copy_file(name, new_name)) hit = FALSE;
+        if (hit && debugfile_switch)
+        {   cache_filename(name, cache_path, ".dbg");
+            if (!cache_copy_file(name, Debugging_Name)) hit = FALSE;
+        }
+    }
+
+    /*  The first line of the ".msg" file gives the warning counts; the
+        rest is the text of the warnings, exactly as first printed.          */
+    messages = NULL;
+    if (hit)
+    {   cache_filename(name, cache_path, ".msg");
+        messages = fopen(name, "r");
+        if ((messages == NULL)
+            || (fscanf(messages, "%d %d\n", &warnings, &suppressed) != 2))
+            hit = FALSE;
+    }
+
+    result_cache_statistics(cache_path, hit);
+
+    if (messages != NULL)
+    {   if (hit)
+        {   while ((i = fgetc(messages)) != EOF) putchar(i);
+            no_warnings = warnings;
+            no_suppressed_warnings = suppressed;
+        }
+        fclose(messages);
+    }
+    return hit;
+}
+
+/*  Called after a successful compilation (with the story file and any
+    debugging file closed, but the source file names still to hand) to
+    record its result under the key worked out by result_cache_fetch().    */
+extern void result_cache_store(char *cache_path)
+{   char name[PATHLEN], new_name[PATHLEN], text[17];
+    cache_hash h;
+    FILE *manifest;
+    int i;
+
+    /*  Remove any old manifest first, so that if anything goes wrong
+        while storing, the cache entry is simply missing.                    */
+    cache_filename(name, cache_path, ".man");
+    remove(name);
+
+    translate_out_filename(new_name, Code_Name);
+    cache_filename(name, cache_path, ".story");
+    if (!cache_copy_file(new_name, name))
+    {   warning_named("Couldn't write to the result cache:", name);
+        return;
+    }
+    if (debugfile_switch)
+    {   cache_filename(name, cache_path, ".dbg");
+        if (!cache_copy_file(Debugging_Name, name))
+        {   warning_named("Couldn't write to the result cache:", name);
+            return;
+        }
+    }
+
+    cache_filename(name, cache_path, ".msg");
+    manifest = fopen(name, "w");
+    if (manifest == NULL)
+    {   warning_named("Couldn't write to the result cache:", name);
+        return;
+    }
+    fprintf(manifest, "%d %d\n", no_warnings, no_suppressed_warnings);
+    if (diagnostics_length > 0)
+        fwrite(diagnostics_text, 1, diagnostics_length, manifest);
+    if (fclose(manifest) != 0)
+    {   remove(name);
+        return;
+    }
+
+    cache_filename(name, cache_path, ".tmp");
+    manifest = fopen(name, "w");
+    if (manifest == NULL)
+    {   warning_named("Couldn't write to the result cache:", name);
+        return;
+    }
+    if (glulx_mode) fprintf(manifest, "G\n");
+    else fprintf(manifest, "Z%d\n", version_number);
+    for (i=0; i<total_files; i++)
+    {   if (!InputFiles[i].is_input) continue;
+        cache_hash_start(&h);
+        if (!cache_hash_file(&h, InputFiles[i].filename))
+        {   fclose(manifest);
+            remove(name);
+            return;
+        }
+        cache_hash_text(&h, text);
+        fprintf(manifest, "%s %s\n", text, InputFiles[i].filename);
+    }
+    for (i=0; i<no_absent_files; i++)
+        fprintf(manifest, "%s %s\n", CACHE_ABSENT, absent_files[i]);
+    if (fclose(manifest) != 0)
+    {   remove(name);
+        return;
+    }
+    cache_filename(new_name, cache_path, ".man");
+    if (rename(name, new_name) != 0) remove(name);
+}
+
 /* ========================================================================= */
 /*   Data structure management routines                                      */
 /* ------------------------------------------------------------------------- */
@@ -1724,6 +2593,9 @@ extern void init_files_vars(void)
 
 extern void files_begin_prepass(void)
 {   
+#ifdef READ_AHEAD
+    no_readahead_files = 0;
+#endif
     total_files = 0;
     total_input_files = 0;
     current_input_file = 0;
@@ -1753,6 +2625,15 @@ extern void files_allocate_arrays(void)
     initialise_memory_list(&InputFiles_memlist,
         sizeof(FileId), 16, (void**)&InputFiles,
         "input file storage");
+    initialise_memory_list(&absent_files_memlist,
+        sizeof(char *), 16, (void**)&absent_files,
+        "absent file names");
+    no_absent_files = 0;
+#ifdef READ_AHEAD
+    initialise_memory_list(&readahead_files_memlist,
+        sizeof(readahead *), 16, (void**)&readahead_files,
+        "source read-ahead files");
+#endif
     if (debugfile_switch)
     {   if (glulx_mode)
         {   initialise_accumulator
@@ -1787,6 +2668,13 @@ extern void files_free_arrays(void)
         my_free(&InputFiles[ix].filename, "filename storage");
     }
     deallocate_memory_list(&InputFiles_memlist);
+    for (ix=0; ix<no_absent_files; ix++)
+        my_free(&absent_files[ix], "absent file name");
+    deallocate_memory_list(&absent_files_memlist);
+    no_absent_files = 0;
+#ifdef READ_AHEAD
+    deallocate_memory_list(&readahead_files_memlist);
+#endif
     
     if (debugfile_switch)
     {   if (!glulx_mode)
@@ -122,6 +122,9 @@
 /*                         by default, you should define this                */
 /*   HAS_REALPATH        - the POSIX realpath() function is available to     */
 /*                         find the absolute path to a file                  */
+/*   READ_AHEAD          - read source files into memory ahead of the lexer  */
+/*                         on a background thread (needs POSIX threads, so  */
+/*                         link with -pthread); never defined by default     */
 /*                                                                           */
 /*   3. This was DEFAULT_MEMORY_SIZE, now withdrawn.                         */
 /* ------------------------------------------------------------------------- */
@@ -733,6 +736,7 @@ typedef struct fpropt {
 typedef struct objecttz {
     uchar atts[6];
     int parent, next, child;
+    int32 propaddr; /* offset in properties_table */
     int propsize;
     int32 symbol; /* name symbol or 0 */
 } objecttz;
@@ -770,6 +774,9 @@ typedef struct objecttg {
     int32 propaddr;
     int32 propsize;
     int32 symbol; /* name symbol or 0 */
+    int32 blockstart; /* offset in properties_table of the whole block */
+    int32 finaladdr;  /* offset of the object from the start of the
+                         object tree, once laid out */
 } objecttg;
 
 typedef struct abbreviation_s {
@@ -854,6 +861,24 @@ typedef struct symbolinfo_s {
     int next_entry; /* Linked list for symbol hash table */
 } symbolinfo;
 
+/* Per-symbol counts gathered during the analysis pass. (See
+   run_analysis_pass() in "inform.c".) */
+typedef struct symbolusage_s {
+    int32 refs;          /* References from expressions */
+    unsigned int flags;  /* ?_UFLAGS bitmask */
+} symbolusage;
+
+/* What survives of a symbol once the analysis pass has ended. The main
+   pass looks these up by name. */
+typedef struct analysedsymbol_s {
+    char *name;
+    int index;           /* Symbol index in the analysis pass */
+    int type;            /* ?_T value at the end of the analysis pass */
+    int32 value;
+    int32 refs;
+    unsigned int flags;  /* ?_UFLAGS bitmask */
+} analysedsymbol;
+
 typedef struct symboldebuginfo_s {
     maybe_file_position backpatch_pos;
     maybe_file_position replacement_backpatch_pos;
@@ -915,6 +940,20 @@ typedef struct assembly_instruction_t
     assembly_operand operand[8];
 } assembly_instruction;
 
+/* A Glulx instruction as read back from a finished story file. */
+typedef struct glulx_operand_s
+{   int mode;                      /* Glulx addressing mode, 0 to 15         */
+    uint32 value;                  /* Constant, address or local offset      */
+    int kind;                      /* 'L'oad, 'S'tore or 'B'ranch            */
+} glulx_operand;
+
+typedef struct glulx_instruction_s
+{   int32 code;                    /* Opcode number                          */
+    char *name;                    /* Lower case standard name               */
+    int no;                        /* Number of operands                     */
+    glulx_operand ops[8];
+} glulx_instruction;
+
 typedef struct expression_tree_node_s
 {
     /*  Data used in tree construction                                       */
@@ -1334,6 +1373,19 @@ typedef struct operator_s
 #define STAR_SFLAG    16384  /* function defined with "*" or property named
                                 "foo_to" */
 
+/* ------------------------------------------------------------------------- */
+/*   Symbol usage flags, noted only during the analysis pass                 */
+/* ------------------------------------------------------------------------- */
+
+#define IMPLICIT_UFLAG 1     /* individual property created by its first
+                                appearance in an object definition */
+#define IFDEF_UFLAG    2     /* tested by Ifdef or Ifndef */
+#define PRIVATE_UFLAG  4     /* individual property given in 'private' */
+#define LONGPROP_UFLAG 8     /* property given more than one value */
+#define ASSIGNED_UFLAG 16    /* global variable which may be written to, or
+                                is accessed by number; or property which
+                                is written to in code */
+
 /* ------------------------------------------------------------------------- */
 /*   Symbol type definitions                                                 */
 /* ------------------------------------------------------------------------- */
@@ -1549,7 +1601,7 @@ typedef struct operator_s
 
 /*  Index numbers into the keyword group "system_constants" (see "lexer.c")  */
 
-#define NO_SYSTEM_CONSTANTS   63
+#define NO_SYSTEM_CONSTANTS   64
 
 #define adjectives_table_SC   0
 #define actions_table_SC      1
@@ -1626,6 +1678,7 @@ typedef struct operator_s
 #define dictionary_table_SC           60
 #define dynam_string_table_SC         61     /* Glulx-only */
 #define highest_meta_action_number_SC 62
+#define grammar_index_table_SC        63     /* Only if $GRAMMAR_INDEX */
 
 
 /*  Index numbers into the keyword group "system_functions" (see "lexer.c")  */
@@ -1810,7 +1863,7 @@ typedef struct operator_s
 /*   (must correspond to entries in the table in "veneer.c")                 */
 /* ------------------------------------------------------------------------- */
 
-#define VENEER_ROUTINES 48
+#define VENEER_ROUTINES 58
 
 #define Box__Routine_VR    0
 
@@ -1859,12 +1912,28 @@ typedef struct operator_s
 #define RT__ChPrintS_VR   41
 #define RT__ChPrintO_VR   42
 
+/* Arity-specialised forms of CA__Pr (Z-code only in practice) */
+#define CA__Pr0_VR        43
+#define CA__Pr1_VR        44
+#define CA__Pr2_VR        45
+#define CA__Pr3_VR        46
+#define CA__Pr4_VR        47
+#define CA__Pr5_VR        48
+#define CA__Pr6_VR        49
+
+/* Readers of #grammar_index_table (only if $GRAMMAR_INDEX) */
+#define Grammar__Mask_VR    50
+#define Grammar__Line_Ok_VR 51
+
+/* Binary search of a sorted name list (only if $SORT_NAME_PROPERTIES) */
+#define Name__Search_VR   52
+
 /* Glulx-only veneer routines */
-#define OB__Move_VR       43
-#define OB__Remove_VR     44
-#define Print__Addr_VR    45
-#define Glk__Wrap_VR      46
-#define Dynam__String_VR  47
+#define OB__Move_VR       53
+#define OB__Remove_VR     54
+#define Print__Addr_VR    55
+#define Glk__Wrap_VR      56
+#define Dynam__String_VR  57
 
 /* ------------------------------------------------------------------------- */
 /*   Run-time-error numbers (must correspond with RT__Err code in veneer)    */
@@ -2149,6 +2218,9 @@ extern void make_array(void);
 extern void check_globals(void);
 extern int32 begin_table_array(void);
 extern int32 begin_word_array(void);
+extern void note_array_write(int32 offset);
+extern void plan_dynamic_array_layout(void);
+extern int32 relocated_array_offset(int32 offset);
 extern void array_entry(int32 i, int is_static, assembly_operand VAL);
 extern void finish_array(int32 i, int is_static);
 extern int globalv_z_temp_var1;
@@ -2192,10 +2264,15 @@ extern void assembleg_instruction(const assembly_instruction *a);
 extern void assemble_label_no(int n);
 extern int assemble_forward_label_no(int n);
 extern void assemble_jump(int n);
+extern int  begin_cold_block(void);
+extern void end_cold_block(int block, int must_leave);
 extern void define_symbol_label(int symbol);
 extern int32 assemble_routine_header(int debug_flag,
     char *name, int embedded_flag, int the_symbol);
 extern void assemble_routine_end(int embedded_flag, debug_locations locations);
+extern void list_opcode_usage(int json);
+extern int32 decode_glulx_instruction(const uchar *mem, uint32 length,
+    uint32 addr, glulx_instruction *gi, char **problem);
 
 extern void assemblez_0(int internal_number);
 extern void assemblez_0_to(int internal_number, assembly_operand o1);
@@ -2336,6 +2413,13 @@ extern void  map_new_zchar(int32 unicode);
 extern void  make_lower_case(char *str);
 extern void  make_upper_case(char *str);
 
+/* ------------------------------------------------------------------------- */
+/*   Extern definitions for "ctrans"                                         */
+/* ------------------------------------------------------------------------- */
+
+extern void translate_code_to_c(uchar *image, int32 length,
+    int32 code_start, int32 code_end, char *filename);
+
 /* ------------------------------------------------------------------------- */
 /*   Extern definitions for "directs"                                        */
 /* ------------------------------------------------------------------------- */
@@ -2355,6 +2439,9 @@ extern int  parse_given_directive(int internal_flag);
 extern char *forerrors_buff;
 extern int  forerrors_pointer;
 extern int  no_errors, no_warnings, no_suppressed_warnings, no_compiler_errors;
+extern int  suppress_repeat_messages;
+extern char *diagnostics_text;
+extern int32 diagnostics_length;
 
 extern ErrorPosition ErrorReport;
 
@@ -2411,6 +2498,11 @@ extern assembly_operand stack_pointer, temp_var1, temp_var2, temp_var3,
 assembly_operand code_generate(assembly_operand AO, int context, int label);
 assembly_operand check_nonzero_at_runtime(assembly_operand AO1, int label,
        int rte_number);
+extern void check_object_tree_write(assembly_operand base,
+    assembly_operand AO);
+extern int attribute_unit_g(int32 lo, int32 hi, int *width, int32 *index);
+extern uint32 attribute_unit_bit_g(int32 attr, int width, int32 index);
+extern int reusable_operand_g(assembly_operand AO);
 
 /* ------------------------------------------------------------------------- */
 /*   Extern definitions for "expressp"                                       */
@@ -2428,6 +2520,16 @@ extern void clear_expression_space(void);
 extern void show_tree(const assembly_operand *AO, int annotate);
 extern assembly_operand parse_expression(int context);
 extern int test_for_incdec(assembly_operand AO);
+extern expression_tree_node *save_expression(assembly_operand AO,
+    int *count);
+extern assembly_operand restore_expression(assembly_operand AO,
+    expression_tree_node *saved, int count);
+extern int test_for_negatable(assembly_operand AO);
+extern assembly_operand negate_expression(assembly_operand AO);
+extern void begin_pure_routine(int symbol);
+extern void note_routine_statement(int is_return);
+extern void note_return_expression(assembly_operand AO);
+extern void end_pure_routine(int ok);
 extern int  test_constant_op_list(const assembly_operand *AO, assembly_operand *ops_found, int max_ops_found);
 
 /* ------------------------------------------------------------------------- */
@@ -2486,12 +2588,20 @@ extern int register_orig_sourcefile(char *filename);
 
 extern void output_file(void);
 
+extern int  result_cache_active;
+extern void result_cache_note_command(char *command);
+extern void result_cache_note_source(char *name, char *given,
+    int same_directory_flag, int command_line_flag);
+extern int  result_cache_fetch(char *cache_path, char *source_name);
+extern void result_cache_store(char *cache_path);
+
 /* ------------------------------------------------------------------------- */
 /*   Extern definitions for "inform"                                         */
 /* ------------------------------------------------------------------------- */
 
 extern char Code_Name[];
 extern int endofpass_flag;
+extern int analysis_pass;
 
 extern int version_number,  instruction_set_number, extend_memory_map;
 extern int32 scale_factor,  length_scale_factor;
@@ -2515,7 +2625,7 @@ extern int
     define_DEBUG_switch,    define_INFIX_switch,
     runtime_error_checking_switch,
     list_verbs_setting,     list_dict_setting,    list_objects_setting,
-    list_symbols_setting;
+    list_symbols_setting,   list_opcodes_setting;
 
 extern int oddeven_packing_switch;
 
@@ -2633,6 +2743,25 @@ extern int DICT_IMPLICIT_SINGULAR;
 extern int DICT_TRUNCATE_FLAG;
 extern int LONG_DICT_FLAG_BUG;
 extern int TRANSCRIPT_FORMAT;
+extern int PROMOTE_INDIV_PROPS;
+extern int ROTATE_LOOPS;
+extern int FOLD_CONSTANT_GLOBALS;
+extern int SPECIALISE_MESSAGE_CALLS;
+extern int CHECK_ONLY;
+extern int GRAMMAR_INDEX;
+extern int RENUMBER_OBJECTS;
+extern int GLULX_C_OUTPUT;
+extern int STACK_ANALYSIS;
+extern int DYNAMIC_ARRAY_ORDER;
+extern int GLULX_OBJECT_LAYOUT;
+extern int GLULX_PREV_SIBLING;
+extern int SNAPSHOT_INIT;
+extern int FOLD_PURE_ROUTINES;
+extern int GLULX_FUSE_ATTRIBUTES;
+extern int SORT_NAME_PROPERTIES;
+extern int SPECIALISE_PROPERTY_READS;
+extern int REORDER_BLOCKS;
+extern int GLULX_DIRECT_OPERANDS;
 
 /* These macros define offsets that depend on the value of NUM_ATTR_BYTES.
    (Meaningful only for Glulx.) */
@@ -2643,6 +2772,8 @@ extern int TRANSCRIPT_FORMAT;
 #define GOBJFIELD_PARENT()   (4+((NUM_ATTR_BYTES)/4))
 #define GOBJFIELD_SIBLING()  (5+((NUM_ATTR_BYTES)/4))
 #define GOBJFIELD_CHILD()    (6+((NUM_ATTR_BYTES)/4))
+/* Present only if GLULX_PREV_SIBLING is set: */
+#define GOBJFIELD_PREVSIB()  (7+((NUM_ATTR_BYTES)/4))
 
 extern void *my_malloc(size_t size, char *whatfor);
 extern void my_realloc(void *pointer, size_t oldsize, size_t size, 
@@ -2665,7 +2796,7 @@ extern void ensure_memory_list_available(memory_list *ML, size_t count);
 /*   Extern definitions for "objects"                                        */
 /* ------------------------------------------------------------------------- */
 
-extern int no_attributes, no_properties;
+extern int no_attributes, no_properties, no_promoted_properties;
 extern int no_individual_properties;
 extern int individuals_length;
 extern uchar *individuals_table;
@@ -2691,7 +2822,17 @@ extern void make_object(int nearby_flag,
 extern void make_class(char *metaclass_name);
 extern int  object_provides(int obj, int id);
 extern void list_object_tree(void);
+extern void check_object_renumbering(void);
 extern void write_the_identifier_names(void);
+extern int32 plan_object_layout_g(void);
+extern int32 object_offset_g(int32 n);
+extern int32 relocated_property_offset_g(int32 offset);
+
+/* ------------------------------------------------------------------------- */
+/*   Extern definitions for "snapshot"                                       */
+/* ------------------------------------------------------------------------- */
+
+extern int run_snapshot_init(uchar *image, int32 length, int32 func_addr);
 
 /* ------------------------------------------------------------------------- */
 /*   Extern definitions for "symbols"                                        */
@@ -2727,11 +2868,22 @@ extern void issue_debug_symbol_warnings(void);
 extern void add_config_symbol_definition(char *symbol, int32 value);
 extern void add_symbol_replacement_mapping(int original, int renamed);
 extern int find_symbol_replacement(int *value);
+extern void note_symbol_usage(int symbol);
+extern void note_symbol_usage_flag(int symbol, unsigned int flag);
+extern void note_global_assignment(int32 var);
+extern void keep_symbol_analysis(void);
+extern void free_symbol_analysis(void);
+extern analysedsymbol *find_analysed_symbol(char *name);
+extern analysedsymbol *analysed_symbols;
+extern int no_analysed_symbols;
 extern void df_note_function_start(char *name, uint32 address, 
     int embedded_flag, brief_location source_line);
 extern void df_note_function_end(uint32 endaddress);
 extern void df_note_function_symbol(int symbol);
+extern void df_note_function_stack(int32 frame, int indirect);
+extern void df_note_veneer_call(int code);
 extern void locate_dead_functions(void);
+extern void analyse_stack_usage(void);
 extern uint32 df_stripped_address_for_address(uint32);
 extern uint32 df_stripped_offset_for_code_offset(uint32, int *);
 extern void df_prepare_function_iterate(void);
@@ -2742,6 +2894,7 @@ extern uint32 df_next_function_iterate(int *);
 /* ------------------------------------------------------------------------- */
 
 extern int   no_syntax_lines;
+extern assembly_operand switch_operand;
 
 extern void  panic_mode_error_recovery(void);
 extern void  get_next_token_with_directives(void);
@@ -2779,6 +2932,7 @@ extern int32
     static_arrays_offset;
 extern int32
     arrays_offset, object_tree_offset, grammar_table_offset,
+    grammar_index_offset,
     abbreviations_offset;    /* For Glulx */
 
 extern int32 Out_Size,      Write_Code_At,        Write_Strings_At;
@@ -2890,10 +3044,12 @@ extern void  copy_sorts(uchar *d1, uchar *d2);
 
 extern int  veneer_mode;
 extern int32 veneer_routine_address[];
+extern int  no_property_read_stubs;
 
 extern void compile_initial_routine(void);
 extern assembly_operand veneer_routine(int code);
 extern char *veneer_routine_name(int code);
+extern assembly_operand property_read_routine(assembly_operand prop);
 extern void compile_veneer(void);
 
 /* ------------------------------------------------------------------------- */
@@ -22,6 +22,10 @@ int endofpass_flag;      /* set to TRUE when an "end" directive is reached
                             (the inputs routines insert one into the stream
                             if necessary)                                    */
 
+int analysis_pass;       /* set to TRUE during the silent preliminary pass
+                            which gathers whole-program information for
+                            some optimisations (see run_analysis_pass())     */
+
 /* ------------------------------------------------------------------------- */
 /*   Version control                                                         */
 /* ------------------------------------------------------------------------- */
@@ -182,6 +186,7 @@ static void select_target(int targ)
   else {
     /* Glulx */
     OBJECT_BYTE_LENGTH = (1 + (NUM_ATTR_BYTES) + 6*4 + (GLULX_OBJECT_EXT_BYTES));
+    if (GLULX_PREV_SIBLING) OBJECT_BYTE_LENGTH += 4;
     DICT_WORD_BYTES = DICT_WORD_SIZE*DICT_CHAR_SIZE;
     if (DICT_CHAR_SIZE == 1) {
       DICT_ENTRY_BYTE_LENGTH = (7+DICT_WORD_BYTES);
@@ -278,6 +283,7 @@ int character_set_setting,          /* set by -C0 through -C9 */
     list_dict_setting,              /* $!DICT */
     list_objects_setting,           /* $!OBJECTS */
     list_symbols_setting,           /* $!SYMBOLS */
+    list_opcodes_setting,           /* $!OPCODES */
     store_the_text;                 /* when set, record game text to a chunk
                                        of memory (used by -u) */
 static int r_e_c_s_set;             /* has -S been explicitly set? */
@@ -294,6 +300,7 @@ static void reset_switch_settings(void)
     list_dict_setting = 0;
     list_objects_setting = 0;
     list_symbols_setting = 0;
+    list_opcodes_setting = 0;
 
     store_the_text = FALSE;
 
@@ -493,6 +500,7 @@ static char current_source_path[PATHLEN];
        char Language_Name[PATHLEN];
        char Charset_Map[PATHLEN];
 static char ICL_Path[PATHLEN];
+static char Cache_Path[PATHLEN];
 
 /* Set one of the above Path buffers to the given location, or list of
    locations. (A list is comma-separated, and only accepted for Source_Path,
@@ -596,6 +604,7 @@ static void set_default_paths(void)
     set_path_value(Transcript_Name, Transcript_File);
     set_path_value(Language_Name,   Default_Language);
     set_path_value(Charset_Map,     "");
+    set_path_value(Cache_Path,      "");
 }
 
 /* Parse a path option which looks like "dir", "+dir", "pathname=dir",
@@ -636,6 +645,7 @@ static void set_path_command(char *command)
         if (strcmp(pathname, "transcript_name")==0) path_to_set=Transcript_Name;
         if (strcmp(pathname, "language_name")==0) path_to_set=Language_Name;
         if (strcmp(pathname, "charset_map")==0) path_to_set=Charset_Map;
+        if (strcmp(pathname, "cache_path")==0)   path_to_set=Cache_Path;
 
         if (path_to_set == NULL)
         {   printf("No such path setting as \"%s\"\n", pathname);
@@ -890,8 +900,9 @@ Inform translates plain filenames (such as \"xyzzy\") into full pathnames\n\
    name_or_unset(Code_Path));
 
     printf(
-"       ICL command file (in)  icl_path            %s\n\n",
-   name_or_unset(ICL_Path));
+"       ICL command file (in)  icl_path            %s\n\
+       Result cache (in/out)  cache_path          %s\n\n",
+   name_or_unset(ICL_Path), name_or_unset(Cache_Path));
 
     printf(
 "   If the path is unset, then the current working directory is used (so\n\
@@ -1027,10 +1038,88 @@ static void run_pass(void)
         sort_actions();
     if (track_unused_routines)
         locate_dead_functions();
+    if (STACK_ANALYSIS && glulx_mode)
+        analyse_stack_usage();
     locate_dead_grammar_lines();
     construct_storyfile();
 }
 
+/* ------------------------------------------------------------------------- */
+/*   The analysis pass                                                       */
+/*                                                                           */
+/*   Some optimisations depend on facts about the whole program which are    */
+/*   not known when the first use of a symbol is compiled: for instance,     */
+/*   how often an individual property is referred to. For these, we first   */
+/*   run the front end of the compiler silently over the same source, and    */
+/*   keep what it learned about each symbol (see "symbols.c"). The main      */
+/*   pass then begins from scratch, exactly as usual, but can consult those  */
+/*   results.                                                                */
+/*                                                                           */
+/*   Nothing is printed during the analysis pass: errors and warnings are    */
+/*   counted but not reported, since the main pass will report them. If     */
+/*   the analysis pass finds any errors, its results are discarded.          */
+/* ------------------------------------------------------------------------- */
+
+static int analysis_pass_needed(void)
+{
+    if (PROMOTE_INDIV_PROPS && !glulx_mode) return TRUE;
+    if (FOLD_CONSTANT_GLOBALS && !define_INFIX_switch) return TRUE;
+    if (RENUMBER_OBJECTS && !glulx_mode) return TRUE;
+    return FALSE;
+}
+
+static void run_analysis_pass(void)
+{   int saved_debugfile = debugfile_switch,
+        saved_hash = hash_switch,
+        saved_printprops = printprops_switch,
+        saved_store_text = store_the_text,
+        saved_asm_trace = asm_trace_setting,
+        saved_expr_trace = expr_trace_setting,
+        saved_tokens_trace = tokens_trace_setting,
+        saved_symdef_trace = symdef_trace_setting,
+        saved_files_trace = files_trace_setting;
+
+    debugfile_switch = FALSE; hash_switch = FALSE;
+    printprops_switch = FALSE; store_the_text = FALSE;
+    asm_trace_setting = 0; expr_trace_setting = 0;
+    tokens_trace_setting = 0; symdef_trace_setting = 0;
+    files_trace_setting = 0;
+
+    analysis_pass = TRUE;
+
+    init_vars();
+    allocate_arrays();
+
+    lexer_begin_prepass();
+    files_begin_prepass();
+    load_sourcefile(Source_Name, 0);
+
+    begin_pass();
+
+    parse_program(NULL);
+
+    ensure_builtin_globals();
+    find_the_actions();
+    compile_veneer();
+
+    lexer_endpass();
+    close_all_source();
+
+    if ((no_errors == 0) && (no_compiler_errors == 0))
+        keep_symbol_analysis();
+
+    free_arrays();
+
+    analysis_pass = FALSE;
+
+    debugfile_switch = saved_debugfile; hash_switch = saved_hash;
+    printprops_switch = saved_printprops; store_the_text = saved_store_text;
+    asm_trace_setting = saved_asm_trace; expr_trace_setting = saved_expr_trace;
+    tokens_trace_setting = saved_tokens_trace;
+    symdef_trace_setting = saved_symdef_trace;
+    files_trace_setting = saved_files_trace;
+}
+
 int output_has_occurred;
 
 static void rennab(float time_taken)
@@ -1079,10 +1168,27 @@ static void rennab(float time_taken)
 
 static int execute_icl_header(char *file1);
 
+/*  The result cache is only used if a cache_path is set, and no switch asks
+    for output which a cached result could not reproduce.                    */
+
+static int result_cache_wanted(void)
+{   if ((Cache_Path[0] == 0) || CHECK_ONLY) return FALSE;
+    if (transcript_switch || statistics_switch || memout_switch
+        || memory_map_setting || frequencies_setting || optimise_switch
+        || printprops_switch || printactions_switch
+        || list_verbs_setting || list_dict_setting
+        || list_objects_setting || list_symbols_setting
+        || list_opcodes_setting
+        || asm_trace_setting || expr_trace_setting || tokens_trace_setting)
+        return FALSE;
+    return TRUE;
+}
+
 static int compile(int number_of_files_specified, char *file1, char *file2)
 {
     TIMEVALUE time_start, time_end;
     float duration;
+    int saved_debugfile, saved_transcript, saved_optimise, saved_store_text;
 
     if (execute_icl_header(file1))
       return 1;
@@ -1105,7 +1211,29 @@ disabling -X switch\n");
     {   strcpy(Code_Name, file2); convert_filename_flag = FALSE;
     }
 
+    if (result_cache_wanted()
+        && result_cache_fetch(Cache_Path, Source_Name))
+    {   output_has_occurred = TRUE;
+        rennab(0);
+        return 0;
+    }
+
+    if (analysis_pass_needed()) run_analysis_pass();
+
+    /*  In check-only mode, the files which -k, -r and -u would write are
+        not wanted: the story file itself is handled by output_file().       */
+
+    saved_debugfile = debugfile_switch;
+    saved_transcript = transcript_switch;
+    saved_optimise = optimise_switch;
+    saved_store_text = store_the_text;
+    if (CHECK_ONLY)
+    {   debugfile_switch = FALSE; transcript_switch = FALSE;
+        optimise_switch = FALSE; store_the_text = FALSE;
+    }
+
     init_vars();
+    result_cache_active = result_cache_wanted();
 
     if (debugfile_switch) begin_debug_file();
 
@@ -1115,7 +1243,10 @@ disabling -X switch\n");
 
     run_pass();
 
-    if (no_errors==0) { output_file(); output_has_occurred = TRUE; }
+    if (no_errors==0)
+    {   output_file();
+        output_has_occurred = (!CHECK_ONLY) && (no_errors==0);
+    }
     else { output_has_occurred = FALSE; }
 
     if (transcript_switch)
@@ -1127,12 +1258,17 @@ disabling -X switch\n");
     {   end_debug_file();
     }
 
+    if ((no_errors==0) && result_cache_active)
+        result_cache_store(Cache_Path);
+    result_cache_active = FALSE;
+
     if (optimise_switch) {
         /* Pull out all_text so that it will not be freed. */
         extract_all_text();
     }
 
     free_arrays();
+    free_symbol_analysis();
 
     TIMEVALUE_NOW(&time_end);
     duration = TIMEVALUE_DIFFERENCE(&time_start, &time_end);
@@ -1144,6 +1280,11 @@ disabling -X switch\n");
         ao_free_arrays();
     }
 
+    debugfile_switch = saved_debugfile;
+    transcript_switch = saved_transcript;
+    optimise_switch = saved_optimise;
+    store_the_text = saved_store_text;
+
     return (no_errors==0)?0:1;
 }
 
@@ -1208,7 +1349,8 @@ One or more words can be supplied as \"commands\". These may be:\n\n\
   --trace TRACEOPT       (set trace option)\n\
   --trace TRACEOPT=num   (more tracing)\n\
   --define SYMBOL=number (define constant)\n\
-  --config filename      (read setup file)\n\n");
+  --config filename      (read setup file)\n\
+  --check-only           (report errors and warnings, but write no files)\n\n");
 
 #ifndef PROMPT_INPUT
     printf("For example: \"inform -dexs curses\".\n\n");
@@ -1651,6 +1793,8 @@ static void execute_icl_command(char *p)
 {   char filename[PATHLEN], cli_buff[CMD_BUF_SIZE];
     FILE *command_file;
     int len;
+
+    result_cache_note_command(p);
     
     switch(p[0])
     {   case '+': set_path_command(p+1); break;
@@ -1700,6 +1844,9 @@ static int execute_dashdash_command(char *p, char *p2)
     else if (!strcmp(p, "list")) {
         strcpy(cli_buff, "$LIST");
     }
+    else if (!strcmp(p, "check-only")) {
+        strcpy(cli_buff, "$CHECK_ONLY=1");
+    }
     else if (!strcmp(p, "size")) {
         consumed2 = TRUE;
         /* We accept these arguments even though they've been withdrawn. */
@@ -578,6 +578,7 @@ keyword_group system_constants =
     "oddeven_packing",
     "grammar_table", "dictionary_table", "dynam_string_table",
     "highest_meta_action_number",
+    "grammar_index_table",
     "" },
     SYSTEM_CONSTANT_TT, FALSE, TRUE
 };
@@ -2327,6 +2328,14 @@ extern void lexer_free_arrays(void)
     my_free(&local_variable_hash_codes, "local variable hash codes");
 
     cleanup_token_locations(NULL);
+
+    /* A pass which stopped early (the analysis pass, say) can leave
+       records still referenced by beginnings nobody will now discard */
+    while (first_token_locations)
+    {   debug_locations*moribund = first_token_locations;
+        first_token_locations = moribund->next;
+        my_free(&moribund, "debug locations of recent tokens");
+    }
 }
 
 /* ========================================================================= */
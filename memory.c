@@ -277,6 +277,32 @@ int DICT_IMPLICIT_SINGULAR; /* 0: no, 1: yes */
 int DICT_TRUNCATE_FLAG; /* 0: no, 1: yes */
 int LONG_DICT_FLAG_BUG; /* 0: no bug, 1: bug (default for historic reasons) */
 int TRANSCRIPT_FORMAT; /* 0: classic, 1: prefixed */
+int PROMOTE_INDIV_PROPS; /* (zcode) 0: no, 1: yes */
+int ROTATE_LOOPS; /* 0: no, 1: yes */
+int FOLD_CONSTANT_GLOBALS; /* 0: no, 1: yes, 2: yes, and list them */
+int SPECIALISE_MESSAGE_CALLS; /* 0: no, 1: yes */
+int CHECK_ONLY; /* 0: no, 1: report errors and warnings but write no files */
+int GRAMMAR_INDEX; /* 0: no, 1: emit #grammar_index_table */
+int RENUMBER_OBJECTS; /* (zcode) 0: no, 1: yes, 2: yes, and list them */
+int GLULX_C_OUTPUT; /* (glulx) 0: no, 1: also write a C translation */
+int STACK_ANALYSIS; /* (glulx) 0: no, 1: warn about MAX_STACK_SIZE, 2: set it */
+int DYNAMIC_ARRAY_ORDER; /* 0: as declared, 1: written arrays first */
+int GLULX_OBJECT_LAYOUT; /* (glulx) 0: objects, then property tables;
+                            1: each object followed by its table */
+int GLULX_PREV_SIBLING; /* (glulx) 0: no, 1: objects record their previous
+                           sibling */
+int SNAPSHOT_INIT; /* (glulx) 0: no, 1: run SnapshotInit at compile time */
+int FOLD_PURE_ROUTINES; /* 0: no, 1: fold constant calls to pure routines */
+int GLULX_FUSE_ATTRIBUTES; /* (glulx) 0: no, 1: test and set attributes
+                              sharing a byte or word together */
+int SORT_NAME_PROPERTIES; /* 0: no, 1: deduplicate and sort name lists */
+int SPECIALISE_PROPERTY_READS; /* 0: no, 1: read constant properties through
+                                  per-property stubs */
+int REORDER_BLOCKS; /* 0: no, 1: move rarely run blocks to the end of
+                       their routines */
+int GLULX_DIRECT_OPERANDS; /* (glulx) 0: no, 1: use simple operands where
+                              they are and pass values on the stack, not
+                              through the temporary globals */
 
 /* The way memory sizes are set causes great nuisance for those parameters
    which have different defaults under Z-code and Glulx. We have to get
@@ -340,6 +366,38 @@ static void list_memory_sizes(void)
     printf("|  %25s = %-7d |\n","DICT_IMPLICIT_SINGULAR",DICT_IMPLICIT_SINGULAR);
     printf("|  %25s = %-7d |\n","DICT_TRUNCATE_FLAG",DICT_TRUNCATE_FLAG);
     printf("|  %25s = %-7d |\n","LONG_DICT_FLAG_BUG",LONG_DICT_FLAG_BUG);
+    if (!glulx_mode)
+      printf("|  %25s = %-7d |\n","PROMOTE_INDIV_PROPS",PROMOTE_INDIV_PROPS);
+    printf("|  %25s = %-7d |\n","ROTATE_LOOPS",ROTATE_LOOPS);
+    printf("|  %25s = %-7d |\n","FOLD_CONSTANT_GLOBALS",FOLD_CONSTANT_GLOBALS);
+    printf("|  %25s = %-7d |\n","SPECIALISE_MESSAGE_CALLS",
+        SPECIALISE_MESSAGE_CALLS);
+    printf("|  %25s = %-7d |\n","CHECK_ONLY",CHECK_ONLY);
+    printf("|  %25s = %-7d |\n","GRAMMAR_INDEX",GRAMMAR_INDEX);
+    if (!glulx_mode)
+      printf("|  %25s = %-7d |\n","RENUMBER_OBJECTS",RENUMBER_OBJECTS);
+    if (glulx_mode)
+      printf("|  %25s = %-7d |\n","GLULX_C_OUTPUT",GLULX_C_OUTPUT);
+    if (glulx_mode)
+      printf("|  %25s = %-7d |\n","STACK_ANALYSIS",STACK_ANALYSIS);
+    printf("|  %25s = %-7d |\n","DYNAMIC_ARRAY_ORDER",DYNAMIC_ARRAY_ORDER);
+    if (glulx_mode)
+      printf("|  %25s = %-7d |\n","GLULX_OBJECT_LAYOUT",GLULX_OBJECT_LAYOUT);
+    if (glulx_mode)
+      printf("|  %25s = %-7d |\n","GLULX_PREV_SIBLING",GLULX_PREV_SIBLING);
+    if (glulx_mode)
+      printf("|  %25s = %-7d |\n","SNAPSHOT_INIT",SNAPSHOT_INIT);
+    printf("|  %25s = %-7d |\n","FOLD_PURE_ROUTINES",FOLD_PURE_ROUTINES);
+    if (glulx_mode)
+      printf("|  %25s = %-7d |\n","GLULX_FUSE_ATTRIBUTES",
+        GLULX_FUSE_ATTRIBUTES);
+    printf("|  %25s = %-7d |\n","SORT_NAME_PROPERTIES",SORT_NAME_PROPERTIES);
+    printf("|  %25s = %-7d |\n","SPECIALISE_PROPERTY_READS",
+        SPECIALISE_PROPERTY_READS);
+    printf("|  %25s = %-7d |\n","REORDER_BLOCKS",REORDER_BLOCKS);
+    if (glulx_mode)
+      printf("|  %25s = %-7d |\n","GLULX_DIRECT_OPERANDS",
+        GLULX_DIRECT_OPERANDS);
     printf("+--------------------------------------+\n");
 }
 
@@ -382,6 +440,25 @@ extern void set_memory_sizes(void)
     DICT_TRUNCATE_FLAG = 0;
     LONG_DICT_FLAG_BUG = 1;
     TRANSCRIPT_FORMAT = 0;
+    PROMOTE_INDIV_PROPS = 0;
+    ROTATE_LOOPS = 0;
+    FOLD_CONSTANT_GLOBALS = 0;
+    SPECIALISE_MESSAGE_CALLS = 0;
+    CHECK_ONLY = 0;
+    GRAMMAR_INDEX = 0;
+    RENUMBER_OBJECTS = 0;
+    GLULX_C_OUTPUT = 0;
+    STACK_ANALYSIS = 0;
+    DYNAMIC_ARRAY_ORDER = 0;
+    GLULX_OBJECT_LAYOUT = 0;
+    GLULX_PREV_SIBLING = 0;
+    SNAPSHOT_INIT = 0;
+    FOLD_PURE_ROUTINES = 0;
+    GLULX_FUSE_ATTRIBUTES = 0;
+    SORT_NAME_PROPERTIES = 0;
+    SPECIALISE_PROPERTY_READS = 0;
+    REORDER_BLOCKS = 0;
+    GLULX_DIRECT_OPERANDS = 0;
 
     adjust_memory_sizes();
 }
@@ -589,11 +666,210 @@ static void explain_parameter(char *command)
   retained.\n");
         return;
     }
+    if (strcmp(command,"PROMOTE_INDIV_PROPS")==0)
+    {
+        printf(
+"  PROMOTE_INDIV_PROPS, if set to 1, will make a preliminary pass over the \n\
+  source to count references to individual properties, and then declare \n\
+  the most used of them as common properties if there are free slots. \n\
+  Properties written to in code are not promoted. (Z-code only)\n");
+        return;
+    }
+    if (strcmp(command,"ROTATE_LOOPS")==0)
+    {
+        printf(
+"  ROTATE_LOOPS, if set to 1, compiles 'for' and 'while' loops with the \n\
+  condition tested at the bottom of the loop (after a test on entry), \n\
+  saving a jump on every iteration. In Z-code, counting loops such as \n\
+  'for (i=0 : i<10 : i++)' use @inc_chk or @dec_chk.\n");
+        return;
+    }
+    if (strcmp(command,"FOLD_CONSTANT_GLOBALS")==0)
+    {
+        printf(
+"  FOLD_CONSTANT_GLOBALS, if set to 1 or 2, will make a preliminary pass \n\
+  over the source to find global variables which are never written to, and \n\
+  then declare those as constants with their initial values. If set to 2, \n\
+  each such global is listed.\n");
+        return;
+    }
+    if (strcmp(command,"SPECIALISE_MESSAGE_CALLS")==0)
+    {
+        printf(
+"  SPECIALISE_MESSAGE_CALLS, if set to 1, compiles a message send such as \n\
+  'obj.prop(a, b)' as a call to one of the veneer routines CA__Pr0 to \n\
+  CA__Pr6, chosen by the number of arguments, which saves counting the \n\
+  arguments at run time. (Z-code version 4 and later only)\n");
+        return;
+    }
+    if (strcmp(command,"CHECK_ONLY")==0)
+    {
+        printf(
+"  CHECK_ONLY, if set to 1, compiles the source as usual and reports the \n\
+  same errors and warnings, but writes no story file, debugging file or \n\
+  transcript. Only the writing is skipped, so this is no faster than an \n\
+  ordinary compilation. (The same as the --check-only option.)\n");
+        return;
+    }
+    if (strcmp(command,"GRAMMAR_INDEX")==0)
+    {
+        printf(
+"  GRAMMAR_INDEX, if set to 1, adds an index to the grammar table, found \n\
+  at #grammar_index_table. For each grammar line it gives the type of the \n\
+  first token and a bitmap of the prepositions the line requires, so that \n\
+  a parser can rule out lines without walking them. The veneer routines \n\
+  Grammar__Mask and Grammar__Line_Ok show how to use it. (Grammar version \n\
+  2 or 3 only)\n");
+        return;
+    }
+    if (strcmp(command,"RENUMBER_OBJECTS")==0)
+    {
+        printf(
+"  RENUMBER_OBJECTS, if set to 1 or 2, will make a preliminary pass over \n\
+  the source to count references to each object, and then give the most \n\
+  used objects the numbers below 256, which are compiled as one-byte \n\
+  constants. Classes keep their numbers. If set to 2, each object moved \n\
+  is listed. (Z-code only)\n");
+        return;
+    }
+    if (strcmp(command,"DYNAMIC_ARRAY_ORDER")==0)
+    {
+        printf(
+"  DYNAMIC_ARRAY_ORDER, if set to 1, moves the arrays which the game may \n\
+  write to (those stored into, or whose address is passed to a routine or \n\
+  an input opcode) next to the global variables, ahead of the arrays it \n\
+  only reads. Data which changes during play is then kept together, which \n\
+  makes save files and undo snapshots smaller for interpreters which store \n\
+  the differences from the original memory.\n");
+        return;
+    }
+    if (strcmp(command,"GLULX_OBJECT_LAYOUT")==0)
+    {
+        printf(
+"  GLULX_OBJECT_LAYOUT, if set to 1, places each object's property table \n\
+  directly after the object itself, rather than writing all the objects \n\
+  and then all the property tables. Looking up a property then reads \n\
+  memory close to the object. The object format is unchanged, but objects \n\
+  are no longer a fixed distance apart. (Glulx only)\n");
+        return;
+    }
+    if (strcmp(command,"GLULX_PREV_SIBLING")==0)
+    {
+        printf(
+"  GLULX_PREV_SIBLING, if set to 1, adds a field to each object holding \n\
+  its previous sibling (or 0), so that \"move\" and \"remove\" no longer \n\
+  have to search the parent's list of children. The field follows the \n\
+  child field, at word GOBJFIELD_PREVSIB, and GOBJ_EXT_START moves up to \n\
+  make room. Code which writes GOBJFIELD_SIBLING or GOBJFIELD_CHILD \n\
+  itself must keep the new field up to date too; such writes are warned \n\
+  about, unless made at a plain number through a variable. (Glulx only)\n");
+        return;
+    }
+    if (strcmp(command,"SNAPSHOT_INIT")==0)
+    {
+        printf(
+"  SNAPSHOT_INIT, if set to 1, calls the game's SnapshotInit routine when \n\
+  the story file has been written, and stores the memory it leaves behind \n\
+  as the game's initial state. If it does so, the compiler-defined global \n\
+  sys_snapshot_taken is 1 when the game starts, so Main can skip it. It \n\
+  may only compute: printing, input, random numbers, gestalt and the like \n\
+  abandon the snapshot with a warning, leaving the story file as it was. \n\
+  (Glulx only)\n");
+        return;
+    }
+    if (strcmp(command,"FOLD_PURE_ROUTINES")==0)
+    {
+        printf(
+"  FOLD_PURE_ROUTINES, if set to 1, looks for routines whose body is a \n\
+  single \"return\" of an expression using only their arguments, \n\
+  constants, arithmetic, comparisons and calls to other such routines. \n\
+  A call to one of these with constant arguments, appearing later in the \n\
+  source, is replaced by its value, and may be used where a constant is \n\
+  needed.\n");
+        return;
+    }
+    if (strcmp(command,"GLULX_FUSE_ATTRIBUTES")==0)
+    {
+        printf(
+"  GLULX_FUSE_ATTRIBUTES, if set to 1, compiles a test of several constant \n\
+  attributes of one object, such as \"x has a && x hasnt b\" or \"x has a \n\
+  or b\", as one read of the object's attribute bits and a mask compare, \n\
+  when the attributes lie in the same byte or word. A \"give\" statement \n\
+  similarly sets and clears such attributes with one read and one write, \n\
+  where that takes no more instructions than setting them one by one. \n\
+  With run-time checks (-S) on, only tests of a named object are fused, \n\
+  and \"give\" statements are not. (Glulx only)\n");
+        return;
+    }
+    if (strcmp(command,"SORT_NAME_PROPERTIES")==0)
+    {
+        printf(
+"  SORT_NAME_PROPERTIES, if set to 1, writes the \"name\" property of \n\
+  every object with each word only once, inherited words included, and \n\
+  in increasing order of address, so that a parser can look a word up by \n\
+  binary search. The constant SORT_NAME_PROPERTIES is then defined, and \n\
+  the veneer routine Name__Search(obj, word) does such a search.\n");
+        return;
+    }
+    if (strcmp(command,"SPECIALISE_PROPERTY_READS")==0)
+    {
+        printf(
+"  SPECIALISE_PROPERTY_READS, if set to 1, compiles a property read such \n\
+  as 'obj.prop', where 'prop' is a named property and not a variable, as \n\
+  a call to a routine RV__Pr_<n> written for that property number alone, \n\
+  rather than to the general veneer routine RV__Pr. Such routines are \n\
+  added to the veneer only for the properties read in this way. (Z-code \n\
+  common properties are read by an opcode and are not affected.)\n");
+        return;
+    }
+    if (strcmp(command,"REORDER_BLOCKS")==0)
+    {
+        printf(
+"  REORDER_BLOCKS, if set to 1, moves code which is unlikely to run to the \n\
+  end of its routine, so that the usual path through the routine runs \n\
+  straight on instead of branching around it. The blocks moved are the \n\
+  bodies of 'if' statements (without 'else') which end by returning or \n\
+  quitting, and the run-time error reports added by the -S switch. The \n\
+  code is the same size or slightly larger, but fewer branches are taken.\n");
+        return;
+    }
+    if (strcmp(command,"GLULX_DIRECT_OPERANDS")==0)
+    {
+        printf(
+"  GLULX_DIRECT_OPERANDS, if set to 1, compiles Glulx code which uses \n\
+  constants and local variables directly as operands, and passes values \n\
+  between instructions on the stack, where it would otherwise copy them \n\
+  into the temporary global variables first. This affects 'switch' \n\
+  statements, 'random(x)', array entries incremented with '++' or '--', \n\
+  and the run-time checks of the -S switch.\n");
+        return;
+    }
+    if (strcmp(command,"STACK_ANALYSIS")==0)
+    {
+        printf(
+"  STACK_ANALYSIS, if set to 1, works out how much stack the deepest chain \n\
+  of routine calls needs, and warns if MAX_STACK_SIZE is smaller, or if it \n\
+  is over four times larger when no recursion is involved. If set to 2, \n\
+  MAX_STACK_SIZE is set from the result instead (or only raised, if the \n\
+  chain involves recursion). With -s, the chain is listed. (Glulx only)\n");
+        return;
+    }
+    if (strcmp(command,"GLULX_C_OUTPUT")==0)
+    {
+        printf(
+"  GLULX_C_OUTPUT, if set to 1, writes a translation of the game into C \n\
+  alongside the story file, with the same name ending \".c\". Each Glulx \n\
+  function becomes a C function; built with the runtime and Glk shim in \n\
+  tools/glulxc, the game runs natively. (Glulx only)\n");
+        return;
+    }
     if (strcmp(command,"SERIAL")==0)
     {
         printf(
 "  SERIAL, if set, will be used as the six digit serial number written into \n\
-  the header of the output file.\n");
+  the header of the output file. If not, the date given by the environment \n\
+  variable SOURCE_DATE_EPOCH (in seconds since 1970) is used if that is \n\
+  set, and today's date otherwise.\n");
         return;
     }
 
@@ -718,6 +994,8 @@ static void set_trace_option(char *command)
         printf("    MAP=3: also show number of bytes that each segment occupies\n");
         printf("  MEM: show internal memory allocations\n");
         printf("  OBJECTS: display the object table\n");
+        printf("  OPCODES: show how often each opcode was emitted, by form, operands and\n    length (also part of -s)\n");
+        printf("    OPCODES=2: as JSON\n");
         printf("  PROPS: show attributes and properties defined\n");
         printf("  RUNTIME: show game function calls at runtime (same as -g)\n");
         printf("    RUNTIME=2: also show library calls (not supported in Glulx)\n");
@@ -788,6 +1066,9 @@ static void set_trace_option(char *command)
     else if (strcmp(command, "OBJECTS")==0 || strcmp(command, "OBJECT")==0 || strcmp(command, "OBJS")==0 || strcmp(command, "OBJ")==0) {
         list_objects_setting = value;
     }
+    else if (strcmp(command, "OPCODES")==0 || strcmp(command, "OPCODE")==0 || strcmp(command, "OPS")==0) {
+        list_opcodes_setting = value;
+    }
     else if (strcmp(command, "PROP")==0 || strcmp(command, "PROPERTY")==0 || strcmp(command, "PROPS")==0 || strcmp(command, "PROPERTIES")==0) {
         printprops_switch = value;
     }
@@ -1033,6 +1314,121 @@ extern void memory_command(char *command)
                 if (LONG_DICT_FLAG_BUG > 1 || LONG_DICT_FLAG_BUG < 0)
                     LONG_DICT_FLAG_BUG = 1;
             }
+            if (strcmp(command,"PROMOTE_INDIV_PROPS")==0)
+            {
+                PROMOTE_INDIV_PROPS=j, flag=1;
+                if (PROMOTE_INDIV_PROPS > 1 || PROMOTE_INDIV_PROPS < 0)
+                    PROMOTE_INDIV_PROPS = 1;
+            }
+            if (strcmp(command,"ROTATE_LOOPS")==0)
+            {
+                ROTATE_LOOPS=j, flag=1;
+                if (ROTATE_LOOPS > 1 || ROTATE_LOOPS < 0)
+                    ROTATE_LOOPS = 1;
+            }
+            if (strcmp(command,"FOLD_CONSTANT_GLOBALS")==0)
+            {
+                FOLD_CONSTANT_GLOBALS=j, flag=1;
+                if (FOLD_CONSTANT_GLOBALS > 2 || FOLD_CONSTANT_GLOBALS < 0)
+                    FOLD_CONSTANT_GLOBALS = 2;
+            }
+            if (strcmp(command,"SPECIALISE_MESSAGE_CALLS")==0)
+            {
+                SPECIALISE_MESSAGE_CALLS=j, flag=1;
+                if (SPECIALISE_MESSAGE_CALLS > 1 || SPECIALISE_MESSAGE_CALLS < 0)
+                    SPECIALISE_MESSAGE_CALLS = 1;
+            }
+            if (strcmp(command,"CHECK_ONLY")==0)
+            {
+                CHECK_ONLY=j, flag=1;
+                if (CHECK_ONLY > 1 || CHECK_ONLY < 0)
+                    CHECK_ONLY = 1;
+            }
+            if (strcmp(command,"GRAMMAR_INDEX")==0)
+            {
+                GRAMMAR_INDEX=j, flag=1;
+                if (GRAMMAR_INDEX > 1 || GRAMMAR_INDEX < 0)
+                    GRAMMAR_INDEX = 1;
+            }
+            if (strcmp(command,"RENUMBER_OBJECTS")==0)
+            {
+                RENUMBER_OBJECTS=j, flag=1;
+                if (RENUMBER_OBJECTS > 2 || RENUMBER_OBJECTS < 0)
+                    RENUMBER_OBJECTS = 2;
+            }
+            if (strcmp(command,"DYNAMIC_ARRAY_ORDER")==0)
+            {
+                DYNAMIC_ARRAY_ORDER=j, flag=1;
+                if (DYNAMIC_ARRAY_ORDER > 1 || DYNAMIC_ARRAY_ORDER < 0)
+                    DYNAMIC_ARRAY_ORDER = 1;
+            }
+            if (strcmp(command,"GLULX_OBJECT_LAYOUT")==0)
+            {
+                GLULX_OBJECT_LAYOUT=j, flag=1;
+                if (GLULX_OBJECT_LAYOUT > 1 || GLULX_OBJECT_LAYOUT < 0)
+                    GLULX_OBJECT_LAYOUT = 1;
+            }
+            if (strcmp(command,"GLULX_PREV_SIBLING")==0)
+            {
+                GLULX_PREV_SIBLING=j, flag=1;
+                if (GLULX_PREV_SIBLING > 1 || GLULX_PREV_SIBLING < 0)
+                    GLULX_PREV_SIBLING = 1;
+            }
+            if (strcmp(command,"FOLD_PURE_ROUTINES")==0)
+            {
+                FOLD_PURE_ROUTINES=j, flag=1;
+                if (FOLD_PURE_ROUTINES > 1 || FOLD_PURE_ROUTINES < 0)
+                    FOLD_PURE_ROUTINES = 1;
+            }
+            if (strcmp(command,"SORT_NAME_PROPERTIES")==0)
+            {
+                SORT_NAME_PROPERTIES=j, flag=1;
+                if (SORT_NAME_PROPERTIES > 1 || SORT_NAME_PROPERTIES < 0)
+                    SORT_NAME_PROPERTIES = 1;
+            }
+            if (strcmp(command,"SPECIALISE_PROPERTY_READS")==0)
+            {
+                SPECIALISE_PROPERTY_READS=j, flag=1;
+                if (SPECIALISE_PROPERTY_READS > 1
+                    || SPECIALISE_PROPERTY_READS < 0)
+                    SPECIALISE_PROPERTY_READS = 1;
+            }
+            if (strcmp(command,"REORDER_BLOCKS")==0)
+            {
+                REORDER_BLOCKS=j, flag=1;
+                if (REORDER_BLOCKS > 1 || REORDER_BLOCKS < 0)
+                    REORDER_BLOCKS = 1;
+            }
+            if (strcmp(command,"GLULX_DIRECT_OPERANDS")==0)
+            {
+                GLULX_DIRECT_OPERANDS=j, flag=1;
+                if (GLULX_DIRECT_OPERANDS > 1 || GLULX_DIRECT_OPERANDS < 0)
+                    GLULX_DIRECT_OPERANDS = 1;
+            }
+            if (strcmp(command,"GLULX_FUSE_ATTRIBUTES")==0)
+            {
+                GLULX_FUSE_ATTRIBUTES=j, flag=1;
+                if (GLULX_FUSE_ATTRIBUTES > 1 || GLULX_FUSE_ATTRIBUTES < 0)
+                    GLULX_FUSE_ATTRIBUTES = 1;
+            }
+            if (strcmp(command,"SNAPSHOT_INIT")==0)
+            {
+                SNAPSHOT_INIT=j, flag=1;
+                if (SNAPSHOT_INIT > 1 || SNAPSHOT_INIT < 0)
+                    SNAPSHOT_INIT = 1;
+            }
+            if (strcmp(command,"STACK_ANALYSIS")==0)
+            {
+                STACK_ANALYSIS=j, flag=1;
+                if (STACK_ANALYSIS > 2 || STACK_ANALYSIS < 0)
+                    STACK_ANALYSIS = 2;
+            }
+            if (strcmp(command,"GLULX_C_OUTPUT")==0)
+            {
+                GLULX_C_OUTPUT=j, flag=1;
+                if (GLULX_C_OUTPUT > 1 || GLULX_C_OUTPUT < 0)
+                    GLULX_C_OUTPUT = 1;
+            }
             if (strcmp(command,"SERIAL")==0)
             {
                 if (j >= 0 && j <= 999999)
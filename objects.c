@@ -84,6 +84,9 @@ int no_attributes,                 /* Number of attributes defined so far    */
                                       1 and Inform creates "name" and two
                                       others itself, so the variable begins
                                       the compilation pass set to 4)         */
+int no_promoted_properties;        /* Common properties made from individual
+                                      ones ($PROMOTE_INDIV_PROPS), numbered
+                                      downwards from the top of the range    */
 
 /* Print a PROPS trace line. The f flag is 0 for an attribute, 1 for
    a common property, 2 for an individual property. */
@@ -330,7 +333,8 @@ extern void make_property(void)
     /* We now know we're allocating a new common property. Make sure 
        there's room. */
     if (!glulx_mode) {
-        if (no_properties==((version_number==3)?32:64))
+        if (no_properties + no_promoted_properties
+            == ((version_number==3)?32:64))
         {   discard_token_location(beginning_debug_location);
             /* The maximum listed here includes "name" but not the 
                unused zero value or the two hidden properties (class
@@ -457,6 +461,26 @@ static int   *classes_to_inherit_from; /* Allocated to no_classes_to_inherit_fro
 static memory_list classes_to_inherit_from_memlist;
 classinfo    *class_info;            /* Allocated up to no_classes           */
 memory_list   class_info_memlist;
+static int   *object_numbers;        /* Allocated to no_object_numbers; the
+                                        number given to each object, in
+                                        order of definition, if objects are
+                                        renumbered (see below)              */
+static int    no_object_numbers;
+
+static int defined_object_index(int n)
+{   /*  The index in objectsz[] (or objectsg[]) of the n-th object to have
+        been defined, counting from 0. This is simply n unless objects are
+        being renumbered.                                                    */
+
+    if (n < no_object_numbers) return object_numbers[n]-1;
+    return n;
+}
+
+static int next_object_number(void)
+{   /*  The number which the object now being defined will have.            */
+
+    return defined_object_index(no_objects)+1;
+}
 
 /* ------------------------------------------------------------------------- */
 /*   Tracing for compiler maintenance                                        */
@@ -825,6 +849,106 @@ static void property_inheritance_g(void)
   
 }
 
+/* ------------------------------------------------------------------------- */
+/*   Deduplicating "name" lists ($SORT_NAME_PROPERTIES). The words of each   */
+/*   class's name property are noted as its block is written, so that a     */
+/*   word which an object inherits (an INHERIT_MV reference into the block) */
+/*   can be compared with the object's own words. Sorting has to wait for   */
+/*   the dictionary's final order: see sort_name_properties() in tables.c.  */
+/* ------------------------------------------------------------------------- */
+
+static int32 *name_word_offsets;       /* Allocated to no_name_words; in
+                                          increasing order                  */
+static int *name_word_markers;
+static int32 *name_word_values;
+static memory_list name_word_offsets_memlist;
+static memory_list name_word_markers_memlist;
+static memory_list name_word_values_memlist;
+static int no_name_words;
+
+static void resolve_name_word(assembly_operand *AO, int *marker,
+    int32 *value)
+{   int lo = 0, hi = no_name_words - 1, mid;
+
+    *marker = AO->marker; *value = AO->value;
+    if (AO->marker != INHERIT_MV) return;
+    while (lo <= hi)
+    {   mid = (lo + hi)/2;
+        if (name_word_offsets[mid] == AO->value)
+        {   *marker = name_word_markers[mid];
+            *value = name_word_values[mid];
+            return;
+        }
+        if (name_word_offsets[mid] < AO->value) lo = mid + 1;
+        else hi = mid - 1;
+    }
+}
+
+static void note_class_name_word(int32 offset, assembly_operand *AO)
+{   ensure_memory_list_available(&name_word_offsets_memlist,
+        no_name_words+1);
+    ensure_memory_list_available(&name_word_markers_memlist,
+        no_name_words+1);
+    ensure_memory_list_available(&name_word_values_memlist,
+        no_name_words+1);
+    resolve_name_word(AO, &name_word_markers[no_name_words],
+        &name_word_values[no_name_words]);
+    name_word_offsets[no_name_words++] = offset;
+}
+
+static int same_name_word(assembly_operand *AO1, assembly_operand *AO2)
+{   int marker1, marker2;
+    int32 value1, value2;
+
+    resolve_name_word(AO1, &marker1, &value1);
+    resolve_name_word(AO2, &marker2, &value2);
+    return ((marker1 == marker2) && (value1 == value2));
+}
+
+static void dedupe_name_property_z(void)
+{   int i, j, k, n;
+
+    for (k=0; k<full_object.l; k++)
+    {   if ((full_object.pp[k].num != 1) || (full_object.pp[k].l > 32))
+            continue;
+        n = 0;
+        for (i=0; i<full_object.pp[k].l; i++)
+        {   for (j=0; j<n; j++)
+                if (same_name_word(&full_object.pp[k].ao[j],
+                    &full_object.pp[k].ao[i])) break;
+            if (j == n) full_object.pp[k].ao[n++] = full_object.pp[k].ao[i];
+        }
+        full_object.pp[k].l = n;
+    }
+}
+
+static void dedupe_name_property_g(void)
+{   /*  The list may be spread over several entries (one for the object's
+        own words and one for each class inherited from): each keeps its
+        place, and only loses words which an earlier one has.                */
+    int i, j, k, m, n;
+    assembly_operand *data = full_object_g.propdata;
+
+    for (k=0; k<full_object_g.numprops; k++)
+    {   int32 start = full_object_g.props[k].datastart;
+        if (full_object_g.props[k].num != 1) continue;
+        n = 0;
+        for (i=0; i<full_object_g.props[k].datalen; i++)
+        {   for (m=0; m<=k; m++)
+            {   int32 mstart = full_object_g.props[m].datastart;
+                int mlen = (m == k) ? n : full_object_g.props[m].datalen;
+                if (full_object_g.props[m].num != 1) continue;
+                for (j=0; j<mlen; j++)
+                    if (same_name_word(&data[mstart+j], &data[start+i]))
+                        break;
+                if (j < mlen) break;
+            }
+            if (m > k) data[start+n++] = data[start+i];
+        }
+        full_object_g.props[k].datalen = n;
+    }
+}
+
 /* ------------------------------------------------------------------------- */
 /*   Construction of Z-machine-format property blocks.                       */
 /* ------------------------------------------------------------------------- */
@@ -860,6 +984,9 @@ static int write_properties_between(int mark, int from, int to)
                         error("Too many values for Z-machine property");
                         break;
                     }
+                    if (SORT_NAME_PROPERTIES && current_defn_is_class
+                        && (prop_number == 1))
+                        note_class_name_word(mark, &full_object.pp[j].ao[k]);
                     if (full_object.pp[j].ao[k].marker != 0)
                         backpatch_zmachine(full_object.pp[j].ao[k].marker,
                             PROP_ZA, mark);
@@ -994,6 +1121,9 @@ static int32 write_property_block_g(void)
       ensure_memory_list_available(&properties_table_memlist, datamark+4*full_object_g.props[jx].datalen);
       for (kx=0; kx<full_object_g.props[jx].datalen; kx++) {
         int32 val = full_object_g.propdata[datastart+kx].value;
+        if (SORT_NAME_PROPERTIES && current_defn_is_class && (propnum == 1))
+          note_class_name_word(datamark,
+            &full_object_g.propdata[datastart+kx]);
         WriteInt32(properties_table+datamark, val);
         if (full_object_g.propdata[datastart+kx].marker != 0)
           backpatch_zmachine(full_object_g.propdata[datastart+kx].marker,
@@ -1025,28 +1155,30 @@ static int32 write_property_block_g(void)
 /* ------------------------------------------------------------------------- */
 
 static void manufacture_object_z(void)
-{   int i, j;
+{   int i, j, k = next_object_number()-1;
 
     segment_markers.enabled = FALSE;
     directives.enabled = TRUE;
 
-    ensure_memory_list_available(&objectsz_memlist, no_objects+1);
+    ensure_memory_list_available(&objectsz_memlist,
+        ((k > no_objects) ? k : no_objects)+1);
 
-    objectsz[no_objects].symbol = full_object.symbol;
+    objectsz[k].symbol = full_object.symbol;
     
     property_inheritance_z();
+    if (SORT_NAME_PROPERTIES) dedupe_name_property_z();
 
-    objectsz[no_objects].parent = parent_of_this_obj;
-    objectsz[no_objects].next = 0;
-    objectsz[no_objects].child = 0;
+    objectsz[k].parent = parent_of_this_obj;
+    objectsz[k].next = 0;
+    objectsz[k].child = 0;
 
     if ((parent_of_this_obj > 0) && (parent_of_this_obj != 0x7fff))
     {   i = objectsz[parent_of_this_obj-1].child;
         if (i == 0)
-            objectsz[parent_of_this_obj-1].child = no_objects + 1;
+            objectsz[parent_of_this_obj-1].child = k + 1;
         else
         {   while(objectsz[i-1].next != 0) i = objectsz[i-1].next;
-            objectsz[i-1].next = no_objects+1;
+            objectsz[i-1].next = k+1;
         }
     }
 
@@ -1054,15 +1186,16 @@ static void manufacture_object_z(void)
             blocks, one for each object in order of definition, exactly as
             it will appear in the final Z-machine.                           */
 
+    objectsz[k].propaddr = properties_table_size;
     j = write_property_block_z(shortname_buffer);
 
-    objectsz[no_objects].propsize = j;
+    objectsz[k].propsize = j;
 
     if (current_defn_is_class)
-        for (i=0;i<6;i++) objectsz[no_objects].atts[i] = 0;
+        for (i=0;i<6;i++) objectsz[k].atts[i] = 0;
     else
         for (i=0;i<6;i++)
-            objectsz[no_objects].atts[i] = full_object.atts[i];
+            objectsz[k].atts[i] = full_object.atts[i];
 
     no_objects++;
 
@@ -1084,6 +1217,7 @@ static void manufacture_object_g(void)
     objectsg[no_objects].symbol = full_object_g.symbol;
     
     property_inheritance_g();
+    if (SORT_NAME_PROPERTIES) dedupe_name_property_g();
 
     objectsg[no_objects].parent = parent_of_this_obj;
     objectsg[no_objects].next = 0;
@@ -1122,6 +1256,63 @@ static void manufacture_object_g(void)
     no_objects++;
 }
 
+/* ------------------------------------------------------------------------- */
+/*   Laying out the Glulx objects and property tables. Normally all the     */
+/*   objects come first, a fixed distance apart, followed by the property   */
+/*   tables in properties_table order. With GLULX_OBJECT_LAYOUT set, each   */
+/*   object's block from properties_table (a class's attribute bytes, then  */
+/*   the property table) is placed around the object, so that the table     */
+/*   directly follows it: the two areas become one, and offsets into        */
+/*   properties_table are moved to match.                                   */
+/* ------------------------------------------------------------------------- */
+
+extern int32 plan_object_layout_g(void)
+{   /*  Returns the size of the objects and property tables together.       */
+    int32 i, pos = 0, start = 0;
+
+    for (i=0; i<no_objects; i++)
+    {   objectsg[i].blockstart = start;
+        start += objectsg[i].propsize;
+        if (GLULX_OBJECT_LAYOUT)
+        {   pos += objectsg[i].propaddr - objectsg[i].blockstart;
+            objectsg[i].finaladdr = pos;
+            pos += OBJECT_BYTE_LENGTH + (start - objectsg[i].propaddr);
+        }
+        else
+        {   objectsg[i].finaladdr = pos;
+            pos += OBJECT_BYTE_LENGTH;
+        }
+    }
+    if (start != properties_table_size)
+        compiler_error("Property blocks do not fill the properties table");
+    if (!GLULX_OBJECT_LAYOUT) pos += properties_table_size;
+    return pos;
+}
+
+extern int32 object_offset_g(int32 n)
+{   /*  The offset of object n (counted from 1) from the object tree.       */
+    if (GLULX_OBJECT_LAYOUT && (n >= 1) && (n <= no_objects))
+        return objectsg[n-1].finaladdr;
+    return OBJECT_BYTE_LENGTH*(n-1);
+}
+
+extern int32 relocated_property_offset_g(int32 offset)
+{   /*  Where a byte at this offset in properties_table ends up, relative   */
+    /*  to the start of the property tables in the story file.              */
+    int32 lo = 0, hi = no_objects-1, mid;
+    objecttg *obj;
+
+    if (!GLULX_OBJECT_LAYOUT || (no_objects == 0)) return offset;
+    while (lo < hi)
+    {   mid = (lo + hi + 1)/2;
+        if (objectsg[mid].blockstart <= offset) lo = mid; else hi = mid - 1;
+    }
+    obj = objectsg + lo;
+    if (offset < obj->propaddr)
+        return obj->finaladdr - (obj->propaddr - offset);
+    return obj->finaladdr + OBJECT_BYTE_LENGTH + (offset - obj->propaddr);
+}
+
 
 /* ========================================================================= */
 /*   [2]  The Object/Nearby/Class directives parser: translating the syntax  */
@@ -1175,6 +1366,7 @@ static void properties_segment_z(int this_segment)
             {   this_identifier_number = no_individual_properties++;
                 assign_symbol(token_value, this_identifier_number,
                     INDIVIDUAL_PROPERTY_T);
+                note_symbol_usage_flag(token_value, IMPLICIT_UFLAG);
 
                 if (debugfile_switch)
                 {   debug_file_printf("<property>");
@@ -1196,6 +1388,9 @@ static void properties_segment_z(int this_segment)
                 }
             }
 
+            if (this_segment == PRIVATE_SEGMENT)
+                note_symbol_usage_flag(token_value, PRIVATE_UFLAG);
+
             if (def_t_s >= defined_this_segment_size)
                 ensure_defined_this_segment(def_t_s*2);
             defined_this_segment[def_t_s++] = token_value;
@@ -1394,6 +1589,8 @@ the names \"%s\" and \"%s\" actually refer to the same property",
 
         if (individual_property)
         {
+            if (length > 2)
+                note_symbol_usage_flag(property_name_symbol, LONGPROP_UFLAG);
             ensure_memory_list_available(&individuals_table_memlist, individuals_length+length+3);
             individuals_table[i_m + 2] = length;
             individuals_length += length+3;
@@ -1864,7 +2061,7 @@ static void initialise_full_object(void)
 }
 
 extern void make_class(char * metaclass_name)
-{   int n, duplicates_to_make = 0, class_number = no_objects+1,
+{   int n, duplicates_to_make = 0, class_number = next_object_number(),
         metaclass_flag = (metaclass_name != NULL);
     debug_location_beginning beginning_debug_location =
         get_token_location_beginning();
@@ -1941,7 +2138,7 @@ inconvenience, please contact the maintainers.");
       full_object.l = 1;
       full_object.pp[0].num = 2;
       full_object.pp[0].l = 1;
-      INITAOTV(&full_object.pp[0].ao[0], LONG_CONSTANT_OT, no_objects + 1);
+      INITAOTV(&full_object.pp[0].ao[0], LONG_CONSTANT_OT, class_number);
       full_object.pp[0].ao[0].marker = OBJECT_MV;
     }
     else {
@@ -1955,7 +2152,7 @@ inconvenience, please contact the maintainers.");
       full_object_g.props[0].datalen = 1;
       full_object_g.propdatasize = 1;
       ensure_memory_list_available(&full_object_g.propdata_memlist, 1);
-      INITAOTV(&full_object_g.propdata[0], CONSTANT_OT, no_objects + 1);
+      INITAOTV(&full_object_g.propdata[0], CONSTANT_OT, class_number);
       full_object_g.propdata[0].marker = OBJECT_MV;
     }
 
@@ -1993,7 +2190,7 @@ inconvenience, please contact the maintainers.");
         debug_file_printf("<identifier>%s</identifier>", shortname_buffer);
         debug_file_printf("<class-number>%d</class-number>", no_classes);
         debug_file_printf("<value>");
-        write_debug_object_backpatch(no_objects + 1);
+        write_debug_object_backpatch(class_number);
         debug_file_printf("</value>");
         write_debug_locations
             (get_token_location_end(beginning_debug_location));
@@ -2052,14 +2249,15 @@ extern void make_object(int nearby_flag,
         the routine is called for class duplicates manufacture (see above).
         The last is used to create instances of a particular class.  */
 
-    int i, tree_depth, internal_name_symbol = 0;
+    int i, n, tree_depth, internal_name_symbol = 0;
     debug_location_beginning beginning_debug_location =
         get_token_location_beginning();
 
     directives.enabled = FALSE;
 
     ensure_memory_list_available(&current_object_name, 32);
-    sprintf(current_object_name.data, "nameless_obj__%d", no_objects+1);
+    sprintf(current_object_name.data, "nameless_obj__%d",
+        next_object_number());
 
     current_defn_is_class = FALSE;
 
@@ -2161,7 +2359,7 @@ extern void make_object(int nearby_flag,
     if (specified_class == -1) put_token_back();
 
     if (internal_name_symbol > 0)
-        assign_symbol(internal_name_symbol, no_objects + 1, OBJECT_T);
+        assign_symbol(internal_name_symbol, next_object_number(), OBJECT_T);
 
     if (textual_name == NULL)
     {
@@ -2172,7 +2370,7 @@ extern void make_object(int nearby_flag,
         }
         else {
             ensure_memory_list_available(&shortname_buffer_memlist, 32);
-            sprintf(shortname_buffer, "(%d)", no_objects+1);
+            sprintf(shortname_buffer, "(%d)", next_object_number());
         }
     }
     else
@@ -2206,8 +2404,10 @@ extern void make_object(int nearby_flag,
                 Z-machine (and in the objects[].parent, etc., fields) but
                 0, 1, 2, ... internally (and as indices to object[]).        */
 
-            for (i=no_objects-1; i>=0; i--)
-            {   int j = i, k = 0;
+            for (n=no_objects-1; n>=0; n--)
+            {   int j, k = 0;
+
+                i = defined_object_index(n); j = i;
 
                 /*  Metaclass or class objects cannot be '->' parents:  */
                 if (i<4)
@@ -2262,7 +2462,7 @@ extern void make_object(int nearby_flag,
                  current_object_name.data);
         }
         debug_file_printf("<value>");
-        write_debug_object_backpatch(no_objects + 1);
+        write_debug_object_backpatch(next_object_number());
         debug_file_printf("</value>");
         write_debug_locations
             (get_token_location_end(beginning_debug_location));
@@ -2275,6 +2475,217 @@ extern void make_object(int nearby_flag,
       manufacture_object_g();
 }
 
+/* ------------------------------------------------------------------------- */
+/*   Promotion of individual properties to common properties.                */
+/*                                                                           */
+/*   In Z-code, reading a common property is a single @get_prop opcode,      */
+/*   whereas an individual property goes through the RV__Pr veneer routine   */
+/*   and a search of the object's individual property table. If              */
+/*   $PROMOTE_INDIV_PROPS is set, the analysis pass counts references to     */
+/*   every property, and at the start of the main pass we declare the most   */
+/*   used individual properties as common properties, for as many as there   */
+/*   are common property slots left unused. They take the highest numbers,   */
+/*   counting down from 63 (or 31), so that the properties declared with     */
+/*   "Property" keep the numbers they would otherwise have had.              */
+/*                                                                           */
+/*   Only properties which were created implicitly, by their first           */
+/*   appearance in an object or class definition, are considered: one        */
+/*   declared with "Property individual" stays individual. So does one       */
+/*   which is ever given in a "private" segment, or given more than one      */
+/*   value (since @get_prop cannot read it), or tested with Ifdef (since     */
+/*   declaring it earlier would change the outcome), or written to in code   */
+/*   (since @put_prop on a property the object does not provide halts the    */
+/*   interpreter, where the veneer gives a run-time error and carries on).   */
+/*                                                                           */
+/*   A promoted property has default value 0. The only difference seen at    */
+/*   run time is in programs which read a property that the object does not  */
+/*   provide: this quietly reads as 0, where the veneer would give a "no     */
+/*   such property" run-time error (and the value 1).                        */
+/*                                                                           */
+/*   References are counted in the source, not weighted by how often the     */
+/*   code runs: no run-time profile is used.                                 */
+/* ------------------------------------------------------------------------- */
+
+static int promoted_property_compare(const void *ptr1, const void *ptr2)
+{   const analysedsymbol *s1 = *(const analysedsymbol **)ptr1;
+    const analysedsymbol *s2 = *(const analysedsymbol **)ptr2;
+    if (s1->refs != s2->refs) return (s1->refs > s2->refs) ? -1 : 1;
+    return s1->index - s2->index;
+}
+
+static void promote_individual_properties(void)
+{   analysedsymbol **candidates;
+    int i, count, slots, number, used = no_properties;
+
+    no_promoted_properties = 0;
+    if (!PROMOTE_INDIV_PROPS || glulx_mode || analysis_pass
+        || no_analysed_symbols == 0)
+        return;
+
+    /* Common property numbers are allocated in sequence, so the highest
+       one seen in the analysis pass tells us how many were used. */
+    for (i=0; i<no_analysed_symbols; i++)
+        if ((analysed_symbols[i].type == PROPERTY_T)
+            && (analysed_symbols[i].value >= used))
+            used = analysed_symbols[i].value + 1;
+
+    slots = ((version_number==3) ? 32 : 64) - used;
+    if (slots <= 0) return;
+
+    candidates = my_calloc(sizeof(analysedsymbol *), no_analysed_symbols,
+        "property promotion candidates");
+    for (i=0, count=0; i<no_analysed_symbols; i++)
+    {   analysedsymbol *as = &analysed_symbols[i];
+        if ((as->type == INDIVIDUAL_PROPERTY_T)
+            && (as->flags & IMPLICIT_UFLAG)
+            && !(as->flags & (IFDEF_UFLAG + PRIVATE_UFLAG + LONGPROP_UFLAG
+                              + ASSIGNED_UFLAG))
+            && (as->refs > 0))
+            candidates[count++] = as;
+    }
+    qsort(candidates, count, sizeof(analysedsymbol *),
+        promoted_property_compare);
+    if (count > slots) count = slots;
+
+    for (i=0; i<count; i++)
+    {   int created, symbol;
+        symbol = symbol_index(candidates[i]->name, -1, &created);
+        if (!created) continue;
+
+        number = ((version_number==3) ? 31 : 63) - no_promoted_properties++;
+        commonprops[number].default_value = 0;
+        commonprops[number].is_long = TRUE;
+        commonprops[number].is_additive = FALSE;
+        assign_symbol(symbol, number, PROPERTY_T);
+
+        if (debugfile_switch)
+        {   debug_file_printf("<property>");
+            debug_file_printf("<identifier>%s</identifier>",
+                symbols[symbol].name);
+            debug_file_printf("<value>%d</value>", symbols[symbol].value);
+            debug_file_printf("</property>");
+        }
+
+        trace_s(symbols[symbol].name, symbols[symbol].value, 1);
+    }
+
+    my_free(&candidates, "property promotion candidates");
+}
+
+/* ------------------------------------------------------------------------- */
+/*   Renumbering of objects.                                                 */
+/*                                                                           */
+/*   A Z-code constant operand from 0 to 255 takes one byte, and a larger    */
+/*   one two, so in a game with more than 255 objects it is better for the  */
+/*   objects most often named in the source to have numbers below 256. If   */
+/*   $RENUMBER_OBJECTS is set, the analysis pass counts references to each   */
+/*   object, and at the start of the main pass we decide the number every    */
+/*   object will be given when it is defined. Each object is then compiled   */
+/*   with its final number from the outset, so nothing needs backpatching.   */
+/*                                                                           */
+/*   Only the slots held by plain objects are shuffled: the metaclasses and  */
+/*   classes keep the numbers they would have had. Those plain slots below   */
+/*   256 go to the most referred-to objects (on a tie, the one defined       */
+/*   first), and within the low and high slots objects stay in order of      */
+/*   definition. The object tree is built from the final numbers, so it has  */
+/*   the same shape; but "objectloop" over all objects, or over a class,     */
+/*   meets the objects in the new order.                                     */
+/* ------------------------------------------------------------------------- */
+
+static int32 *renumbering_refs;        /* Only valid within renumber_objects() */
+
+static int renumbering_compare(const void *ptr1, const void *ptr2)
+{   int n1 = *(const int *)ptr1, n2 = *(const int *)ptr2;
+    if (renumbering_refs[n1] != renumbering_refs[n2])
+        return (renumbering_refs[n1] > renumbering_refs[n2]) ? -1 : 1;
+    return n1 - n2;
+}
+
+static void renumber_objects(void)
+{   int32 *refs;
+    int *order, *low_slots, *high_slots;
+    char *chosen, **names;
+    int i, n, count, no_low, no_high;
+
+    my_free(&object_numbers, "object numbers");
+    no_object_numbers = 0;
+
+    if (!RENUMBER_OBJECTS || glulx_mode || analysis_pass
+        || no_analysed_symbols == 0)
+        return;
+
+    /* Objects are numbered in sequence, so the highest number seen in
+       the analysis pass tells us how many it made (apart from any
+       nameless ones after the last named object or class). */
+    for (i=0, n=0; i<no_analysed_symbols; i++)
+        if (((analysed_symbols[i].type == OBJECT_T)
+             || (analysed_symbols[i].type == CLASS_T))
+            && (analysed_symbols[i].value > n))
+            n = analysed_symbols[i].value;
+    if (n <= 255) return;
+
+    refs = my_calloc(sizeof(int32), n+1, "object renumbering counts");
+    chosen = my_calloc(sizeof(char), n+1, "object renumbering choices");
+    order = my_calloc(sizeof(int), n, "object renumbering order");
+    low_slots = my_calloc(sizeof(int), n, "object renumbering slots");
+    high_slots = my_calloc(sizeof(int), n, "object renumbering slots");
+    names = my_calloc(sizeof(char *), n+1, "object renumbering names");
+    object_numbers = my_calloc(sizeof(int), n, "object numbers");
+
+    /* Refs of -1 marks a metaclass or class, which is not moved. */
+    for (i=1; i<=4; i++) refs[i] = -1;
+    for (i=0; i<no_analysed_symbols; i++)
+    {   analysedsymbol *as = &analysed_symbols[i];
+        if ((as->value < 1) || (as->value > n)) continue;
+        if (as->type == CLASS_T) refs[as->value] = -1;
+        else if ((as->type == OBJECT_T) && (refs[as->value] >= 0))
+        {   refs[as->value] = as->refs;
+            names[as->value] = as->name;
+        }
+    }
+
+    for (i=1, count=0, no_low=0, no_high=0; i<=n; i++)
+    {   object_numbers[i-1] = i;
+        if (refs[i] < 0) continue;
+        order[count++] = i;
+        if (i <= 255) low_slots[no_low++] = i;
+        else high_slots[no_high++] = i;
+    }
+
+    renumbering_refs = refs;
+    qsort(order, count, sizeof(int), renumbering_compare);
+    renumbering_refs = NULL;
+    for (i=0; i<no_low; i++) chosen[order[i]] = TRUE;
+
+    for (i=1, no_low=0, no_high=0; i<=n; i++)
+    {   if (refs[i] < 0) continue;
+        if (chosen[i]) object_numbers[i-1] = low_slots[no_low++];
+        else object_numbers[i-1] = high_slots[no_high++];
+        if ((RENUMBER_OBJECTS >= 2) && (chosen[i] ? (i > 255) : (i <= 255)))
+            printf("Object \"%s\" (%d reference%s) renumbered from %d to %d\n",
+                (names[i]) ? names[i] : "(nameless)", refs[i],
+                (refs[i] == 1) ? "" : "s", i, object_numbers[i-1]);
+    }
+    no_object_numbers = n;
+
+    my_free(&refs, "object renumbering counts");
+    my_free(&chosen, "object renumbering choices");
+    my_free(&order, "object renumbering order");
+    my_free(&low_slots, "object renumbering slots");
+    my_free(&high_slots, "object renumbering slots");
+    my_free(&names, "object renumbering names");
+}
+
+extern void check_object_renumbering(void)
+{   /*  Called when the main pass is over. The analysis pass ought to have
+        defined the same objects, in the same order; if it made more, some
+        object numbers have not been given out.                              */
+
+    if (no_objects < no_object_numbers)
+        compiler_error("Objects were not defined as the analysis pass \
+predicted, so cannot be renumbered");
+}
+
 /* ========================================================================= */
 /*   Data structure management routines                                      */
 /* ------------------------------------------------------------------------- */
@@ -2291,6 +2702,12 @@ extern void init_objects_vars(void)
     objectatts = NULL;
     classes_to_inherit_from = NULL;
     class_info = NULL;
+    object_numbers = NULL;
+    no_object_numbers = 0;
+    name_word_offsets = NULL;
+    name_word_markers = NULL;
+    name_word_values = NULL;
+    no_name_words = 0;
 
     full_object_g.props = NULL;    
     full_object_g.propdata = NULL;    
@@ -2359,8 +2776,12 @@ extern void objects_begin_pass(void)
     current_classname_symbol = 0;
 
     no_embedded_routines = 0;
+    no_name_words = 0;
 
     individuals_length=0;
+
+    promote_individual_properties();
+    renumber_objects();
 }
 
 extern void objects_allocate_arrays(void)
@@ -2399,6 +2820,15 @@ extern void objects_allocate_arrays(void)
     initialise_memory_list(&embedded_function_name,
         sizeof(char), 32, NULL,
         "temporary storage for inline function name");
+    initialise_memory_list(&name_word_offsets_memlist,
+        sizeof(int32), 64, (void**)&name_word_offsets,
+        "class name word offsets");
+    initialise_memory_list(&name_word_markers_memlist,
+        sizeof(int), 64, (void**)&name_word_markers,
+        "class name word markers");
+    initialise_memory_list(&name_word_values_memlist,
+        sizeof(int32), 64, (void**)&name_word_values,
+        "class name word values");
     
     if (!glulx_mode) {
       initialise_memory_list(&objectsz_memlist,
@@ -2428,6 +2858,9 @@ extern void objects_free_arrays(void)
     deallocate_memory_list(&current_object_name);
     deallocate_memory_list(&shortname_buffer_memlist);
     deallocate_memory_list(&embedded_function_name);
+    deallocate_memory_list(&name_word_offsets_memlist);
+    deallocate_memory_list(&name_word_markers_memlist);
+    deallocate_memory_list(&name_word_values_memlist);
     deallocate_memory_list(&objectsz_memlist);
     deallocate_memory_list(&objectsg_memlist);
     deallocate_memory_list(&objectatts_memlist);
@@ -2438,8 +2871,10 @@ extern void objects_free_arrays(void)
     deallocate_memory_list(&individuals_table_memlist);
 
     my_free(&defined_this_segment,"defined this segment table");
+    my_free(&object_numbers, "object numbers");
+    no_object_numbers = 0;
 
-    if (!glulx_mode) {
+    if (glulx_mode) {
         deallocate_memory_list(&full_object_g.props_memlist);
         deallocate_memory_list(&full_object_g.propdata_memlist);
     }
@@ -0,0 +1,478 @@
+/* ------------------------------------------------------------------------- */
+/*   "snapshot" : Running the game's SnapshotInit routine at build time      */
+/*                ($SNAPSHOT_INIT)                                           */
+/*                                                                           */
+/*   Part of Inform 6.43                                                     */
+/*   copyright (c) Graham Nelson 1993 - 2024                                 */
+/*                                                                           */
+/*   A small Glulx interpreter calls the routine on a copy of the finished   */
+/*   story file; if it returns, the RAM it leaves behind replaces the story  */
+/*   file's initial RAM. Only opcodes which compute are known: anything      */
+/*   which does input or output, depends on the interpreter (gestalt,        */
+/*   random numbers, acceleration), or changes state which the story file    */
+/*   cannot record (the heap, undo, the string table, memory size) abandons  */
+/*   the attempt and the story file is left as it was.                       */
+/*                                                                           */
+/*   The stack holds words. A frame is a word giving the number of locals,   */
+/*   then the locals, then the frame's values; a call stub is four words     */
+/*   (destination type, destination, PC, frame pointer). Catch tokens are    */
+/*   byte offsets as usual, so games cannot tell the difference.             */
+/*   Instructions are decoded by decode_glulx_instruction() in "asm.c".      */
+/* ------------------------------------------------------------------------- */
+
+#include "header.h"
+
+#define SN_STEP_LIMIT 500000000L  /* Give up after this many instructions  */
+#define SN_FINISHED 0xFF          /* Destination type for the outermost call */
+
+static uchar *sn_mem;
+static uint32 sn_endmem, sn_ramstart, sn_stringtbl;
+static uint32 *sn_stack, sn_stacksize, sn_sp, sn_fp, sn_vbase;
+static uint32 sn_pc, sn_start;     /* Current PC and the instruction's start */
+static int sn_failed, sn_finished;
+
+static void sn_abandon(char *why)
+{   if (!sn_failed)
+        warning_fmt("Snapshot of SnapshotInit abandoned: %s at $%06lx, so \
+the game must run it itself", why, (long int) sn_start);
+    sn_failed = TRUE;
+}
+
+static uint32 sn_read(uint32 addr, int size)
+{   uint32 v = 0;
+    if ((addr > sn_endmem) || ((uint32) size > sn_endmem - addr))
+    {   sn_abandon("memory read out of range"); return 0;
+    }
+    while (size-- > 0) v = (v << 8) | sn_mem[addr++];
+    return v;
+}
+
+static void sn_write(uint32 addr, int size, uint32 v)
+{   if ((addr < sn_ramstart) || (addr > sn_endmem)
+        || ((uint32) size > sn_endmem - addr))
+    {   sn_abandon("memory write outside RAM"); return;
+    }
+    while (size-- > 0) { sn_mem[addr+size] = v & 0xFF; v >>= 8; }
+}
+
+static void sn_push(uint32 v)
+{   if (sn_sp >= sn_stacksize) { sn_abandon("stack overflow"); return; }
+    sn_stack[sn_sp++] = v;
+}
+
+static uint32 sn_pop(void)
+{   if (sn_sp <= sn_vbase) { sn_abandon("stack underflow"); return 0; }
+    return sn_stack[--sn_sp];
+}
+
+static uint32 *sn_local(uint32 offset)
+{   if ((offset % 4) || (offset/4 >= sn_stack[sn_fp]))
+    {   sn_abandon("bad local variable"); return NULL;
+    }
+    return &sn_stack[sn_fp + 1 + offset/4];
+}
+
+/*  Loads an operand, width being 4, or 2 or 1 for copys and copyb.          */
+
+static uint32 sn_load(int mode, uint32 raw, int width)
+{   uint32 mask = (width == 4) ? 0xFFFFFFFF : (1L << (8*width)) - 1, *l;
+    switch (mode)
+    {   case 0: return 0;
+        case 1: case 2: case 3: return raw & mask;
+        case 5: case 6: case 7: return sn_read(raw, width);
+        case 8: return sn_pop() & mask;
+        case 9: case 10: case 11:
+            if (width != 4) { sn_abandon("part of a local loaded"); return 0; }
+            l = sn_local(raw);
+            return (l) ? *l : 0;
+        case 13: case 14: case 15: return sn_read(raw + sn_ramstart, width);
+    }
+    sn_abandon("bad operand mode");
+    return 0;
+}
+
+static void sn_store(int mode, uint32 raw, uint32 v, int width)
+{   uint32 *l;
+    if (width < 4) v &= (1L << (8*width)) - 1;
+    switch (mode)
+    {   case 0: return;
+        case 5: case 6: case 7: sn_write(raw, width, v); return;
+        case 8: sn_push(v); return;
+        case 9: case 10: case 11:
+            if (width != 4) { sn_abandon("part of a local stored"); return; }
+            l = sn_local(raw);
+            if (l) *l = v;
+            return;
+        case 13: case 14: case 15: sn_write(raw + sn_ramstart, width, v);
+            return;
+    }
+    sn_abandon("bad store operand");
+}
+
+/*  Enters the function at addr, with its arguments in args[0..argc).        */
+
+static void sn_enter(uint32 addr, uint32 argc, uint32 *args)
+{   uint32 i, n = 0, type = sn_read(addr, 1), p = addr + 1;
+    if ((type != 0xC0) && (type != 0xC1))
+    {   sn_abandon("call to something which is not a function"); return;
+    }
+    while (!sn_failed && (sn_read(p, 2) != 0))
+    {   if (sn_read(p, 1) != 4)
+        {   sn_abandon("locals which are not four bytes wide"); return;
+        }
+        n += sn_read(p+1, 1);
+        p += 2;
+    }
+    sn_fp = sn_sp;
+    sn_push(n);
+    for (i=0; i<n; i++)
+        sn_push(((type == 0xC1) && (i < argc)) ? args[i] : 0);
+    sn_vbase = sn_sp;
+    if (type == 0xC0)
+    {   for (i=argc; i>0; i--) sn_push(args[i-1]);
+        sn_push(argc);
+    }
+    sn_pc = p + 2;
+}
+
+/*  Pushes a call stub for a value going to the store operand given.         */
+
+static void sn_push_stub(int mode, uint32 raw)
+{   uint32 type = 0;
+    switch (mode)
+    {   case 0: type = 0; break;
+        case 5: case 6: case 7: type = 1; break;
+        case 9: case 10: case 11: type = 2; break;
+        case 8: type = 3; break;
+        case 13: case 14: case 15: type = 1; raw += sn_ramstart; break;
+        default: sn_abandon("bad store operand"); return;
+    }
+    sn_push(type); sn_push(raw); sn_push(sn_pc); sn_push(sn_fp);
+}
+
+/*  Pops the call stub on top of the stack and sends v where it says.        */
+
+static void sn_pop_stub(uint32 v)
+{   uint32 type, dest, *l;
+    if (sn_sp < 4) { sn_abandon("stack underflow"); return; }
+    sn_fp = sn_stack[--sn_sp];
+    sn_pc = sn_stack[--sn_sp];
+    dest = sn_stack[--sn_sp];
+    type = sn_stack[--sn_sp];
+    if (type == SN_FINISHED) { sn_finished = TRUE; return; }
+    if ((sn_fp >= sn_sp) || (sn_stack[sn_fp] >= sn_sp - sn_fp))
+    {   sn_abandon("corrupt call stub"); return;
+    }
+    sn_vbase = sn_fp + 1 + sn_stack[sn_fp];
+    switch (type)
+    {   case 0: break;
+        case 1: sn_write(dest, 4, v); break;
+        case 2: l = sn_local(dest); if (l) *l = v; break;
+        case 3: sn_push(v); break;
+        default: sn_abandon("string-printing call stub"); break;
+    }
+}
+
+static void sn_return(uint32 v)
+{   sn_sp = sn_fp;
+    sn_pop_stub(v);
+}
+
+static void sn_branch(uint32 offset)
+{   if ((offset == 0) || (offset == 1)) sn_return(offset);
+    else sn_pc += offset - 2;
+}
+
+static void sn_call(uint32 addr, uint32 argc, uint32 *args,
+    glulx_operand *S)
+{   sn_push_stub(S->mode, S->value);
+    if (!sn_failed) sn_enter(addr, argc, args);
+}
+
+/*  The three search opcodes, as the Glulx specification has them.           */
+
+static int sn_key_matches(uint32 key, uint32 keysize, uint32 options,
+    uint32 at)
+{   uint32 i;
+    if (options & 1)
+    {   for (i=0; i<keysize; i++)
+            if (sn_read(key+i, 1) != sn_read(at+i, 1)) return FALSE;
+        return TRUE;
+    }
+    if (keysize < 4) key &= (1L << (8*keysize)) - 1;
+    return (sn_read(at, keysize) == key);
+}
+
+static int sn_key_is_zero(uint32 keysize, uint32 at)
+{   uint32 i;
+    for (i=0; i<keysize; i++) if (sn_read(at+i, 1)) return FALSE;
+    return TRUE;
+}
+
+static int sn_key_compare(uint32 key, uint32 keysize, uint32 options,
+    uint32 at)
+{   uint32 i, a, b;
+    for (i=0; i<keysize; i++)
+    {   a = (options & 1) ? sn_read(key+i, 1)
+            : (key >> (8*(keysize-1-i))) & 0xFF;
+        b = sn_read(at+i, 1);
+        if (a != b) return (a < b) ? -1 : 1;
+    }
+    return 0;
+}
+
+static uint32 sn_search(int32 code, uint32 *a)
+{   uint32 key = a[0], keysize = a[1], start = a[2], structsize, n, keyoff,
+        options, i, lo, hi, at;
+    int c;
+    if (code == 0x152)
+    {   keyoff = a[3]; options = a[5];
+        if ((keysize == 0) || ((!(options & 1)) && (keysize > 4)))
+        {   sn_abandon("bad key size"); return 0;
+        }
+        for (at = start; at && !sn_failed; at = sn_read(at + a[4], 4))
+        {   if (sn_key_matches(key, keysize, options, at + keyoff)) return at;
+            if ((options & 2) && sn_key_is_zero(keysize, at + keyoff)) break;
+        }
+        return 0;
+    }
+    structsize = a[3]; n = a[4]; keyoff = a[5]; options = a[6];
+    if ((keysize == 0) || ((!(options & 1)) && (keysize > 4)))
+    {   sn_abandon("bad key size"); return 0;
+    }
+    if (code == 0x150)
+    {   for (i=0; (n == 0xFFFFFFFF) || (i < n); i++)
+        {   at = start + i*structsize;
+            if (sn_failed) return 0;
+            if (sn_key_matches(key, keysize, options, at + keyoff))
+                return (options & 4) ? i : at;
+            if ((options & 2) && sn_key_is_zero(keysize, at + keyoff)) break;
+        }
+        return (options & 4) ? 0xFFFFFFFF : 0;
+    }
+    lo = 0; hi = n;
+    while ((lo < hi) && !sn_failed)
+    {   i = (lo + hi)/2;
+        at = start + i*structsize;
+        c = sn_key_compare(key, keysize, options, at + keyoff);
+        if (c == 0) return (options & 4) ? i : at;
+        if (c < 0) hi = i; else lo = i + 1;
+    }
+    return (options & 4) ? 0xFFFFFFFF : 0;
+}
+
+/*  Executes one instruction.                                                */
+
+static void sn_step(void)
+{   int32 code, next;
+    int i, width = 4;
+    glulx_instruction gi;
+    glulx_operand *ops = gi.ops;
+    uint32 a[8], v, b, *args = NULL;
+    char *problem;
+
+    sn_start = sn_pc;
+    next = decode_glulx_instruction(sn_mem, sn_endmem, sn_pc, &gi, &problem);
+    if (next < 0) { sn_abandon(problem); return; }
+    sn_pc = next;
+    code = gi.code;
+    if ((code == 0x41) || (code == 0x42)) width = (code == 0x41) ? 2 : 1;
+
+    for (i=0; i<gi.no; i++)
+    {   if (ops[i].kind != 'S')
+            a[i] = sn_load(ops[i].mode, ops[i].value, width);
+        if (sn_failed) return;
+    }
+
+    #define SN_S(n) sn_store(ops[n].mode, ops[n].value, v, width)
+
+    switch (code)
+    {   case 0x00: return;
+        case 0x10: v = a[0] + a[1]; SN_S(2); return;
+        case 0x11: v = a[0] - a[1]; SN_S(2); return;
+        case 0x12: v = a[0] * a[1]; SN_S(2); return;
+        case 0x13: case 0x14:
+            if (a[1] == 0) { sn_abandon("division by zero"); return; }
+            if (a[1] == 0xFFFFFFFF) v = (code == 0x13) ? 0 - a[0] : 0;
+            else if (code == 0x13) v = (int32) a[0] / (int32) a[1];
+            else v = (int32) a[0] % (int32) a[1];
+            SN_S(2); return;
+        case 0x15: v = 0 - a[0]; SN_S(1); return;
+        case 0x18: v = a[0] & a[1]; SN_S(2); return;
+        case 0x19: v = a[0] | a[1]; SN_S(2); return;
+        case 0x1A: v = a[0] ^ a[1]; SN_S(2); return;
+        case 0x1B: v = ~a[0]; SN_S(1); return;
+        case 0x1C: v = (a[1] >= 32) ? 0 : (a[0] << a[1]); SN_S(2); return;
+        case 0x1D:
+            if (a[1] >= 32) v = (a[0] & 0x80000000) ? 0xFFFFFFFF : 0;
+            else if (a[0] & 0x80000000) v = ~((~a[0]) >> a[1]);
+            else v = a[0] >> a[1];
+            SN_S(2); return;
+        case 0x1E: v = (a[1] >= 32) ? 0 : (a[0] >> a[1]); SN_S(2); return;
+        case 0x20: sn_branch(a[0]); return;
+        case 0x22: if (a[0] == 0) sn_branch(a[1]); return;
+        case 0x23: if (a[0] != 0) sn_branch(a[1]); return;
+        case 0x24: if (a[0] == a[1]) sn_branch(a[2]); return;
+        case 0x25: if (a[0] != a[1]) sn_branch(a[2]); return;
+        case 0x26: if ((int32) a[0] < (int32) a[1]) sn_branch(a[2]); return;
+        case 0x27: if ((int32) a[0] >= (int32) a[1]) sn_branch(a[2]); return;
+        case 0x28: if ((int32) a[0] > (int32) a[1]) sn_branch(a[2]); return;
+        case 0x29: if ((int32) a[0] <= (int32) a[1]) sn_branch(a[2]); return;
+        case 0x2A: if (a[0] < a[1]) sn_branch(a[2]); return;
+        case 0x2B: if (a[0] >= a[1]) sn_branch(a[2]); return;
+        case 0x2C: if (a[0] > a[1]) sn_branch(a[2]); return;
+        case 0x2D: if (a[0] <= a[1]) sn_branch(a[2]); return;
+        case 0x104: sn_pc = a[0]; return;
+
+        case 0x30: case 0x34:
+            args = my_calloc(sizeof(uint32), a[1] + 1, "snapshot arguments");
+            for (b=0; (b<a[1]) && !sn_failed; b++) args[b] = sn_pop();
+            if (!sn_failed)
+            {   if (code == 0x30) sn_call(a[0], a[1], args, &ops[2]);
+                else { sn_sp = sn_fp; sn_enter(a[0], a[1], args); }
+            }
+            my_free(&args, "snapshot arguments");
+            return;
+        case 0x160: sn_call(a[0], 0, a+1, &ops[1]); return;
+        case 0x161: sn_call(a[0], 1, a+1, &ops[2]); return;
+        case 0x162: sn_call(a[0], 2, a+1, &ops[3]); return;
+        case 0x163: sn_call(a[0], 3, a+1, &ops[4]); return;
+        case 0x31: sn_return(a[0]); return;
+        case 0x32:
+            sn_push_stub(ops[0].mode, ops[0].value);
+            v = 4*sn_sp; SN_S(0);
+            sn_branch(a[1]);
+            return;
+        case 0x33:
+            if ((a[1] % 4) || (a[1]/4 > sn_sp) || (a[1] < 16))
+            {   sn_abandon("bad catch token"); return;
+            }
+            sn_sp = a[1]/4;
+            sn_pop_stub(a[0]);
+            return;
+
+        case 0x40: case 0x41: case 0x42: v = a[0]; SN_S(1); return;
+        case 0x44: v = (a[0] & 0x8000) ? (a[0] | 0xFFFF0000)
+                                       : (a[0] & 0xFFFF); SN_S(1); return;
+        case 0x45: v = (a[0] & 0x80) ? (a[0] | 0xFFFFFF00)
+                                     : (a[0] & 0xFF); SN_S(1); return;
+        case 0x48: v = sn_read(a[0] + 4*a[1], 4); SN_S(2); return;
+        case 0x49: v = sn_read(a[0] + 2*a[1], 2); SN_S(2); return;
+        case 0x4A: v = sn_read(a[0] + a[1], 1); SN_S(2); return;
+        case 0x4B:
+            v = (sn_read(a[0] + ((int32) a[1] >> 3), 1) >> (a[1] & 7)) & 1;
+            SN_S(2); return;
+        case 0x4C: sn_write(a[0] + 4*a[1], 4, a[2]); return;
+        case 0x4D: sn_write(a[0] + 2*a[1], 2, a[2]); return;
+        case 0x4E: sn_write(a[0] + a[1], 1, a[2]); return;
+        case 0x4F:
+            b = a[0] + ((int32) a[1] >> 3);
+            v = sn_read(b, 1);
+            if (a[2]) v |= 1 << (a[1] & 7); else v &= ~(1 << (a[1] & 7));
+            sn_write(b, 1, v);
+            return;
+
+        case 0x50: v = sn_sp - sn_vbase; SN_S(0); return;
+        case 0x51:
+            if (a[0] >= sn_sp - sn_vbase)
+            {   sn_abandon("stack underflow"); return;
+            }
+            v = sn_stack[sn_sp - 1 - a[0]]; SN_S(1); return;
+        case 0x52:
+            if (sn_sp - sn_vbase < 2)
+            {   sn_abandon("stack underflow"); return;
+            }
+            v = sn_stack[sn_sp-1];
+            sn_stack[sn_sp-1] = sn_stack[sn_sp-2]; sn_stack[sn_sp-2] = v;
+            return;
+        case 0x53:
+            if (a[0] > sn_sp - sn_vbase)
+            {   sn_abandon("stack underflow"); return;
+            }
+            if (a[0] == 0) return;
+            b = (int32) a[1] % (int32) a[0];
+            if ((int32) b < 0) b += a[0];
+            args = my_calloc(sizeof(uint32), a[0], "snapshot arguments");
+            for (v=0; v<a[0]; v++)
+                args[(v + b) % a[0]] = sn_stack[sn_sp - a[0] + v];
+            for (v=0; v<a[0]; v++) sn_stack[sn_sp - a[0] + v] = args[v];
+            my_free(&args, "snapshot arguments");
+            return;
+        case 0x54:
+            if (a[0] > sn_sp - sn_vbase)
+            {   sn_abandon("stack underflow"); return;
+            }
+            b = sn_sp - a[0];
+            for (v=0; (v<a[0]) && !sn_failed; v++) sn_push(sn_stack[b+v]);
+            return;
+
+        case 0x102: v = sn_endmem; SN_S(0); return;
+        case 0x140: v = sn_stringtbl; SN_S(0); return;
+        case 0x150: case 0x151: case 0x152:
+            v = sn_search(code, a); SN_S(gi.no - 1); return;
+        case 0x170:
+            for (b=0; (b<a[0]) && !sn_failed; b++) sn_write(a[1]+b, 1, 0);
+            return;
+        case 0x171:
+            if (a[2] < a[1])
+                for (b=0; (b<a[0]) && !sn_failed; b++)
+                    sn_write(a[2]+b, 1, sn_read(a[1]+b, 1));
+            else
+                for (b=a[0]; (b>0) && !sn_failed; b--)
+                    sn_write(a[2]+b-1, 1, sn_read(a[1]+b-1, 1));
+            return;
+    }
+
+    #undef SN_S
+
+    {   char buff[64];
+        sprintf(buff, "the opcode @%.40s", gi.name);
+        sn_abandon(buff);
+    }
+}
+
+/*  Calls the function at func_addr in a copy of the story file image. If it
+    returns, the RAM it leaves behind is copied back into image[] and TRUE
+    is returned.                                                             */
+
+extern int run_snapshot_init(uchar *image, int32 length, int32 func_addr)
+{   long steps = 0;
+    int32 i;
+
+    sn_endmem = (image[16] << 24) | (image[17] << 16) | (image[18] << 8)
+        | image[19];
+    if (sn_endmem < (uint32) length) sn_endmem = length;
+    sn_mem = my_calloc(sizeof(uchar), sn_endmem, "snapshot memory");
+    memcpy(sn_mem, image, length);
+    sn_ramstart = sn_read(8, 4);
+    sn_stringtbl = sn_read(28, 4);
+    sn_stacksize = sn_read(20, 4)/4;
+    sn_stack = my_calloc(sizeof(uint32), sn_stacksize + 1, "snapshot stack");
+    sn_sp = sn_fp = sn_vbase = 0;
+    sn_failed = FALSE; sn_finished = FALSE;
+    sn_start = func_addr;
+
+    sn_push(SN_FINISHED); sn_push(0); sn_push(0); sn_push(0);
+    sn_enter(func_addr, 0, NULL);
+    while (!sn_failed && !sn_finished)
+    {   if (++steps > SN_STEP_LIMIT)
+        {   sn_abandon("too many instructions"); break;
+        }
+        sn_step();
+    }
+
+    if (!sn_failed)
+        for (i=length; i<(int32) sn_endmem; i++)
+            if (sn_mem[i])
+            {   sn_start = i;
+                sn_abandon("memory written beyond the end of the story file");
+                break;
+            }
+    if (!sn_failed)
+        memcpy(image + sn_ramstart, sn_mem + sn_ramstart,
+            length - sn_ramstart);
+
+    my_free(&sn_stack, "snapshot stack");
+    my_free(&sn_mem, "snapshot memory");
+    return !sn_failed;
+}
@@ -796,9 +796,190 @@ static int parse_named_label_statements()
     return TRUE;
 }
 
+/* ------------------------------------------------------------------------- */
+/*   Rotated loops ($ROTATE_LOOPS): the condition is compiled twice, once   */
+/*   as a test on entry and once at the bottom of the loop, where it        */
+/*   branches back to the top while it holds.                               */
+/*   Conditions which make calls or hold string literals are left alone,    */
+/*   as compiling them twice would cost more than the jump it saves.        */
+/* ------------------------------------------------------------------------- */
+
+static int loop_test_tree_is_simple(int n)
+{   int i;
+    if (ET[n].down == -1)
+        return (ET[n].value.marker != STRING_MV);
+    switch(ET[n].operator_number)
+    {   case FCALL_OP: case MESSAGE_OP:
+        case PROP_CALL_OP: case MESSAGE_CALL_OP:
+            return FALSE;
+    }
+    for (i = ET[n].down; i != -1; i = ET[i].right)
+        if (!loop_test_tree_is_simple(i)) return FALSE;
+    return TRUE;
+}
+
+/*  Should the (parsed, not yet compiled) loop condition AO be rotated?      */
+
+static int loop_test_rotates(assembly_operand AO)
+{   if (!ROTATE_LOOPS || !test_for_negatable(AO)) return FALSE;
+    if (AO.type != EXPRESSION_OT) return TRUE;
+    return loop_test_tree_is_simple(AO.value);
+}
+
+static void generate_loop_test(assembly_operand AO,
+    expression_tree_node *saved, int count, int label)
+{
+    AO = negate_expression(restore_expression(AO, saved, count));
+
+    /*  Anything worth reporting was reported the first time round  */
+    suppress_repeat_messages = TRUE;
+    code_generate(AO, CONDITION_CONTEXT, label);
+    suppress_repeat_messages = FALSE;
+}
+
+/*  In Z-code, if the update of a rotated "for" loop is "v++" or "v--" (flag
+    being as returned by test_for_incdec()) and the condition compares v
+    with a limit, then the update and the condition can be compiled as a
+    single @inc_chk or @dec_chk.  These branch when the new value of v is
+    greater than (resp. less than) their second operand, so the loop goes
+    on when they fail:
+
+        v <= x  is  @inc_chk v x ?~top      v < K  is  @inc_chk v K-1 ?~top
+        v >= x  is  @dec_chk v x ?~top      v > K  is  @dec_chk v K+1 ?~top
+
+    where K must be a constant known now.  Returns TRUE and sets *limit to
+    the second operand if the condition is of this form.                     */
+
+static int fused_loop_limit(assembly_operand AO, int flag,
+    assembly_operand *limit)
+{   int n, v1, v2; int32 k;
+
+    if ((flag == 0) || (AO.type != EXPRESSION_OT)) return FALSE;
+    n = AO.value;
+    v1 = ET[n].down;
+    if (v1 == -1) return FALSE;
+    v2 = ET[v1].right;
+    if ((v2 == -1) || (ET[v2].right != -1)) return FALSE;
+    if ((ET[v1].down != -1) || (ET[v2].down != -1)) return FALSE;
+
+    if (!is_variable_ot(ET[v1].value.type)) return FALSE;
+    if (ET[v1].value.value != ((flag > 0)?flag:-flag)) return FALSE;
+
+    *limit = ET[v2].value;
+    if (is_variable_ot(limit->type))
+    {   if (limit->value == 0) return FALSE;
+    }
+    else if (!is_constant_ot(limit->type)) return FALSE;
+
+    switch(ET[n].operator_number)
+    {   case LE_OP: return (flag > 0);
+        case GE_OP: return (flag < 0);
+        case LESS_OP: if (flag < 0) return FALSE; k = -1; break;
+        case GREATER_OP: if (flag > 0) return FALSE; k = 1; break;
+        default: return FALSE;
+    }
+
+    if (!is_constant_ot(limit->type) || (limit->marker != 0)) return FALSE;
+    k += (limit->value & 0x8000)?((limit->value & 0xFFFF) - 0x10000)
+                                :(limit->value & 0xFFFF);
+    if ((k < -0x8000) || (k > 0x7FFF)) return FALSE;
+    limit->value = k & 0xFFFF;
+    set_constant_ot(limit);
+    return TRUE;
+}
+
+/* ------------------------------------------------------------------------- */
+/*   Fused "give" ($GLULX_FUSE_ATTRIBUTES): the constant attributes in a    */
+/*   Glulx "give" are held back until something else must be compiled,    */
+/*   and then those whose bits share a unit of the object record (see      */
+/*   attribute_unit_g()) are written by one read-modify-write.              */
+/* ------------------------------------------------------------------------- */
+
+#define MAX_GIVE_ATTRIBUTES 32
+
+static int no_give_attributes;
+static int32 give_attribute[MAX_GIVE_ATTRIBUTES];
+static int give_attribute_set[MAX_GIVE_ATTRIBUTES];
+
+static void give_attribute_bit_g(assembly_operand AO, int32 attr, int set)
+{   assembly_operand AO2;
+    INITAO(&AO2);
+    AO2.value = attr + 8;
+    set_constant_ot(&AO2);
+    assembleg_3(astorebit_gc, AO, AO2, (set) ? one_operand : zero_operand);
+}
+
+/*  A unit with s attributes to set and c to clear takes 2, 3 or 4
+    instructions (load, or, and, store), against s+c @astorebits; it is
+    written as a whole only when that is no more.                            */
+
+static void give_held_attributes_g(assembly_operand AO)
+{   int i, j, width, count, done[MAX_GIVE_ATTRIBUTES];
+    int32 index, lo, hi, word;
+    uint32 set_bits, clear_bits, bit;
+    assembly_operand AO2, AO3;
+
+    for (i=0; i<no_give_attributes; i++) done[i] = FALSE;
+    for (i=0; i<no_give_attributes; i++)
+    {   if (done[i]) continue;
+        word = (1 + give_attribute[i]/8)/4;
+        lo = hi = give_attribute[i];
+        for (j=i; j<no_give_attributes; j++)
+            if ((!done[j]) && ((1 + give_attribute[j]/8)/4 == word))
+            {   if (give_attribute[j] < lo) lo = give_attribute[j];
+                if (give_attribute[j] > hi) hi = give_attribute[j];
+            }
+        attribute_unit_g(lo, hi, &width, &index);
+
+        set_bits = 0; clear_bits = 0; count = 0;
+        for (j=i; j<no_give_attributes; j++)
+            if ((!done[j]) && ((1 + give_attribute[j]/8)/4 == word))
+            {   bit = attribute_unit_bit_g(give_attribute[j], width, index);
+                if (((set_bits | clear_bits) & bit) == 0) count++;
+                if (give_attribute_set[j])
+                {   set_bits |= bit; clear_bits &= ~bit; }
+                else
+                {   clear_bits |= bit; set_bits &= ~bit; }
+            }
+
+        if (2 + (set_bits != 0) + (clear_bits != 0) > count)
+        {   for (j=i; j<no_give_attributes; j++)
+                if ((!done[j]) && ((1 + give_attribute[j]/8)/4 == word))
+                {   give_attribute_bit_g(AO, give_attribute[j],
+                        give_attribute_set[j]);
+                    done[j] = TRUE;
+                }
+            continue;
+        }
+
+        INITAO(&AO2);
+        AO2.value = index;
+        set_constant_ot(&AO2);
+        assembleg_3((width == 1) ? aloadb_gc : ((width == 2) ? aloads_gc
+            : aload_gc), AO, AO2, stack_pointer);
+        INITAO(&AO3);
+        if (set_bits)
+        {   AO3.value = (int32) set_bits;
+            set_constant_ot(&AO3);
+            assembleg_3(bitor_gc, stack_pointer, AO3, stack_pointer);
+        }
+        if (clear_bits)
+        {   AO3.value = (int32) ((~clear_bits)
+                & (0xFFFFFFFFu >> (32 - 8*width)));
+            set_constant_ot(&AO3);
+            assembleg_3(bitand_gc, stack_pointer, AO3, stack_pointer);
+        }
+        assembleg_3((width == 1) ? astoreb_gc : ((width == 2) ? astores_gc
+            : astore_gc), AO, AO2, stack_pointer);
+        for (j=i; j<no_give_attributes; j++)
+            if ((1 + give_attribute[j]/8)/4 == word) done[j] = TRUE;
+    }
+    no_give_attributes = 0;
+}
+
 static void parse_statement_z(int break_label, int continue_label)
 {   int ln, ln2, ln3, ln4, flag;
-    int pre_unreach, labelexists;
+    int pre_unreach, labelexists, cold;
     assembly_operand AO, AO2, AO3, AO4;
     debug_location spare_debug_location1, spare_debug_location2;
 
@@ -1048,6 +1229,60 @@ static void parse_statement_z(int break_label, int continue_label)
                  ln2 = next_label++;
                  ln3 = next_label++;
 
+                 if (loop_test_rotates(AO))
+                 {   expression_tree_node *saved_AO = NULL, *saved_AO2 = NULL;
+                     int AO_count = 0, AO2_count = 0;
+                     int fused = fused_loop_limit(AO, flag, &AO4);
+
+                     if (!fused) saved_AO = save_expression(AO, &AO_count);
+                     if (flag == 0)
+                         saved_AO2 = save_expression(AO2, &AO2_count);
+
+                     /*  Test on entry  */
+
+                     sequence_point_follows = TRUE;
+                     statement_debug_location = spare_debug_location1;
+                     code_generate(AO, CONDITION_CONTEXT, ln3);
+
+                     /*  The loop body, with "continue" going to the update  */
+
+                     assemble_label_no(ln);
+                     parse_code_block(ln3, ln2, 0);
+                     assemble_label_no(ln2);
+
+                     sequence_point_follows = TRUE;
+                     statement_debug_location = spare_debug_location2;
+                     if (fused)
+                     {   INITAOTV(&AO3, SHORT_CONSTANT_OT,
+                             (flag > 0)?flag:-flag);
+                         assemblez_2_branch((flag>0)?inc_chk_zc:dec_chk_zc,
+                             AO3, AO4, ln, FALSE);
+                     }
+                     else
+                     {   if (flag > 0)
+                         {   INITAOTV(&AO3, SHORT_CONSTANT_OT, flag);
+                             assemblez_1(inc_zc, AO3);
+                         }
+                         else if (flag < 0)
+                         {   INITAOTV(&AO3, SHORT_CONSTANT_OT, -flag);
+                             assemblez_1(dec_zc, AO3);
+                         }
+                         else if (AO2.type != OMITTED_OT)
+                             code_generate(
+                                 restore_expression(AO2, saved_AO2, AO2_count),
+                                 VOID_CONTEXT, -1);
+
+                         /*  The "finished yet?" condition, reversed  */
+
+                         sequence_point_follows = TRUE;
+                         statement_debug_location = spare_debug_location1;
+                         generate_loop_test(AO, saved_AO, AO_count, ln);
+                     }
+
+                     assemble_forward_label_no(ln3);
+                     return;
+                 }
+
                  if ((AO2.type == OMITTED_OT) || (flag != 0))
                  {
                      assemble_label_no(ln);
@@ -1193,6 +1428,7 @@ static void parse_statement_z(int break_label, int continue_label)
 
                  /* The condition */
                  code_generate(AO, CONDITION_CONTEXT, ln);
+                 cold = (ln >= 0) ? begin_cold_block() : -1;
 
                  if (!pre_unreach && ln >= 0 && execution_never_reaches_here) {
                      /* If the condition never falls through to here, then
@@ -1234,6 +1470,10 @@ static void parse_statement_z(int break_label, int continue_label)
                  }
                  else put_token_back();
 
+                 /* An "if" block with no "else" which leaves the routine
+                    is taken to be rarely run, e.g. an early return       */
+                 if (!flag) end_cold_block(cold, TRUE);
+
                  /* The "else" label (or end of statement, if there is no "else") */
                  labelexists = FALSE;
                  if (ln >= 0) labelexists = assemble_forward_label_no(ln);
@@ -1581,8 +1821,9 @@ static void parse_statement_z(int break_label, int continue_label)
                  if ((token_type == SEP_TT) && (token_value == SEMICOLON_SEP))
                  {   assemblez_0(rtrue_zc); return; }
                  put_token_back();
-                 AO = code_generate(parse_expression(RETURN_Q_CONTEXT),
-                     QUANTITY_CONTEXT, -1);
+                 AO = parse_expression(RETURN_Q_CONTEXT);
+                 note_return_expression(AO);
+                 AO = code_generate(AO, QUANTITY_CONTEXT, -1);
                  if ((AO.type == SHORT_CONSTANT_OT) && (AO.value == 0)
                      && (AO.marker == 0))
                  {   assemblez_0(rfalse_zc); break; }
@@ -1723,6 +1964,7 @@ static void parse_statement_z(int break_label, int continue_label)
 
                  INITAOTV(&AO2, VARIABLE_OT, globalv_z_temp_var1);
                  assemblez_store(AO2, AO);
+                 switch_operand = AO2;
 
                  parse_code_block(ln = next_label++, continue_label, 1);
                  assemble_forward_label_no(ln);
@@ -1733,13 +1975,36 @@ static void parse_statement_z(int break_label, int continue_label)
     /*  -------------------------------------------------------------------- */
 
         case WHILE_CODE:
-                 assemble_label_no(ln = next_label++);
                  match_open_bracket();
-
-                 code_generate(parse_expression(CONDITION_CONTEXT),
-                     CONDITION_CONTEXT, ln2 = next_label++);
+                 get_next_token(); put_token_back();
+                 spare_debug_location1 = get_token_location();
+                 AO = parse_expression(CONDITION_CONTEXT);
                  match_close_bracket();
 
+                 if (loop_test_rotates(AO))
+                 {   expression_tree_node *saved_AO;
+                     int AO_count;
+
+                     ln = next_label++;
+                     ln2 = next_label++;
+                     ln3 = next_label++;
+                     saved_AO = save_expression(AO, &AO_count);
+
+                     code_generate(AO, CONDITION_CONTEXT, ln2);
+                     assemble_label_no(ln);
+                     parse_code_block(ln2, ln3, 0);
+                     assemble_label_no(ln3);
+
+                     sequence_point_follows = TRUE;
+                     statement_debug_location = spare_debug_location1;
+                     generate_loop_test(AO, saved_AO, AO_count, ln);
+                     assemble_forward_label_no(ln2);
+                     return;
+                 }
+
+                 assemble_label_no(ln = next_label++);
+                 code_generate(AO, CONDITION_CONTEXT, ln2 = next_label++);
+
                  parse_code_block(ln2, ln, 0);
                  sequence_point_follows = FALSE;
                  assemblez_jump(ln);
@@ -1768,7 +2033,7 @@ static void parse_statement_z(int break_label, int continue_label)
 
 static void parse_statement_g(int break_label, int continue_label)
 {   int ln, ln2, ln3, ln4, flag, onstack;
-    int pre_unreach, labelexists;
+    int pre_unreach, labelexists, cold;
     assembly_operand AO, AO2, AO3, AO4;
     debug_location spare_debug_location1, spare_debug_location2;
 
@@ -1997,6 +2262,55 @@ static void parse_statement_g(int break_label, int continue_label)
                  ln2 = next_label++;
                  ln3 = next_label++;
 
+                 if (loop_test_rotates(AO))
+                 {   expression_tree_node *saved_AO, *saved_AO2 = NULL;
+                     int AO_count, AO2_count = 0;
+
+                     saved_AO = save_expression(AO, &AO_count);
+                     if (flag == 0)
+                         saved_AO2 = save_expression(AO2, &AO2_count);
+
+                     /*  Test on entry  */
+
+                     sequence_point_follows = TRUE;
+                     statement_debug_location = spare_debug_location1;
+                     code_generate(AO, CONDITION_CONTEXT, ln3);
+
+                     /*  The loop body, with "continue" going to the update  */
+
+                     assemble_label_no(ln);
+                     parse_code_block(ln3, ln2, 0);
+                     assemble_label_no(ln2);
+
+                     sequence_point_follows = TRUE;
+                     statement_debug_location = spare_debug_location2;
+                     if (flag != 0)
+                     {   INITAO(&AO3);
+                         AO3.value = (flag > 0)?flag:-flag;
+                         if (AO3.value >= MAX_LOCAL_VARIABLES)
+                           AO3.type = GLOBALVAR_OT;
+                         else
+                           AO3.type = LOCALVAR_OT;
+                         assembleg_3((flag > 0)?add_gc:sub_gc,
+                             AO3, one_operand, AO3);
+                     }
+                     else if (AO2.type != OMITTED_OT)
+                         code_generate(
+                             restore_expression(AO2, saved_AO2, AO2_count),
+                             VOID_CONTEXT, -1);
+
+                     /*  The "finished yet?" condition, reversed, which
+                         compiles to a single compare-and-branch for the
+                         usual counting loop  */
+
+                     sequence_point_follows = TRUE;
+                     statement_debug_location = spare_debug_location1;
+                     generate_loop_test(AO, saved_AO, AO_count, ln);
+
+                     assemble_forward_label_no(ln3);
+                     return;
+                 }
+
                  if ((AO2.type == OMITTED_OT) || (flag != 0))
                  {
                      assemble_label_no(ln);
@@ -2099,6 +2413,8 @@ static void parse_statement_g(int break_label, int continue_label)
                  {   get_next_token();
                      if ((token_type == SEP_TT) 
                        && (token_value == SEMICOLON_SEP)) {
+                         if (no_give_attributes > 0)
+                           give_held_attributes_g(AO);
                          if (onstack) {
                            assembleg_2(copy_gc, stack_pointer, zero_operand);
                          }
@@ -2113,6 +2429,17 @@ static void parse_statement_g(int break_label, int continue_label)
                      AO2 = code_generate(parse_expression(QUANTITY_CONTEXT),
                                QUANTITY_CONTEXT, -1);
                      check_warn_symbol_type(&AO2, ATTRIBUTE_T, 0, "\"give\" statement");
+                     if (GLULX_FUSE_ATTRIBUTES && (!onstack)
+                         && (!runtime_error_checking_switch || veneer_mode)
+                         && is_constant_ot(AO2.type) && (AO2.marker == 0)
+                         && (AO2.value >= 0)
+                         && (AO2.value < NUM_ATTR_BYTES*8)
+                         && (no_give_attributes < MAX_GIVE_ATTRIBUTES))
+                     {   give_attribute[no_give_attributes] = AO2.value;
+                         give_attribute_set[no_give_attributes++] = ln;
+                         continue;
+                     }
+                     if (no_give_attributes > 0) give_held_attributes_g(AO);
                      if (runtime_error_checking_switch && (!veneer_mode))
                      {   ln2 = (ln ? RT__ChG_VR : RT__ChGt_VR);
                          if ((AO2.type == LOCALVAR_OT) && (AO2.value == 0)) {
@@ -2181,6 +2508,7 @@ static void parse_statement_g(int break_label, int continue_label)
 
                  /* The condition */
                  code_generate(AO, CONDITION_CONTEXT, ln);
+                 cold = (ln >= 0) ? begin_cold_block() : -1;
 
                  if (!pre_unreach && ln >= 0 && execution_never_reaches_here) {
                      /* If the condition never falls through to here, then
@@ -2222,6 +2550,10 @@ static void parse_statement_g(int break_label, int continue_label)
                  }
                  else put_token_back();
 
+                 /* An "if" block with no "else" which leaves the routine
+                    is taken to be rarely run, e.g. an early return       */
+                 if (!flag) end_cold_block(cold, TRUE);
+
                  /* The "else" label (or end of statement, if there is no "else") */
                  labelexists = FALSE;
                  if (ln >= 0) labelexists = assemble_forward_label_no(ln);
@@ -2550,8 +2882,9 @@ static void parse_statement_g(int break_label, int continue_label)
             return; 
           }
           put_token_back();
-          AO = code_generate(parse_expression(RETURN_Q_CONTEXT),
-            QUANTITY_CONTEXT, -1);
+          AO = parse_expression(RETURN_Q_CONTEXT);
+          note_return_expression(AO);
+          AO = code_generate(AO, QUANTITY_CONTEXT, -1);
           assembleg_1(return_gc, AO);
           break;
 
@@ -2684,7 +3017,13 @@ static void parse_statement_g(int break_label, int continue_label)
                      QUANTITY_CONTEXT, -1);
                  match_close_bracket();
 
-                 assembleg_store(temp_var1, AO); 
+                 /*  The cases test the value where it is if it cannot
+                     change meanwhile, or else a copy of it              */
+                 if (reusable_operand_g(AO)) switch_operand = AO;
+                 else
+                 {   assembleg_store(temp_var1, AO);
+                     switch_operand = temp_var1;
+                 }
 
                  parse_code_block(ln = next_label++, continue_label, 1);
                  assemble_forward_label_no(ln);
@@ -2695,13 +3034,36 @@ static void parse_statement_g(int break_label, int continue_label)
     /*  -------------------------------------------------------------------- */
 
         case WHILE_CODE:
-                 assemble_label_no(ln = next_label++);
                  match_open_bracket();
-
-                 code_generate(parse_expression(CONDITION_CONTEXT),
-                     CONDITION_CONTEXT, ln2 = next_label++);
+                 get_next_token(); put_token_back();
+                 spare_debug_location1 = get_token_location();
+                 AO = parse_expression(CONDITION_CONTEXT);
                  match_close_bracket();
 
+                 if (loop_test_rotates(AO))
+                 {   expression_tree_node *saved_AO;
+                     int AO_count;
+
+                     ln = next_label++;
+                     ln2 = next_label++;
+                     ln3 = next_label++;
+                     saved_AO = save_expression(AO, &AO_count);
+
+                     code_generate(AO, CONDITION_CONTEXT, ln2);
+                     assemble_label_no(ln);
+                     parse_code_block(ln2, ln3, 0);
+                     assemble_label_no(ln3);
+
+                     sequence_point_follows = TRUE;
+                     statement_debug_location = spare_debug_location1;
+                     generate_loop_test(AO, saved_AO, AO_count, ln);
+                     assemble_forward_label_no(ln2);
+                     return;
+                 }
+
+                 assemble_label_no(ln = next_label++);
+                 code_generate(AO, CONDITION_CONTEXT, ln2 = next_label++);
+
                  parse_code_block(ln2, ln, 0);
                  sequence_point_follows = FALSE;
                  assembleg_jump(ln);
@@ -58,6 +58,9 @@ symboldebuginfo *symbol_debug_info;            /* Allocated up to no_symbols */
 static memory_list symbol_debug_info_memlist;
 static char *temp_symbol_buf;        /* used in write_the_identifier_names() */
 static memory_list temp_symbol_buf_memlist;
+static symbolusage *symbol_usage;  /* Allocated up to no_symbols, and only
+                                      during the analysis pass (see below)  */
+static memory_list symbol_usage_memlist;
 
 /* ------------------------------------------------------------------------- */
 /*   Memory to hold the text of symbol names: note that this memory is       */
@@ -318,6 +321,12 @@ extern int symbol_index(char *p, int hashcode, int *created)
             (&symbol_debug_info[no_symbols].replacement_backpatch_pos);
     }
 
+    if (analysis_pass)
+    {   ensure_memory_list_available(&symbol_usage_memlist, no_symbols+1);
+        symbol_usage[no_symbols].refs = 0;
+        symbol_usage[no_symbols].flags = 0;
+    }
+
     if (track_unused_routines)
         df_note_function_symbol(no_symbols);
     if (created) *created = TRUE;
@@ -868,6 +877,9 @@ static void stockup_symbols(void)
     if (GRAMMAR_META_FLAG)
         create_symbol("GRAMMAR_META_FLAG", 0, CONSTANT_T);
 
+    if (SORT_NAME_PROPERTIES)
+        create_symbol("SORT_NAME_PROPERTIES", 0, CONSTANT_T);
+
     create_symbol("WORDSIZE",        WORDSIZE, CONSTANT_T);
     /* DICT_ENTRY_BYTES must be REDEFINABLE_SFLAG because the Version directive can change it. */
     create_rsymbol("DICT_ENTRY_BYTES", DICT_ENTRY_BYTE_LENGTH, CONSTANT_T);
@@ -887,8 +899,10 @@ static void stockup_symbols(void)
         create_symbol("GOBJFIELD_PARENT",   GOBJFIELD_PARENT(), CONSTANT_T);
         create_symbol("GOBJFIELD_SIBLING",  GOBJFIELD_SIBLING(), CONSTANT_T);
         create_symbol("GOBJFIELD_CHILD",    GOBJFIELD_CHILD(), CONSTANT_T);
-        create_symbol("GOBJ_EXT_START",     1+NUM_ATTR_BYTES+6*WORDSIZE, CONSTANT_T);
-        create_symbol("GOBJ_TOTAL_LENGTH",  1+NUM_ATTR_BYTES+6*WORDSIZE+GLULX_OBJECT_EXT_BYTES, CONSTANT_T);
+        if (GLULX_PREV_SIBLING)
+            create_symbol("GOBJFIELD_PREVSIB", GOBJFIELD_PREVSIB(), CONSTANT_T);
+        create_symbol("GOBJ_EXT_START",     1+NUM_ATTR_BYTES+(GLULX_PREV_SIBLING?7:6)*WORDSIZE, CONSTANT_T);
+        create_symbol("GOBJ_TOTAL_LENGTH",  1+NUM_ATTR_BYTES+(GLULX_PREV_SIBLING?7:6)*WORDSIZE+GLULX_OBJECT_EXT_BYTES, CONSTANT_T);
         create_symbol("INDIV_PROP_START",   INDIV_PROP_START, CONSTANT_T);
     }    
 
@@ -946,6 +960,12 @@ static void stockup_symbols(void)
         create_symbol("sys_statusline_flag",  MAX_LOCAL_VARIABLES+10, 
           GLOBAL_VARIABLE_T);
 
+        /* Set to 1 in the story file if $SNAPSHOT_INIT has run
+           SnapshotInit, so that the game knows not to run it again */
+        if (SNAPSHOT_INIT)
+            create_symbol("sys_snapshot_taken", MAX_LOCAL_VARIABLES+11,
+                GLOBAL_VARIABLE_T);
+
         /* These are created in order, but not necessarily at a fixed
            value. */
         create_symbol("create",        INDIV_PROP_START+0, 
@@ -1053,12 +1073,124 @@ extern int find_symbol_replacement(int *value)
     return changed;
 }
 
+/* ------------------------------------------------------------------------- */
+/*   Symbol usage, as seen by the analysis pass.                             */
+/*                                                                           */
+/*   Some optimisations need to know how a symbol is used throughout the     */
+/*   whole program before its first appearance is compiled. For these, a     */
+/*   silent preliminary pass is run over the same source (see               */
+/*   run_analysis_pass() in "inform.c"), during which symbol_usage[] counts  */
+/*   references and notes flags for each symbol. When that pass ends, the    */
+/*   counts are kept, together with the symbol's name, type and value, in    */
+/*   analysed_symbols[] (sorted by name), where the main pass can find      */
+/*   them. Symbol indices are not stable between the two passes, so the      */
+/*   name is the only key.                                                   */
+/* ------------------------------------------------------------------------- */
+
+analysedsymbol *analysed_symbols = NULL; /* Kept from the analysis pass
+                                            until the end of the main pass;
+                                            not touched by init_symbols_vars() */
+int no_analysed_symbols = 0;
+static char *analysed_symbol_names = NULL;
+
+extern void note_symbol_usage(int symbol)
+{   if (!analysis_pass || symbol < 0 || symbol >= no_symbols) return;
+    symbol_usage[symbol].refs++;
+}
+
+extern void note_symbol_usage_flag(int symbol, unsigned int flag)
+{   if (!analysis_pass || symbol < 0 || symbol >= no_symbols) return;
+    symbol_usage[symbol].flags |= flag;
+}
+
+static int any_global_assigned;     /* An instruction may have written to a
+                                       global chosen at run time           */
+
+extern void note_global_assignment(int32 var)
+{   /*  var is a variable number which an instruction may write to, or
+        -1 if the variable is only known at run time.                       */
+    int symbol;
+    if (!analysis_pass) return;
+    if (var < 0) { any_global_assigned = TRUE; return; }
+    if ((var < MAX_LOCAL_VARIABLES) || (var >= MAX_LOCAL_VARIABLES+no_globals))
+        return;
+    symbol = variables[var].token;
+    if ((symbols[symbol].type == GLOBAL_VARIABLE_T)
+        && (symbols[symbol].value == var))
+        note_symbol_usage_flag(symbol, ASSIGNED_UFLAG);
+}
+
+static int analysed_symbol_compare(const void *ptr1, const void *ptr2)
+{   const analysedsymbol *s1 = ptr1, *s2 = ptr2;
+    return strcmpcis(s1->name, s2->name);
+}
+
+extern void free_symbol_analysis(void)
+{   if (analysed_symbols)
+        my_free(&analysed_symbols, "analysed symbols");
+    if (analysed_symbol_names)
+        my_free(&analysed_symbol_names, "analysed symbol names");
+    no_analysed_symbols = 0;
+}
+
+extern void keep_symbol_analysis(void)
+{   /*  Called at the end of the analysis pass, before its arrays are
+        freed. Symbols which have been removed by Undef are not kept.       */
+
+    int i, n = 0;
+    size_t len = 0;
+    char *p;
+
+    free_symbol_analysis();
+
+    for (i=0; i<no_symbols; i++)
+    {   if (symbols[i].flags & UNHASHED_SFLAG) continue;
+        len += strlen(symbols[i].name)+1;
+        n++;
+    }
+    if (n == 0) return;
+
+    analysed_symbols = my_calloc(sizeof(analysedsymbol), n,
+        "analysed symbols");
+    analysed_symbol_names = my_malloc(len, "analysed symbol names");
+
+    p = analysed_symbol_names;
+    for (i=0; i<no_symbols; i++)
+    {   analysedsymbol *as;
+        if (symbols[i].flags & UNHASHED_SFLAG) continue;
+        as = &analysed_symbols[no_analysed_symbols++];
+        strcpy(p, symbols[i].name);
+        as->name = p;
+        p += strlen(p)+1;
+        as->index = i;
+        as->type = symbols[i].type;
+        as->value = symbols[i].value;
+        as->refs = symbol_usage[i].refs;
+        as->flags = symbol_usage[i].flags;
+        if (any_global_assigned && (symbols[i].type == GLOBAL_VARIABLE_T))
+            as->flags |= ASSIGNED_UFLAG;
+        if (symbols[i].flags & UNKNOWN_SFLAG) as->type = -1;
+    }
+
+    qsort(analysed_symbols, no_analysed_symbols, sizeof(analysedsymbol),
+        analysed_symbol_compare);
+}
+
+extern analysedsymbol *find_analysed_symbol(char *name)
+{   analysedsymbol key;
+    if (!analysed_symbols) return NULL;
+    key.name = name;
+    return bsearch(&key, analysed_symbols, no_analysed_symbols,
+        sizeof(analysedsymbol), analysed_symbol_compare);
+}
+
 /* ------------------------------------------------------------------------- */
 /*   The dead-function removal optimization.                                 */
 /* ------------------------------------------------------------------------- */
 
 int track_unused_routines; /* set if either WARN_UNUSED_ROUTINES or
-                              OMIT_UNUSED_ROUTINES is nonzero */
+                              OMIT_UNUSED_ROUTINES is nonzero, or for
+                              STACK_ANALYSIS in Glulx */
 int df_dont_note_global_symbols; /* temporarily set at times in parsing */
 static int df_tables_closed; /* set at end of compiler pass */
 
@@ -1079,6 +1211,21 @@ struct df_function_struct {
     df_function_t *funcnext; /* in forward functions order */
     df_function_t *todonext; /* in the todo chain */
     df_function_t *next; /* in the hash table */
+
+    /* The rest is used only by the stack analysis. */
+    df_reference_t *vrefs; /* veneer routines called (symbol = VR code) */
+    int32 stack_frame; /* bytes of call frame and evaluation stack */
+    int indirect; /* makes calls to computed addresses */
+    df_function_t **callees; /* routines it may call, once analysed */
+    int no_callees;
+    int sa_index, sa_lowlink, sa_onstack; /* for finding recursion */
+    df_function_t *sa_stacknext;
+    df_function_t *group; /* first-found member of its recursive group */
+    int recursive; /* (of a group) its size, if its members call each
+                      other (or itself) */
+    int reaches_recursion; /* (of a group) or calls a group which does */
+    uint32 chain_size; /* (of a group) stack needed by its deepest chain */
+    df_function_t *chain_next; /* (of a group) next group in that chain */
 };
 
 struct df_reference_struct {
@@ -1191,6 +1338,42 @@ extern void df_note_function_end(uint32 endaddress)
     df_current_function = df_functions_head; /* the global namespace */
 }
 
+/* For the stack analysis: the function just assembled needs this many
+   bytes of stack for its own frame, and makes calls through variables
+   (if indirect is set). Call this before df_note_function_end().
+*/
+extern void df_note_function_stack(int32 frame, int indirect)
+{
+    if (!df_current_function
+        || df_current_function->address == DF_NOT_IN_FUNCTION)
+        return;
+    df_current_function->stack_frame = frame;
+    df_current_function->indirect = indirect;
+}
+
+/* The veneer routine with this code is called from the function being
+   assembled. (Calls to the veneer are not made through symbols, so this
+   is the only record of them.)
+*/
+extern void df_note_veneer_call(int code)
+{
+    df_reference_t *ent;
+
+    if (df_tables_closed || !df_current_function
+        || df_current_function->address == DF_NOT_IN_FUNCTION)
+        return;
+    for (ent = df_current_function->vrefs; ent; ent = ent->refsnext) {
+        if (ent->symbol == code)
+            return;
+    }
+    ent = my_malloc(sizeof(df_reference_t), "df veneer call entry");
+    ent->address = df_current_function->address;
+    ent->symbol = code;
+    ent->next = NULL;
+    ent->refsnext = df_current_function->vrefs;
+    df_current_function->vrefs = ent;
+}
+
 /* Find the function record for a given address. (Addresses are offsets
    in zcode_area.)
 */
@@ -1426,6 +1609,226 @@ extern void locate_dead_functions(void)
     /* df_measure_hash_table_usage(); */
 }
 
+/* ------------------------------------------------------------------------- */
+/*   Stack analysis ($STACK_ANALYSIS, Glulx only)                            */
+/*                                                                           */
+/*   Using the map of function references built above, find the chain of    */
+/*   calls from Main__ which needs the most stack. A function which calls   */
+/*   through a variable is taken to be able to call any function whose     */
+/*   address is given outside a routine (in a property, array or global),  */
+/*   which covers messages and property routines. Groups of functions      */
+/*   which call each other recursively are counted once round, so when     */
+/*   the deepest chain passes through one the result is only a lower bound. */
+/* ------------------------------------------------------------------------- */
+
+static int sa_counter;
+static df_function_t *sa_stack;
+static df_function_t **sa_indirect_targets;
+static int sa_no_indirect_targets;
+static int sa_recursive_groups;
+
+static void sa_add_callee(df_function_t *func, uint32 addr, int *room)
+{
+    df_function_t *tofunc = df_function_for_address(addr);
+    if (!tofunc || !tofunc->usage)
+        return;
+    if (func->no_callees == *room) {
+        *room = 2*(*room) + 8;
+        my_realloc(&func->callees,
+            sizeof(df_function_t *)*func->no_callees,
+            sizeof(df_function_t *)*(*room), "stack analysis callees");
+    }
+    func->callees[func->no_callees++] = tofunc;
+}
+
+static void sa_find_callees(df_function_t *func)
+{
+    df_reference_t *ent;
+    int room = 0;
+
+    for (ent = func->refs; ent; ent = ent->refsnext) {
+        if (symbols[ent->symbol].type == ROUTINE_T)
+            sa_add_callee(func, symbols[ent->symbol].value, &room);
+    }
+    for (ent = func->vrefs; ent; ent = ent->refsnext) {
+        if (veneer_routine_address[ent->symbol])
+            sa_add_callee(func, veneer_routine_address[ent->symbol], &room);
+    }
+    if (func->address == 0) {
+        /* Main__, which calls Main without a symbol reference */
+        df_function_t *main;
+        for (main = func->funcnext; main; main = main->funcnext) {
+            if (main->usage & DF_USAGE_MAIN)
+                sa_add_callee(func, main->address, &room);
+        }
+    }
+}
+
+/* The callees of a function: its own list, then (if it calls through
+   variables) the shared list of indirect targets. */
+static df_function_t *sa_callee(df_function_t *func, int i)
+{
+    if (i < func->no_callees)
+        return func->callees[i];
+    i -= func->no_callees;
+    if (func->indirect && i < sa_no_indirect_targets)
+        return sa_indirect_targets[i];
+    return NULL;
+}
+
+/* Tarjan's algorithm. Each group is completed only after every group it
+   calls, so its chain size can be worked out as soon as it is found. */
+static void sa_visit(df_function_t *func)
+{
+    df_function_t *tofunc, *member, *top;
+    int i;
+
+    func->sa_index = func->sa_lowlink = ++sa_counter;
+    func->sa_stacknext = sa_stack;
+    sa_stack = func;
+    func->sa_onstack = TRUE;
+
+    for (i = 0; (tofunc = sa_callee(func, i)) != NULL; i++) {
+        if (!tofunc->sa_index) {
+            sa_visit(tofunc);
+            if (tofunc->sa_lowlink < func->sa_lowlink)
+                func->sa_lowlink = tofunc->sa_lowlink;
+        }
+        else if (tofunc->sa_onstack && tofunc->sa_index < func->sa_lowlink) {
+            func->sa_lowlink = tofunc->sa_index;
+        }
+    }
+
+    if (func->sa_lowlink != func->sa_index)
+        return;
+
+    /* func is the first-found member of a group: pop the group. */
+    func->chain_size = 0;
+    top = sa_stack;
+    do {
+        member = sa_stack;
+        sa_stack = member->sa_stacknext;
+        member->sa_onstack = FALSE;
+        member->group = func;
+        func->chain_size += member->stack_frame + 16;
+        func->recursive++;
+    } while (member != func);
+    if (func->recursive == 1)
+        func->recursive = 0;
+
+    /* Now the deepest of the groups called from this one. */
+    {
+        uint32 deepest = 0;
+        for (member = top; member; member = member->sa_stacknext) {
+            for (i = 0; (tofunc = sa_callee(member, i)) != NULL; i++) {
+                if (tofunc->group == func) {
+                    if (tofunc == member && !func->recursive)
+                        func->recursive = 1;
+                    continue;
+                }
+                tofunc = tofunc->group;
+                if (tofunc->reaches_recursion)
+                    func->reaches_recursion = TRUE;
+                if (tofunc->chain_size > deepest) {
+                    deepest = tofunc->chain_size;
+                    func->chain_next = tofunc;
+                }
+            }
+            if (member == func)
+                break;
+        }
+        func->chain_size += deepest;
+    }
+    if (func->recursive) {
+        func->reaches_recursion = TRUE;
+        sa_recursive_groups++;
+    }
+}
+
+extern void analyse_stack_usage(void)
+{
+    df_function_t *func, *root;
+    uint32 needed;
+    int count;
+
+    if (!track_unused_routines || !df_tables_closed)
+        compiler_error("DF: analyse_stack_usage called before the function map was complete");
+
+    root = df_functions_head ? df_functions_head->funcnext : NULL;
+    if (!root || root->address != 0 || !root->usage)
+        return;
+
+    count = 0;
+    for (func = df_functions_head; func; func = func->funcnext) {
+        if (func->address != DF_NOT_IN_FUNCTION && func != root
+            && (func->usage & (DF_USAGE_GLOBAL | DF_USAGE_EMBEDDED)))
+            count++;
+    }
+    sa_indirect_targets = my_calloc(sizeof(df_function_t *), count+1,
+        "stack analysis indirect targets");
+    sa_no_indirect_targets = 0;
+    for (func = df_functions_head; func; func = func->funcnext) {
+        if (func->address == DF_NOT_IN_FUNCTION || !func->usage)
+            continue;
+        if (func != root
+            && (func->usage & (DF_USAGE_GLOBAL | DF_USAGE_EMBEDDED)))
+            sa_indirect_targets[sa_no_indirect_targets++] = func;
+        sa_find_callees(func);
+    }
+
+    sa_counter = 0;
+    sa_stack = NULL;
+    sa_recursive_groups = 0;
+    sa_visit(root);
+    root = root->group;
+
+    /* Round up to the 256-byte boundary MAX_STACK_SIZE insists on. */
+    needed = (root->chain_size + 0xFF) & (~0xFF);
+
+    if (statistics_switch) {
+        printf("Stack analysis: the deepest chain of calls needs %lu bytes\n",
+            (unsigned long) root->chain_size);
+        printf("  ");
+        for (func = root, count = 0; func && count < 16;
+             func = func->chain_next, count++) {
+            printf("%s%s", (count ? " > " : ""), func->name);
+            if (func->recursive > 1)
+                printf(" (recursive, with %d other%s)", func->recursive - 1,
+                    (func->recursive == 2) ? "" : "s");
+            else if (func->recursive)
+                printf(" (recursive)");
+        }
+        printf("%s\n", (func ? " > ..." : ""));
+        if (root->reaches_recursion)
+            printf("  %d group%s of routines %s recursive, so this is only "
+                "a lower bound\n", sa_recursive_groups,
+                (sa_recursive_groups == 1) ? "" : "s",
+                (sa_recursive_groups == 1) ? "is" : "are");
+    }
+
+    if (STACK_ANALYSIS >= 2) {
+        if (!root->reaches_recursion)
+            MAX_STACK_SIZE = needed + 0x100;
+        else if (MAX_STACK_SIZE < (int32) needed)
+            MAX_STACK_SIZE = needed;
+    }
+    else if (MAX_STACK_SIZE < (int32) root->chain_size) {
+        warning_fmt("The deepest chain of routine calls needs %lu bytes of \
+stack, but $MAX_STACK_SIZE is only %ld", (unsigned long) root->chain_size,
+            (long int) MAX_STACK_SIZE);
+    }
+    else if (!root->reaches_recursion && MAX_STACK_SIZE > 4096
+        && MAX_STACK_SIZE > 4*(int32) needed) {
+        warning_fmt("$MAX_STACK_SIZE is %ld, but no chain of routine calls \
+needs more than %lu bytes of stack", (long int) MAX_STACK_SIZE,
+            (unsigned long) root->chain_size);
+    }
+
+    for (func = df_functions_head; func; func = func->funcnext)
+        my_free(&func->callees, "stack analysis callees");
+    my_free(&sa_indirect_targets, "stack analysis indirect targets");
+}
+
 /* Given an original function address, return where it winds up after
    unused-function stripping. The function must not itself be unused.
 
@@ -1466,7 +1869,7 @@ extern uint32 df_stripped_address_for_address(uint32 addr)
 
    The input and output are offsets, but *not* scaled.
 
-   This is only used by the debug-file system.
+   This is used by the debug-file system, and to find SnapshotInit.
 */
 uint32 df_stripped_offset_for_code_offset(uint32 offset, int *stripped)
 {
@@ -1583,6 +1986,8 @@ extern uint32 df_next_function_iterate(int *funcused)
 extern void init_symbols_vars(void)
 {
     symbols = NULL;
+    symbol_usage = NULL;
+    any_global_assigned = FALSE;
     start_of_list = NULL;
     symbol_debug_info = NULL;
     temp_symbol_buf = NULL;
@@ -1600,7 +2005,8 @@ extern void init_symbols_vars(void)
 
     make_case_conversion_grid();
 
-    track_unused_routines = (WARN_UNUSED_ROUTINES || OMIT_UNUSED_ROUTINES);
+    track_unused_routines = (WARN_UNUSED_ROUTINES || OMIT_UNUSED_ROUTINES
+        || (STACK_ANALYSIS && glulx_mode));
     df_tables_closed = FALSE;
     df_symbol_map = NULL;
     df_functions = NULL;
@@ -1634,6 +2040,13 @@ extern void symbols_allocate_arrays(void)
     initialise_memory_list(&temp_symbol_buf_memlist,
         sizeof(char), 64, (void**)&temp_symbol_buf,
         "temporary symbol name");
+
+    if (analysis_pass)
+    {
+        initialise_memory_list(&symbol_usage_memlist,
+            sizeof(symbolusage), 6400, (void**)&symbol_usage,
+            "symbol usage counts");
+    }
         
     start_of_list = my_calloc(sizeof(int32), HASH_TAB_SIZE,
                      "hash code list beginnings");
@@ -1689,6 +2102,10 @@ extern void symbols_free_arrays(void)
         deallocate_memory_list(&symbol_debug_info_memlist);
     }
     deallocate_memory_list(&temp_symbol_buf_memlist);
+    if (analysis_pass)
+    {
+        deallocate_memory_list(&symbol_usage_memlist);
+    }
     
     my_free(&start_of_list, "hash code list beginnings");
 
@@ -1714,6 +2131,11 @@ extern void symbols_free_arrays(void)
             df_function_t *func = df_functions[i];
             while (func) {
                 df_function_t *next = func->next;
+                while (func->vrefs) {
+                    df_reference_t *ent = func->vrefs;
+                    func->vrefs = ent->refsnext;
+                    my_free(&ent, "df veneer call entry");
+                }
                 my_free(&func, "df function entry");
                 func = next;
             }
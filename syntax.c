@@ -12,6 +12,10 @@ static char *lexical_source;
 
 int no_syntax_lines;                                  /*  Syntax line count  */
 
+assembly_operand switch_operand;       /*  The value which the cases of the
+                                           next 'switch' block are tested
+                                           against (usually temp_var1)       */
+
 static void begin_syntax_line(int statement_mode)
 {   no_syntax_lines++;
     next_token_begins_syntax_line = TRUE;
@@ -502,6 +506,8 @@ extern int32 parse_routine(char *source, int embedded_flag, char *name,
 
     packed_address = assemble_routine_header(debug_flag,
         name, embedded_flag, r_symbol);
+    begin_pure_routine((embedded_flag || veneer_mode || debug_flag)
+        ? -1 : r_symbol);
 
     do
     {   begin_syntax_line(TRUE);
@@ -510,6 +516,7 @@ extern int32 parse_routine(char *source, int embedded_flag, char *name,
 
         if (token_type == EOF_TT)
         {   ebf_curtoken_error("']'");
+            end_pure_routine(FALSE);
             assemble_routine_end
                 (embedded_flag,
                  get_token_location_end(beginning_debug_location));
@@ -523,6 +530,7 @@ extern int32 parse_routine(char *source, int embedded_flag, char *name,
                 assemble_label_no(switch_label);
             directives.enabled = TRUE;
             sequence_point_follows = TRUE;
+            end_pure_routine(!switch_clause_made);
             get_next_token();
             assemble_routine_end
                 (embedded_flag,
@@ -603,6 +611,8 @@ extern int32 parse_routine(char *source, int embedded_flag, char *name,
             }
         }
 
+        note_routine_statement((token_type == STATEMENT_TT)
+            && (token_value == RETURN_CODE));
         parse_statement(-1, -1);
 
     } while (TRUE);
@@ -625,6 +635,7 @@ extern void parse_code_block(int break_label, int continue_label,
     int switch_rule)
 {   int switch_clause_made = FALSE, default_clause_made = FALSE, switch_label = 0;
     int unary_minus_flag, saved_entire_flag;
+    assembly_operand switch_value = switch_operand;
 
     saved_entire_flag = (execution_never_reaches_here & EXECSTATE_ENTIRE);
     if (execution_never_reaches_here)
@@ -727,7 +738,7 @@ extern void parse_code_block(int break_label, int continue_label,
                            appear in the reverse order from how
                            parse_switch_spec() would do it. The results
                            are the same because we're just comparing
-                           temp_var1 with a bunch of constants. */
+                           switch_value with a bunch of constants. */
                         if (default_clause_made)
                             error("'default' must be the last 'switch' case");
                         
@@ -742,7 +753,7 @@ extern void parse_code_block(int break_label, int continue_label,
                         switch_label = next_label++;
                         switch_clause_made = TRUE;
                         
-                        AO = temp_var1;
+                        AO = switch_value;
                         generate_switch_spec(AO, switch_label, -1, constcount);
                         continue;
                     }
@@ -785,7 +796,7 @@ extern void parse_code_block(int break_label, int continue_label,
                     put_token_back(); put_token_back();
                     if (unary_minus_flag) put_token_back();
 
-                    AO = temp_var1;
+                    AO = switch_value;
                     parse_switch_spec(AO, switch_label, FALSE);
                     continue;
                 }
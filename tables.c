@@ -63,6 +63,7 @@ int32 code_offset,
 int32 arrays_offset,
       object_tree_offset,
       grammar_table_offset,
+      grammar_index_offset,
       abbreviations_offset; /* Glulx */
 
 int32 Out_Size, Write_Code_At, Write_Strings_At;
@@ -109,8 +110,26 @@ extern void write_serial_number(char *buffer)
         sprintf(buffer,"970000");
 #else
         /* Write a six-digit date, null-terminated. Fall back to "970000"
-           if that fails. */
-        int len = strftime(buffer,7,"%y%m%d",localtime(&tt));
+           if that fails.
+
+           For reproducible builds, the environment variable
+           SOURCE_DATE_EPOCH (seconds since 1970) replaces today's date
+           if it is set; that date is taken in UTC, not local time. */
+        struct tm *date = NULL;
+        char *epoch = getenv("SOURCE_DATE_EPOCH");
+        int len = 0;
+        if (epoch != NULL && epoch[0] != 0) {
+            char *end;
+            long secs = strtol(epoch, &end, 10);
+            if (*end == 0 && secs >= 0) {
+                tt = (time_t) secs;
+                date = gmtime(&tt);
+            }
+        }
+        if (date == NULL)
+            date = localtime(&tt);
+        if (date != NULL)
+            len = strftime(buffer,7,"%y%m%d",date);
         if (len != 6)
             sprintf(buffer,"970000");
 #endif
@@ -154,6 +173,309 @@ static char *version_name(int v)
   }
 }
 
+/* ------------------------------------------------------------------------- */
+/*   The grammar index (written only if $GRAMMAR_INDEX is set) summarises    */
+/*   the grammar table, so that a parser can rule out grammar lines without  */
+/*   walking their tokens. Its address is #grammar_index_table, and it is    */
+/*   laid out in words (--> entries) of the virtual machine:                 */
+/*                                                                           */
+/*       -->0       P, the number of prepositions indexed                    */
+/*       -->1       B, the number of bytes in a bitmap, which is (P+7)/8     */
+/*       -->2       address of a table of the P dictionary addresses, in     */
+/*                  dictionary order (so it can be binary-searched)          */
+/*       -->(3+v)   address of the line records for verb v, or 0 if the      */
+/*                  verb's grammar was omitted                               */
+/*                                                                           */
+/*   There is one line record of 2+B bytes for each grammar line:            */
+/*                                                                           */
+/*       ->0        type of the first token (1 to 6), or 0 if none           */
+/*       ->1        if that is an elementary token, its number; if it is     */
+/*                  an indexed preposition, the preposition's index plus 1   */
+/*                  (or 0 if above 255); otherwise 0                         */
+/*       ->2...     bitmap of the prepositions the line requires: index i    */
+/*                  is bit (i%8) of byte 2+(i/8)                             */
+/*                                                                           */
+/*   Only prepositions standing alone are indexed, since a line can match    */
+/*   without any one word of a '/' group.                                    */
+/* ------------------------------------------------------------------------- */
+
+static int grammar_index_made;         /* TRUE if the index is being written */
+static int32 *grammar_index_preps;     /* Accession numbers of the indexed
+                                          prepositions, in dictionary order  */
+static int32 *grammar_index_number;    /* Accession number -> index+1, or 0  */
+static int32 grammar_index_count,      /* P, as above                        */
+             grammar_index_bytes,      /* B, as above                        */
+             grammar_index_at,         /* Position of the index in paged
+                                          memory                             */
+             grammar_index_preps_at;   /* Position of the prepositions table */
+
+static int32 grammar_first_token(int32 k, int *left)
+{
+    /*  Given the offset of a grammar line in grammar_lines[], return the
+        offset of its first token. *left is set to the number of tokens
+        (in grammar version 3) or -1 (if the line ends with ENDIT).          */
+
+    if (glulx_mode) {
+        *left = -1;
+        return k+3;
+    }
+    if (grammar_version_number == 3)
+        *left = (grammar_lines[k] >> 3) & 0x1F;
+    else
+        *left = -1;
+    return k+2;
+}
+
+static int grammar_next_token(int32 *k, int *left, int *bytecode,
+    int32 *data)
+{
+    /*  Read the token at offset *k, moving *k on to the next; or return
+        FALSE at the end of the line. A preposition's data is always
+        returned as its dictionary accession number.                         */
+
+    int32 j = *k;
+
+    if (*left == 0) return FALSE;
+    if (*left < 0 && grammar_lines[j] == 15) return FALSE;
+
+    *bytecode = grammar_lines[j];
+    if (glulx_mode) {
+        *data = (grammar_lines[j+1] << 24) | (grammar_lines[j+2] << 16)
+            | (grammar_lines[j+3] << 8) | (grammar_lines[j+4]);
+        j += 5;
+    }
+    else if (grammar_version_number == 3) {
+        *data = grammar_lines[j+1];
+        if ((*bytecode & 0x0F) == 2)
+            *data = adjectives[*data];
+        j += 2;
+        (*left)--;
+    }
+    else {
+        *data = grammar_lines[j+1]*256 + grammar_lines[j+2];
+        j += 3;
+    }
+    *k = j;
+    return TRUE;
+}
+
+static void prepare_grammar_index(void)
+{
+    /*  Work out which prepositions are to be indexed, and in what order.
+        (The dictionary must already have been sorted.)                      */
+
+    int32 i, j, k, data, *by_position;
+    int left, bytecode;
+
+    grammar_index_made = FALSE;
+    grammar_index_count = 0;
+    grammar_index_bytes = 0;
+    grammar_index_at = 0;
+    grammar_index_preps_at = 0;
+
+    if (!GRAMMAR_INDEX)
+        return;
+    if (grammar_version_number == 1) {
+        error("$GRAMMAR_INDEX requires grammar version 2 or later");
+        return;
+    }
+    grammar_index_made = TRUE;
+
+    grammar_index_number = my_calloc(sizeof(int32), dict_entries+1,
+        "grammar index numbers");
+    grammar_index_preps = my_calloc(sizeof(int32), dict_entries+1,
+        "grammar index prepositions");
+    by_position = my_calloc(sizeof(int32), dict_entries+1,
+        "grammar index ordering");
+
+    for (i=0; i<no_Inform_verbs; i++) {
+        if (!Inform_verbs[i].used) continue;
+        for (j=0; j<Inform_verbs[i].lines; j++) {
+            k = grammar_first_token(Inform_verbs[i].l[j], &left);
+            while (grammar_next_token(&k, &left, &bytecode, &data)) {
+                if ((bytecode & 0x0F) == 2 && (bytecode & 0x30) == 0
+                    && data >= 0 && data < dict_entries)
+                    by_position[final_dict_order[data]] = data+1;
+            }
+        }
+    }
+
+    for (i=0; i<dict_entries; i++) {
+        if (by_position[i]) {
+            grammar_index_preps[grammar_index_count] = by_position[i]-1;
+            grammar_index_number[by_position[i]-1] = ++grammar_index_count;
+        }
+    }
+    grammar_index_bytes = (grammar_index_count+7)/8;
+
+    my_free(&by_position, "grammar index ordering");
+}
+
+static int32 grammar_index_size(void)
+{
+    if (!grammar_index_made) return 0;
+    return (3 + no_Inform_verbs + grammar_index_count)*WORDSIZE
+        + no_grammar_lines*(2 + grammar_index_bytes);
+}
+
+static void write_grammar_index_word(uchar *p, int32 at, int32 value)
+{
+    if (!glulx_mode) {
+        p[at] = (value/256) & 0xFF;
+        p[at+1] = value%256;
+    }
+    else {
+        WriteInt32(p+at, value);
+    }
+}
+
+static int32 write_grammar_index(uchar *p, int32 mark, int32 base)
+{
+    /*  Write the index at p[mark], returning the position after it. Its
+        internal addresses are positions plus base. The prepositions table
+        is filled in by backpatch_grammar_index(), once the dictionary's
+        address is known.                                                    */
+
+    int32 i, j, k, m, data;
+    int left, bytecode, first;
+
+    grammar_index_at = mark;
+    mark += (3 + no_Inform_verbs)*WORDSIZE;
+    grammar_index_preps_at = mark;
+    mark += grammar_index_count*WORDSIZE;
+
+    write_grammar_index_word(p, grammar_index_at, grammar_index_count);
+    write_grammar_index_word(p, grammar_index_at + WORDSIZE,
+        grammar_index_bytes);
+    write_grammar_index_word(p, grammar_index_at + 2*WORDSIZE,
+        base + grammar_index_preps_at);
+
+    for (i=0; i<no_Inform_verbs; i++) {
+        if (!Inform_verbs[i].used) {
+            write_grammar_index_word(p,
+                grammar_index_at + (3+i)*WORDSIZE, 0);
+            continue;
+        }
+        write_grammar_index_word(p,
+            grammar_index_at + (3+i)*WORDSIZE, base + mark);
+        for (j=0; j<Inform_verbs[i].lines; j++) {
+            for (m=0; m<2+grammar_index_bytes; m++) p[mark+m] = 0;
+            k = grammar_first_token(Inform_verbs[i].l[j], &left);
+            first = TRUE;
+            while (grammar_next_token(&k, &left, &bytecode, &data)) {
+                int32 n = 0;
+                if ((bytecode & 0x0F) == 2 && (bytecode & 0x30) == 0
+                    && data >= 0 && data < dict_entries)
+                    n = grammar_index_number[data];
+                if (first) {
+                    p[mark] = bytecode & 0x0F;
+                    if (p[mark] == 1)
+                        p[mark+1] = data & 0xFF;
+                    else if (n < 256)
+                        p[mark+1] = n;
+                    first = FALSE;
+                }
+                if (n > 0)
+                    p[mark+2+(n-1)/8] |= (1 << ((n-1)%8));
+            }
+            mark += 2 + grammar_index_bytes;
+        }
+    }
+
+    return mark;
+}
+
+static void backpatch_grammar_index(uchar *p)
+{
+    int32 i, value;
+
+    if (!grammar_index_made) return;
+
+    for (i=0; i<grammar_index_count; i++) {
+        value = final_dict_order[grammar_index_preps[i]]
+            *DICT_ENTRY_BYTE_LENGTH;
+        if (!glulx_mode)
+            value += dictionary_offset + 7;
+        else
+            value += dictionary_offset + 4;
+        write_grammar_index_word(p, grammar_index_preps_at + i*WORDSIZE,
+            value);
+    }
+}
+
+static void free_grammar_index(void)
+{
+    grammar_index_made = FALSE;
+    my_free(&grammar_index_number, "grammar index numbers");
+    my_free(&grammar_index_preps, "grammar index prepositions");
+}
+
+/* ------------------------------------------------------------------------- */
+/*   With $SORT_NAME_PROPERTIES, each "name" list (already free of repeats: */
+/*   see objects.c) is sorted into increasing order once backpatching has  */
+/*   filled in the final dictionary addresses. Z-code words are compared   */
+/*   unsigned and Glulx words signed, as the veneer's Name__Search does.   */
+/* ------------------------------------------------------------------------- */
+
+static int32 read_name_word(uchar *p, int32 at)
+{
+    if (!glulx_mode)
+        return 256*p[at] + p[at+1];
+    return (int32) ReadInt32(p+at);
+}
+
+static void sort_name_words(uchar *p, int32 at, int32 count)
+{
+    int32 i, j, v;
+
+    for (i=1; i<count; i++) {
+        v = read_name_word(p, at + i*WORDSIZE);
+        for (j=i; j>0; j--) {
+            int32 w = read_name_word(p, at + (j-1)*WORDSIZE);
+            if (w <= v) break;
+            write_grammar_index_word(p, at + j*WORDSIZE, w);
+        }
+        write_grammar_index_word(p, at + j*WORDSIZE, v);
+    }
+}
+
+static void sort_name_properties(uchar *p, int32 props_at)
+{
+    int32 i, j, at, count, len, num;
+
+    if (!SORT_NAME_PROPERTIES) return;
+
+    for (i=0; i<no_objects; i++) {
+        if (!glulx_mode) {
+            at = props_at + objectsz[i].propaddr;
+            at += 1 + 2*p[at];
+            while (p[at] != 0) {
+                if (version_number == 3) {
+                    num = p[at] % 32; len = 1 + p[at++]/32;
+                }
+                else if (p[at] & 0x80) {
+                    num = p[at++] % 64; len = p[at++] % 64;
+                    if (len == 0) len = 64;
+                }
+                else {
+                    num = p[at] % 64; len = 1 + p[at++]/64;
+                }
+                if (num == 1) sort_name_words(p, at, len/2);
+                at += len;
+            }
+        }
+        else {
+            at = props_at + relocated_property_offset_g(objectsg[i].propaddr);
+            count = ReadInt32(p+at);
+            for (j=0, at += 4; j<count; j++, at += 10) {
+                if (ReadInt16(p+at) == 1)
+                    sort_name_words(p, ReadInt32(p+at+4) - Write_RAM_At,
+                        ReadInt16(p+at+2));
+            }
+        }
+    }
+}
+
 static int32 rough_size_of_paged_memory_z(void)
 {
     /*  This function calculates a modest over-estimate of the amount of
@@ -195,6 +517,8 @@ static int32 rough_size_of_paged_memory_z(void)
     if (grammar_version_number != 1)
         total += grammar_lines_top;            /* size of grammar lines area */
 
+    total += grammar_index_size();                       /* grammar index */
+
     total +=  2 + 4*no_adjectives                        /* adjectives table */
               + 2*no_actions                              /* action routines */
               + 2*no_grammar_token_routines;     /* general parsing routines */
@@ -241,6 +565,7 @@ static int32 rough_size_of_paged_memory_g(void)
 
     total += 4 + no_Inform_verbs * 4; /* index of grammar tables */
     total += grammar_lines_top; /* grammar tables */
+    total += grammar_index_size(); /* grammar index */
 
     total += 4 + no_actions * 4; /* actions functions table */
 
@@ -286,6 +611,8 @@ static void construct_storyfile_z(void)
         write_the_identifier_names();
     }
 
+    prepare_grammar_index();
+
     /*  We now know how large the buffer to hold our construction has to be  */
 
     rough_size = rough_size_of_paged_memory_z();
@@ -399,8 +726,10 @@ static void construct_storyfile_z(void)
     for (i=0; i<properties_table_size; i++)
         p[mark+i]=properties_table[i];
 
+    check_object_renumbering();
+
     for (i=0, objs=object_tree_at; i<no_objects; i++)
-    {
+    {   j = object_props_at + objectsz[i].propaddr;
         if (version_number == 3)
         {   p[objs]=objectsz[i].atts[0];
             p[objs+1]=objectsz[i].atts[1];
@@ -409,8 +738,8 @@ static void construct_storyfile_z(void)
             p[objs+4]=objectsz[i].parent;
             p[objs+5]=objectsz[i].next;
             p[objs+6]=objectsz[i].child;
-            p[objs+7]=mark/256;
-            p[objs+8]=mark%256;
+            p[objs+7]=j/256;
+            p[objs+8]=j%256;
             objs+=9;
         }
         else
@@ -426,8 +755,8 @@ static void construct_storyfile_z(void)
             p[objs+9]=(objectsz[i].next)%256;
             p[objs+10]=(objectsz[i].child)/256;
             p[objs+11]=(objectsz[i].child)%256;
-            p[objs+12]=mark/256;
-            p[objs+13]=mark%256;
+            p[objs+12]=j/256;
+            p[objs+13]=j%256;
             objs+=14;
         }
         mark+=objectsz[i].propsize;
@@ -624,6 +953,9 @@ static void construct_storyfile_z(void)
         }
     }
 
+    if (grammar_index_made)
+        mark = write_grammar_index(p, mark, 0);
+
     /*  ------------------- Actions and Preactions ------------------------- */
     /*  (The term "preactions" is traditional: Inform uses the preactions    */
     /*  table for a different purpose than Infocom used to.)                 */
@@ -794,6 +1126,7 @@ or less.");
     prop_values_offset = object_props_at;
     static_memory_offset = grammar_table_at;
     grammar_table_offset = grammar_table_at;
+    grammar_index_offset = (grammar_index_made) ? grammar_index_at : 0;
     static_arrays_offset = static_arrays_at;
 
     if (extend_memory_map)
@@ -926,6 +1259,8 @@ or less.");
 
     if (!skip_backpatching)
     {   backpatch_zmachine_image_z();
+        backpatch_grammar_index(p);
+        sort_name_properties(p, object_props_at);
 
         /* The symbol name, action, and grammar tables must be backpatched specially. */
         
@@ -1181,6 +1516,8 @@ static void construct_storyfile_g(void)
 
     compress_game_text();
 
+    prepare_grammar_index();
+
     /*  We now know how large the buffer to hold our construction has to be  */
 
     rough_size = rough_size_of_paged_memory_g();
@@ -1255,10 +1592,14 @@ static void construct_storyfile_g(void)
 
     object_tree_at = mark;
 
-    object_props_at = mark + no_objects*OBJECT_BYTE_LENGTH;
+    l = plan_object_layout_g();
+    if (GLULX_OBJECT_LAYOUT)
+      object_props_at = mark;
+    else
+      object_props_at = mark + no_objects*OBJECT_BYTE_LENGTH;
 
     for (i=0; i<no_objects; i++) {
-      int32 objmark = mark;
+      mark = object_tree_at + objectsg[i].finaladdr;
       p[mark++] = 0x70; /* type byte -- object */
       for (j=0; j<NUM_ATTR_BYTES; j++) {
         p[mark++] = objectatts[i*NUM_ATTR_BYTES+j];
@@ -1270,34 +1611,35 @@ static void construct_storyfile_g(void)
           if (i == no_objects-1)
             val = 0;
           else
-            val = Write_RAM_At + objmark + OBJECT_BYTE_LENGTH;
+            val = Write_RAM_At + object_tree_at + object_offset_g(i+2);
           break;
         case 1: /* hardware name address */
           val = Write_Strings_At + compressed_offsets[objectsg[i].shortname-1];
           break;
         case 2: /* property table address */
-          val = Write_RAM_At + object_props_at + objectsg[i].propaddr;
+          val = Write_RAM_At + object_props_at
+            + relocated_property_offset_g(objectsg[i].propaddr);
           break;
         case 3: /* parent */
           if (objectsg[i].parent == 0)
             val = 0;
           else
             val = Write_RAM_At + object_tree_at +
-              (OBJECT_BYTE_LENGTH*(objectsg[i].parent-1));
+              object_offset_g(objectsg[i].parent);
           break;
         case 4: /* sibling */
           if (objectsg[i].next == 0)
             val = 0;
           else
             val = Write_RAM_At + object_tree_at +
-              (OBJECT_BYTE_LENGTH*(objectsg[i].next-1));
+              object_offset_g(objectsg[i].next);
           break;
         case 5: /* child */
           if (objectsg[i].child == 0)
             val = 0;
           else
             val = Write_RAM_At + object_tree_at +
-              (OBJECT_BYTE_LENGTH*(objectsg[i].child-1));
+              object_offset_g(objectsg[i].child);
           break;
         }
         p[mark++] = (val >> 24) & 0xFF;
@@ -1306,30 +1648,57 @@ static void construct_storyfile_g(void)
         p[mark++] = (val) & 0xFF;
       }
 
+      if (GLULX_PREV_SIBLING) {
+        /* previous sibling: filled in below */
+        for (j=0; j<4; j++)
+          p[mark++] = 0;
+      }
       for (j=0; j<GLULX_OBJECT_EXT_BYTES; j++) {
         p[mark++] = 0;
       }
     }
 
-    if (object_props_at != mark)
+    if (GLULX_PREV_SIBLING) {
+      for (i=0; i<no_objects; i++) {
+        if (objectsg[i].next == 0)
+          continue;
+        WriteInt32(p + object_tree_at + object_offset_g(objectsg[i].next)
+            + 4*GOBJFIELD_PREVSIB(),
+          Write_RAM_At + object_tree_at + object_offset_g(i+1));
+      }
+    }
+
+    if (!GLULX_OBJECT_LAYOUT && (object_props_at != mark))
       error("*** Object table was impossible length ***");
 
-    for (i=0; i<properties_table_size; i++)
-      p[mark+i]=properties_table[i];
+    /*  Each object's block is copied in two parts, since the object itself
+        may have been placed between a class's attribute bytes and its
+        property table. */
+    for (i=0; i<no_objects; i++) {
+      int32 from = objectsg[i].blockstart, split = objectsg[i].propaddr;
+      int32 to = from + objectsg[i].propsize;
+      int32 blockaddr = object_props_at + relocated_property_offset_g(from);
+      for (j=from; j<split; j++)
+        p[blockaddr+j-from] = properties_table[j];
+      blockaddr = object_props_at + relocated_property_offset_g(split);
+      for (j=split; j<to; j++)
+        p[blockaddr+j-split] = properties_table[j];
+    }
 
     for (i=0; i<no_objects; i++) { 
-      int32 tableaddr = object_props_at + objectsg[i].propaddr;
+      int32 tableaddr = object_props_at
+        + relocated_property_offset_g(objectsg[i].propaddr);
       int32 tablelen = ReadInt32(p+tableaddr);
       tableaddr += 4;
       for (j=0; j<tablelen; j++) {
         k = ReadInt32(p+tableaddr+4);
-        k += (Write_RAM_At + object_props_at);
+        k = relocated_property_offset_g(k) + Write_RAM_At + object_props_at;
         WriteInt32(p+tableaddr+4, k);
         tableaddr += 10;
       }
     }
 
-    mark += properties_table_size;
+    mark = object_tree_at + l;
 
     prop_defaults_at = mark;
     for (i=0; i<no_properties; i++) {
@@ -1343,7 +1712,7 @@ static void construct_storyfile_g(void)
     class_numbers_offset = mark;
     for (i=0; i<no_classes; i++) {
       j = Write_RAM_At + object_tree_at +
-        (OBJECT_BYTE_LENGTH*(class_info[i].object_number-1));
+        object_offset_g(class_info[i].object_number);
       WriteInt32(p+mark, j);
       mark += 4;
     }
@@ -1470,6 +1839,9 @@ static void construct_storyfile_g(void)
       }
     }
 
+    if (grammar_index_made)
+      mark = write_grammar_index(p, mark, Write_RAM_At);
+
     /*  ------------------- Actions and Preactions ------------------------- */
 
     actions_at = mark;
@@ -1529,6 +1901,8 @@ static void construct_storyfile_g(void)
     prop_values_offset = Write_RAM_At + object_props_at;
     static_memory_offset = Write_RAM_At + grammar_table_at;
     grammar_table_offset = Write_RAM_At + grammar_table_at;
+    grammar_index_offset =
+      (grammar_index_made) ? Write_RAM_At + grammar_index_at : 0;
     abbreviations_offset = Write_RAM_At + abbrevs_at;
 
     code_offset = Write_Code_At;
@@ -1541,6 +1915,8 @@ static void construct_storyfile_g(void)
 
     if (TRUE)
     {   backpatch_zmachine_image_g();
+        backpatch_grammar_index(p);
+        sort_name_properties(p, object_props_at);
 
         /* The action and grammar tables must be backpatched specially. */
         
@@ -1620,8 +1996,9 @@ static void construct_storyfile_g(void)
         write_debug_section("array space", Write_RAM_At + arrays_at);
         write_debug_section("abbreviations table", Write_RAM_At + abbrevs_at);
         write_debug_section("object tree", Write_RAM_At + object_tree_at);
-        write_debug_section("common properties",
-                            Write_RAM_At + object_props_at);
+        if (!GLULX_OBJECT_LAYOUT)
+            write_debug_section("common properties",
+                                Write_RAM_At + object_props_at);
         write_debug_section("property defaults",
                             Write_RAM_At + prop_defaults_at);
         write_debug_section("class numbers",
@@ -1832,7 +2209,8 @@ Out:   Version %d \"%s\" %s %d.%c%c%c%c%c%c (%ld%sK long):\n",
                no_grammar_tokens,
                no_actions,
                no_attributes, ((version_number==3)?32:48),
-               no_properties-3, ((version_number==3)?29:61),
+               no_properties+no_promoted_properties-3,
+               ((version_number==3)?29:61),
                no_individual_properties - 64);
 
         if (track_unused_routines)
@@ -1845,6 +2223,9 @@ Out:   Version %d \"%s\" %s %d.%c%c%c%c%c%c (%ld%sK long):\n",
                        100 * (float)diff / (float)df_total_size_before_stripping);
             }
 
+        if (SPECIALISE_PROPERTY_READS)
+            printf("%6d property read stubs\n", no_property_read_stubs);
+
         printf(
                "%6ld characters used in text      %6ld bytes compressed (rate %d.%3ld)\n\
 %6d abbreviations (maximum %d)   %6d routines (unlimited)\n\
@@ -1940,6 +2321,9 @@ Out:   %s %s %d.%c%c%c%c%c%c (%ld%sK long):\n",
                        100 * (float)diff / (float)df_total_size_before_stripping);
             }
 
+        if (SPECIALISE_PROPERTY_READS)
+            printf("%6d property read stubs\n", no_property_read_stubs);
+
         printf(
                "%6ld characters used in text      %6ld bytes compressed (rate %d.%3ld)\n\
 %6d abbreviations (maximum %d)   %6d routines (unlimited)\n\
@@ -1965,6 +2349,8 @@ Out:   %s %s %d.%c%c%c%c%c%c (%ld%sK long):\n",
 
 extern void construct_storyfile(void)
 {
+    plan_dynamic_array_layout();
+
     if (!glulx_mode)
         construct_storyfile_z();
     else
@@ -2001,6 +2387,9 @@ extern void construct_storyfile(void)
         else
             display_statistics_g();
     }
+
+    if (statistics_switch || list_opcodes_setting)
+        list_opcode_usage((list_opcodes_setting >= 2));
 }
 
 /* ========================================================================= */
@@ -2059,6 +2448,7 @@ extern void tables_free_arrays(void)
     /*  Allocation for this array happens in construct_storyfile() above     */
 
     my_free(&zmachine_paged_memory,"output buffer");
+    free_grammar_index();
 }
 
 /* ========================================================================= */
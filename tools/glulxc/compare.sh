@@ -0,0 +1,42 @@
+#!/bin/sh
+# ---------------------------------------------------------------------------
+#   compare.sh : Checks the C translation of a Glulx story against the story
+#                file itself, by playing the same script on both
+#
+#   Part of Inform 6.43
+#   copyright (c) Graham Nelson 1993 - 2024
+#
+#   Usage:  tools/glulxc/compare.sh inform [source-file script-file]
+#
+#   Run from the top of the source tree, with the path of a compiled inform.
+#   The source (by default tools/glulxc/test.inf, with test.txt as its
+#   script) is compiled with $GLULX_C_OUTPUT=1; the C is built with the
+#   runtime and glkstdio, the story file is played by tools/refvm, and the
+#   two transcripts must be the same. CC and CFLAGS are used if set.
+# ---------------------------------------------------------------------------
+
+INFORM=${1:?usage: $0 inform [source-file script-file]}
+SOURCE=${2:-tools/glulxc/test.inf}
+SCRIPT=${3:-tools/glulxc/test.txt}
+CC=${CC:-cc}
+CFLAGS=${CFLAGS:--O1 -Wall -Wextra}
+
+WORK=$(mktemp -d) || exit 1
+trap 'rm -rf "$WORK"' 0
+
+"$INFORM" -G '$GLULX_C_OUTPUT=1' "$SOURCE" "$WORK/story.ulx" \
+    > "$WORK/inform.txt" || { cat "$WORK/inform.txt"; exit 1; }
+
+$CC $CFLAGS -Itools/glulxc -o "$WORK/story" "$WORK/story.c" \
+    tools/glulxc/glulxc.c tools/glulxc/glkstdio.c -lm || exit 1
+$CC $CFLAGS -Itools/glulxc -o "$WORK/refvm" tools/refvm/refvm.c \
+    tools/refvm/zvm.c tools/refvm/gvm.c tools/glulxc/glkstdio.c -lm || exit 1
+
+"$WORK/story" -s 1 < "$SCRIPT" > "$WORK/c.txt" || exit 1
+"$WORK/refvm" -s 1 -p /dev/null -i "$SCRIPT" "$WORK/story.ulx" \
+    > "$WORK/vm.txt" || exit 1
+
+if diff "$WORK/vm.txt" "$WORK/c.txt"
+then echo "Transcripts match"
+else echo "Transcripts differ (< interpreter, > C translation)"; exit 1
+fi
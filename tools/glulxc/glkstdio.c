@@ -0,0 +1,405 @@
+/* ------------------------------------------------------------------------- */
+/*   "glkstdio" : A minimal Glk for translated Glulx stories, reading lines  */
+/*                from stdin and writing the main window to stdout           */
+/*                                                                           */
+/*   Part of Inform 6.43                                                     */
+/*   copyright (c) Graham Nelson 1993 - 2024                                 */
+/*                                                                           */
+/*   This covers what a text game needs for scripted play-throughs: text    */
+/*   buffer and grid windows (grid output is discarded), memory streams,    */
+/*   line and character input, and the case-conversion calls. Files,        */
+/*   sound, graphics, hyperlinks and timers are reported as unavailable by  */
+/*   gestalt, and their calls do nothing and return 0. References passed   */
+/*   as -1 (meaning the Glulx stack) are not supported.                    */
+/*                                                                           */
+/*   With -e, each input line is echoed to stdout as it is read.            */
+/* ------------------------------------------------------------------------- */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "glulxc.h"
+
+#define WINDOW_OBJ 1
+#define STREAM_OBJ 2
+
+#define WINTYPE_TEXTBUFFER 3
+#define WINTYPE_TEXTGRID   4
+
+typedef struct glk_object_s
+{   int kind;                      /* 0 if this slot is free                 */
+    glui32 rock;
+    glui32 wintype;                /* Windows: type                          */
+    glui32 stream;                 /*          and own stream                */
+    glui32 echo;                   /*          and echo stream               */
+    glui32 window;                 /* Streams: window, or 0 for memory       */
+    glui32 buf, buflen, pos;       /*          memory stream buffer          */
+    int unicode;
+    glui32 readcount, writecount;
+} glk_object;
+
+static glk_object *objects;        /* Object n is objects[n-1]               */
+static glui32 no_objects;
+static glui32 root_window, current_stream;
+
+static glui32 line_window, line_buf, line_maxlen;
+static int line_request, line_unicode;
+static glui32 char_window;
+static int char_request;
+static int echo_input;
+
+/* ------------------------------------------------------------------------- */
+/*   Objects                                                                 */
+/* ------------------------------------------------------------------------- */
+
+static glui32 new_object(int kind, glui32 rock)
+{   glui32 i;
+    for (i=0; i<no_objects; i++) if (objects[i].kind == 0) break;
+    if (i == no_objects)
+    {   objects = realloc(objects, (++no_objects)*sizeof(glk_object));
+        if (objects == NULL) glc_fatal("Out of memory");
+    }
+    memset(&objects[i], 0, sizeof(glk_object));
+    objects[i].kind = kind;
+    objects[i].rock = rock;
+    return i+1;
+}
+
+static glk_object *object(glui32 id, int kind)
+{   if ((id == 0) || (id > no_objects) || (objects[id-1].kind != kind))
+        glc_fatal("Invalid Glk object");
+    return &objects[id-1];
+}
+
+static glui32 iterate(int kind, glui32 id, glui32 rockptr)
+{   glui32 i;
+    for (i=id; i<no_objects; i++)
+        if (objects[i].kind == kind)
+        {   if (rockptr) W4(rockptr, objects[i].rock);
+            return i+1;
+        }
+    if (rockptr) W4(rockptr, 0);
+    return 0;
+}
+
+static void close_stream(glui32 id, glui32 result)
+{   glk_object *s = object(id, STREAM_OBJ);
+    glui32 i;
+    if (result)
+    {   W4(result, s->readcount);
+        i = result+4;
+        W4(i, s->writecount);
+    }
+    if (current_stream == id) current_stream = 0;
+    for (i=0; i<no_objects; i++)
+        if ((objects[i].kind == WINDOW_OBJ) && (objects[i].echo == id))
+            objects[i].echo = 0;
+    s->kind = 0;
+}
+
+/* ------------------------------------------------------------------------- */
+/*   Output                                                                  */
+/* ------------------------------------------------------------------------- */
+
+static void put_utf8(glui32 ch)
+{   if (ch < 0x80) putchar(ch);
+    else if (ch < 0x800)
+    {   putchar(0xC0 | (ch >> 6)); putchar(0x80 | (ch & 0x3F));
+    }
+    else if (ch < 0x10000)
+    {   putchar(0xE0 | (ch >> 12)); putchar(0x80 | ((ch >> 6) & 0x3F));
+        putchar(0x80 | (ch & 0x3F));
+    }
+    else
+    {   putchar(0xF0 | (ch >> 18)); putchar(0x80 | ((ch >> 12) & 0x3F));
+        putchar(0x80 | ((ch >> 6) & 0x3F)); putchar(0x80 | (ch & 0x3F));
+    }
+}
+
+static void put_char_stream(glui32 id, glui32 ch)
+{   glk_object *s;
+    glui32 a;
+    if (id == 0) return;
+    s = object(id, STREAM_OBJ);
+    s->writecount++;
+    if (s->window)
+    {   glk_object *w = object(s->window, WINDOW_OBJ);
+        if (w->wintype == WINTYPE_TEXTBUFFER) put_utf8(ch);
+        if (w->echo) put_char_stream(w->echo, ch);
+        return;
+    }
+    if (s->pos >= s->buflen) return;
+    if (s->unicode)
+    {   a = s->buf + 4*s->pos; W4(a, ch);
+    }
+    else
+    {   a = s->buf + s->pos; W1(a, (ch < 0x100) ? ch : '?');
+    }
+    s->pos++;
+}
+
+static void put_string_stream(glui32 id, glui32 addr)
+{   glui32 ch;
+    if (MEM1(addr) == 0xE0)
+        for (addr++; (ch = MEM1(addr)) != 0; addr++)
+            put_char_stream(id, ch);
+    else if (MEM1(addr) == 0xE2)
+        for (addr += 4; (ch = MEM4(addr)) != 0; addr += 4)
+            put_char_stream(id, ch);
+}
+
+static void put_buffer_stream(glui32 id, glui32 addr, glui32 len, int uni)
+{   glui32 i, a;
+    for (i=0; i<len; i++)
+    {   a = addr + (uni ? 4*i : i);
+        put_char_stream(id, uni ? MEM4(a) : MEM1(a));
+    }
+}
+
+static glui32 get_char_stream(glui32 id)
+{   glk_object *s = object(id, STREAM_OBJ);
+    glui32 a;
+    if (s->window || (s->pos >= s->buflen)) return 0xFFFFFFFF;
+    s->readcount++;
+    a = s->buf + (s->unicode ? 4*s->pos : s->pos);
+    s->pos++;
+    return s->unicode ? MEM4(a) : MEM1(a);
+}
+
+/* ------------------------------------------------------------------------- */
+/*   Input                                                                   */
+/* ------------------------------------------------------------------------- */
+
+/*  Read one line of UTF-8 from stdin into chars[], without the newline;
+    returns the number of characters, or -1 at the end of input.             */
+
+static int read_line(glui32 *chars, int max)
+{   int c, n = 0, more = 0;
+    glui32 ch = 0;
+    fflush(stdout);
+    c = getchar();
+    if (c == EOF) return -1;
+    while ((c != EOF) && (c != '\n'))
+    {   if (more && ((c & 0xC0) == 0x80))
+        {   ch = (ch << 6) | (c & 0x3F);
+            more--;
+        }
+        else
+        {   if (c < 0x80) { ch = c; more = 0; }
+            else if ((c & 0xE0) == 0xC0) { ch = c & 0x1F; more = 1; }
+            else if ((c & 0xF0) == 0xE0) { ch = c & 0x0F; more = 2; }
+            else { ch = c & 0x07; more = 3; }
+        }
+        if ((more == 0) && (ch != '\r') && (n < max)) chars[n++] = ch;
+        c = getchar();
+    }
+    if (echo_input)
+    {   int i;
+        for (i=0; i<n; i++) put_utf8(chars[i]);
+        putchar('\n');
+    }
+    return n;
+}
+
+static void write_event(glui32 event, glui32 type, glui32 win,
+    glui32 val1, glui32 val2)
+{   if (event == 0) return;
+    W4(event, type);
+    event += 4; W4(event, win);
+    event += 4; W4(event, val1);
+    event += 4; W4(event, val2);
+}
+
+static glui32 select_event(glui32 event)
+{   glui32 buf[256], i, a;
+    int n;
+
+    if (!line_request && !char_request) glc_quit();
+    n = read_line(buf, line_request ? 256 : 1);
+    if (n < 0) glc_quit();
+
+    if (line_request)
+    {   if ((glui32) n > line_maxlen) n = line_maxlen;
+        for (i=0; i<(glui32) n; i++)
+        {   if (line_unicode)
+            {   a = line_buf + 4*i; W4(a, buf[i]);
+            }
+            else
+            {   a = line_buf + i; W1(a, (buf[i] < 0x100) ? buf[i] : '?');
+            }
+        }
+        line_request = 0;
+        write_event(event, 3, line_window, n, 0);
+        glc_note_input();
+    }
+    else
+    {   char_request = 0;
+        write_event(event, 2, char_window, (n == 0) ? 0xFFFFFFFA : buf[0], 0);
+    }
+    return 0;
+}
+
+/* ------------------------------------------------------------------------- */
+/*   Case conversion (Latin-1 only)                                          */
+/* ------------------------------------------------------------------------- */
+
+static glui32 to_lower(glui32 ch)
+{   if (((ch >= 'A') && (ch <= 'Z'))
+        || ((ch >= 0xC0) && (ch <= 0xDE) && (ch != 0xD7)))
+        return ch + 0x20;
+    return ch;
+}
+
+static glui32 to_upper(glui32 ch)
+{   if (((ch >= 'a') && (ch <= 'z'))
+        || ((ch >= 0xE0) && (ch <= 0xFE) && (ch != 0xF7)))
+        return ch - 0x20;
+    return ch;
+}
+
+static glui32 convert_buffer(glui32 buf, glui32 len, glui32 numchars,
+    int mode, int lowerrest)
+{   glui32 i, a, ch;
+    if (numchars > len) numchars = len;
+    for (i=0; i<numchars; i++)
+    {   a = buf + 4*i;
+        ch = MEM4(a);
+        if ((mode == 0) || ((mode == 2) && (i > 0) && lowerrest))
+            ch = to_lower(ch);
+        else if ((mode == 1) || ((mode == 2) && (i == 0)))
+            ch = to_upper(ch);
+        W4(a, ch);
+    }
+    return numchars;
+}
+
+/* ------------------------------------------------------------------------- */
+/*   The dispatcher                                                          */
+/* ------------------------------------------------------------------------- */
+
+extern void glkshim_init(int argc, char **argv)
+{   int i;
+    for (i=1; i<argc; i++)
+        if (strcmp(argv[i], "-e") == 0) echo_input = 1;
+}
+
+extern void glkshim_exit(void)
+{   fflush(stdout);
+}
+
+extern glui32 glkshim_call(glui32 sel, glui32 argc, glui32 *argv)
+{   glui32 a[8], i, id;
+    glk_object *o;
+
+    for (i=0; i<8; i++) a[i] = (i < argc) ? argv[i] : 0;
+
+    switch (sel)
+    {   case 0x01: glc_quit(); return 0;                     /* exit */
+        case 0x04: case 0x05:                                /* gestalt */
+            switch (a[0])
+            {   case 0: return 0x00070600;
+                case 1: case 2: case 15: return 1;
+                case 3: return 2;
+            }
+            return 0;
+
+        case 0x20: return iterate(WINDOW_OBJ, a[0], a[1]);   /* window_... */
+        case 0x21: return object(a[0], WINDOW_OBJ)->rock;
+        case 0x22: return root_window;
+        case 0x23:
+            if ((a[3] != WINTYPE_TEXTBUFFER) && (a[3] != WINTYPE_TEXTGRID))
+                return 0;
+            if ((a[0] == 0) != (root_window == 0)) return 0;
+            id = new_object(WINDOW_OBJ, a[4]);
+            i = new_object(STREAM_OBJ, 0);
+            objects[id-1].wintype = a[3];
+            objects[id-1].stream = i;
+            objects[i-1].window = id;
+            if (root_window == 0) root_window = id;
+            return id;
+        case 0x24:
+            o = object(a[0], WINDOW_OBJ);
+            close_stream(o->stream, a[1]);
+            if (root_window == a[0]) root_window = 0;
+            o->kind = 0;
+            return 0;
+        case 0x25:
+            o = object(a[0], WINDOW_OBJ);
+            if (a[1]) W4(a[1], 80);
+            if (a[2]) W4(a[2], (o->wintype == WINTYPE_TEXTGRID) ? 1 : 24);
+            return 0;
+        case 0x27:
+            if (a[1]) W4(a[1], 0);
+            if (a[2]) W4(a[2], 0);
+            if (a[3]) W4(a[3], 0);
+            return 0;
+        case 0x28: return object(a[0], WINDOW_OBJ)->wintype;
+        case 0x2C: return object(a[0], WINDOW_OBJ)->stream;
+        case 0x2D: object(a[0], WINDOW_OBJ)->echo = a[1]; return 0;
+        case 0x2E: return object(a[0], WINDOW_OBJ)->echo;
+        case 0x2F:
+            current_stream = a[0] ? object(a[0], WINDOW_OBJ)->stream : 0;
+            return 0;
+
+        case 0x40: return iterate(STREAM_OBJ, a[0], a[1]);   /* stream_... */
+        case 0x41: return object(a[0], STREAM_OBJ)->rock;
+        case 0x43: case 0x138:
+            id = new_object(STREAM_OBJ, a[3]);
+            objects[id-1].buf = a[0];
+            objects[id-1].buflen = a[0] ? a[1] : 0;
+            objects[id-1].unicode = (sel == 0x138);
+            return id;
+        case 0x44: close_stream(a[0], a[1]); return 0;
+        case 0x45:
+            o = object(a[0], STREAM_OBJ);
+            if (o->window) return 0;
+            switch (a[2])
+            {   case 0: o->pos = a[1]; break;
+                case 1: o->pos += a[1]; break;
+                case 2: o->pos = o->buflen + a[1]; break;
+            }
+            if ((glsi32) o->pos < 0) o->pos = 0;
+            if (o->pos > o->buflen) o->pos = o->buflen;
+            return 0;
+        case 0x46: return object(a[0], STREAM_OBJ)->pos;
+        case 0x47:
+            if (a[0]) object(a[0], STREAM_OBJ);
+            current_stream = a[0];
+            return 0;
+        case 0x48: return current_stream;
+
+        case 0x80: case 0x128: put_char_stream(current_stream, a[0]); return 0;
+        case 0x81: case 0x12B: put_char_stream(a[0], a[1]); return 0;
+        case 0x82: case 0x129:
+            put_string_stream(current_stream, a[0]); return 0;
+        case 0x83: case 0x12C: put_string_stream(a[0], a[1]); return 0;
+        case 0x84: put_buffer_stream(current_stream, a[0], a[1], 0); return 0;
+        case 0x85: put_buffer_stream(a[0], a[1], a[2], 0); return 0;
+        case 0x12A: put_buffer_stream(current_stream, a[0], a[1], 1); return 0;
+        case 0x12D: put_buffer_stream(a[0], a[1], a[2], 1); return 0;
+        case 0x90: case 0x130: return get_char_stream(a[0]);
+
+        case 0xA0: return to_lower(a[0] & 0xFF);
+        case 0xA1: return to_upper(a[0] & 0xFF);
+        case 0x120: return convert_buffer(a[0], a[1], a[2], 0, 0);
+        case 0x121: return convert_buffer(a[0], a[1], a[2], 1, 0);
+        case 0x122: return convert_buffer(a[0], a[1], a[2], 2, a[3]);
+
+        case 0xC0: return select_event(a[0]);
+        case 0xC1: write_event(a[0], 0, 0, 0, 0); return 0;
+        case 0xD0: case 0x141:
+            line_request = 1; line_unicode = (sel == 0x141);
+            line_window = a[0]; line_buf = a[1]; line_maxlen = a[2];
+            return 0;
+        case 0xD1:
+            if (line_request) write_event(a[1], 3, a[0], 0, 0);
+            else write_event(a[1], 0, 0, 0, 0);
+            line_request = 0;
+            return 0;
+        case 0xD2: case 0x140:
+            char_request = 1; char_window = a[0];
+            return 0;
+        case 0xD3: char_request = 0; return 0;
+    }
+    return 0;
+}
@@ -0,0 +1,772 @@
+/* ------------------------------------------------------------------------- */
+/*   "glulxc" : Runtime for Glulx stories translated into C                  */
+/*                                                                           */
+/*   Part of Inform 6.43                                                     */
+/*   copyright (c) Graham Nelson 1993 - 2024                                 */
+/*                                                                           */
+/*   The translated code keeps the Glulx value stack and memory map: locals */
+/*   live on glc_stk above the caller's values, and memory is one big-endian */
+/*   byte array initialised from the story image. Calls between functions   */
+/*   are C calls, so there are no call frames on glc_stk.                    */
+/*                                                                           */
+/*   Not supported: @save, @restore and the undo opcodes (which report      */
+/*   failure), and the @malloc heap (which gestalt reports as absent).       */
+/*   @accelfunc and @accelparam are accepted and ignored.                    */
+/*                                                                           */
+/*   Options: -s <n> seeds the random number generator; -c measures, after  */
+/*   each line of input, how large a Quetzal save's CMem chunk would be,    */
+/*   and reports the figures on stderr at exit.                             */
+/* ------------------------------------------------------------------------- */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "glulxc.h"
+
+unsigned char *glc_mem;            /* Main memory, glc_memsize bytes         */
+glui32 glc_memsize, glc_ramstart;
+glui32 *glc_stk, glc_sp, glc_stacksize;
+glui32 *glc_args;
+glui32 glc_thrown;
+glc_catch_t **glc_catches;         /* Active catches, innermost last         */
+glui32 glc_ncatches, glc_depth;
+glui32 glc_stringtbl, glc_iosys_mode, glc_iosys_rock;
+
+static glui32 no_args_allocated, catches_allocated;
+static glui32 orig_endmem;
+static glui32 protect_start, protect_length;
+static jmp_buf top_level;
+static glui32 rng_state;
+static int measure_saves;
+static glui32 save_turns, save_max, save_last;
+static double save_total;
+
+/* ------------------------------------------------------------------------- */
+/*   Errors                                                                  */
+/* ------------------------------------------------------------------------- */
+
+extern void glc_fatal(const char *msg)
+{   fflush(stdout);
+    fprintf(stderr, "Glulx fatal error: %s\n", msg);
+    exit(1);
+}
+
+extern glui32 glc_bad_access(glui32 addr)
+{   char buf[64];
+    if ((addr < glc_memsize) && (addr < glc_ramstart))
+        sprintf(buf, "Write to ROM at $%lx", (unsigned long) addr);
+    else
+        sprintf(buf, "Memory access out of range at $%lx",
+            (unsigned long) addr);
+    glc_fatal(buf);
+    return 0;
+}
+
+static void check_range(glui32 addr, glui32 length, int writing)
+{   if ((addr > glc_memsize) || (length > glc_memsize - addr)
+        || (writing && (addr < glc_ramstart)))
+        glc_bad_access(addr);
+}
+
+/* ------------------------------------------------------------------------- */
+/*   Calls, returns, catch and throw                                         */
+/* ------------------------------------------------------------------------- */
+
+static void ensure_stack(glui32 n)
+{   if (n > glc_stacksize - glc_sp) glc_fatal("Stack overflow");
+}
+
+extern glui32 glc_enter(glui32 nlocals, glui32 argc, const glui32 *argv)
+{   glui32 fp = glc_sp, i;
+    ensure_stack(nlocals);
+    for (i=0; i<nlocals; i++)
+        glc_stk[fp+i] = (i < argc) ? argv[i] : 0;
+    glc_sp = fp + nlocals;
+    glc_depth++;
+    return fp;
+}
+
+extern glui32 glc_enter_stk(glui32 nlocals, glui32 argc, const glui32 *argv)
+{   glui32 fp = glc_sp, i;
+    ensure_stack(nlocals + argc + 1);
+    for (i=0; i<nlocals; i++) glc_stk[fp+i] = 0;
+    glc_sp = fp + nlocals;
+    for (i=argc; i>0; i--) glc_stk[glc_sp++] = argv[i-1];
+    glc_stk[glc_sp++] = argc;
+    glc_depth++;
+    return fp;
+}
+
+extern glui32 glc_call(glui32 addr, glui32 argc, glui32 *argv)
+{   glui32 lo = 0, hi = glc_function_count, mid;
+    char buf[64];
+    while (lo < hi)
+    {   mid = (lo + hi)/2;
+        if (glc_functions[mid].addr == addr)
+            return (*glc_functions[mid].fn)(argc, argv);
+        if (glc_functions[mid].addr < addr) lo = mid+1; else hi = mid;
+    }
+    sprintf(buf, "Call to non-function at $%lx", (unsigned long) addr);
+    glc_fatal(buf);
+    return 0;
+}
+
+/*  Pop argc values into glc_args, the first popped becoming the first
+    argument, as @call, @tailcall and @glk require.                          */
+
+static void ensure_args(glui32 argc)
+{   if (argc > no_args_allocated)
+    {   no_args_allocated = argc + 16;
+        glc_args = realloc(glc_args, no_args_allocated*sizeof(glui32));
+        if (glc_args == NULL) glc_fatal("Out of memory");
+    }
+}
+
+extern void glc_pop_args(glui32 argc)
+{   glui32 i;
+    ensure_args(argc);
+    if (argc > glc_sp) glc_fatal("Stack underflow in call");
+    for (i=0; i<argc; i++) glc_args[i] = glc_stk[--glc_sp];
+}
+
+extern glui32 glc_catch(void)
+{   if (glc_ncatches == catches_allocated)
+    {   glui32 i = catches_allocated;
+        catches_allocated = 2*catches_allocated + 8;
+        glc_catches = realloc(glc_catches,
+            catches_allocated*sizeof(glc_catch_t *));
+        if (glc_catches == NULL) glc_fatal("Out of memory");
+        for (; i<catches_allocated; i++)
+        {   glc_catches[i] = malloc(sizeof(glc_catch_t));
+            if (glc_catches[i] == NULL) glc_fatal("Out of memory");
+        }
+    }
+    glc_catches[glc_ncatches]->depth = glc_depth;
+    glc_catches[glc_ncatches]->sp = glc_sp;
+    return ++glc_ncatches;
+}
+
+/*  Called on every return, to forget the catches made by the function.     */
+
+extern void glc_drop_catches(void)
+{   while ((glc_ncatches > 0)
+           && (glc_catches[glc_ncatches-1]->depth > glc_depth))
+        glc_ncatches--;
+}
+
+extern void glc_throw(glui32 value, glui32 token)
+{   glc_catch_t *c;
+    if ((token == 0) || (token > glc_ncatches))
+        glc_fatal("Throw to an invalid catch token");
+    c = glc_catches[token-1];
+    glc_ncatches = token-1;
+    glc_sp = c->sp;
+    glc_depth = c->depth;
+    glc_thrown = value;
+    longjmp(c->jb, 1);
+}
+
+/* ------------------------------------------------------------------------- */
+/*   Arithmetic and bit operations with awkward cases                        */
+/* ------------------------------------------------------------------------- */
+
+extern glui32 glc_div(glui32 a, glui32 b)
+{   if (b == 0) glc_fatal("Division by zero");
+    if ((a == 0x80000000) && (b == 0xFFFFFFFF)) return a;
+    return (glui32) ((glsi32) a / (glsi32) b);
+}
+
+extern glui32 glc_mod(glui32 a, glui32 b)
+{   if (b == 0) glc_fatal("Division by zero doing remainder");
+    if (b == 0xFFFFFFFF) return 0;
+    return (glui32) ((glsi32) a % (glsi32) b);
+}
+
+extern glui32 glc_sshiftr(glui32 a, glui32 b)
+{   if (b >= 32) return (a & 0x80000000) ? 0xFFFFFFFF : 0;
+    if (a & 0x80000000) return ~((~a) >> b);
+    return a >> b;
+}
+
+extern glui32 glc_aloadbit(glui32 addr, glui32 bit)
+{   glsi32 b = (glsi32) bit;
+    addr += (b >= 0) ? (glui32) (b/8) : (glui32) -(glsi32)((-(b+1))/8 + 1);
+    return (MEM1(addr) >> (bit & 7)) & 1;
+}
+
+extern void glc_astorebit(glui32 addr, glui32 bit, glui32 value)
+{   glsi32 b = (glsi32) bit;
+    glui32 byte;
+    addr += (b >= 0) ? (glui32) (b/8) : (glui32) -(glsi32)((-(b+1))/8 + 1);
+    byte = MEM1(addr);
+    if (value) byte |= (1 << (bit & 7)); else byte &= ~(1 << (bit & 7));
+    W1(addr, byte);
+}
+
+/* ------------------------------------------------------------------------- */
+/*   Stack manipulation (base is where the current function's values start) */
+/* ------------------------------------------------------------------------- */
+
+static void check_values(glui32 base, glui32 n)
+{   if (glc_sp - base < n) glc_fatal("Stack underflow");
+}
+
+extern glui32 glc_stkpeek(glui32 base, glui32 pos)
+{   check_values(base, pos+1);
+    return glc_stk[glc_sp-1-pos];
+}
+
+extern void glc_stkswap(glui32 base)
+{   glui32 x;
+    check_values(base, 2);
+    x = glc_stk[glc_sp-1];
+    glc_stk[glc_sp-1] = glc_stk[glc_sp-2];
+    glc_stk[glc_sp-2] = x;
+}
+
+extern void glc_stkroll(glui32 base, glui32 count, glui32 shift)
+{   glsi32 s = (glsi32) shift;
+    glui32 i, n, *tmp;
+    if ((glsi32) count < 0)
+        glc_fatal("Stack operation stkroll had negative count");
+    if (count == 0) return;
+    check_values(base, count);
+    if (s > 0) n = s % count; else n = count - ((glui32) -s) % count;
+    if (n == count) n = 0;
+    if (n == 0) return;
+    tmp = malloc(count*sizeof(glui32));
+    if (tmp == NULL) glc_fatal("Out of memory");
+    for (i=0; i<count; i++) tmp[(i+n) % count] = glc_stk[glc_sp-count+i];
+    memcpy(glc_stk+glc_sp-count, tmp, count*sizeof(glui32));
+    free(tmp);
+}
+
+extern void glc_stkcopy(glui32 base, glui32 count)
+{   glui32 i;
+    check_values(base, count);
+    ensure_stack(count);
+    for (i=0; i<count; i++, glc_sp++)
+        glc_stk[glc_sp] = glc_stk[glc_sp-count];
+}
+
+/* ------------------------------------------------------------------------- */
+/*   Output                                                                  */
+/* ------------------------------------------------------------------------- */
+
+extern void glc_setiosys(glui32 mode, glui32 rock)
+{   if (mode > 2) mode = 0;
+    glc_iosys_mode = mode;
+    glc_iosys_rock = rock;
+}
+
+extern void glc_streamchar(glui32 ch)
+{   ch &= 0xFF;
+    switch (glc_iosys_mode)
+    {   case 1: glc_call(glc_iosys_rock, 1, &ch); break;
+        case 2: glkshim_call(0x80, 1, &ch); break;
+    }
+}
+
+extern void glc_streamunichar(glui32 ch)
+{   switch (glc_iosys_mode)
+    {   case 1: glc_call(glc_iosys_rock, 1, &ch); break;
+        case 2: glkshim_call(0x128, 1, &ch); break;
+    }
+}
+
+extern void glc_streamnum(glui32 n)
+{   char buf[16];
+    int i;
+    sprintf(buf, "%ld", (long) (glsi32) n);
+    for (i=0; buf[i]; i++) glc_streamchar((unsigned char) buf[i]);
+}
+
+/*  Print the string, or call the function, at addr: as an indirect
+    reference inside a compressed string requires.                           */
+
+static void print_or_call(glui32 addr, glui32 argc, glui32 argsat)
+{   glui32 type = MEM1(addr), i, *argv;
+    if ((type >= 0xE0) && (type <= 0xFF))
+    {   glc_streamstr(addr); return;
+    }
+    if ((type == 0xC0) || (type == 0xC1))
+    {   argv = malloc((argc+1)*sizeof(glui32));
+        if (argv == NULL) glc_fatal("Out of memory");
+        for (i=0; i<argc; i++) argv[i] = MEM4(argsat+4*i);
+        glc_call(addr, argc, argv);
+        free(argv);
+        return;
+    }
+    glc_fatal("Unknown object while decoding string indirect reference");
+}
+
+extern void glc_streamstr(glui32 addr)
+{   glui32 type = MEM1(addr), p, ch, root, node, byte, bit;
+
+    switch (type)
+    {   case 0xE0:
+            for (p = addr+1; (ch = MEM1(p)) != 0; p++) glc_streamchar(ch);
+            return;
+        case 0xE2:
+            for (p = addr+4; (ch = MEM4(p)) != 0; p += 4)
+                glc_streamunichar(ch);
+            return;
+        case 0xE1:
+            break;
+        default:
+            glc_fatal("Attempt to print non-string");
+    }
+
+    if (glc_stringtbl == 0)
+        glc_fatal("Attempt to print a compressed string with no table");
+    root = MEM4(glc_stringtbl+8);
+    p = addr+1; bit = 0; byte = MEM1(p);
+    node = root;
+    for (;;)
+    {   switch (MEM1(node))
+        {   case 0x00:
+                node = MEM4(node + 1 + 4*((byte >> bit) & 1));
+                if (++bit == 8) { bit = 0; p++; byte = MEM1(p); }
+                continue;
+            case 0x01:
+                return;
+            case 0x02:
+                glc_streamchar(MEM1(node+1)); break;
+            case 0x03:
+                for (ch = node+1; MEM1(ch) != 0; ch++)
+                    glc_streamchar(MEM1(ch));
+                break;
+            case 0x04:
+                glc_streamunichar(MEM4(node+1)); break;
+            case 0x05:
+                for (ch = node+1; MEM4(ch) != 0; ch += 4)
+                    glc_streamunichar(MEM4(ch));
+                break;
+            case 0x08:
+                print_or_call(MEM4(node+1), 0, 0); break;
+            case 0x09:
+                ch = MEM4(node+1);
+                print_or_call(MEM4(ch), 0, 0); break;
+            case 0x0A:
+                print_or_call(MEM4(node+1), MEM4(node+5), node+9); break;
+            case 0x0B:
+                ch = MEM4(node+1);
+                print_or_call(MEM4(ch), MEM4(node+5), node+9); break;
+            default:
+                glc_fatal("Unknown node type in string table");
+        }
+        node = root;
+    }
+}
+
+extern glui32 glc_glk(glui32 sel, glui32 argc)
+{   glc_pop_args(argc);
+    return glkshim_call(sel, argc, glc_args);
+}
+
+/* ------------------------------------------------------------------------- */
+/*   Memory, the random number generator and the system                      */
+/* ------------------------------------------------------------------------- */
+
+extern glui32 glc_gestalt(glui32 sel, glui32 arg)
+{   switch (sel)
+    {   case 0: return 0x00030103;      /* GlulxVersion */
+        case 1: return 0x00000100;      /* TerpVersion */
+        case 2: return 1;               /* ResizeMem */
+        case 4: return (arg <= 2);      /* IOSystem */
+        case 5: return 1;               /* Unicode */
+        case 6: return 1;               /* MemCopy */
+        case 11: return 1;              /* Float */
+        case 13: return 1;              /* Double */
+    }
+    return 0;
+}
+
+extern glui32 glc_setmemsize(glui32 size)
+{   unsigned char *m;
+    if ((size < orig_endmem) || (size % 256)) return 1;
+    m = realloc(glc_mem, size);
+    if (m == NULL) return 1;
+    if (size > glc_memsize) memset(m + glc_memsize, 0, size - glc_memsize);
+    glc_mem = m;
+    glc_memsize = size;
+    return 0;
+}
+
+extern void glc_mzero(glui32 count, glui32 addr)
+{   check_range(addr, count, 1);
+    memset(glc_mem+addr, 0, count);
+}
+
+extern void glc_mcopy(glui32 count, glui32 from, glui32 to)
+{   check_range(from, count, 0);
+    check_range(to, count, 1);
+    memmove(glc_mem+to, glc_mem+from, count);
+}
+
+static glui32 next_random(void)
+{   rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+extern void glc_setrandom(glui32 seed)
+{   if (seed == 0) seed = (glui32) time(NULL);
+    rng_state = seed * 2654435761U;
+    if (rng_state == 0) rng_state = 0x12345678;
+    next_random();
+}
+
+extern glui32 glc_random(glui32 range)
+{   glsi32 r = (glsi32) range;
+    if (r == 0) return next_random();
+    if (r > 0) return next_random() % range;
+    return (glui32) -(glsi32) (next_random() % (glui32) -r);
+}
+
+extern void glc_protect(glui32 start, glui32 length)
+{   protect_start = start;
+    protect_length = length;
+}
+
+extern void glc_quit(void)
+{   longjmp(top_level, 1);
+}
+
+extern void glc_restart(void)
+{   longjmp(top_level, 2);
+}
+
+/* ------------------------------------------------------------------------- */
+/*   Searching                                                               */
+/* ------------------------------------------------------------------------- */
+
+/*  Sets *kp to the key bytes for a search, copying a direct key into kb.    */
+
+static void search_key(glui32 key, glui32 keysize, glui32 options,
+    unsigned char *kb, const unsigned char **kp)
+{   glui32 i;
+    if (options & 1)
+    {   check_range(key, keysize, 0);
+        *kp = glc_mem + key;
+        return;
+    }
+    if ((keysize != 1) && (keysize != 2) && (keysize != 4))
+        glc_fatal("Direct search key must hold one, two, or four bytes");
+    for (i=0; i<keysize; i++) kb[i] = (key >> (8*(keysize-1-i))) & 0xFF;
+    *kp = kb;
+}
+
+static int zero_key(glui32 addr, glui32 keysize)
+{   glui32 i;
+    for (i=0; i<keysize; i++) if (glc_mem[addr+i]) return 0;
+    return 1;
+}
+
+extern glui32 glc_linearsearch(glui32 key, glui32 keysize, glui32 start,
+    glui32 structsize, glui32 numstructs, glui32 keyoffset, glui32 options)
+{   unsigned char kb[4];
+    const unsigned char *kp;
+    glui32 i, addr;
+    search_key(key, keysize, options, kb, &kp);
+    for (i=0; (numstructs == 0xFFFFFFFF) || (i < numstructs); i++)
+    {   addr = start + i*structsize + keyoffset;
+        check_range(addr, keysize, 0);
+        if (memcmp(glc_mem+addr, kp, keysize) == 0)
+            return (options & 4) ? i : start + i*structsize;
+        if ((options & 2) && zero_key(addr, keysize)) break;
+    }
+    return (options & 4) ? 0xFFFFFFFF : 0;
+}
+
+extern glui32 glc_binarysearch(glui32 key, glui32 keysize, glui32 start,
+    glui32 structsize, glui32 numstructs, glui32 keyoffset, glui32 options)
+{   unsigned char kb[4];
+    const unsigned char *kp;
+    glui32 lo = 0, hi = numstructs, mid, addr;
+    int cmp;
+    search_key(key, keysize, options, kb, &kp);
+    while (lo < hi)
+    {   mid = (lo + hi)/2;
+        addr = start + mid*structsize + keyoffset;
+        check_range(addr, keysize, 0);
+        cmp = memcmp(glc_mem+addr, kp, keysize);
+        if (cmp == 0) return (options & 4) ? mid : start + mid*structsize;
+        if (cmp < 0) lo = mid+1; else hi = mid;
+    }
+    return (options & 4) ? 0xFFFFFFFF : 0;
+}
+
+extern glui32 glc_linkedsearch(glui32 key, glui32 keysize, glui32 start,
+    glui32 keyoffset, glui32 nextoffset, glui32 options)
+{   unsigned char kb[4];
+    const unsigned char *kp;
+    glui32 addr;
+    search_key(key, keysize, options, kb, &kp);
+    while (start != 0)
+    {   addr = start + keyoffset;
+        check_range(addr, keysize, 0);
+        if (memcmp(glc_mem+addr, kp, keysize) == 0) return start;
+        if ((options & 2) && zero_key(addr, keysize)) break;
+        addr = start + nextoffset;
+        start = MEM4(addr);
+    }
+    return 0;
+}
+
+/* ------------------------------------------------------------------------- */
+/*   Floating-point opcodes. Operands are passed in instruction order; the  */
+/*   result is the branch condition, and *v and *w receive the first and    */
+/*   second stored values. Doubles are loaded high word first, and stored   */
+/*   low word (*v) first.                                                    */
+/* ------------------------------------------------------------------------- */
+
+static float fl(glui32 x)  { float f;  memcpy(&f, &x, 4); return f; }
+static glui32 enc(float f) { glui32 x; memcpy(&x, &f, 4); return x; }
+
+static double dbl(glui32 hi, glui32 lo)
+{   uint64_t x = ((uint64_t) hi << 32) | lo;
+    double d;
+    memcpy(&d, &x, 8);
+    return d;
+}
+static void encd(double d, glui32 *v, glui32 *w)
+{   uint64_t x;
+    memcpy(&x, &d, 8);
+    *v = (glui32) x; *w = (glui32) (x >> 32);
+}
+
+static glui32 to_num(double d, int neg, int round)
+{   if (!neg)
+    {   if (isnan(d) || isinf(d) || (d > 2147483647.0)) return 0x7FFFFFFF;
+    }
+    else
+    {   if (isnan(d) || isinf(d) || (d < -2147483647.0)) return 0x80000000;
+    }
+    if (round) d = neg ? ceil(d - 0.5) : floor(d + 0.5);
+    return (glui32) (glsi32) (neg ? ceil(d) : floor(d));
+}
+
+static float fpow(float a, float b)
+{   if ((a == 1.0f) || (b == 0.0f) || (b == -0.0f)) return 1.0f;
+    if ((a == -1.0f) && isinf(b)) return 1.0f;
+    return powf(a, b);
+}
+
+static double dpow(double a, double b)
+{   if ((a == 1.0) || (b == 0.0)) return 1.0;
+    if ((a == -1.0) && isinf(b)) return 1.0;
+    return pow(a, b);
+}
+
+static int feq(glui32 a, glui32 b, glui32 tol)
+{   float d, t;
+    if (((tol & 0x7F800000) == 0x7F800000) && (tol & 0x007FFFFF)) return 0;
+    if (((a == 0x7F800000) || (a == 0xFF800000))
+        && ((b == 0x7F800000) || (b == 0xFF800000)))
+        return (a == b);
+    d = fl(b) - fl(a); t = fabsf(fl(tol));
+    return ((d <= t) && (d >= -t));
+}
+
+static int deq(double a, double b, double tol)
+{   double d;
+    if (isnan(tol)) return 0;
+    if (isinf(a) && isinf(b)) return (a == b);
+    d = b - a; tol = fabs(tol);
+    return ((d <= tol) && (d >= -tol));
+}
+
+extern int glc_fop(glui32 op, glui32 a0, glui32 a1, glui32 a2, glui32 a3,
+    glui32 a4, glui32 a5, glui32 *v, glui32 *w)
+{   float f;
+    double d, e;
+    switch (op)
+    {   case 0x190: *v = enc((float) (glsi32) a0); break;
+        case 0x191: *v = to_num(fl(a0), (a0 & 0x80000000) != 0, 0); break;
+        case 0x192: *v = to_num(fl(a0), (a0 & 0x80000000) != 0, 1); break;
+        case 0x198: *v = enc(ceilf(fl(a0))); break;
+        case 0x199: *v = enc(floorf(fl(a0))); break;
+        case 0x1A0: *v = enc(fl(a0) + fl(a1)); break;
+        case 0x1A1: *v = enc(fl(a0) - fl(a1)); break;
+        case 0x1A2: *v = enc(fl(a0) * fl(a1)); break;
+        case 0x1A3: *v = enc(fl(a0) / fl(a1)); break;
+        case 0x1A4:
+            f = fmodf(fl(a0), fl(a1));
+            *v = enc(f);
+            *w = enc((fl(a0) - f) / fl(a1));
+            if ((*w == 0) || (*w == 0x80000000)) *w = (a0 ^ a1) & 0x80000000;
+            break;
+        case 0x1A8: *v = enc(sqrtf(fl(a0))); break;
+        case 0x1A9: *v = enc(expf(fl(a0))); break;
+        case 0x1AA: *v = enc(logf(fl(a0))); break;
+        case 0x1AB: *v = enc(fpow(fl(a0), fl(a1))); break;
+        case 0x1B0: *v = enc(sinf(fl(a0))); break;
+        case 0x1B1: *v = enc(cosf(fl(a0))); break;
+        case 0x1B2: *v = enc(tanf(fl(a0))); break;
+        case 0x1B3: *v = enc(asinf(fl(a0))); break;
+        case 0x1B4: *v = enc(acosf(fl(a0))); break;
+        case 0x1B5: *v = enc(atanf(fl(a0))); break;
+        case 0x1B6: *v = enc(atan2f(fl(a0), fl(a1))); break;
+        case 0x1C0: return feq(a0, a1, a2);
+        case 0x1C1: return !feq(a0, a1, a2);
+        case 0x1C2: return fl(a0) < fl(a1);
+        case 0x1C3: return fl(a0) <= fl(a1);
+        case 0x1C4: return fl(a0) > fl(a1);
+        case 0x1C5: return fl(a0) >= fl(a1);
+        case 0x1C8: return isnan(fl(a0)) != 0;
+        case 0x1C9: return isinf(fl(a0)) != 0;
+
+        case 0x200: encd((double) (glsi32) a0, v, w); break;
+        case 0x201: *v = to_num(dbl(a0, a1), (a0 & 0x80000000) != 0, 0); break;
+        case 0x202: *v = to_num(dbl(a0, a1), (a0 & 0x80000000) != 0, 1); break;
+        case 0x203: encd((double) fl(a0), v, w); break;
+        case 0x204: *v = enc((float) dbl(a0, a1)); break;
+        case 0x208: encd(ceil(dbl(a0, a1)), v, w); break;
+        case 0x209: encd(floor(dbl(a0, a1)), v, w); break;
+        case 0x210: encd(dbl(a0, a1) + dbl(a2, a3), v, w); break;
+        case 0x211: encd(dbl(a0, a1) - dbl(a2, a3), v, w); break;
+        case 0x212: encd(dbl(a0, a1) * dbl(a2, a3), v, w); break;
+        case 0x213: encd(dbl(a0, a1) / dbl(a2, a3), v, w); break;
+        case 0x214: encd(fmod(dbl(a0, a1), dbl(a2, a3)), v, w); break;
+        case 0x215:
+            d = dbl(a0, a1); e = dbl(a2, a3);
+            encd((d - fmod(d, e)) / e, v, w);
+            if ((*v == 0) && ((*w == 0) || (*w == 0x80000000)))
+                *w = (a0 ^ a2) & 0x80000000;
+            break;
+        case 0x218: encd(sqrt(dbl(a0, a1)), v, w); break;
+        case 0x219: encd(exp(dbl(a0, a1)), v, w); break;
+        case 0x21A: encd(log(dbl(a0, a1)), v, w); break;
+        case 0x21B: encd(dpow(dbl(a0, a1), dbl(a2, a3)), v, w); break;
+        case 0x220: encd(sin(dbl(a0, a1)), v, w); break;
+        case 0x221: encd(cos(dbl(a0, a1)), v, w); break;
+        case 0x222: encd(tan(dbl(a0, a1)), v, w); break;
+        case 0x223: encd(asin(dbl(a0, a1)), v, w); break;
+        case 0x224: encd(acos(dbl(a0, a1)), v, w); break;
+        case 0x225: encd(atan(dbl(a0, a1)), v, w); break;
+        case 0x226: encd(atan2(dbl(a0, a1), dbl(a2, a3)), v, w); break;
+        case 0x230: return deq(dbl(a0, a1), dbl(a2, a3), dbl(a4, a5));
+        case 0x231: return !deq(dbl(a0, a1), dbl(a2, a3), dbl(a4, a5));
+        case 0x232: return dbl(a0, a1) < dbl(a2, a3);
+        case 0x233: return dbl(a0, a1) <= dbl(a2, a3);
+        case 0x234: return dbl(a0, a1) > dbl(a2, a3);
+        case 0x235: return dbl(a0, a1) >= dbl(a2, a3);
+        case 0x238: return isnan(dbl(a0, a1)) != 0;
+        case 0x239: return isinf(dbl(a0, a1)) != 0;
+        default: glc_fatal("Unknown floating-point opcode");
+    }
+    return 0;
+}
+
+/* ------------------------------------------------------------------------- */
+/*   Save size measurement                                                   */
+/* ------------------------------------------------------------------------- */
+
+/*  The length of a Quetzal CMem chunk for the current RAM: each byte is
+    XORed with the original, a run of zeros becomes a zero and a count of
+    up to 255 further zeros, and trailing zeros are left out.                */
+
+static glui32 cmem_size(void)
+{   glui32 extstart = GLC_GET4(glc_image+12), size = 4, run = 0, i;
+    unsigned char b;
+    for (i=glc_ramstart; i<glc_memsize; i++)
+    {   b = glc_mem[i];
+        if (i < extstart) b ^= glc_image[i];
+        if (b == 0) { run++; continue; }
+        size += 2*((run+255)/256) + 1;
+        run = 0;
+    }
+    return size;
+}
+
+extern void glc_note_input(void)
+{   if (!measure_saves) return;
+    save_last = cmem_size();
+    if (save_last > save_max) save_max = save_last;
+    save_total += save_last;
+    save_turns++;
+}
+
+static void report_saves(void)
+{   if (!measure_saves) return;
+    if (save_turns == 0)
+    {   fprintf(stderr, "No input was read, so no saves were measured\n");
+        return;
+    }
+    fprintf(stderr, "CMem size over %lu inputs: mean %.0f, max %lu, last %lu"
+        " bytes (RAM is %lu bytes)\n", (unsigned long) save_turns,
+        save_total/save_turns, (unsigned long) save_max,
+        (unsigned long) save_last, (unsigned long) (glc_memsize-glc_ramstart));
+}
+
+/* ------------------------------------------------------------------------- */
+/*   Starting and restarting                                                 */
+/* ------------------------------------------------------------------------- */
+
+static void reset_machine(void)
+{   glui32 extstart = GLC_GET4(glc_image+12);
+    unsigned char *saved = NULL;
+
+    if (glc_mem && protect_length)
+    {   check_range(protect_start, protect_length, 0);
+        saved = malloc(protect_length);
+        if (saved == NULL) glc_fatal("Out of memory");
+        memcpy(saved, glc_mem+protect_start, protect_length);
+    }
+
+    glc_ramstart = GLC_GET4(glc_image+8);
+    orig_endmem = GLC_GET4(glc_image+16);
+    glc_memsize = orig_endmem;
+    glc_mem = realloc(glc_mem, glc_memsize);
+    if (glc_mem == NULL) glc_fatal("Out of memory");
+    memcpy(glc_mem, glc_image, extstart);
+    memset(glc_mem+extstart, 0, glc_memsize-extstart);
+
+    if (saved)
+    {   if (protect_start + protect_length <= glc_memsize)
+            memcpy(glc_mem+protect_start, saved, protect_length);
+        free(saved);
+    }
+
+    glc_stacksize = GLC_GET4(glc_image+20)/4;
+    if (glc_stk == NULL)
+    {   glc_stk = malloc((glc_stacksize+1)*sizeof(glui32));
+        if (glc_stk == NULL) glc_fatal("Out of memory");
+    }
+    if (glc_args == NULL) ensure_args(16);
+    glc_sp = 0;
+    glc_ncatches = 0;
+    glc_depth = 0;
+    glc_stringtbl = GLC_GET4(glc_image+28);
+    glc_iosys_mode = 0; glc_iosys_rock = 0;
+}
+
+int main(int argc, char **argv)
+{   int i;
+
+    glc_setrandom(0);
+    for (i=1; i<argc-1; i++)
+        if (strcmp(argv[i], "-s") == 0) glc_setrandom(atoi(argv[i+1]));
+    for (i=1; i<argc; i++)
+        if (strcmp(argv[i], "-c") == 0) measure_saves = 1;
+    if ((glc_image_length < 36) || (memcmp(glc_image, "Glul", 4) != 0))
+        glc_fatal("The story image is not a Glulx game");
+    glkshim_init(argc, argv);
+
+    switch (setjmp(top_level))
+    {   case 0: break;
+        case 1: goto Quit;
+        default: break;
+    }
+    reset_machine();
+    glc_call(GLC_GET4(glc_image+24), 0, NULL);
+
+    Quit:
+    glkshim_exit();
+    report_saves();
+    return 0;
+}
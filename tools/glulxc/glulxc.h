@@ -0,0 +1,151 @@
+/* ------------------------------------------------------------------------- */
+/*   "glulxc.h" : Interface between a Glulx story translated into C (by      */
+/*                the compiler's $GLULX_C_OUTPUT setting) and its runtime    */
+/*                                                                           */
+/*   Part of Inform 6.43                                                     */
+/*   copyright (c) Graham Nelson 1993 - 2024                                 */
+/*                                                                           */
+/*   A translated story is built with the runtime and a Glk shim, e.g.:      */
+/*                                                                           */
+/*       cc -O2 -Itools/glulxc story.c tools/glulxc/glulxc.c               */
+/*           tools/glulxc/glkstdio.c -lm                                     */
+/*                                                                           */
+/*   The story file supplies the memory image and one C function for each   */
+/*   Glulx function; the runtime supplies the stack, the memory and the     */
+/*   opcodes too large to expand inline; the shim supplies Glk.             */
+/* ------------------------------------------------------------------------- */
+
+#ifndef GLULXC_H
+#define GLULXC_H
+
+#include <setjmp.h>
+#include <stdint.h>
+
+typedef uint32_t glui32;
+typedef int32_t glsi32;
+
+typedef glui32 (*glc_function)(glui32 argc, glui32 *argv);
+
+typedef struct glc_entry_s
+{   glui32 addr;                   /* Address of the Glulx function          */
+    glc_function fn;               /* Its translation                        */
+} glc_entry;
+
+/* ------------------------------------------------------------------------- */
+/*   Supplied by the translated story file                                   */
+/* ------------------------------------------------------------------------- */
+
+extern const unsigned char glc_image[];  /* The story file, up to EXTSTART   */
+extern const glui32 glc_image_length;
+extern const glc_entry glc_functions[];  /* In increasing address order      */
+extern const glui32 glc_function_count;
+
+/* ------------------------------------------------------------------------- */
+/*   Supplied by the runtime (glulxc.c)                                      */
+/* ------------------------------------------------------------------------- */
+
+extern unsigned char *glc_mem;
+extern glui32 glc_memsize, glc_ramstart;
+extern glui32 *glc_stk, glc_sp, glc_stacksize;
+extern glui32 *glc_args;           /* Arguments for the next call            */
+extern glui32 glc_thrown;          /* Value passed by the last throw         */
+
+typedef struct glc_catch_s
+{   jmp_buf jb;
+    glui32 depth, sp;              /* Call depth and stack pointer at catch  */
+} glc_catch_t;
+extern glc_catch_t **glc_catches;
+extern glui32 glc_ncatches, glc_depth;
+
+extern void glc_fatal(const char *msg);
+extern glui32 glc_bad_access(glui32 addr);
+extern glui32 glc_enter(glui32 nlocals, glui32 argc, const glui32 *argv);
+extern glui32 glc_enter_stk(glui32 nlocals, glui32 argc, const glui32 *argv);
+extern void glc_drop_catches(void);
+extern glui32 glc_call(glui32 addr, glui32 argc, glui32 *argv);
+extern void glc_pop_args(glui32 argc);
+extern glui32 glc_catch(void);
+extern void glc_throw(glui32 value, glui32 token);
+extern glui32 glc_div(glui32 a, glui32 b);
+extern glui32 glc_mod(glui32 a, glui32 b);
+extern glui32 glc_sshiftr(glui32 a, glui32 b);
+extern glui32 glc_aloadbit(glui32 addr, glui32 bit);
+extern void glc_astorebit(glui32 addr, glui32 bit, glui32 value);
+extern glui32 glc_stkpeek(glui32 base, glui32 pos);
+extern void glc_stkswap(glui32 base);
+extern void glc_stkroll(glui32 base, glui32 count, glui32 shift);
+extern void glc_stkcopy(glui32 base, glui32 count);
+extern void glc_streamchar(glui32 ch);
+extern void glc_streamunichar(glui32 ch);
+extern void glc_streamnum(glui32 n);
+extern void glc_streamstr(glui32 addr);
+extern glui32 glc_gestalt(glui32 sel, glui32 arg);
+extern glui32 glc_setmemsize(glui32 size);
+extern glui32 glc_random(glui32 range);
+extern void glc_setrandom(glui32 seed);
+extern void glc_quit(void);
+extern void glc_restart(void);
+extern void glc_protect(glui32 start, glui32 length);
+extern glui32 glc_glk(glui32 sel, glui32 argc);
+extern void glc_note_input(void);
+extern glui32 glc_stringtbl, glc_iosys_mode, glc_iosys_rock;
+extern void glc_setiosys(glui32 mode, glui32 rock);
+extern glui32 glc_linearsearch(glui32 key, glui32 keysize, glui32 start,
+    glui32 structsize, glui32 numstructs, glui32 keyoffset, glui32 options);
+extern glui32 glc_binarysearch(glui32 key, glui32 keysize, glui32 start,
+    glui32 structsize, glui32 numstructs, glui32 keyoffset, glui32 options);
+extern glui32 glc_linkedsearch(glui32 key, glui32 keysize, glui32 start,
+    glui32 keyoffset, glui32 nextoffset, glui32 options);
+extern void glc_mzero(glui32 count, glui32 addr);
+extern void glc_mcopy(glui32 count, glui32 from, glui32 to);
+extern int glc_fop(glui32 op, glui32 a0, glui32 a1, glui32 a2, glui32 a3,
+    glui32 a4, glui32 a5, glui32 *v, glui32 *w);
+
+/* ------------------------------------------------------------------------- */
+/*   Supplied by the Glk shim (glkstdio.c, or a replacement)                 */
+/* ------------------------------------------------------------------------- */
+
+extern void glkshim_init(int argc, char **argv);
+extern glui32 glkshim_call(glui32 sel, glui32 argc, glui32 *argv);
+extern void glkshim_exit(void);
+
+/* ------------------------------------------------------------------------- */
+/*   Memory and stack access used by the translated code. Addresses and     */
+/*   values passed to these are always plain variables or constants.       */
+/* ------------------------------------------------------------------------- */
+
+#define GLC_GET4(p) (((glui32)(p)[0]<<24) | ((glui32)(p)[1]<<16) \
+                     | ((glui32)(p)[2]<<8) | (glui32)(p)[3])
+#define GLC_GET2(p) (((glui32)(p)[0]<<8) | (glui32)(p)[1])
+
+#define MEM4(a) (((a) <= glc_memsize-4) ? GLC_GET4(glc_mem+(a)) \
+                 : glc_bad_access(a))
+#define MEM2(a) (((a) <= glc_memsize-2) ? GLC_GET2(glc_mem+(a)) \
+                 : glc_bad_access(a))
+#define MEM1(a) (((a) < glc_memsize) ? (glui32) glc_mem[a] \
+                 : glc_bad_access(a))
+
+#define W4(a, v) do { unsigned char *glc_p; \
+    if ((a) < glc_ramstart || (a) > glc_memsize-4) glc_bad_access(a); \
+    glc_p = glc_mem+(a); glc_p[0] = (unsigned char) ((v)>>24); \
+    glc_p[1] = (unsigned char) ((v)>>16); \
+    glc_p[2] = (unsigned char) ((v)>>8); glc_p[3] = (unsigned char) (v); \
+    } while (0)
+#define W2(a, v) do { unsigned char *glc_p; \
+    if ((a) < glc_ramstart || (a) > glc_memsize-2) glc_bad_access(a); \
+    glc_p = glc_mem+(a); glc_p[0] = (unsigned char) ((v)>>8); \
+    glc_p[1] = (unsigned char) (v); } while (0)
+#define W1(a, v) do { \
+    if ((a) < glc_ramstart || (a) >= glc_memsize) glc_bad_access(a); \
+    glc_mem[a] = (unsigned char) (v); } while (0)
+
+#define PUSH(v) do { \
+    if (glc_sp >= glc_stacksize) glc_fatal("Stack overflow"); \
+    glc_stk[glc_sp++] = (v); } while (0)
+#define POP() (glc_stk[--glc_sp])
+#define LOC(n) (glc_stk[fp+(n)])
+
+#define LEAVE(fp) do { glc_sp = (fp); glc_depth--; \
+    if (glc_ncatches) glc_drop_catches(); } while (0)
+
+#endif
@@ -0,0 +1,1025 @@
+/* ------------------------------------------------------------------------- */
+/*   "gvm" : The Glulx engine of the reference interpreter                   */
+/*                                                                           */
+/*   Part of Inform 6.43                                                     */
+/*   copyright (c) Graham Nelson 1993 - 2024                                 */
+/*                                                                           */
+/*   Glk calls go to the shim in tools/glulxc/glkstdio.c, which reaches      */
+/*   memory through glc_mem and the macros in glulxc.h; this engine keeps    */
+/*   its memory there too. Locals must be four bytes wide, as Inform makes   */
+/*   them. Call frames and values are held apart rather than on one Glulx    */
+/*   stack, which no game can observe.                                       */
+/*                                                                           */
+/*   Not supported: @save, @restore and the undo opcodes (which report       */
+/*   failure), the @malloc heap and double-precision floats (which gestalt   */
+/*   reports as absent). @accelfunc and @accelparam are accepted and         */
+/*   ignored, so accelerated functions run as ordinary Glulx code.           */
+/* ------------------------------------------------------------------------- */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "glulxc.h"
+#include "refvm.h"
+
+#define MAX_FRAMES 0x4000          /* Function calls in progress at once     */
+#define MAX_OPERANDS 8
+
+/*  Where an instruction stores a value. Destination types are those of a
+    Glulx call stub: 0 discard, 1 memory, 2 local, 3 push.                   */
+
+typedef struct dest_s
+{   int type;
+    glui32 addr;                   /* Memory address, or local number        */
+} dest;
+
+typedef struct frame_s
+{   glui32 return_pc;
+    dest result;
+    int nested;                    /* Called from C: see call_nested()       */
+    glui32 value_base;             /* Start of the frame's values            */
+    glui32 locals;                 /* Start of the frame's locals            */
+    int routine;                   /* Index in rv_routines                   */
+} frame;
+
+typedef struct catch_s
+{   int depth;                     /* Frames in progress at the @catch       */
+    glui32 sp, lsp, pc;
+    dest result;
+} catch_t;
+
+unsigned char *glc_mem;            /* Used by the Glk shim too               */
+glui32 glc_memsize, glc_ramstart;
+
+static unsigned char *image;
+static glui32 image_length, ext_start, orig_endmem;
+static glui32 pc;
+
+static glui32 *values, sp, stack_size;
+static glui32 *local_store, lsp;
+static frame frames[MAX_FRAMES];
+static int fp;                     /* frames[fp-1] is the current frame      */
+static catch_t *catches;
+static int no_catches, catches_allocated;
+static glui32 nested_result;
+
+static glui32 string_table, iosys_mode, iosys_rock;
+static glui32 protect_start, protect_length;
+static glui32 rng_state;
+
+/* ------------------------------------------------------------------------- */
+/*   Opcodes                                                                 */
+/* ------------------------------------------------------------------------- */
+
+/*  Each operand is L (loaded) or S (stored).                                */
+
+typedef struct opcode_s
+{   glui32 code;
+    const char *name;
+    const char *operands;
+} opcode;
+
+static const opcode opcode_table[] =
+{   { 0x00, "nop", "" },
+    { 0x10, "add", "LLS" }, { 0x11, "sub", "LLS" }, { 0x12, "mul", "LLS" },
+    { 0x13, "div", "LLS" }, { 0x14, "mod", "LLS" }, { 0x15, "neg", "LS" },
+    { 0x18, "bitand", "LLS" }, { 0x19, "bitor", "LLS" },
+    { 0x1A, "bitxor", "LLS" }, { 0x1B, "bitnot", "LS" },
+    { 0x1C, "shiftl", "LLS" }, { 0x1D, "sshiftr", "LLS" },
+    { 0x1E, "ushiftr", "LLS" },
+    { 0x20, "jump", "L" }, { 0x22, "jz", "LL" }, { 0x23, "jnz", "LL" },
+    { 0x24, "jeq", "LLL" }, { 0x25, "jne", "LLL" }, { 0x26, "jlt", "LLL" },
+    { 0x27, "jge", "LLL" }, { 0x28, "jgt", "LLL" }, { 0x29, "jle", "LLL" },
+    { 0x2A, "jltu", "LLL" }, { 0x2B, "jgeu", "LLL" },
+    { 0x2C, "jgtu", "LLL" }, { 0x2D, "jleu", "LLL" },
+    { 0x30, "call", "LLS" }, { 0x31, "return", "L" },
+    { 0x32, "catch", "SL" }, { 0x33, "throw", "LL" },
+    { 0x34, "tailcall", "LL" },
+    { 0x40, "copy", "LS" }, { 0x41, "copys", "LS" }, { 0x42, "copyb", "LS" },
+    { 0x44, "sexs", "LS" }, { 0x45, "sexb", "LS" },
+    { 0x48, "aload", "LLS" }, { 0x49, "aloads", "LLS" },
+    { 0x4A, "aloadb", "LLS" }, { 0x4B, "aloadbit", "LLS" },
+    { 0x4C, "astore", "LLL" }, { 0x4D, "astores", "LLL" },
+    { 0x4E, "astoreb", "LLL" }, { 0x4F, "astorebit", "LLL" },
+    { 0x50, "stkcount", "S" }, { 0x51, "stkpeek", "LS" },
+    { 0x52, "stkswap", "" }, { 0x53, "stkroll", "LL" },
+    { 0x54, "stkcopy", "L" },
+    { 0x70, "streamchar", "L" }, { 0x71, "streamnum", "L" },
+    { 0x72, "streamstr", "L" }, { 0x73, "streamunichar", "L" },
+    { 0x100, "gestalt", "LLS" }, { 0x101, "debugtrap", "L" },
+    { 0x102, "getmemsize", "S" }, { 0x103, "setmemsize", "LS" },
+    { 0x104, "jumpabs", "L" },
+    { 0x110, "random", "LS" }, { 0x111, "setrandom", "L" },
+    { 0x120, "quit", "" }, { 0x121, "verify", "S" },
+    { 0x122, "restart", "" }, { 0x123, "save", "LS" },
+    { 0x124, "restore", "LS" }, { 0x125, "saveundo", "S" },
+    { 0x126, "restoreundo", "S" }, { 0x127, "protect", "LL" },
+    { 0x128, "hasundo", "S" }, { 0x129, "discardundo", "" },
+    { 0x130, "glk", "LLS" },
+    { 0x140, "getstringtbl", "S" }, { 0x141, "setstringtbl", "L" },
+    { 0x148, "getiosys", "SS" }, { 0x149, "setiosys", "LL" },
+    { 0x150, "linearsearch", "LLLLLLLS" },
+    { 0x151, "binarysearch", "LLLLLLLS" },
+    { 0x152, "linkedsearch", "LLLLLLS" },
+    { 0x160, "callf", "LS" }, { 0x161, "callfi", "LLS" },
+    { 0x162, "callfii", "LLLS" }, { 0x163, "callfiii", "LLLLS" },
+    { 0x170, "mzero", "LL" }, { 0x171, "mcopy", "LLL" },
+    { 0x178, "malloc", "LS" }, { 0x179, "mfree", "L" },
+    { 0x180, "accelfunc", "LL" }, { 0x181, "accelparam", "LL" },
+    { 0x190, "numtof", "LS" }, { 0x191, "ftonumz", "LS" },
+    { 0x192, "ftonumn", "LS" }, { 0x198, "ceil", "LS" },
+    { 0x199, "floor", "LS" },
+    { 0x1A0, "fadd", "LLS" }, { 0x1A1, "fsub", "LLS" },
+    { 0x1A2, "fmul", "LLS" }, { 0x1A3, "fdiv", "LLS" },
+    { 0x1A4, "fmod", "LLSS" }, { 0x1A8, "sqrt", "LS" },
+    { 0x1A9, "exp", "LS" }, { 0x1AA, "log", "LS" }, { 0x1AB, "pow", "LLS" },
+    { 0x1B0, "sin", "LS" }, { 0x1B1, "cos", "LS" }, { 0x1B2, "tan", "LS" },
+    { 0x1B3, "asin", "LS" }, { 0x1B4, "acos", "LS" },
+    { 0x1B5, "atan", "LS" }, { 0x1B6, "atan2", "LLS" },
+    { 0x1C0, "jfeq", "LLLL" }, { 0x1C1, "jfne", "LLLL" },
+    { 0x1C2, "jflt", "LLL" }, { 0x1C3, "jfle", "LLL" },
+    { 0x1C4, "jfgt", "LLL" }, { 0x1C5, "jfge", "LLL" },
+    { 0x1C8, "jisnan", "LL" }, { 0x1C9, "jisinf", "LL" },
+    { 0, NULL, NULL }
+};
+
+static const opcode *opcodes[RV_MAX_OPCODES];
+
+extern const char *gvm_opcode_name(int n)
+{   if ((n < 0) || (n >= RV_MAX_OPCODES) || (opcodes[n] == NULL)) return "?";
+    return opcodes[n]->name;
+}
+
+/* ------------------------------------------------------------------------- */
+/*   Errors, and what the Glk shim needs from a runtime                      */
+/* ------------------------------------------------------------------------- */
+
+extern void glc_fatal(const char *msg)
+{   char buf[160];
+    sprintf(buf, "%.100s (PC $%06lx)", msg, (unsigned long) pc);
+    rv_fatal(buf);
+}
+
+extern glui32 glc_bad_access(glui32 addr)
+{   char buf[64];
+    if ((addr < glc_memsize) && (addr < glc_ramstart))
+        sprintf(buf, "Write to ROM at $%lx", (unsigned long) addr);
+    else
+        sprintf(buf, "Memory access out of range at $%lx",
+            (unsigned long) addr);
+    glc_fatal(buf);
+    return 0;
+}
+
+extern void glc_note_input(void) { rv_turns++; }
+extern void glc_quit(void) { rv_quit(); }
+
+static void check_range(glui32 addr, glui32 length, int writing)
+{   if ((addr > glc_memsize) || (length > glc_memsize - addr)
+        || (writing && (addr < glc_ramstart)))
+        glc_bad_access(addr);
+}
+
+/* ------------------------------------------------------------------------- */
+/*   Memory: the game's own reads and writes are counted                     */
+/* ------------------------------------------------------------------------- */
+
+static glui32 rd(glui32 addr, int size)
+{   RV_READ(size);
+    if (size == 4) return MEM4(addr);
+    if (size == 2) return MEM2(addr);
+    return MEM1(addr);
+}
+
+static void wr(glui32 addr, glui32 v, int size)
+{   RV_WRITE(size);
+    if (size == 4) W4(addr, v);
+    else if (size == 2) W2(addr, v);
+    else W1(addr, v);
+}
+
+static glui32 fetch(int size)
+{   glui32 v;
+    if (size == 4) v = MEM4(pc);
+    else if (size == 2) v = MEM2(pc);
+    else v = MEM1(pc);
+    pc += size;
+    return v;
+}
+
+/* ------------------------------------------------------------------------- */
+/*   Values and locals                                                       */
+/* ------------------------------------------------------------------------- */
+
+static void push(glui32 v)
+{   if (sp >= stack_size) glc_fatal("Stack overflow");
+    values[sp++] = v;
+}
+
+static glui32 pop(void)
+{   if (sp <= frames[fp-1].value_base) glc_fatal("Stack underflow");
+    return values[--sp];
+}
+
+static glui32 *local(glui32 offset)
+{   if ((offset & 3) || (frames[fp-1].locals + offset/4 >= lsp))
+        glc_fatal("Bad local variable");
+    return &local_store[frames[fp-1].locals + offset/4];
+}
+
+static void store(dest d, glui32 v, int size)
+{   if (size == 2) v &= 0xFFFF;
+    else if (size == 1) v &= 0xFF;
+    switch (d.type)
+    {   case 1: wr(d.addr, v, size); break;
+        case 2: *local(d.addr) = v; break;
+        case 3: push(v); break;
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/*   Calls, returns, catch and throw                                         */
+/* ------------------------------------------------------------------------- */
+
+static void enter(glui32 addr, glui32 argc, const glui32 *argv, dest result,
+    int nested)
+{   glui32 type, p, nlocals = 0, i;
+    frame *f;
+
+    type = MEM1(addr);
+    if ((type != 0xC0) && (type != 0xC1))
+    {   char buf[64];
+        sprintf(buf, "Call to non-function at $%lx", (unsigned long) addr);
+        glc_fatal(buf);
+    }
+    for (p = addr+1; MEM1(p) != 0; p += 2)
+    {   if (MEM1(p) != 4) glc_fatal("Locals must be four bytes wide");
+        nlocals += MEM1(p+1);
+    }
+    if (fp >= MAX_FRAMES) glc_fatal("Too many nested calls");
+    if ((nlocals > stack_size - lsp) || (argc + 1 > stack_size - sp))
+        glc_fatal("Stack overflow");
+
+    f = &frames[fp];
+    f->return_pc = pc;
+    f->result = result;
+    f->nested = nested;
+    f->value_base = sp;
+    f->locals = lsp;
+    for (i=0; i<nlocals; i++)
+        local_store[lsp++] = ((type == 0xC1) && (i < argc)) ? argv[i] : 0;
+    if (type == 0xC0)
+    {   for (i=argc; i>0; i--) values[sp++] = argv[i-1];
+        values[sp++] = argc;
+    }
+    f->routine = rv_routine_index(addr);
+    rv_routines[f->routine].calls++;
+    rv_calls++;
+    fp++;
+    pc = p + 2;
+}
+
+static void leave(glui32 v)
+{   frame *f = &frames[--fp];
+    sp = f->value_base;
+    lsp = f->locals;
+    pc = f->return_pc;
+    while ((no_catches > 0) && (catches[no_catches-1].depth > fp))
+        no_catches--;
+    if (f->nested) nested_result = v;
+    else store(f->result, v, 4);
+}
+
+static void call_with_stack_args(glui32 addr, glui32 argc, dest result)
+{   glui32 *argv = malloc((argc+1)*sizeof(glui32)), i;
+    if (argv == NULL) glc_fatal("Out of memory");
+    for (i=0; i<argc; i++) argv[i] = pop();
+    enter(addr, argc, argv, result, 0);
+    free(argv);
+}
+
+static void execute(void);
+
+/*  Calls a function from C, as printing a string or using the filter I/O
+    system requires, and runs it to its return.                              */
+
+static glui32 call_nested(glui32 addr, glui32 argc, const glui32 *argv)
+{   dest none;
+    glui32 saved_pc = pc;
+    int depth = fp;
+    none.type = 0; none.addr = 0;
+    enter(addr, argc, argv, none, 1);
+    while (fp > depth) execute();
+    pc = saved_pc;
+    return nested_result;
+}
+
+static glui32 make_catch(dest result)
+{   if (no_catches == catches_allocated)
+    {   catches_allocated = 2*catches_allocated + 8;
+        catches = realloc(catches, catches_allocated*sizeof(catch_t));
+        if (catches == NULL) glc_fatal("Out of memory");
+    }
+    catches[no_catches].depth = fp;
+    catches[no_catches].sp = sp;
+    catches[no_catches].lsp = lsp;
+    catches[no_catches].result = result;
+    return ++no_catches;
+}
+
+static void throw_to(glui32 value, glui32 token)
+{   catch_t *c;
+    if ((token == 0) || (token > (glui32) no_catches))
+        glc_fatal("Throw to an invalid catch token");
+    c = &catches[token-1];
+    no_catches = token-1;
+    while (fp > c->depth)
+        if (frames[--fp].nested)
+            glc_fatal("Throw out of a function called while printing");
+    sp = c->sp;
+    lsp = c->lsp;
+    pc = c->pc;
+    store(c->result, value, 4);
+}
+
+static void branch(glui32 offset)
+{   if ((offset == 0) || (offset == 1)) leave(offset);
+    else pc += offset - 2;
+}
+
+/* ------------------------------------------------------------------------- */
+/*   Output                                                                  */
+/* ------------------------------------------------------------------------- */
+
+static void stream_char(glui32 ch, int unicode)
+{   if (!unicode) ch &= 0xFF;
+    switch (iosys_mode)
+    {   case 1: call_nested(iosys_rock, 1, &ch); break;
+        case 2: glkshim_call(unicode ? 0x128 : 0x80, 1, &ch); break;
+    }
+}
+
+static void stream_num(glui32 n)
+{   char buf[16];
+    int i;
+    sprintf(buf, "%ld", (long) (glsi32) n);
+    for (i=0; buf[i]; i++) stream_char((unsigned char) buf[i], 0);
+}
+
+static void stream_string(glui32 addr);
+
+/*  Prints the string, or calls the function, at addr: as an indirect
+    reference inside a compressed string requires.                           */
+
+static void print_or_call(glui32 addr, glui32 argc, glui32 argsat)
+{   glui32 type = MEM1(addr), i, *argv;
+    if ((type >= 0xE0) && (type <= 0xFF))
+    {   stream_string(addr); return;
+    }
+    if ((type == 0xC0) || (type == 0xC1))
+    {   argv = malloc((argc+1)*sizeof(glui32));
+        if (argv == NULL) glc_fatal("Out of memory");
+        for (i=0; i<argc; i++) argv[i] = MEM4(argsat+4*i);
+        call_nested(addr, argc, argv);
+        free(argv);
+        return;
+    }
+    glc_fatal("Unknown object while decoding string indirect reference");
+}
+
+static void stream_string(glui32 addr)
+{   glui32 type = MEM1(addr), p, ch, root, node, byte, bit;
+
+    switch (type)
+    {   case 0xE0:
+            for (p = addr+1; (ch = MEM1(p)) != 0; p++) stream_char(ch, 0);
+            return;
+        case 0xE2:
+            for (p = addr+4; (ch = MEM4(p)) != 0; p += 4)
+                stream_char(ch, 1);
+            return;
+        case 0xE1:
+            break;
+        default:
+            glc_fatal("Attempt to print non-string");
+    }
+
+    if (string_table == 0)
+        glc_fatal("Attempt to print a compressed string with no table");
+    root = MEM4(string_table+8);
+    p = addr+1; bit = 0; byte = MEM1(p);
+    node = root;
+    for (;;)
+    {   switch (MEM1(node))
+        {   case 0x00:
+                node = MEM4(node + 1 + 4*((byte >> bit) & 1));
+                if (++bit == 8) { bit = 0; p++; byte = MEM1(p); }
+                continue;
+            case 0x01:
+                return;
+            case 0x02:
+                stream_char(MEM1(node+1), 0); break;
+            case 0x03:
+                for (ch = node+1; MEM1(ch) != 0; ch++)
+                    stream_char(MEM1(ch), 0);
+                break;
+            case 0x04:
+                stream_char(MEM4(node+1), 1); break;
+            case 0x05:
+                for (ch = node+1; MEM4(ch) != 0; ch += 4)
+                    stream_char(MEM4(ch), 1);
+                break;
+            case 0x08:
+                print_or_call(MEM4(node+1), 0, 0); break;
+            case 0x09:
+                ch = MEM4(node+1);
+                print_or_call(MEM4(ch), 0, 0); break;
+            case 0x0A:
+                print_or_call(MEM4(node+1), MEM4(node+5), node+9); break;
+            case 0x0B:
+                ch = MEM4(node+1);
+                print_or_call(MEM4(ch), MEM4(node+5), node+9); break;
+            default:
+                glc_fatal("Unknown node type in string table");
+        }
+        node = root;
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/*   Searching                                                               */
+/* ------------------------------------------------------------------------- */
+
+/*  Sets *kp to the key bytes for a search, copying a direct key into kb.    */
+
+static void search_key(glui32 key, glui32 keysize, glui32 options,
+    unsigned char *kb, const unsigned char **kp)
+{   glui32 i;
+    if (options & 1)
+    {   check_range(key, keysize, 0);
+        *kp = glc_mem + key;
+        return;
+    }
+    if ((keysize != 1) && (keysize != 2) && (keysize != 4))
+        glc_fatal("Direct search key must hold one, two, or four bytes");
+    for (i=0; i<keysize; i++) kb[i] = (key >> (8*(keysize-1-i))) & 0xFF;
+    *kp = kb;
+}
+
+static int zero_key(glui32 addr, glui32 keysize)
+{   glui32 i;
+    for (i=0; i<keysize; i++) if (glc_mem[addr+i]) return 0;
+    return 1;
+}
+
+static int key_matches(glui32 addr, const unsigned char *kp, glui32 keysize)
+{   check_range(addr, keysize, 0);
+    RV_READ(keysize);
+    return memcmp(glc_mem+addr, kp, keysize);
+}
+
+static glui32 linear_search(glui32 *a)
+{   unsigned char kb[4];
+    const unsigned char *kp;
+    glui32 i, addr;
+    search_key(a[0], a[1], a[6], kb, &kp);
+    for (i=0; (a[4] == 0xFFFFFFFF) || (i < a[4]); i++)
+    {   addr = a[2] + i*a[3] + a[5];
+        if (key_matches(addr, kp, a[1]) == 0)
+            return (a[6] & 4) ? i : a[2] + i*a[3];
+        if ((a[6] & 2) && zero_key(addr, a[1])) break;
+    }
+    return (a[6] & 4) ? 0xFFFFFFFF : 0;
+}
+
+static glui32 binary_search(glui32 *a)
+{   unsigned char kb[4];
+    const unsigned char *kp;
+    glui32 lo = 0, hi = a[4], mid;
+    int cmp;
+    search_key(a[0], a[1], a[6], kb, &kp);
+    while (lo < hi)
+    {   mid = (lo + hi)/2;
+        cmp = key_matches(a[2] + mid*a[3] + a[5], kp, a[1]);
+        if (cmp == 0) return (a[6] & 4) ? mid : a[2] + mid*a[3];
+        if (cmp < 0) lo = mid+1; else hi = mid;
+    }
+    return (a[6] & 4) ? 0xFFFFFFFF : 0;
+}
+
+static glui32 linked_search(glui32 *a)
+{   unsigned char kb[4];
+    const unsigned char *kp;
+    glui32 start = a[2];
+    search_key(a[0], a[1], a[5], kb, &kp);
+    while (start != 0)
+    {   if (key_matches(start + a[3], kp, a[1]) == 0) return start;
+        if ((a[5] & 2) && zero_key(start + a[3], a[1])) break;
+        start = rd(start + a[4], 4);
+    }
+    return 0;
+}
+
+/* ------------------------------------------------------------------------- */
+/*   Floating point                                                          */
+/* ------------------------------------------------------------------------- */
+
+static float fl(glui32 x)  { float f;  memcpy(&f, &x, 4); return f; }
+static glui32 enc(float f) { glui32 x; memcpy(&x, &f, 4); return x; }
+
+static glui32 to_num(glui32 x, int round)
+{   float f = fl(x);
+    int neg = ((x & 0x80000000) != 0);
+    if (!neg)
+    {   if (isnan(f) || isinf(f) || (f > 2147483647.0)) return 0x7FFFFFFF;
+    }
+    else
+    {   if (isnan(f) || isinf(f) || (f < -2147483647.0)) return 0x80000000;
+    }
+    if (round) f = neg ? ceilf(f - 0.5f) : floorf(f + 0.5f);
+    return (glui32) (glsi32) (neg ? ceilf(f) : floorf(f));
+}
+
+static float fpow(float a, float b)
+{   if ((a == 1.0f) || (b == 0.0f) || (b == -0.0f)) return 1.0f;
+    if ((a == -1.0f) && isinf(b)) return 1.0f;
+    return powf(a, b);
+}
+
+static int feq(glui32 a, glui32 b, glui32 tol)
+{   float d, t;
+    if (((tol & 0x7F800000) == 0x7F800000) && (tol & 0x007FFFFF)) return 0;
+    if (((a == 0x7F800000) || (a == 0xFF800000))
+        && ((b == 0x7F800000) || (b == 0xFF800000)))
+        return (a == b);
+    d = fl(b) - fl(a); t = fabsf(fl(tol));
+    return ((d <= t) && (d >= -t));
+}
+
+/* ------------------------------------------------------------------------- */
+/*   The machine                                                             */
+/* ------------------------------------------------------------------------- */
+
+static glui32 next_random(void)
+{   rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+/*  The same generator as tools/glulxc, so that the two agree when given
+    the same seed; a seed of 0 gives the seed set by -s.                    */
+
+static void set_random(glui32 seed)
+{   if (seed == 0) seed = rv_random_seed;
+    rng_state = seed * 2654435761U;
+    if (rng_state == 0) rng_state = 0x12345678;
+    next_random();
+}
+
+static glui32 set_memsize(glui32 size)
+{   unsigned char *m;
+    if ((size < orig_endmem) || (size % 256)) return 1;
+    m = realloc(glc_mem, size);
+    if (m == NULL) return 1;
+    if (size > glc_memsize) memset(m + glc_memsize, 0, size - glc_memsize);
+    glc_mem = m;
+    glc_memsize = size;
+    return 0;
+}
+
+static glui32 gestalt(glui32 sel, glui32 arg)
+{   switch (sel)
+    {   case 0: return 0x00030103;      /* GlulxVersion */
+        case 1: return 0x00000100;      /* TerpVersion */
+        case 2: return 1;               /* ResizeMem */
+        case 4: return (arg <= 2);      /* IOSystem */
+        case 5: return 1;               /* Unicode */
+        case 6: return 1;               /* MemCopy */
+        case 11: return 1;              /* Float */
+    }
+    return 0;
+}
+
+static void restart(void)
+{   unsigned char *saved = NULL;
+    dest none;
+
+    if (glc_mem && protect_length)
+    {   check_range(protect_start, protect_length, 0);
+        saved = malloc(protect_length);
+        if (saved == NULL) glc_fatal("Out of memory");
+        memcpy(saved, glc_mem+protect_start, protect_length);
+    }
+    glc_memsize = orig_endmem;
+    glc_mem = realloc(glc_mem, glc_memsize);
+    if (glc_mem == NULL) glc_fatal("Out of memory");
+    memcpy(glc_mem, image, ext_start);
+    memset(glc_mem+ext_start, 0, glc_memsize-ext_start);
+    if (saved)
+    {   if (protect_start + protect_length <= glc_memsize)
+            memcpy(glc_mem+protect_start, saved, protect_length);
+        free(saved);
+    }
+
+    sp = 0; lsp = 0; fp = 0; no_catches = 0;
+    string_table = GLC_GET4(image+28);
+    iosys_mode = 0; iosys_rock = 0;
+    none.type = 0; none.addr = 0;
+    pc = 0;
+    enter(GLC_GET4(image+24), 0, NULL, none, 0);
+}
+
+/* ------------------------------------------------------------------------- */
+/*   Decoding and executing instructions                                     */
+/* ------------------------------------------------------------------------- */
+
+static glui32 load_operand(int mode, int size)
+{   glui32 v = 0;
+    switch (mode)
+    {   case 0x0: return 0;
+        case 0x1: return (glui32) (glsi32) (signed char) fetch(1);
+        case 0x2: return (glui32) (glsi32) (int16_t) fetch(2);
+        case 0x3: return fetch(4);
+        case 0x5: return rd(fetch(1), size);
+        case 0x6: return rd(fetch(2), size);
+        case 0x7: return rd(fetch(4), size);
+        case 0x8: v = pop(); break;
+        case 0x9: v = *local(fetch(1)); break;
+        case 0xA: v = *local(fetch(2)); break;
+        case 0xB: v = *local(fetch(4)); break;
+        case 0xD: return rd(glc_ramstart + fetch(1), size);
+        case 0xE: return rd(glc_ramstart + fetch(2), size);
+        case 0xF: return rd(glc_ramstart + fetch(4), size);
+        default: glc_fatal("Unknown operand mode");
+    }
+    if (size == 2) return v & 0xFFFF;
+    if (size == 1) return v & 0xFF;
+    return v;
+}
+
+static dest store_operand(int mode)
+{   dest d;
+    d.addr = 0;
+    switch (mode)
+    {   case 0x0: d.type = 0; break;
+        case 0x5: d.type = 1; d.addr = fetch(1); break;
+        case 0x6: d.type = 1; d.addr = fetch(2); break;
+        case 0x7: d.type = 1; d.addr = fetch(4); break;
+        case 0x8: d.type = 3; break;
+        case 0x9: d.type = 2; d.addr = fetch(1); break;
+        case 0xA: d.type = 2; d.addr = fetch(2); break;
+        case 0xB: d.type = 2; d.addr = fetch(4); break;
+        case 0xD: d.type = 1; d.addr = glc_ramstart + fetch(1); break;
+        case 0xE: d.type = 1; d.addr = glc_ramstart + fetch(2); break;
+        case 0xF: d.type = 1; d.addr = glc_ramstart + fetch(4); break;
+        default: glc_fatal("Unknown store operand mode");
+    }
+    return d;
+}
+
+static glui32 bit_address(glui32 addr, glui32 bit)
+{   glsi32 b = (glsi32) bit;
+    return addr + ((b >= 0) ? (glui32) (b/8)
+        : (glui32) -(glsi32)((-(b+1))/8 + 1));
+}
+
+static void execute(void)
+{   glui32 op, b, x, y, i, ops[MAX_OPERANDS];
+    dest s[2];
+    const opcode *o;
+    const char *p;
+    int modes[MAX_OPERANDS], n, no_stores = 0, size = 4;
+    glui32 saved_pc = pc;
+
+    b = fetch(1);
+    if (b < 0x80) op = b;
+    else if (b < 0xC0) op = ((b & 0x3F) << 8) | fetch(1);
+    else { pc--; op = fetch(4) & 0x0FFFFFFF; }
+    o = (op < RV_MAX_OPCODES) ? opcodes[op] : NULL;
+    if (o == NULL)
+    {   char buf[64];
+        pc = saved_pc;
+        sprintf(buf, "Unknown opcode $%lx", (unsigned long) op);
+        glc_fatal(buf);
+    }
+
+    n = (int) strlen(o->operands);
+    for (i=0; i<(glui32) n; i+=2)
+    {   b = fetch(1);
+        modes[i] = b & 0x0F;
+        if (i+1 < (glui32) n) modes[i+1] = (b >> 4) & 0x0F;
+    }
+    if (op == 0x41) size = 2;
+    if (op == 0x42) size = 1;
+    for (i=0, p=o->operands; *p; p++, i++)
+    {   if (*p == 'L') ops[i] = load_operand(modes[i], size);
+        else s[no_stores++] = store_operand(modes[i]);
+    }
+
+    rv_instructions++;
+    rv_opcodes[op]++;
+    rv_routines[frames[fp-1].routine].instructions++;
+
+    switch (op)
+    {
+        /* --- Arithmetic and logic ---------------------------------------- */
+
+        case 0x00: break;
+        case 0x10: store(s[0], ops[0] + ops[1], 4); break;
+        case 0x11: store(s[0], ops[0] - ops[1], 4); break;
+        case 0x12: store(s[0], ops[0] * ops[1], 4); break;
+        case 0x13:
+            if (ops[1] == 0) glc_fatal("Division by zero");
+            if ((ops[0] == 0x80000000) && (ops[1] == 0xFFFFFFFF))
+                store(s[0], ops[0], 4);
+            else store(s[0], (glui32) ((glsi32) ops[0] / (glsi32) ops[1]), 4);
+            break;
+        case 0x14:
+            if (ops[1] == 0) glc_fatal("Division by zero doing remainder");
+            if (ops[1] == 0xFFFFFFFF) store(s[0], 0, 4);
+            else store(s[0], (glui32) ((glsi32) ops[0] % (glsi32) ops[1]), 4);
+            break;
+        case 0x15: store(s[0], -ops[0], 4); break;
+        case 0x18: store(s[0], ops[0] & ops[1], 4); break;
+        case 0x19: store(s[0], ops[0] | ops[1], 4); break;
+        case 0x1A: store(s[0], ops[0] ^ ops[1], 4); break;
+        case 0x1B: store(s[0], ~ops[0], 4); break;
+        case 0x1C: store(s[0], (ops[1] >= 32) ? 0 : ops[0] << ops[1], 4);
+            break;
+        case 0x1D:
+            if (ops[1] >= 32) x = (ops[0] & 0x80000000) ? 0xFFFFFFFF : 0;
+            else if (ops[0] & 0x80000000) x = ~((~ops[0]) >> ops[1]);
+            else x = ops[0] >> ops[1];
+            store(s[0], x, 4);
+            break;
+        case 0x1E: store(s[0], (ops[1] >= 32) ? 0 : ops[0] >> ops[1], 4);
+            break;
+
+        /* --- Branches ---------------------------------------------------- */
+
+        case 0x20: branch(ops[0]); break;
+        case 0x104: pc = ops[0]; break;
+        case 0x22: if (ops[0] == 0) branch(ops[1]); break;
+        case 0x23: if (ops[0] != 0) branch(ops[1]); break;
+        case 0x24: if (ops[0] == ops[1]) branch(ops[2]); break;
+        case 0x25: if (ops[0] != ops[1]) branch(ops[2]); break;
+        case 0x26: if ((glsi32) ops[0] < (glsi32) ops[1]) branch(ops[2]);
+            break;
+        case 0x27: if ((glsi32) ops[0] >= (glsi32) ops[1]) branch(ops[2]);
+            break;
+        case 0x28: if ((glsi32) ops[0] > (glsi32) ops[1]) branch(ops[2]);
+            break;
+        case 0x29: if ((glsi32) ops[0] <= (glsi32) ops[1]) branch(ops[2]);
+            break;
+        case 0x2A: if (ops[0] < ops[1]) branch(ops[2]); break;
+        case 0x2B: if (ops[0] >= ops[1]) branch(ops[2]); break;
+        case 0x2C: if (ops[0] > ops[1]) branch(ops[2]); break;
+        case 0x2D: if (ops[0] <= ops[1]) branch(ops[2]); break;
+
+        /* --- Calls and returns ------------------------------------------- */
+
+        case 0x30: call_with_stack_args(ops[0], ops[1], s[0]); break;
+        case 0x160: case 0x161: case 0x162: case 0x163:
+            enter(ops[0], op - 0x160, ops+1, s[0], 0);
+            break;
+        case 0x31: leave(ops[0]); break;
+        case 0x34:
+        {   frame *f = &frames[fp-1];
+            glui32 *argv = malloc((ops[1]+1)*sizeof(glui32));
+            dest result = f->result;
+            int nested = f->nested;
+            if (argv == NULL) glc_fatal("Out of memory");
+            for (i=0; i<ops[1]; i++) argv[i] = pop();
+            pc = f->return_pc;
+            sp = f->value_base;
+            lsp = f->locals;
+            fp--;
+            while ((no_catches > 0) && (catches[no_catches-1].depth > fp))
+                no_catches--;
+            enter(ops[0], ops[1], argv, result, nested);
+            free(argv);
+            break;
+        }
+        case 0x32:
+            x = make_catch(s[0]);
+            catches[x-1].pc = pc;
+            store(s[0], x, 4);
+            branch(ops[1]);
+            break;
+        case 0x33: throw_to(ops[0], ops[1]); break;
+
+        /* --- Moving data ------------------------------------------------- */
+
+        case 0x40: store(s[0], ops[0], 4); break;
+        case 0x41: store(s[0], ops[0], (s[0].type == 1) ? 2 : 4); break;
+        case 0x42: store(s[0], ops[0], (s[0].type == 1) ? 1 : 4); break;
+        case 0x44: store(s[0], (ops[0] & 0x8000)
+            ? (ops[0] | 0xFFFF0000) : (ops[0] & 0xFFFF), 4); break;
+        case 0x45: store(s[0], (ops[0] & 0x80)
+            ? (ops[0] | 0xFFFFFF00) : (ops[0] & 0xFF), 4); break;
+        case 0x48: store(s[0], rd(ops[0] + 4*ops[1], 4), 4); break;
+        case 0x49: store(s[0], rd(ops[0] + 2*ops[1], 2), 4); break;
+        case 0x4A: store(s[0], rd(ops[0] + ops[1], 1), 4); break;
+        case 0x4B:
+            store(s[0], (rd(bit_address(ops[0], ops[1]), 1)
+                >> (ops[1] & 7)) & 1, 4);
+            break;
+        case 0x4C: wr(ops[0] + 4*ops[1], ops[2], 4); break;
+        case 0x4D: wr(ops[0] + 2*ops[1], ops[2], 2); break;
+        case 0x4E: wr(ops[0] + ops[1], ops[2], 1); break;
+        case 0x4F:
+            x = bit_address(ops[0], ops[1]);
+            y = rd(x, 1);
+            if (ops[2]) y |= (1 << (ops[1] & 7));
+            else y &= ~(1 << (ops[1] & 7));
+            wr(x, y, 1);
+            break;
+
+        /* --- The stack --------------------------------------------------- */
+
+        case 0x50: store(s[0], sp - frames[fp-1].value_base, 4); break;
+        case 0x51:
+            if (sp - frames[fp-1].value_base <= ops[0])
+                glc_fatal("Stack underflow");
+            store(s[0], values[sp-1-ops[0]], 4);
+            break;
+        case 0x52:
+            if (sp - frames[fp-1].value_base < 2)
+                glc_fatal("Stack underflow");
+            x = values[sp-1]; values[sp-1] = values[sp-2]; values[sp-2] = x;
+            break;
+        case 0x53:
+        {   glui32 count = ops[0], shift, *tmp;
+            glsi32 sh = (glsi32) ops[1];
+            if ((glsi32) count < 0)
+                glc_fatal("Stack operation stkroll had negative count");
+            if (count == 0) break;
+            if (sp - frames[fp-1].value_base < count)
+                glc_fatal("Stack underflow");
+            if (sh > 0) shift = sh % count;
+            else shift = count - ((glui32) -sh) % count;
+            if (shift == count) shift = 0;
+            if (shift == 0) break;
+            tmp = malloc(count*sizeof(glui32));
+            if (tmp == NULL) glc_fatal("Out of memory");
+            for (i=0; i<count; i++)
+                tmp[(i+shift) % count] = values[sp-count+i];
+            memcpy(values+sp-count, tmp, count*sizeof(glui32));
+            free(tmp);
+            break;
+        }
+        case 0x54:
+            if (sp - frames[fp-1].value_base < ops[0])
+                glc_fatal("Stack underflow");
+            if (ops[0] > stack_size - sp) glc_fatal("Stack overflow");
+            for (i=0; i<ops[0]; i++, sp++) values[sp] = values[sp-ops[0]];
+            break;
+
+        /* --- Output ------------------------------------------------------ */
+
+        case 0x70: stream_char(ops[0], 0); break;
+        case 0x71: stream_num(ops[0]); break;
+        case 0x72: stream_string(ops[0]); break;
+        case 0x73: stream_char(ops[0], 1); break;
+        case 0x130:
+        {   glui32 *argv = malloc((ops[1]+1)*sizeof(glui32));
+            if (argv == NULL) glc_fatal("Out of memory");
+            for (i=0; i<ops[1]; i++) argv[i] = pop();
+            x = glkshim_call(ops[0], ops[1], argv);
+            free(argv);
+            store(s[0], x, 4);
+            break;
+        }
+        case 0x140: store(s[0], string_table, 4); break;
+        case 0x141: string_table = ops[0]; break;
+        case 0x148:
+            store(s[0], iosys_mode, 4);
+            store(s[1], iosys_rock, 4);
+            break;
+        case 0x149:
+            iosys_mode = (ops[0] > 2) ? 0 : ops[0];
+            iosys_rock = ops[1];
+            break;
+
+        /* --- Memory ------------------------------------------------------ */
+
+        case 0x102: store(s[0], glc_memsize, 4); break;
+        case 0x103: store(s[0], set_memsize(ops[0]), 4); break;
+        case 0x150: store(s[0], linear_search(ops), 4); break;
+        case 0x151: store(s[0], binary_search(ops), 4); break;
+        case 0x152: store(s[0], linked_search(ops), 4); break;
+        case 0x170:
+            check_range(ops[1], ops[0], 1);
+            RV_WRITE(ops[0]);
+            memset(glc_mem+ops[1], 0, ops[0]);
+            break;
+        case 0x171:
+            check_range(ops[1], ops[0], 0);
+            check_range(ops[2], ops[0], 1);
+            RV_READ(ops[0]); RV_WRITE(ops[0]);
+            memmove(glc_mem+ops[2], glc_mem+ops[1], ops[0]);
+            break;
+        case 0x178: store(s[0], 0, 4); break;
+        case 0x179: break;
+
+        /* --- The system -------------------------------------------------- */
+
+        case 0x100: store(s[0], gestalt(ops[0], ops[1]), 4); break;
+        case 0x101: glc_fatal("@debugtrap"); break;
+        case 0x110:
+            x = ops[0];
+            if (x == 0) y = next_random();
+            else if ((glsi32) x > 0) y = next_random() % x;
+            else y = (glui32) -(glsi32) (next_random() % (glui32) -(glsi32) x);
+            store(s[0], y, 4);
+            break;
+        case 0x111: set_random(ops[0]); break;
+        case 0x120: rv_quit(); break;
+        case 0x121: store(s[0], 0, 4); break;
+        case 0x122: restart(); break;
+        case 0x123: case 0x124: store(s[0], 1, 4); break;
+        case 0x125: case 0x126: case 0x128: store(s[0], 1, 4); break;
+        case 0x127: protect_start = ops[0]; protect_length = ops[1]; break;
+        case 0x129: case 0x180: case 0x181: break;
+
+        /* --- Floating point ---------------------------------------------- */
+
+        case 0x190: store(s[0], enc((float) (glsi32) ops[0]), 4); break;
+        case 0x191: store(s[0], to_num(ops[0], 0), 4); break;
+        case 0x192: store(s[0], to_num(ops[0], 1), 4); break;
+        case 0x198: store(s[0], enc(ceilf(fl(ops[0]))), 4); break;
+        case 0x199: store(s[0], enc(floorf(fl(ops[0]))), 4); break;
+        case 0x1A0: store(s[0], enc(fl(ops[0]) + fl(ops[1])), 4); break;
+        case 0x1A1: store(s[0], enc(fl(ops[0]) - fl(ops[1])), 4); break;
+        case 0x1A2: store(s[0], enc(fl(ops[0]) * fl(ops[1])), 4); break;
+        case 0x1A3: store(s[0], enc(fl(ops[0]) / fl(ops[1])), 4); break;
+        case 0x1A4:
+        {   float f = fmodf(fl(ops[0]), fl(ops[1]));
+            x = enc(f);
+            y = enc((fl(ops[0]) - f) / fl(ops[1]));
+            if ((y == 0) || (y == 0x80000000))
+                y = (ops[0] ^ ops[1]) & 0x80000000;
+            store(s[0], x, 4);
+            store(s[1], y, 4);
+            break;
+        }
+        case 0x1A8: store(s[0], enc(sqrtf(fl(ops[0]))), 4); break;
+        case 0x1A9: store(s[0], enc(expf(fl(ops[0]))), 4); break;
+        case 0x1AA: store(s[0], enc(logf(fl(ops[0]))), 4); break;
+        case 0x1AB: store(s[0], enc(fpow(fl(ops[0]), fl(ops[1]))), 4); break;
+        case 0x1B0: store(s[0], enc(sinf(fl(ops[0]))), 4); break;
+        case 0x1B1: store(s[0], enc(cosf(fl(ops[0]))), 4); break;
+        case 0x1B2: store(s[0], enc(tanf(fl(ops[0]))), 4); break;
+        case 0x1B3: store(s[0], enc(asinf(fl(ops[0]))), 4); break;
+        case 0x1B4: store(s[0], enc(acosf(fl(ops[0]))), 4); break;
+        case 0x1B5: store(s[0], enc(atanf(fl(ops[0]))), 4); break;
+        case 0x1B6: store(s[0], enc(atan2f(fl(ops[0]), fl(ops[1]))), 4);
+            break;
+        case 0x1C0: if (feq(ops[0], ops[1], ops[2])) branch(ops[3]); break;
+        case 0x1C1: if (!feq(ops[0], ops[1], ops[2])) branch(ops[3]); break;
+        case 0x1C2: if (fl(ops[0]) < fl(ops[1])) branch(ops[2]); break;
+        case 0x1C3: if (fl(ops[0]) <= fl(ops[1])) branch(ops[2]); break;
+        case 0x1C4: if (fl(ops[0]) > fl(ops[1])) branch(ops[2]); break;
+        case 0x1C5: if (fl(ops[0]) >= fl(ops[1])) branch(ops[2]); break;
+        case 0x1C8: if (isnan(fl(ops[0]))) branch(ops[1]); break;
+        case 0x1C9: if (isinf(fl(ops[0]))) branch(ops[1]); break;
+    }
+}
+
+extern void gvm_run(int argc, char **argv, unsigned char *story,
+    glui32 length)
+{   int i;
+
+    image = story;
+    image_length = length;
+    if (length < 36) rv_fatal("The story file is truncated");
+    glc_ramstart = GLC_GET4(image+8);
+    ext_start = GLC_GET4(image+12);
+    orig_endmem = GLC_GET4(image+16);
+    if ((ext_start > length) || (orig_endmem < ext_start))
+        rv_fatal("The story file is truncated");
+    stack_size = GLC_GET4(image+20)/4;
+    values = malloc((stack_size+1)*sizeof(glui32));
+    local_store = malloc((stack_size+1)*sizeof(glui32));
+    if ((values == NULL) || (local_store == NULL))
+        rv_fatal("Out of memory");
+    for (i=0; opcode_table[i].name; i++)
+        opcodes[opcode_table[i].code] = &opcode_table[i];
+
+    set_random(0);
+    glkshim_init(argc, argv);
+    restart();
+
+    while (1)
+    {   if (rv_limit && (rv_instructions >= rv_limit))
+        {   fflush(stdout);
+            fprintf(stderr, "refvm: stopped after %llu instructions\n",
+                (unsigned long long) rv_instructions);
+            rv_quit();
+        }
+        if (fp == 0) rv_quit();
+        execute();
+    }
+}
@@ -0,0 +1,457 @@
+/* ------------------------------------------------------------------------- */
+/*   "refvm" : A reference interpreter for Z-code and Glulx story files,     */
+/*             which plays a script and counts what the game executed        */
+/*                                                                           */
+/*   Part of Inform 6.43                                                     */
+/*   copyright (c) Graham Nelson 1993 - 2024                                 */
+/*                                                                           */
+/*   Usage:  refvm [options] story-file                                      */
+/*                                                                           */
+/*       -i <file>  read the input script from <file> rather than stdin      */
+/*       -k <file>  name routines from this debugging information file       */
+/*                  (as written by Inform's -k switch)                       */
+/*       -p <file>  write the profile to <file> rather than stderr           */
+/*       -s <n>     seed the random number generator (default 1)             */
+/*       -l <n>     stop after <n> instructions                              */
+/*       -e         echo each line of input as it is read                    */
+/*                                                                           */
+/*       refvm -C <old-profile> <new-profile>                                */
+/*                  compare two profiles, e.g. of the same game compiled     */
+/*                  with and without some optimisation, playing the same     */
+/*                  script                                                   */
+/*                                                                           */
+/*   The game's output goes to stdout; when the script runs out, the game    */
+/*   stops. Everything is deterministic: the same story and script always    */
+/*   give the same output and the same profile, so two builds can be         */
+/*   compared by running each and then using -C (and cmp on the outputs).    */
+/*                                                                           */
+/*   A profile counts instructions executed, by opcode and by routine (the   */
+/*   routine whose code they belong to), calls to each routine, and reads    */
+/*   and writes of memory other than fetching code. Z-code global            */
+/*   variables and Glulx memory operands count as memory; locals and the     */
+/*   stack do not.                                                           */
+/* ------------------------------------------------------------------------- */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include "refvm.h"
+
+rv_count rv_opcodes[RV_MAX_OPCODES];
+rv_count rv_instructions, rv_calls, rv_turns;
+rv_count rv_reads, rv_read_bytes, rv_writes, rv_write_bytes;
+rv_count rv_limit;
+rv_routine *rv_routines;
+rv_uint rv_random_seed = 1;
+int rv_echo;
+
+static int no_routines, routines_allocated;
+static int *routine_hash;          /* Indices into rv_routines, or -1        */
+static int routine_hash_size;
+static jmp_buf top_level;
+static int glulx;
+
+typedef struct routine_name_s
+{   rv_uint addr;
+    char *name;
+} routine_name;
+
+static routine_name *names;        /* From the debugging file, sorted        */
+static int no_names;
+
+/* ------------------------------------------------------------------------- */
+/*   Errors and stopping                                                     */
+/* ------------------------------------------------------------------------- */
+
+extern void rv_fatal(const char *msg)
+{   fflush(stdout);
+    fprintf(stderr, "refvm: %s\n", msg);
+    exit(1);
+}
+
+static void *rv_malloc(size_t n)
+{   void *p = malloc(n ? n : 1);
+    if (p == NULL) rv_fatal("Out of memory");
+    return p;
+}
+
+extern void rv_quit(void)
+{   longjmp(top_level, 1);
+}
+
+/* ------------------------------------------------------------------------- */
+/*   Routines, found by address through a hash table                         */
+/* ------------------------------------------------------------------------- */
+
+static int hash_slot(rv_uint addr)
+{   int i = (int) ((addr * 2654435761U) & (routine_hash_size - 1));
+    while ((routine_hash[i] >= 0)
+           && (rv_routines[routine_hash[i]].addr != addr))
+        i = (i + 1) & (routine_hash_size - 1);
+    return i;
+}
+
+static void grow_hash(void)
+{   int i;
+    free(routine_hash);
+    routine_hash_size = (routine_hash_size) ? 2*routine_hash_size : 1024;
+    routine_hash = rv_malloc(routine_hash_size*sizeof(int));
+    for (i=0; i<routine_hash_size; i++) routine_hash[i] = -1;
+    for (i=0; i<no_routines; i++)
+        routine_hash[hash_slot(rv_routines[i].addr)] = i;
+}
+
+/*  Returns the index in rv_routines of the routine at addr, making an entry
+    for it if this is the first call.                                        */
+
+extern int rv_routine_index(rv_uint addr)
+{   int i;
+    if (2*(no_routines+1) > routine_hash_size) grow_hash();
+    i = hash_slot(addr);
+    if (routine_hash[i] >= 0) return routine_hash[i];
+    if (no_routines == routines_allocated)
+    {   routines_allocated = 2*routines_allocated + 256;
+        rv_routines = realloc(rv_routines,
+            routines_allocated*sizeof(rv_routine));
+        if (rv_routines == NULL) rv_fatal("Out of memory");
+    }
+    rv_routines[no_routines].addr = addr;
+    rv_routines[no_routines].calls = 0;
+    rv_routines[no_routines].instructions = 0;
+    routine_hash[i] = no_routines;
+    return no_routines++;
+}
+
+/* ------------------------------------------------------------------------- */
+/*   The input script                                                        */
+/* ------------------------------------------------------------------------- */
+
+/*  Reads the next line of the script into buf (without its line ending),
+    giving its length, or -1 when the script has run out.                    */
+
+extern int rv_read_line(char *buf, int max)
+{   int c, n = 0;
+    c = getchar();
+    if (c == EOF) return -1;
+    while ((c != EOF) && (c != '\n'))
+    {   if ((c != '\r') && (n < max)) buf[n++] = (char) c;
+        c = getchar();
+    }
+    if (rv_echo)
+    {   fwrite(buf, 1, n, stdout);
+        putchar('\n');
+    }
+    return n;
+}
+
+/* ------------------------------------------------------------------------- */
+/*   Routine names from the debugging information file                       */
+/* ------------------------------------------------------------------------- */
+
+static char *read_file(const char *filename, rv_uint *length)
+{   FILE *f = fopen(filename, "rb");
+    char *data;
+    long n;
+    if (f == NULL)
+    {   fprintf(stderr, "refvm: can't open '%s'\n", filename);
+        exit(1);
+    }
+    fseek(f, 0L, SEEK_END);
+    n = ftell(f);
+    fseek(f, 0L, SEEK_SET);
+    data = rv_malloc(n + 1);
+    if (fread(data, 1, n, f) != (size_t) n) rv_fatal("Can't read file");
+    data[n] = 0;
+    fclose(f);
+    *length = (rv_uint) n;
+    return data;
+}
+
+static int compare_names(const void *a, const void *b)
+{   rv_uint x = ((const routine_name *) a)->addr,
+        y = ((const routine_name *) b)->addr;
+    return (x < y) ? -1 : (x > y);
+}
+
+/*  Each routine in the file appears as <routine>, then its <identifier>,
+    its <value> and then its <address>; later <address> elements belong
+    to sequence points.                                                      */
+
+static void load_names(const char *filename)
+{   rv_uint length;
+    char *data = read_file(filename, &length), *p = data, *q, *end;
+    int allocated = 0;
+
+    while ((p = strstr(p, "<routine>")) != NULL)
+    {   end = strstr(p, "</routine>");
+        if (end == NULL) break;
+        q = strstr(p, "<identifier");
+        if ((q != NULL) && (q < end) && ((q = strchr(q, '>')) != NULL))
+        {   char *close = strstr(q, "</identifier>"), *a;
+            a = strstr(q, "<address>");
+            if ((close != NULL) && (a != NULL) && (a < end))
+            {   if (no_names == allocated)
+                {   allocated = 2*allocated + 256;
+                    names = realloc(names, allocated*sizeof(routine_name));
+                    if (names == NULL) rv_fatal("Out of memory");
+                }
+                names[no_names].addr = (rv_uint) strtoul(a+9, NULL, 10);
+                names[no_names].name = rv_malloc(close - q);
+                memcpy(names[no_names].name, q+1, close - q - 1);
+                names[no_names].name[close - q - 1] = 0;
+                no_names++;
+            }
+        }
+        p = end;
+    }
+    free(data);
+    qsort(names, no_names, sizeof(routine_name), compare_names);
+}
+
+static const char *name_of_routine(rv_uint addr)
+{   int lo = 0, hi = no_names, mid;
+    while (lo < hi)
+    {   mid = (lo + hi)/2;
+        if (names[mid].addr == addr) return names[mid].name;
+        if (names[mid].addr < addr) lo = mid+1; else hi = mid;
+    }
+    return "?";
+}
+
+/* ------------------------------------------------------------------------- */
+/*   Writing a profile                                                       */
+/* ------------------------------------------------------------------------- */
+
+static int compare_routines(const void *a, const void *b)
+{   const rv_routine *x = a, *y = b;
+    if (x->instructions != y->instructions)
+        return (x->instructions < y->instructions) ? 1 : -1;
+    return (x->addr < y->addr) ? -1 : (x->addr > y->addr);
+}
+
+static void write_profile(FILE *f)
+{   int i;
+    fprintf(f, "! refvm profile\n");
+    fprintf(f, "format %s\n", glulx ? "glulx" : "zcode");
+    fprintf(f, "instructions %llu\n", (unsigned long long) rv_instructions);
+    fprintf(f, "calls %llu\n", (unsigned long long) rv_calls);
+    fprintf(f, "turns %llu\n", (unsigned long long) rv_turns);
+    fprintf(f, "reads %llu %llu\n", (unsigned long long) rv_reads,
+        (unsigned long long) rv_read_bytes);
+    fprintf(f, "writes %llu %llu\n", (unsigned long long) rv_writes,
+        (unsigned long long) rv_write_bytes);
+    for (i=0; i<RV_MAX_OPCODES; i++)
+        if (rv_opcodes[i])
+            fprintf(f, "opcode %s %llu\n",
+                glulx ? gvm_opcode_name(i) : zvm_opcode_name(i),
+                (unsigned long long) rv_opcodes[i]);
+    qsort(rv_routines, no_routines, sizeof(rv_routine), compare_routines);
+    for (i=0; i<no_routines; i++)
+        fprintf(f, "routine %06lx %llu %llu %s\n",
+            (unsigned long) rv_routines[i].addr,
+            (unsigned long long) rv_routines[i].calls,
+            (unsigned long long) rv_routines[i].instructions,
+            name_of_routine(rv_routines[i].addr));
+}
+
+/* ------------------------------------------------------------------------- */
+/*   Comparing two profiles                                                  */
+/* ------------------------------------------------------------------------- */
+
+typedef struct profile_line_s
+{   char *key;                     /* "opcode add", "routine Main", ...      */
+    double value[2];               /* Count in the old and new profiles      */
+} profile_line;
+
+static profile_line *lines;
+static int no_lines, lines_allocated;
+
+static void note_count(const char *key, int which, double value)
+{   int i;
+    for (i=0; i<no_lines; i++)
+        if (strcmp(lines[i].key, key) == 0) break;
+    if (i == no_lines)
+    {   if (no_lines == lines_allocated)
+        {   lines_allocated = 2*lines_allocated + 256;
+            lines = realloc(lines, lines_allocated*sizeof(profile_line));
+            if (lines == NULL) rv_fatal("Out of memory");
+        }
+        lines[i].key = rv_malloc(strlen(key)+1);
+        strcpy(lines[i].key, key);
+        lines[i].value[0] = lines[i].value[1] = 0;
+        no_lines++;
+    }
+    lines[i].value[which] += value;
+}
+
+/*  Routines are matched by name where the debugging file gave one, since
+    their addresses differ between builds.                                   */
+
+static void read_profile(const char *filename, int which)
+{   rv_uint length;
+    char *data = read_file(filename, &length), *p, *next, key[512];
+    unsigned long long a, b;
+    unsigned long addr;
+    int n;
+
+    for (p = data; *p; p = next)
+    {   next = strchr(p, '\n');
+        if (next) *next++ = 0; else next = p + strlen(p);
+        if (sscanf(p, "instructions %llu", &a) == 1)
+            note_count("instructions", which, (double) a);
+        else if (sscanf(p, "calls %llu", &a) == 1)
+            note_count("calls", which, (double) a);
+        else if (sscanf(p, "turns %llu", &a) == 1)
+            note_count("turns", which, (double) a);
+        else if (sscanf(p, "reads %llu %llu", &a, &b) == 2)
+        {   note_count("memory reads", which, (double) a);
+            note_count("bytes read", which, (double) b);
+        }
+        else if (sscanf(p, "writes %llu %llu", &a, &b) == 2)
+        {   note_count("memory writes", which, (double) a);
+            note_count("bytes written", which, (double) b);
+        }
+        else if (sscanf(p, "opcode %400s %llu", key+7, &a) == 2)
+        {   memcpy(key, "opcode ", 7);
+            note_count(key, which, (double) a);
+        }
+        else if (sscanf(p, "routine %lx %llu %llu %n", &addr, &a, &b, &n)
+            == 3)
+        {   if (strcmp(p+n, "?") == 0)
+                sprintf(key, "routine $%06lx", addr);
+            else
+                sprintf(key, "routine %.400s", p+n);
+            note_count(key, which, (double) b);
+        }
+    }
+    free(data);
+}
+
+static int compare_changes(const void *a, const void *b)
+{   const profile_line *x = a, *y = b;
+    double dx = x->value[1] - x->value[0], dy = y->value[1] - y->value[0];
+    if (dx < 0) dx = -dx;
+    if (dy < 0) dy = -dy;
+    if (dx != dy) return (dx < dy) ? 1 : -1;
+    return strcmp(x->key, y->key);
+}
+
+static void print_change(const profile_line *l)
+{   double d = l->value[1] - l->value[0];
+    printf("  %-36.36s %14.0f %14.0f %+14.0f", l->key, l->value[0],
+        l->value[1], d);
+    if (l->value[0] != 0) printf(" %+7.2f%%", 100.0*d/l->value[0]);
+    printf("\n");
+}
+
+static void compare_profiles(const char *old_name, const char *new_name)
+{   static const char *totals[] =
+    {   "instructions", "calls", "turns", "memory reads", "bytes read",
+        "memory writes", "bytes written", NULL };
+    int i, j, shown;
+
+    read_profile(old_name, 0);
+    read_profile(new_name, 1);
+
+    printf("  %-36s %14s %14s %14s\n", "", "old", "new", "change");
+    for (j=0; totals[j]; j++)
+        for (i=0; i<no_lines; i++)
+            if (strcmp(lines[i].key, totals[j]) == 0) print_change(&lines[i]);
+
+    qsort(lines, no_lines, sizeof(profile_line), compare_changes);
+    printf("\nOpcodes which changed:\n");
+    for (i=0, shown=0; i<no_lines; i++)
+        if ((strncmp(lines[i].key, "opcode ", 7) == 0)
+            && (lines[i].value[0] != lines[i].value[1]))
+        {   print_change(&lines[i]); shown++;
+        }
+    if (!shown) printf("  none\n");
+    printf("\nRoutines which changed most (instructions executed):\n");
+    for (i=0, shown=0; (i<no_lines) && (shown<20); i++)
+        if ((strncmp(lines[i].key, "routine ", 8) == 0)
+            && (lines[i].value[0] != lines[i].value[1]))
+        {   print_change(&lines[i]); shown++;
+        }
+    if (!shown) printf("  none\n");
+}
+
+/* ------------------------------------------------------------------------- */
+/*   Main                                                                    */
+/* ------------------------------------------------------------------------- */
+
+/*  Runs the game until it quits, the script runs out or the limit is
+    reached.                                                                 */
+
+static void play(int argc, char **argv, unsigned char *story, rv_uint length)
+{   if (setjmp(top_level) == 0)
+    {   if (glulx) gvm_run(argc, argv, story, length);
+        else zvm_run(story, length);
+    }
+    fflush(stdout);
+}
+
+static void usage(void)
+{   fprintf(stderr, "usage: refvm [-i script] [-k debug-file] [-p profile] \
+[-s seed] [-l limit] [-e] story-file\n       refvm -C old-profile \
+new-profile\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{   char *story_name = NULL, *profile_name = NULL;
+    unsigned char *story;
+    rv_uint length;
+    FILE *f;
+    int i;
+
+    if ((argc == 4) && (strcmp(argv[1], "-C") == 0))
+    {   compare_profiles(argv[2], argv[3]);
+        return 0;
+    }
+
+    for (i=1; i<argc; i++)
+    {   if ((argv[i][0] != '-') || (argv[i][1] == 0))
+        {   if (story_name) usage();
+            story_name = argv[i];
+            continue;
+        }
+        switch (argv[i][1])
+        {   case 'e': rv_echo = 1; continue;
+            case 'i': case 'k': case 'p': case 's': case 'l':
+                if ((argv[i][2] != 0) || (i+1 == argc)) usage();
+                break;
+            default: usage();
+        }
+        switch (argv[i++][1])
+        {   case 'i':
+                if (freopen(argv[i], "r", stdin) == NULL)
+                {   fprintf(stderr, "refvm: can't open '%s'\n", argv[i]);
+                    return 1;
+                }
+                break;
+            case 'k': load_names(argv[i]); break;
+            case 'p': profile_name = argv[i]; break;
+            case 's': rv_random_seed = (rv_uint) strtoul(argv[i], NULL, 0);
+                break;
+            case 'l': rv_limit = (rv_count) strtod(argv[i], NULL); break;
+        }
+    }
+    if (story_name == NULL) usage();
+
+    story = (unsigned char *) read_file(story_name, &length);
+    glulx = ((length >= 4) && (memcmp(story, "Glul", 4) == 0));
+    play(argc, argv, story, length);
+
+    if (profile_name)
+    {   f = fopen(profile_name, "w");
+        if (f == NULL)
+        {   fprintf(stderr, "refvm: can't write '%s'\n", profile_name);
+            return 1;
+        }
+        write_profile(f);
+        fclose(f);
+    }
+    else write_profile(stderr);
+    return 0;
+}
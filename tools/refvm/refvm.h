@@ -0,0 +1,64 @@
+/* ------------------------------------------------------------------------- */
+/*   "refvm.h" : Interface between the reference interpreter's front end     */
+/*               (refvm.c) and its Z-machine and Glulx engines               */
+/*                                                                           */
+/*   Part of Inform 6.43                                                     */
+/*   copyright (c) Graham Nelson 1993 - 2024                                 */
+/*                                                                           */
+/*   refvm is built on its own, apart from the compiler, e.g.:               */
+/*                                                                           */
+/*       cc -O2 -Itools/glulxc -o refvm tools/refvm/refvm.c                  */
+/*           tools/refvm/zvm.c tools/refvm/gvm.c tools/glulxc/glkstdio.c     */
+/*           -lm                                                             */
+/*                                                                           */
+/*   The Glulx engine uses the Glk shim written for tools/glulxc, so the     */
+/*   two tools play a script in exactly the same way.                        */
+/* ------------------------------------------------------------------------- */
+
+#ifndef REFVM_H
+#define REFVM_H
+
+#include <stdint.h>
+
+typedef uint32_t rv_uint;
+typedef uint64_t rv_count;
+
+#define RV_MAX_OPCODES 0x200       /* Opcode numbers index rv_opcodes[]      */
+
+typedef struct rv_routine_s
+{   rv_uint addr;                  /* Byte address of the routine header     */
+    rv_count calls;
+    rv_count instructions;         /* Executed in the routine itself         */
+} rv_routine;
+
+/* ------------------------------------------------------------------------- */
+/*   Supplied by the front end (refvm.c)                                     */
+/* ------------------------------------------------------------------------- */
+
+extern rv_count rv_opcodes[RV_MAX_OPCODES];
+extern rv_count rv_instructions, rv_calls, rv_turns;
+extern rv_count rv_reads, rv_read_bytes, rv_writes, rv_write_bytes;
+extern rv_count rv_limit;          /* Stop after this many, or 0 for never  */
+extern rv_routine *rv_routines;
+extern rv_uint rv_random_seed;
+extern int rv_echo;
+
+extern void rv_fatal(const char *msg);
+extern void rv_quit(void);
+extern int rv_routine_index(rv_uint addr);
+extern int rv_read_line(char *buf, int max);
+
+#define RV_READ(n)  (rv_reads++, rv_read_bytes += (n))
+#define RV_WRITE(n) (rv_writes++, rv_write_bytes += (n))
+
+/* ------------------------------------------------------------------------- */
+/*   Supplied by the engines (zvm.c and gvm.c)                               */
+/* ------------------------------------------------------------------------- */
+
+extern void zvm_run(unsigned char *story, rv_uint length);
+extern const char *zvm_opcode_name(int n);
+extern void gvm_run(int argc, char **argv, unsigned char *story,
+    rv_uint length);
+extern const char *gvm_opcode_name(int n);
+
+#endif
@@ -0,0 +1,1034 @@
+/* ------------------------------------------------------------------------- */
+/*   "zvm" : The Z-machine engine of the reference interpreter               */
+/*                                                                           */
+/*   Part of Inform 6.43                                                     */
+/*   copyright (c) Graham Nelson 1993 - 2024                                 */
+/*                                                                           */
+/*   Versions 3, 4, 5, 7 and 8 are supported. The screen model is a single   */
+/*   scrolling window written to stdout: the upper window (and so the        */
+/*   status line) is not shown, and styles, colours, fonts and sound are     */
+/*   ignored. The screen is reported as 80 columns by 255 lines, so games    */
+/*   never wait at a [MORE] prompt. Input is read a line at a time from the  */
+/*   script; @read_char takes the first character of a line. Saving,         */
+/*   restoring and undo are reported as failing.                             */
+/* ------------------------------------------------------------------------- */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "refvm.h"
+
+#define STACK_SIZE 0x8000          /* Words on the evaluation stack          */
+#define MAX_FRAMES 0x1000          /* Routine calls in progress at once      */
+#define MAX_STREAM3 16             /* Nested output stream 3 tables          */
+
+typedef struct frame_s
+{   rv_uint return_pc;
+    int store;                     /* Variable for the result, or -1         */
+    int stack_base;                /* Stack pointer on entry                 */
+    int argc;                      /* Arguments supplied                     */
+    int nlocals;
+    int routine;                   /* Index in rv_routines                   */
+    rv_uint locals[15];
+} frame;
+
+static unsigned char *mem, *original;
+static rv_uint mem_size, static_base, version;
+static rv_uint pc, start_pc;
+static rv_uint stack[STACK_SIZE];
+static int sp;
+static frame frames[MAX_FRAMES];
+static int fp;                     /* frames[fp-1] is the current frame      */
+
+static rv_uint ops[8];             /* Operands of the current instruction    */
+static int nops;
+static int store_var;              /* Its store variable, or -1              */
+static unsigned char stores[128], branches[128];
+
+static int window, screen_on = 1;
+static rv_uint stream3[MAX_STREAM3], stream3_count[MAX_STREAM3];
+static int stream3_depth;
+static rv_uint random_state;
+
+static const char *names[128] =
+{   /* 2OP */
+    "?", "je", "jl", "jg", "dec_chk", "inc_chk", "jin", "test",
+    "or", "and", "test_attr", "set_attr", "clear_attr", "store",
+    "insert_obj", "loadw", "loadb", "get_prop", "get_prop_addr",
+    "get_next_prop", "add", "sub", "mul", "div", "mod", "call_2s",
+    "call_2n", "set_colour", "throw", "?", "?", "?",
+    /* 1OP */
+    "jz", "get_sibling", "get_child", "get_parent", "get_prop_len",
+    "inc", "dec", "print_addr", "call_1s", "remove_obj", "print_obj",
+    "ret", "jump", "print_paddr", "load", "call_1n",
+    /* 0OP */
+    "rtrue", "rfalse", "print", "print_ret", "nop", "save", "restore",
+    "restart", "ret_popped", "catch", "quit", "new_line", "show_status",
+    "verify", "extended", "piracy",
+    /* VAR */
+    "call_vs", "storew", "storeb", "put_prop", "aread", "print_char",
+    "print_num", "random", "push", "pull", "split_window", "set_window",
+    "call_vs2", "erase_window", "erase_line", "set_cursor", "get_cursor",
+    "set_text_style", "buffer_mode", "output_stream", "input_stream",
+    "sound_effect", "read_char", "scan_table", "not", "call_vn",
+    "call_vn2", "tokenise", "encode_text", "copy_table", "print_table",
+    "check_arg_count",
+    /* EXT */
+    "save", "restore", "log_shift", "art_shift", "set_font",
+    "draw_picture", "picture_data", "erase_picture", "set_margins",
+    "save_undo", "restore_undo", "print_unicode", "check_unicode",
+    "set_true_colour", "?", "?", "move_window", "window_size",
+    "window_style", "get_wind_prop", "scroll_window", "pop_stack",
+    "read_mouse", "mouse_window", "push_stack", "put_wind_prop",
+    "print_form", "make_menu", "picture_table", "buffer_screen", "?", "?"
+};
+
+/*  Opcode numbers: 2OP n is n, 1OP n is 32+n, 0OP n is 48+n, VAR n is
+    64+n and EXT n is 96+n.                                                  */
+
+#define OP2(n) (n)
+#define OP1(n) (32+(n))
+#define OP0(n) (48+(n))
+#define VAR(n) (64+(n))
+#define EXT(n) (96+(n))
+
+extern const char *zvm_opcode_name(int n)
+{   if ((n < 0) || (n >= 128)) return "?";
+    if (version <= 4)
+    {   if (n == OP1(15)) return "not";
+        if (n == OP0(9)) return "pop";
+    }
+    if (version <= 3)
+    {   if (n == VAR(0)) return "call";
+        if (n == VAR(4)) return "sread";
+    }
+    return names[n];
+}
+
+static void fatal_at(const char *msg)
+{   char buf[128];
+    sprintf(buf, "%s (PC $%05lx)", msg, (unsigned long) pc);
+    rv_fatal(buf);
+}
+
+/* ------------------------------------------------------------------------- */
+/*   Memory                                                                  */
+/* ------------------------------------------------------------------------- */
+
+static rv_uint fetch(void)
+{   if (pc >= mem_size) fatal_at("PC out of range");
+    return mem[pc++];
+}
+
+static rv_uint byte_at(rv_uint addr)
+{   if (addr >= mem_size) fatal_at("Read out of range");
+    return mem[addr];
+}
+
+static rv_uint word_at(rv_uint addr)
+{   if (addr + 1 >= mem_size) fatal_at("Read out of range");
+    return (mem[addr] << 8) | mem[addr+1];
+}
+
+static void set_byte(rv_uint addr, rv_uint v)
+{   if (addr >= static_base) fatal_at("Write outside dynamic memory");
+    mem[addr] = (unsigned char) v;
+}
+
+static void set_word(rv_uint addr, rv_uint v)
+{   if (addr + 1 >= static_base) fatal_at("Write outside dynamic memory");
+    mem[addr] = (unsigned char) (v >> 8);
+    mem[addr+1] = (unsigned char) v;
+}
+
+/*  The game's own reads and writes, which are counted.                      */
+
+static rv_uint rb(rv_uint addr) { RV_READ(1); return byte_at(addr); }
+static rv_uint rw(rv_uint addr) { RV_READ(2); return word_at(addr); }
+static void wb(rv_uint addr, rv_uint v) { RV_WRITE(1); set_byte(addr, v); }
+static void ww(rv_uint addr, rv_uint v) { RV_WRITE(2); set_word(addr, v); }
+
+static rv_uint sgn(rv_uint v) { return (v & 0x8000) ? (v | ~0xFFFFU) : v; }
+
+/* ------------------------------------------------------------------------- */
+/*   The stack and variables                                                 */
+/* ------------------------------------------------------------------------- */
+
+static void push(rv_uint v)
+{   if (sp >= STACK_SIZE) fatal_at("Stack overflow");
+    stack[sp++] = v & 0xFFFF;
+}
+
+static rv_uint pop(void)
+{   if (sp <= frames[fp-1].stack_base) fatal_at("Stack underflow");
+    return stack[--sp];
+}
+
+static rv_uint *local(int v)
+{   if (v > frames[fp-1].nlocals) fatal_at("No such local variable");
+    return &frames[fp-1].locals[v-1];
+}
+
+static rv_uint read_var(int v)
+{   if (v == 0) return pop();
+    if (v < 16) return *local(v);
+    return rw(word_at(0x0C) + 2*(v-16));
+}
+
+static void write_var(int v, rv_uint x)
+{   x &= 0xFFFF;
+    if (v == 0) push(x);
+    else if (v < 16) *local(v) = x;
+    else ww(word_at(0x0C) + 2*(v-16), x);
+}
+
+/*  Opcodes which name a variable (inc, dec, load, store, pull, inc_chk and
+    dec_chk) read and write the top of the stack in place.                   */
+
+static rv_uint read_var_in_place(int v)
+{   if (v != 0) return read_var(v);
+    if (sp <= frames[fp-1].stack_base) fatal_at("Stack underflow");
+    return stack[sp-1];
+}
+
+static void write_var_in_place(int v, rv_uint x)
+{   if (v != 0) { write_var(v, x); return; }
+    if (sp <= frames[fp-1].stack_base) fatal_at("Stack underflow");
+    stack[sp-1] = x & 0xFFFF;
+}
+
+/* ------------------------------------------------------------------------- */
+/*   Calls, returns and branches                                             */
+/* ------------------------------------------------------------------------- */
+
+static rv_uint unpack(rv_uint p, int routine)
+{   switch (version)
+    {   case 1: case 2: case 3: return 2*p;
+        case 4: case 5: return 4*p;
+        case 6: case 7: return 4*p + 8*word_at(routine ? 0x28 : 0x2A);
+        default: return 8*p;
+    }
+}
+
+static void call(rv_uint packed, int argc, rv_uint *args, int store)
+{   rv_uint addr, i;
+    frame *f;
+
+    if (packed == 0)
+    {   if (store >= 0) write_var(store, 0);
+        return;
+    }
+    if (fp >= MAX_FRAMES) fatal_at("Too many nested calls");
+    addr = unpack(packed, 1);
+    f = &frames[fp];
+    f->return_pc = pc;
+    f->store = store;
+    f->stack_base = sp;
+    f->argc = argc;
+    f->nlocals = byte_at(addr);
+    if (f->nlocals > 15) fatal_at("Call to something which is not a routine");
+    pc = addr + 1;
+    for (i=0; i<(rv_uint) f->nlocals; i++)
+    {   if (version <= 4) { f->locals[i] = word_at(pc); pc += 2; }
+        else f->locals[i] = 0;
+        if (i < (rv_uint) argc) f->locals[i] = args[i];
+    }
+    f->routine = rv_routine_index(addr);
+    rv_routines[f->routine].calls++;
+    rv_calls++;
+    fp++;
+}
+
+static void ret(rv_uint v)
+{   frame *f;
+    if (fp <= 1) fatal_at("Return from the main routine");
+    f = &frames[--fp];
+    sp = f->stack_base;
+    pc = f->return_pc;
+    if (f->store >= 0) write_var(f->store, v);
+}
+
+static void branch(int condition)
+{   rv_uint b = fetch(), offset;
+    int on_true = ((b & 0x80) != 0);
+    if (b & 0x40) offset = b & 0x3F;
+    else
+    {   offset = ((b & 0x3F) << 8) | fetch();
+        if (offset & 0x2000) offset |= ~0x3FFFU;
+    }
+    if ((condition != 0) != on_true) return;
+    if (offset == 0) ret(0);
+    else if (offset == 1) ret(1);
+    else pc += offset - 2;
+}
+
+static void store(rv_uint v)
+{   if (store_var >= 0) write_var(store_var, v);
+}
+
+/* ------------------------------------------------------------------------- */
+/*   Output                                                                  */
+/* ------------------------------------------------------------------------- */
+
+static const unsigned short default_unicode[69] =
+{   0xe4, 0xf6, 0xfc, 0xc4, 0xd6, 0xdc, 0xdf, 0xbb, 0xab, 0xeb, 0xef, 0xff,
+    0xcb, 0xcf, 0xe1, 0xe9, 0xed, 0xf3, 0xfa, 0xfd, 0xc1, 0xc9, 0xcd, 0xd3,
+    0xda, 0xdd, 0xe0, 0xe8, 0xec, 0xf2, 0xf9, 0xc0, 0xc8, 0xcc, 0xd2, 0xd9,
+    0xe2, 0xea, 0xee, 0xf4, 0xfb, 0xc2, 0xca, 0xce, 0xd4, 0xdb, 0xe5, 0xc5,
+    0xf8, 0xd8, 0xe3, 0xf1, 0xf5, 0xc3, 0xd1, 0xd5, 0xe6, 0xc6, 0xe7, 0xc7,
+    0xfe, 0xf0, 0xde, 0xd0, 0xa3, 0x153, 0x152, 0xa1, 0xbf
+};
+
+/*  The Unicode translation table from the header extension, or 0.           */
+
+static rv_uint unicode_table(void)
+{   rv_uint ext = (version >= 5) ? word_at(0x36) : 0;
+    if ((ext == 0) || (word_at(ext) < 3)) return 0;
+    return word_at(ext + 6);
+}
+
+static rv_uint zscii_to_unicode(rv_uint c)
+{   rv_uint t;
+    if ((c >= 155) && (c <= 251))
+    {   t = unicode_table();
+        if (t)
+        {   if (c - 155 < byte_at(t)) return word_at(t + 1 + 2*(c-155));
+            return '?';
+        }
+        if (c - 155 < 69) return default_unicode[c-155];
+        return '?';
+    }
+    if (c == 13) return '\n';
+    if ((c >= 32) && (c <= 126)) return c;
+    return (c == 0) ? 0 : '?';
+}
+
+static rv_uint unicode_to_zscii(rv_uint u)
+{   rv_uint t, i, n;
+    if ((u >= 32) && (u <= 126)) return u;
+    if (u == '\n') return 13;
+    t = unicode_table();
+    n = t ? byte_at(t) : 69;
+    for (i=0; i<n; i++)
+        if ((t ? word_at(t + 1 + 2*i) : default_unicode[i]) == u)
+            return 155 + i;
+    return '?';
+}
+
+static void put_unicode(rv_uint u)
+{   if (u < 0x80) putchar((int) u);
+    else if (u < 0x800)
+    {   putchar(0xC0 | (u >> 6)); putchar(0x80 | (u & 0x3F));
+    }
+    else
+    {   putchar(0xE0 | (u >> 12)); putchar(0x80 | ((u >> 6) & 0x3F));
+        putchar(0x80 | (u & 0x3F));
+    }
+}
+
+static void print_zscii(rv_uint c)
+{   if (c == 0) return;
+    if (stream3_depth > 0)
+    {   rv_uint t = stream3[stream3_depth-1];
+        set_byte(t + 2 + stream3_count[stream3_depth-1]++, c);
+        return;
+    }
+    if (screen_on && (window == 0)) put_unicode(zscii_to_unicode(c));
+}
+
+static void print_unicode(rv_uint u)
+{   if ((stream3_depth > 0) || (u < 0x80)) print_zscii(unicode_to_zscii(u));
+    else if (screen_on && (window == 0)) put_unicode(u);
+}
+
+static void print_number(rv_uint v)
+{   char buf[16];
+    int i;
+    sprintf(buf, "%ld", (long) (int32_t) sgn(v));
+    for (i=0; buf[i]; i++) print_zscii(buf[i]);
+}
+
+/* ------------------------------------------------------------------------- */
+/*   Text                                                                    */
+/* ------------------------------------------------------------------------- */
+
+static const char a2_default[27] = " \r0123456789.,!?_#'\"/\\-:()";
+
+/*  The ZSCII character for Z-character z (6 to 31) in alphabet a.           */
+
+static rv_uint alphabet_char(int a, int z)
+{   rv_uint t = (version >= 5) ? word_at(0x34) : 0;
+    if (t) return byte_at(t + 26*a + (z-6));
+    if (a == 0) return 'a' + (z-6);
+    if (a == 1) return 'A' + (z-6);
+    return (z == 7) ? 13 : (rv_uint) (unsigned char) a2_default[z-6];
+}
+
+/*  Prints the string at addr, giving the address after its end.             */
+
+static rv_uint print_text(rv_uint addr, int in_abbreviation)
+{   rv_uint w, z, zs[3];
+    int i, alphabet = 0, abbreviation = 0, escape = 0, high = 0;
+    do
+    {   w = word_at(addr); addr += 2;
+        zs[0] = (w >> 10) & 31; zs[1] = (w >> 5) & 31; zs[2] = w & 31;
+        for (i=0; i<3; i++)
+        {   z = zs[i];
+            if (abbreviation)
+            {   rv_uint a = word_at(word_at(0x18) + 2*(32*(abbreviation-1)+z));
+                if (in_abbreviation) fatal_at("Abbreviation in abbreviation");
+                print_text(2*a, 1);
+                abbreviation = 0;
+            }
+            else if (escape == 1) { high = z; escape = 2; }
+            else if (escape == 2)
+            {   print_zscii((high << 5) | z); escape = 0;
+            }
+            else if (z == 0) { print_zscii(' '); alphabet = 0; }
+            else if (z <= 3) abbreviation = z;
+            else if (z == 4) { alphabet = 1; continue; }
+            else if (z == 5) { alphabet = 2; continue; }
+            else if ((alphabet == 2) && (z == 6)) escape = 1;
+            else if ((alphabet == 2) && (z == 7)) print_zscii(13);
+            else print_zscii(alphabet_char(alphabet, z));
+            alphabet = 0;
+        }
+    } while (!(w & 0x8000));
+    return addr;
+}
+
+/*  Encodes len ZSCII characters at addr as a dictionary word, in 4 bytes
+    (version 3) or 6 (later versions).                                       */
+
+static void encode_word(rv_uint addr, int len, unsigned char *out)
+{   int zs[12], n = 0, i, a, z, size = (version <= 3) ? 6 : 9;
+    rv_uint c, w;
+    for (i=0; (i<len) && (n<size); i++)
+    {   c = byte_at(addr+i);
+        for (a=0; a<3; a++)
+        {   for (z=6; z<32; z++)
+                if (((a < 2) || (z > 7)) && (alphabet_char(a, z) == c)) break;
+            if (z < 32) break;
+        }
+        if (a == 0) zs[n++] = z;
+        else if (a < 3) { zs[n++] = 3+a; zs[n++] = z; }
+        else
+        {   zs[n++] = 5; zs[n++] = 6;
+            zs[n++] = (c >> 5) & 31; zs[n++] = c & 31;
+        }
+    }
+    while (n < size) zs[n++] = 5;
+    for (i=0; i<size/3; i++)
+    {   w = (zs[3*i] << 10) | (zs[3*i+1] << 5) | zs[3*i+2];
+        if (i == size/3 - 1) w |= 0x8000;
+        out[2*i] = (unsigned char) (w >> 8);
+        out[2*i+1] = (unsigned char) w;
+    }
+}
+
+static rv_uint look_up(rv_uint dict, rv_uint addr, int len)
+{   unsigned char key[6];
+    rv_uint seps = byte_at(dict), entry_length, entries, e;
+    int count, lo, hi, mid, c, key_length = (version <= 3) ? 4 : 6;
+
+    entry_length = byte_at(dict + 1 + seps);
+    count = (int) sgn(word_at(dict + 2 + seps));
+    entries = dict + 4 + seps;
+    encode_word(addr, len, key);
+    if (count < 0)
+    {   for (mid=0; mid<-count; mid++)
+        {   e = entries + mid*entry_length;
+            if (memcmp(mem + e, key, key_length) == 0) return e;
+        }
+        return 0;
+    }
+    lo = 0; hi = count;
+    while (lo < hi)
+    {   mid = (lo + hi)/2;
+        e = entries + mid*entry_length;
+        c = memcmp(key, mem + e, key_length);
+        if (c == 0) return e;
+        if (c < 0) hi = mid; else lo = mid+1;
+    }
+    return 0;
+}
+
+static void tokenise(rv_uint text, rv_uint parse, rv_uint dict, int flag)
+{   rv_uint start, end, i, j, seps, max_words, words = 0, e;
+    int is_sep;
+
+    if (dict == 0) dict = word_at(0x08);
+    seps = byte_at(dict);
+    if (version <= 4)
+    {   start = text + 1;
+        for (end = start; byte_at(end) != 0; end++) ;
+    }
+    else
+    {   start = text + 2;
+        end = start + byte_at(text + 1);
+    }
+    max_words = byte_at(parse);
+
+    for (i = start; i < end; )
+    {   if (byte_at(i) == ' ') { i++; continue; }
+        for (j = i; j < end; j++)
+        {   rv_uint c = byte_at(j), k;
+            is_sep = 0;
+            for (k=0; k<seps; k++) if (byte_at(dict+1+k) == c) is_sep = 1;
+            if ((c == ' ') || is_sep)
+            {   if (j == i) j++;
+                break;
+            }
+        }
+        if (words < max_words)
+        {   e = look_up(dict, i, j - i);
+            if (e || !flag)
+            {   rv_uint entry = parse + 2 + 4*words;
+                set_word(entry, e);
+                set_byte(entry + 2, j - i);
+                set_byte(entry + 3, i - text);
+            }
+            words++;
+        }
+        i = j;
+    }
+    set_byte(parse + 1, words);
+}
+
+static void read_line(void)
+{   char buf[256];
+    rv_uint text = ops[0], parse = (nops > 1) ? ops[1] : 0, max, i;
+    int n = rv_read_line(buf, 255);
+
+    if (n < 0) rv_quit();
+    rv_turns++;
+    max = byte_at(text);
+    if (version <= 4) max = (max > 0) ? max - 1 : 0;
+    if ((rv_uint) n > max) n = max;
+    for (i=0; i<(rv_uint) n; i++)
+    {   rv_uint c = (unsigned char) buf[i];
+        if ((c >= 'A') && (c <= 'Z')) c += 32;
+        if ((c < 32) || (c > 126)) c = '?';
+        set_byte(text + ((version <= 4) ? 1 : 2) + i, c);
+    }
+    if (version <= 4) set_byte(text + 1 + n, 0);
+    else set_byte(text + 1, n);
+    if (parse) tokenise(text, parse, 0, 0);
+    if (version >= 5) store(13);
+}
+
+/* ------------------------------------------------------------------------- */
+/*   Objects                                                                 */
+/* ------------------------------------------------------------------------- */
+
+static rv_uint object_addr(rv_uint o)
+{   if (o == 0) fatal_at("Reference to object 0");
+    if (version <= 3) return word_at(0x0A) + 62 + 9*(o-1);
+    return word_at(0x0A) + 126 + 14*(o-1);
+}
+
+/*  Relatives: 0 parent, 1 sibling, 2 child.                                 */
+
+static rv_uint relative(rv_uint o, int r)
+{   if (o == 0) return 0;
+    if (version <= 3) return rb(object_addr(o) + 4 + r);
+    return rw(object_addr(o) + 6 + 2*r);
+}
+
+static void set_relative(rv_uint o, int r, rv_uint v)
+{   if (version <= 3) wb(object_addr(o) + 4 + r, v);
+    else ww(object_addr(o) + 6 + 2*r, v);
+}
+
+static rv_uint prop_table(rv_uint o)
+{   return rw(object_addr(o) + ((version <= 3) ? 7 : 12));
+}
+
+/*  Finds the property entry at addr: its number (0 at the end of the
+    list), the address of its data and its length.                           */
+
+static rv_uint prop_entry(rv_uint addr, rv_uint *data, rv_uint *len)
+{   rv_uint b = rb(addr);
+    if (b == 0) return 0;
+    if (version <= 3)
+    {   *len = (b >> 5) + 1; *data = addr + 1;
+        return b & 31;
+    }
+    if (b & 0x80)
+    {   *len = rb(addr + 1) & 63;
+        if (*len == 0) *len = 64;
+        *data = addr + 2;
+    }
+    else
+    {   *len = (b & 0x40) ? 2 : 1;
+        *data = addr + 1;
+    }
+    return b & 63;
+}
+
+static rv_uint first_prop(rv_uint o)
+{   rv_uint t = prop_table(o);
+    return t + 1 + 2*rb(t);
+}
+
+static rv_uint find_prop(rv_uint o, rv_uint p, rv_uint *len)
+{   rv_uint a = first_prop(o), n, data;
+    while ((n = prop_entry(a, &data, len)) != 0)
+    {   if (n == p) return data;
+        a = data + *len;
+    }
+    return 0;
+}
+
+static void remove_object(rv_uint o)
+{   rv_uint parent = relative(o, 0), x, next;
+    if (parent == 0) return;
+    next = relative(o, 1);
+    x = relative(parent, 2);
+    if (x == o) set_relative(parent, 2, next);
+    else
+    {   while (relative(x, 1) != o)
+        {   x = relative(x, 1);
+            if (x == 0) fatal_at("Object tree is corrupt");
+        }
+        set_relative(x, 1, next);
+    }
+    set_relative(o, 0, 0);
+    set_relative(o, 1, 0);
+}
+
+static rv_uint attribute_addr(rv_uint o, rv_uint a, rv_uint *bit)
+{   if (a >= ((version <= 3) ? 32U : 48U)) fatal_at("No such attribute");
+    *bit = 0x80 >> (a & 7);
+    return object_addr(o) + a/8;
+}
+
+/* ------------------------------------------------------------------------- */
+/*   Starting and restarting                                                 */
+/* ------------------------------------------------------------------------- */
+
+static rv_uint next_random(void)
+{   random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return random_state;
+}
+
+static void seed_random(rv_uint seed)
+{   random_state = seed ? seed : 1;
+}
+
+static void set_header(void)
+{   if (version <= 3) mem[0x01] = (mem[0x01] & 0x8F) | 0x20;
+    else mem[0x01] = 0;
+    mem[0x11] &= 0x47;             /* No pictures, undo, mouse or sound      */
+    mem[0x1E] = 6; mem[0x1F] = 'A';
+    mem[0x20] = 255; mem[0x21] = 80;
+    if (version >= 5)
+    {   mem[0x22] = 0; mem[0x23] = 80; mem[0x24] = 0; mem[0x25] = 255;
+        mem[0x26] = 1; mem[0x27] = 1;
+        mem[0x2C] = 1; mem[0x2D] = 1;
+    }
+    mem[0x32] = 1; mem[0x33] = 1;
+}
+
+static void restart(void)
+{   rv_uint flags2 = mem[0x11] & 3;
+    memcpy(mem, original, static_base);
+    mem[0x11] = (mem[0x11] & ~3) | flags2;
+    set_header();
+    sp = 0;
+    fp = 1;
+    frames[0].return_pc = 0;
+    frames[0].store = -1;
+    frames[0].stack_base = 0;
+    frames[0].argc = 0;
+    frames[0].nlocals = 0;
+    frames[0].routine = rv_routine_index(start_pc);
+    pc = start_pc;
+    window = 0; screen_on = 1; stream3_depth = 0;
+}
+
+/* ------------------------------------------------------------------------- */
+/*   Decoding and executing instructions                                     */
+/* ------------------------------------------------------------------------- */
+
+static void note_operand_types(rv_uint types, int count)
+{   int i, t;
+    for (i=0; i<count; i++)
+    {   t = (types >> (6 - 2*i)) & 3;
+        if (t == 3) break;
+        if (t == 0) { ops[nops] = fetch() << 8; ops[nops] |= fetch(); }
+        else if (t == 1) ops[nops] = fetch();
+        else ops[nops] = read_var(fetch());
+        nops++;
+    }
+}
+
+static void make_tables(void)
+{   static const int store_ops[] =
+    {   OP2(8), OP2(9), OP2(15), OP2(16), OP2(17), OP2(18), OP2(19),
+        OP2(20), OP2(21), OP2(22), OP2(23), OP2(24), OP2(25),
+        OP1(1), OP1(2), OP1(3), OP1(4), OP1(8), OP1(14),
+        VAR(0), VAR(7), VAR(12), VAR(22), VAR(23), VAR(24),
+        EXT(0), EXT(1), EXT(2), EXT(3), EXT(4), EXT(9), EXT(10), EXT(12),
+        -1 };
+    static const int branch_ops[] =
+    {   OP2(1), OP2(2), OP2(3), OP2(4), OP2(5), OP2(6), OP2(7), OP2(10),
+        OP1(0), OP1(1), OP1(2), OP0(13), OP0(15), VAR(23), VAR(31), -1 };
+    int i;
+    for (i=0; store_ops[i] >= 0; i++) stores[store_ops[i]] = 1;
+    for (i=0; branch_ops[i] >= 0; i++) branches[branch_ops[i]] = 1;
+    if (version <= 4) stores[OP1(15)] = 1;
+    if (version >= 5) { stores[OP0(9)] = 1; stores[VAR(4)] = 1; }
+    if (version <= 3) { branches[OP0(5)] = 1; branches[OP0(6)] = 1; }
+    if (version == 4) { stores[OP0(5)] = 1; stores[OP0(6)] = 1; }
+}
+
+static void execute(void)
+{   rv_uint op, n, a, b, x, len, i;
+    int opcode;
+    rv_uint saved_pc = pc;
+
+    nops = 0;
+    op = fetch();
+    if ((op == 0xBE) && (version >= 5))
+    {   n = fetch();
+        if (n >= 32) fatal_at("Unknown extended opcode");
+        opcode = EXT(n);
+        note_operand_types(fetch(), 4);
+    }
+    else if (op >= 0xC0)
+    {   n = op & 0x1F;
+        opcode = (op >= 0xE0) ? VAR(n) : OP2(n);
+        a = fetch();
+        if ((opcode == VAR(12)) || (opcode == VAR(26)))
+        {   b = fetch();
+            note_operand_types(a, 4);
+            if (nops == 4) note_operand_types(b, 4);
+        }
+        else note_operand_types(a, 4);
+    }
+    else if (op >= 0x80)
+    {   n = op & 0x0F;
+        if (((op >> 4) & 3) == 3) opcode = OP0(n);
+        else
+        {   opcode = OP1(n);
+            note_operand_types(((op >> 4) & 3) << 6 | 0x3F, 1);
+        }
+    }
+    else
+    {   opcode = OP2(op & 0x1F);
+        ops[0] = (op & 0x40) ? read_var(fetch()) : fetch();
+        ops[1] = (op & 0x20) ? read_var(fetch()) : fetch();
+        nops = 2;
+    }
+    store_var = (stores[opcode]) ? (int) fetch() : -1;
+
+    rv_instructions++;
+    rv_opcodes[opcode]++;
+    rv_routines[frames[fp-1].routine].instructions++;
+
+    switch (opcode)
+    {
+        /* --- Arithmetic and logic ---------------------------------------- */
+
+        case OP2(20): store(ops[0] + ops[1]); break;
+        case OP2(21): store(ops[0] - ops[1]); break;
+        case OP2(22): store(ops[0] * ops[1]); break;
+        case OP2(23): case OP2(24):
+            if ((ops[1] & 0xFFFF) == 0) fatal_at("Division by zero");
+            a = sgn(ops[0]); b = sgn(ops[1]);
+            if (opcode == OP2(23))
+                store((rv_uint) ((int32_t) a / (int32_t) b));
+            else store((rv_uint) ((int32_t) a % (int32_t) b));
+            break;
+        case OP2(8): store(ops[0] | ops[1]); break;
+        case OP2(9): store(ops[0] & ops[1]); break;
+        case OP1(15):
+            if (version <= 4) store(~ops[0]);
+            else call(ops[0], 0, NULL, -1);
+            break;
+        case VAR(24): store(~ops[0]); break;
+        case EXT(2):
+            x = sgn(ops[1]);
+            if ((int32_t) x >= 0) store(((int32_t) x >= 16) ? 0 : ops[0] << x);
+            else store(((int32_t) x <= -16) ? 0 : (ops[0] & 0xFFFF) >> -x);
+            break;
+        case EXT(3):
+            x = sgn(ops[1]);
+            if ((int32_t) x >= 0) store(((int32_t) x >= 16) ? 0 : ops[0] << x);
+            else store((rv_uint) ((int32_t) sgn(ops[0])
+                >> (((int32_t) x <= -16) ? 15 : -(int32_t) x)));
+            break;
+
+        /* --- Branches ---------------------------------------------------- */
+
+        case OP2(1):
+            for (i=1, x=0; i<(rv_uint) nops; i++)
+                if ((ops[0] & 0xFFFF) == (ops[i] & 0xFFFF)) x = 1;
+            branch(x);
+            break;
+        case OP2(2): branch((int32_t) sgn(ops[0]) < (int32_t) sgn(ops[1]));
+            break;
+        case OP2(3): branch((int32_t) sgn(ops[0]) > (int32_t) sgn(ops[1]));
+            break;
+        case OP2(4): case OP2(5):
+            x = read_var_in_place(ops[0]) + ((opcode == OP2(4)) ? -1 : 1);
+            write_var_in_place(ops[0], x);
+            if (opcode == OP2(4))
+                branch((int32_t) sgn(x & 0xFFFF) < (int32_t) sgn(ops[1]));
+            else
+                branch((int32_t) sgn(x & 0xFFFF) > (int32_t) sgn(ops[1]));
+            break;
+        case OP2(7): branch((ops[0] & ops[1]) == ops[1]); break;
+        case OP1(0): branch((ops[0] & 0xFFFF) == 0); break;
+        case OP1(12): pc += sgn(ops[0]) - 2; break;
+        case VAR(31): branch(ops[0] <= (rv_uint) frames[fp-1].argc); break;
+        case OP0(13): case OP0(15): branch(1); break;
+
+        /* --- Variables and the stack ------------------------------------- */
+
+        case OP2(13): write_var_in_place(ops[0], ops[1]); break;
+        case OP1(14): store(read_var_in_place(ops[0])); break;
+        case OP1(5): case OP1(6):
+            x = read_var_in_place(ops[0]) + ((opcode == OP1(5)) ? 1 : -1);
+            write_var_in_place(ops[0], x);
+            break;
+        case VAR(8): push(ops[0]); break;
+        case VAR(9): x = pop(); write_var_in_place(ops[0], x); break;
+        case OP0(9):
+            if (version <= 4) pop();
+            else store(fp);
+            break;
+
+        /* --- Memory ------------------------------------------------------ */
+
+        case OP2(15): store(rw((ops[0] + 2*ops[1]) & 0xFFFF)); break;
+        case OP2(16): store(rb((ops[0] + ops[1]) & 0xFFFF)); break;
+        case VAR(1): ww((ops[0] + 2*ops[1]) & 0xFFFF, ops[2]); break;
+        case VAR(2): wb((ops[0] + ops[1]) & 0xFFFF, ops[2]); break;
+        case VAR(29):
+            len = (rv_uint) (int32_t) sgn(ops[2]);
+            a = ops[0]; b = ops[1];
+            if ((int32_t) len < 0) len = -len;
+            if (b == 0)
+                for (i=0; i<len; i++) wb(a+i, 0);
+            else if (((int32_t) sgn(ops[2]) < 0) || (b <= a))
+                for (i=0; i<len; i++) wb(b+i, rb(a+i));
+            else
+                for (i=len; i>0; i--) wb(b+i-1, rb(a+i-1));
+            break;
+        case VAR(23):
+            n = (nops > 3) ? ops[3] : 0x82;
+            for (i=0, x=0; i<ops[2]; i++)
+            {   a = ops[1] + i*(n & 0x7F);
+                if (((n & 0x80) ? rw(a) : rb(a)) == (ops[0] & 0xFFFF))
+                {   x = a; break;
+                }
+            }
+            store(x);
+            branch(x != 0);
+            break;
+
+        /* --- Calls and returns ------------------------------------------- */
+
+        case VAR(0): case VAR(12): case VAR(25): case VAR(26):
+        case OP1(8): case OP2(25): case OP2(26):
+            call(ops[0], nops-1, ops+1, store_var);
+            break;
+        case OP1(11): ret(ops[0]); break;
+        case OP0(0): ret(1); break;
+        case OP0(1): ret(0); break;
+        case OP0(8): ret(pop()); break;
+        case OP0(3): pc = print_text(pc, 0); print_zscii(13); ret(1); break;
+        case OP2(28):
+            if ((ops[1] < 1) || (ops[1] > (rv_uint) fp))
+                fatal_at("Bad frame for throw");
+            fp = ops[1];
+            ret(ops[0]);
+            break;
+
+        /* --- Objects ----------------------------------------------------- */
+
+        case OP2(6): branch((ops[0] != 0) && (relative(ops[0], 0) == ops[1]));
+            break;
+        case OP2(10): case OP2(11): case OP2(12):
+            a = attribute_addr(ops[0], ops[1], &b);
+            x = rb(a);
+            if (opcode == OP2(10)) branch((x & b) != 0);
+            else wb(a, (opcode == OP2(11)) ? (x | b) : (x & ~b));
+            break;
+        case OP2(14):
+            remove_object(ops[0]);
+            set_relative(ops[0], 0, ops[1]);
+            set_relative(ops[0], 1, relative(ops[1], 2));
+            set_relative(ops[1], 2, ops[0]);
+            break;
+        case OP1(9): if (ops[0]) remove_object(ops[0]); break;
+        case OP1(1): x = relative(ops[0], 1); store(x); branch(x); break;
+        case OP1(2): x = relative(ops[0], 2); store(x); branch(x); break;
+        case OP1(3): store(relative(ops[0], 0)); break;
+        case OP2(17):
+            a = find_prop(ops[0], ops[1], &len);
+            if (a == 0)
+                store(rw(word_at(0x0A) + 2*(ops[1]-1)));
+            else store((len == 1) ? rb(a) : rw(a));
+            break;
+        case OP2(18):
+            store((ops[0] == 0) ? 0 : find_prop(ops[0], ops[1], &len));
+            break;
+        case OP2(19):
+            if (ops[1] == 0) a = first_prop(ops[0]);
+            else
+            {   a = find_prop(ops[0], ops[1], &len);
+                if (a == 0) fatal_at("get_next_prop on a missing property");
+                a += len;
+            }
+            store(prop_entry(a, &b, &len));
+            break;
+        case OP1(4):
+            if (ops[0] == 0) { store(0); break; }
+            x = rb(ops[0] - 1);
+            if (version <= 3) store((x >> 5) + 1);
+            else if (x & 0x80) store(((x & 63) == 0) ? 64 : (x & 63));
+            else store((x & 0x40) ? 2 : 1);
+            break;
+        case VAR(3):
+            a = find_prop(ops[0], ops[1], &len);
+            if (a == 0) fatal_at("put_prop on a missing property");
+            if (len == 1) wb(a, ops[2]); else ww(a, ops[2]);
+            break;
+        case OP1(10):
+            a = prop_table(ops[0]);
+            if (byte_at(a)) print_text(a + 1, 0);
+            break;
+
+        /* --- Text -------------------------------------------------------- */
+
+        case OP0(2): pc = print_text(pc, 0); break;
+        case OP1(7): print_text(ops[0], 0); break;
+        case OP1(13): print_text(unpack(ops[0], 0), 0); break;
+        case OP0(11): print_zscii(13); break;
+        case VAR(5): print_zscii(ops[0] & 0x3FF); break;
+        case VAR(6): print_number(ops[0]); break;
+        case EXT(11): print_unicode(ops[0]); break;
+        case EXT(12): store(3); break;
+        case VAR(30):
+            for (b=0; b<((nops > 2) ? ops[2] : 1); b++)
+            {   if (b) print_zscii(13);
+                for (i=0; i<ops[1]; i++)
+                    print_zscii(rb(ops[0] + b*(ops[1] + ((nops > 3)
+                        ? ops[3] : 0)) + i));
+            }
+            break;
+        case VAR(28):
+        {   unsigned char coded[6];
+            encode_word(ops[0] + ops[2], ops[1], coded);
+            for (i=0; i<6; i++) wb(ops[3]+i, coded[i]);
+            break;
+        }
+        case VAR(27):
+            tokenise(ops[0], ops[1], (nops > 2) ? ops[2] : 0,
+                (nops > 3) ? ops[3] : 0);
+            break;
+
+        /* --- Input ------------------------------------------------------- */
+
+        case VAR(4): read_line(); break;
+        case VAR(22):
+        {   char buf[256];
+            int len = rv_read_line(buf, 255);
+            if (len < 0) rv_quit();
+            rv_turns++;
+            store((len == 0) ? 13 : unicode_to_zscii((unsigned char) buf[0]));
+            break;
+        }
+
+        /* --- Screen and streams ------------------------------------------ */
+
+        case VAR(19):
+            x = sgn(ops[0]);
+            if (x == 1) screen_on = 1;
+            else if (x == (rv_uint) -1) screen_on = 0;
+            else if (x == 2) set_byte(0x11, mem[0x11] | 1);
+            else if (x == (rv_uint) -2) set_byte(0x11, mem[0x11] & ~1);
+            else if (x == 3)
+            {   if (stream3_depth == MAX_STREAM3)
+                    fatal_at("Output stream 3 nested too deeply");
+                stream3[stream3_depth] = ops[1];
+                stream3_count[stream3_depth++] = 0;
+            }
+            else if ((x == (rv_uint) -3) && (stream3_depth > 0))
+            {   stream3_depth--;
+                set_word(stream3[stream3_depth], stream3_count[stream3_depth]);
+            }
+            break;
+        case VAR(11): window = ops[0]; break;
+        case VAR(16): set_word(ops[0], 1); set_word(ops[0]+2, 1); break;
+        case EXT(4):
+            store(((ops[0] == 0) || (ops[0] == 1)) ? 1 : 0);
+            break;
+        case VAR(10): case VAR(13): case VAR(14): case VAR(15): case VAR(17):
+        case VAR(18): case VAR(20): case VAR(21): case OP2(27): case OP0(12):
+        case OP0(4): case EXT(13):
+            break;
+
+        /* --- The machine ------------------------------------------------- */
+
+        case VAR(7):
+            x = sgn(ops[0]);
+            if ((int32_t) x > 0) store(1 + next_random() % x);
+            else
+            {   seed_random((x == 0) ? rv_random_seed : -x);
+                store(0);
+            }
+            break;
+        case OP0(5): case OP0(6):
+            if (version <= 3) branch(0); else store(0);
+            break;
+        case EXT(0): case EXT(1): store(0); break;
+        case EXT(9): store(0xFFFF); break;
+        case EXT(10): store(0); break;
+        case OP0(7): restart(); break;
+        case OP0(10): rv_quit(); break;
+
+        default:
+            pc = saved_pc;
+            {   char buf[64];
+                sprintf(buf, "Unsupported opcode %s", zvm_opcode_name(opcode));
+                fatal_at(buf);
+            }
+    }
+}
+
+extern void zvm_run(unsigned char *story, rv_uint length)
+{   char buf[64];
+    version = story[0];
+    if ((length < 64) || (version < 3) || (version > 8) || (version == 6))
+    {   sprintf(buf, "Unsupported story file (version %lu)",
+            (unsigned long) version);
+        rv_fatal(buf);
+    }
+    mem_size = length;
+    mem = story;
+    static_base = word_at(0x0E);
+    if (static_base > mem_size) rv_fatal("Story file is truncated");
+    original = malloc(static_base);
+    if (original == NULL) rv_fatal("Out of memory");
+    memcpy(original, mem, static_base);
+    start_pc = word_at(0x06);
+    make_tables();
+    seed_random(rv_random_seed);
+    restart();
+
+    while (1)
+    {   if (rv_limit && (rv_instructions >= rv_limit))
+        {   fflush(stdout);
+            fprintf(stderr, "refvm: stopped after %llu instructions\n",
+                (unsigned long long) rv_instructions);
+            rv_quit();
+        }
+        execute();
+    }
+}
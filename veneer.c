@@ -95,6 +95,92 @@ typedef struct VeneerRoutine_s
 
 static char *veneer_source_area;
 
+/*  The body of CA__Pr for Z-code is assembled from the pieces below, which
+    are shared with the arity-specialised entry points CA__Pr0 to CA__Pr6.
+    Those are called when the number of arguments in a message send is known
+    at compile time, and so have no need of CA__Pr's @check_arg_count
+    prologue, or to switch on the argument count afterwards.                */
+
+#define CA__PR_Z_REGIONS \
+        "if (obj < 1 || obj > #largest_object-255)\
+         {   switch(Z__Region(obj))\
+             { 2: if (id == call)\
+                   { s = sender; sender = self; self = obj;\
+                     #ifdef action;sw__var=action;#endif;\
+                     x = indirect(obj, a, b, c, d, e, f);\
+                     self = sender; sender = s; return x; }\
+                   jump Call__Error;"
+
+#define CA__PR_Z_STRINGS \
+        "3: if (id == print) { @print_paddr obj; rtrue; }\
+                   if (id == print_to_array)\
+                   { @output_stream 3 a; @print_paddr obj; @output_stream -3;\
+                     return a-->0; }\
+                   jump Call__Error;\
+             }\
+             jump Call__Error;\
+         }"
+
+#define CA__PR_Z_TRACE_OPEN \
+        "#ifdef INFIX;if (obj has infix__watching) n=1;#endif;\
+         #ifdef DEBUG;if (debug_flag & 1 ~= 0) n=1;#endif;\
+         if (n==1) {\
+           #ifdef DEBUG;n=debug_flag & 1; debug_flag=debug_flag-n;#endif;\
+           print \"[ ~\", (name) obj, \"~.\", (property) id, \"(\";"
+
+#define CA__PR_Z_TRACE_CLOSE \
+        "print \") ]^\";\
+           #ifdef DEBUG;debug_flag = debug_flag + n;#endif;\
+           }"
+
+#define CA__PR_Z_LOOKUP_OPEN \
+        "if (id > 0 && id < 64)\
+         { x = obj.&id; if (x==0) { x=$000a-->0 + 2*(id-1); n=2; }\
+         else n = obj.#id; }\
+         else\
+         { if (id>=64 && id<69 && obj in Class)\
+             return Cl__Ms(obj,id,"
+
+#define CA__PR_Z_LOOKUP_CLOSE \
+        ",a,b,c,d);\
+           x = obj..&id;\
+           if (x == 0) { .Call__Error;\
+             RT__Err(\"send message\", obj, id); return; }\
+           n = 0->(x-1);\
+           if (id&$C000==$4000)\
+             switch (n&$C0) { 0: n=1; $40: n=2; $80: n=n&$3F; }\
+         }"
+
+#define CA__PR_Z_LOOP_OPEN \
+        "for (:2*m<n:m++)\
+         {  if (x-->m==$ffff) rfalse;\
+            switch(Z__Region(x-->m))\
+            { 2: s = sender; sender = self; self = obj; s2 = sw__var;\
+               #ifdef LibSerial;\
+               if (id==life) sw__var=reason_code; else sw__var=action;\
+               #endif;"
+
+#define CA__PR_Z_LOOP_CLOSE \
+        "self = sender; sender = s; sw__var = s2;\
+                 if (z ~= 0) return z;\
+              3: print_ret (string) x-->m;\
+        default: return x-->m;\
+            }\
+         }"
+
+/*  CA__Pr<n> passes exactly n arguments on; the unused argument locals a to
+    f are still declared so that the shared pieces above can name them.     */
+
+#define CA__PR_Z_ARITY(name, n, trace, args) \
+    {   name,\
+        "obj id a b c d e f x z s s2 n m;" CA__PR_Z_REGIONS,\
+        CA__PR_Z_STRINGS,\
+        CA__PR_Z_TRACE_OPEN trace CA__PR_Z_TRACE_CLOSE,\
+        CA__PR_Z_LOOKUP_OPEN n CA__PR_Z_LOOKUP_CLOSE,\
+        CA__PR_Z_LOOP_OPEN "z = indirect(x-->m" args ");" CA__PR_Z_LOOP_CLOSE,\
+        "rfalse; ]"\
+    }
+
 static VeneerRoutine VRs_z[VENEER_ROUTINES] =
 {
     /*  Box__Routine:  the only veneer routine used in the implementation of
@@ -263,69 +349,25 @@ static VeneerRoutine VRs_z[VENEER_ROUTINES] =
          #IFV3;\
          #Message error \"Object message calls are not supported in v3.\";\
          obj = id = a = b = c = d = e = f = x = y = z = s = s2 = n = m = 0;\
-         #IFNOT;\
-         if (obj < 1 || obj > #largest_object-255)\
-         {   switch(Z__Region(obj))\
-             { 2: if (id == call)\
-                   { s = sender; sender = self; self = obj;\
-                     #ifdef action;sw__var=action;#endif;\
-                     x = indirect(obj, a, b, c, d, e, f);\
-                     self = sender; sender = s; return x; }\
-                   jump Call__Error;",
-              "3: if (id == print) { @print_paddr obj; rtrue; }\
-                   if (id == print_to_array)\
-                   { @output_stream 3 a; @print_paddr obj; @output_stream -3;\
-                     return a-->0; }\
-                   jump Call__Error;\
-             }\
-             jump Call__Error;\
-         }\
-         @check_arg_count 3 ?~A__x;y++;@check_arg_count 4 ?~A__x;y++;\
+         #IFNOT;" CA__PR_Z_REGIONS,
+         CA__PR_Z_STRINGS
+        "@check_arg_count 3 ?~A__x;y++;@check_arg_count 4 ?~A__x;y++;\
          @check_arg_count 5 ?~A__x;y++;@check_arg_count 6 ?~A__x;y++;\
          @check_arg_count 7 ?~A__x;y++;@check_arg_count 8 ?~A__x;y++;.A__x;",
-        "#ifdef INFIX;if (obj has infix__watching) n=1;#endif;\
-         #ifdef DEBUG;if (debug_flag & 1 ~= 0) n=1;#endif;\
-         if (n==1) {\
-           #ifdef DEBUG;n=debug_flag & 1; debug_flag=debug_flag-n;#endif;\
-           print \"[ ~\", (name) obj, \"~.\", (property) id, \"(\";\
-     switch(y) { 1: print a; 2: print a,\",\",b; 3: print a,\",\",b,\",\",c;\
+         CA__PR_Z_TRACE_OPEN
+    "switch(y) { 1: print a; 2: print a,\",\",b; 3: print a,\",\",b,\",\",c;\
      4: print a,\",\",b,\",\",c,\",\",d;\
      5: print a,\",\",b,\",\",c,\",\",d,\",\",e;\
-     6: print a,\",\",b,\",\",c,\",\",d,\",\",e,\",\",f; }\
-           print \") ]^\";\
-           #ifdef DEBUG;debug_flag = debug_flag + n;#endif;\
-           }",
-        "if (id > 0 && id < 64)\
-         { x = obj.&id; if (x==0) { x=$000a-->0 + 2*(id-1); n=2; }\
-         else n = obj.#id; }\
-         else\
-         { if (id>=64 && id<69 && obj in Class)\
-             return Cl__Ms(obj,id,y,a,b,c,d);\
-           x = obj..&id;\
-           if (x == 0) { .Call__Error;\
-             RT__Err(\"send message\", obj, id); return; }\
-           n = 0->(x-1);\
-           if (id&$C000==$4000)\
-             switch (n&$C0) { 0: n=1; $40: n=2; $80: n=n&$3F; }\
-         }",
-        "for (:2*m<n:m++)\
-         {  if (x-->m==$ffff) rfalse;\
-            switch(Z__Region(x-->m))\
-            { 2: s = sender; sender = self; self = obj; s2 = sw__var;\
-               #ifdef LibSerial;\
-               if (id==life) sw__var=reason_code; else sw__var=action;\
-               #endif;\
-     switch(y) { 0: z = indirect(x-->m); 1: z = indirect(x-->m, a);\
+     6: print a,\",\",b,\",\",c,\",\",d,\",\",e,\",\",f; }"
+         CA__PR_Z_TRACE_CLOSE,
+         CA__PR_Z_LOOKUP_OPEN "y" CA__PR_Z_LOOKUP_CLOSE,
+         CA__PR_Z_LOOP_OPEN
+    "switch(y) { 0: z = indirect(x-->m); 1: z = indirect(x-->m, a);\
      2: z = indirect(x-->m, a, b); 3: z = indirect(x-->m, a, b, c);",
     "4: z = indirect(x-->m, a, b, c, d); 5:z = indirect(x-->m, a, b, c, d, e);\
-     6: z = indirect(x-->m, a, b, c, d, e, f); }\
-                 self = sender; sender = s; sw__var = s2;\
-                 if (z ~= 0) return z;\
-              3: print_ret (string) x-->m;\
-        default: return x-->m;\
-            }\
-         }\
-         #ENDIF;\
+     6: z = indirect(x-->m, a, b, c, d, e, f); }"
+         CA__PR_Z_LOOP_CLOSE
+        "#ENDIF;\
          rfalse;\
          ]"
     },
@@ -953,6 +995,77 @@ static VeneerRoutine VRs_z[VENEER_ROUTINES] =
         "a;\
          if (Z__Region(a)~=1) return RT__Err(36);",
         "@print_obj a; ]", "", "", "", ""
+    },
+    /*  CA__Pr0 to CA__Pr6:  as CA__Pr, for a message send with exactly 0 to 6
+                     arguments                                               */
+
+    CA__PR_Z_ARITY("CA__Pr0", "0", "", ""),
+    CA__PR_Z_ARITY("CA__Pr1", "1", "print a;", ", a"),
+    CA__PR_Z_ARITY("CA__Pr2", "2", "print a,\",\",b;", ", a, b"),
+    CA__PR_Z_ARITY("CA__Pr3", "3",
+        "print a,\",\",b,\",\",c;", ", a, b, c"),
+    CA__PR_Z_ARITY("CA__Pr4", "4",
+        "print a,\",\",b,\",\",c,\",\",d;", ", a, b, c, d"),
+    CA__PR_Z_ARITY("CA__Pr5", "5",
+        "print a,\",\",b,\",\",c,\",\",d,\",\",e;", ", a, b, c, d, e"),
+    CA__PR_Z_ARITY("CA__Pr6", "6",
+        "print a,\",\",b,\",\",c,\",\",d,\",\",e,\",\",f;",
+        ", a, b, c, d, e, f"),
+    {   /*  Grammar__Mask:  look up a dictionary word among the prepositions
+                     of #grammar_index_table, returning its index plus 1 (or
+                     0 if it is not there); if mask is non-zero, also set its
+                     bit in the bitmap at mask                               */
+
+        "Grammar__Mask",
+        "mask word t lo hi mid x;\
+         t = #grammar_index_table; lo = 0; hi = (t-->0) - 1; t = t-->2;\
+         while (lo <= hi)\
+         {   mid = (lo + hi) / 2; x = Unsigned__Compare(word, t-->mid);\
+             if (x == 0)\
+             {   if (mask)\
+                 {   x = 1; for (t = mid % 8 : t > 0 : t--) x = x * 2;\
+                     mask->(mid / 8) = (mask->(mid / 8)) | x;\
+                 }\
+                 return mid + 1;\
+             }\
+             if (x < 0) hi = mid - 1; else lo = mid + 1;\
+         }\
+         rfalse;\
+         ]", "", "", "", "", ""
+    },
+    {   /*  Grammar__Line_Ok:  returns false if grammar line 'line' of the
+                     verb numbered 'verb' in #grammar_table cannot match:
+                     if it begins with a preposition other than 'first'
+                     (unless that is 0), or needs a preposition whose bit
+                     is clear in the bitmap at mask (unless that is 0)       */
+
+        "Grammar__Line_Ok",
+        "verb line mask first t n i b;\
+         t = #grammar_index_table; n = t-->1;\
+         i = t-->(3 + verb); if (i == 0) rfalse;\
+         i = i + line * (n + 2);\
+         if (first && i->0 == 2 && i->1 ~= 0\
+             && Grammar__Mask(0, first) ~= i->1) rfalse;\
+         if (mask)\
+             for (b = 0 : b < n : b++)\
+                 if ((i->(b + 2)) & ~(mask->b)) rfalse;\
+         rtrue;\
+         ]", "", "", "", "", ""
+    },
+    {   /*  Name__Search:  returns true if 'word' is in the name list of
+                     'obj', which $SORT_NAME_PROPERTIES has sorted           */
+
+        "Name__Search",
+        "obj word a lo hi mid x;\
+         a = obj.&name; if (a == 0) rfalse;\
+         lo = 0; hi = (obj.#name) / 2 - 1;\
+         while (lo <= hi)\
+         {   mid = (lo + hi) / 2; x = Unsigned__Compare(word, a-->mid);\
+             if (x == 0) rtrue;\
+             if (x < 0) hi = mid - 1; else lo = mid + 1;\
+         }\
+         rfalse;\
+         ]", "", "", "", "", ""
     }
 };
 
@@ -1890,13 +2003,123 @@ static VeneerRoutine VRs_g[VENEER_ROUTINES] =
            @aload obj GOBJFIELD_NAME sp; @streamstr sp;\
          ]", "", "", "", "", ""
     },
+    {
+        /*  CA__Pr0 to CA__Pr6: only called from Z-code, since the Glulx
+            CA__Pr already knows its argument count from _vararg_count.
+            These simply pass the message on to CA__Pr.
+        */
+        "CA__Pr0",
+        "obj id; return CA__Pr(obj, id); ]", "", "", "", "", ""
+    },
+    {   "CA__Pr1",
+        "obj id a; return CA__Pr(obj, id, a); ]", "", "", "", "", ""
+    },
+    {   "CA__Pr2",
+        "obj id a b; return CA__Pr(obj, id, a, b); ]", "", "", "", "", ""
+    },
+    {   "CA__Pr3",
+        "obj id a b c; return CA__Pr(obj, id, a, b, c); ]",
+        "", "", "", "", ""
+    },
+    {   "CA__Pr4",
+        "obj id a b c d; return CA__Pr(obj, id, a, b, c, d); ]",
+        "", "", "", "", ""
+    },
+    {   "CA__Pr5",
+        "obj id a b c d e; return CA__Pr(obj, id, a, b, c, d, e); ]",
+        "", "", "", "", ""
+    },
+    {   "CA__Pr6",
+        "obj id a b c d e f; return CA__Pr(obj, id, a, b, c, d, e, f); ]",
+        "", "", "", "", ""
+    },
+    {
+        /*  Grammar__Mask: Look up a dictionary word among the prepositions
+            of #grammar_index_table, returning its index plus 1 (or 0 if it
+            is not there). If mask is non-zero, also set its bit in the
+            bitmap at mask.
+        */
+        "Grammar__Mask",
+        "mask word t lo hi mid x;\
+           t = #grammar_index_table;\
+           lo = 0; hi = (t-->0) - 1; t = t-->2;\
+           while (lo <= hi) {\
+             mid = (lo + hi) / 2; x = t-->mid;\
+             if (word == x) {\
+               if (mask) {\
+                 t = mid % 8; @shiftl 1 t x;\
+                 mask->(mid / 8) = (mask->(mid / 8)) | x;\
+               }\
+               return mid + 1;\
+             }\
+             if (word < x) hi = mid - 1; else lo = mid + 1;\
+           }\
+           rfalse;\
+         ]", "", "", "", "", ""
+    },
+    {
+        /*  Grammar__Line_Ok: Return false if grammar line 'line' of the verb
+            numbered 'verb' in #grammar_table cannot match: if it begins
+            with a preposition other than 'first' (unless that is 0), or
+            needs a preposition whose bit is clear in the bitmap at mask
+            (unless that is 0).
+        */
+        "Grammar__Line_Ok",
+        "verb line mask first t n i b;\
+           t = #grammar_index_table; n = t-->1;\
+           i = t-->(3 + verb);\
+           if (i == 0) rfalse;\
+           i = i + line * (n + 2);\
+           if (first && i->0 == 2 && i->1 ~= 0\
+               && Grammar__Mask(0, first) ~= i->1) rfalse;\
+           if (mask) {\
+             for (b = 0 : b < n : b++)\
+               if ((i->(b + 2)) & ~(mask->b)) rfalse;\
+           }\
+           rtrue;\
+         ]", "", "", "", "", ""
+    },
+    {
+        /*  Name__Search: Return true if word is in the name list of obj,
+            which $SORT_NAME_PROPERTIES has sorted.
+        */
+        "Name__Search",
+        "obj word a lo hi mid x;\
+           a = obj.&name;\
+           if (a == 0) rfalse;\
+           lo = 0; hi = (obj.#name) / WORDSIZE - 1;\
+           while (lo <= hi) {\
+             mid = (lo + hi) / 2; x = a-->mid;\
+             if (word == x) rtrue;\
+             if (word < x) hi = mid - 1; else lo = mid + 1;\
+           }\
+           rfalse;\
+         ]", "", "", "", "", ""
+    },
     {
         /*  OB__Move: Move an object within the object tree. This does no
-            more error checking than the Z-code \"move\" opcode.
+            more error checking than the Z-code \"move\" opcode. If objects
+            record their previous siblings, no list needs to be searched.
         */
         "OB__Move",
         "obj dest par chi sib;\
            par = obj-->GOBJFIELD_PARENT;\
+           #ifdef GOBJFIELD_PREVSIB;\
+           if (par ~= 0) {\
+             chi = obj-->GOBJFIELD_PREVSIB;\
+             sib = obj-->GOBJFIELD_SIBLING;\
+             if (chi == 0) par-->GOBJFIELD_CHILD = sib;\
+             else chi-->GOBJFIELD_SIBLING = sib;\
+             if (sib ~= 0) sib-->GOBJFIELD_PREVSIB = chi;\
+           }\
+           sib = dest-->GOBJFIELD_CHILD;\
+           if (sib ~= 0) sib-->GOBJFIELD_PREVSIB = obj;\
+           obj-->GOBJFIELD_PREVSIB = 0;\
+           obj-->GOBJFIELD_SIBLING = sib;\
+           obj-->GOBJFIELD_PARENT = dest;\
+           dest-->GOBJFIELD_CHILD = obj;\
+           rfalse;\
+           #ifnot;\
            if (par ~= 0) {\
              chi = par-->GOBJFIELD_CHILD;\
              if (chi == obj) {\
@@ -1916,6 +2139,7 @@ static VeneerRoutine VRs_g[VENEER_ROUTINES] =
            obj-->GOBJFIELD_PARENT = dest;\
            dest-->GOBJFIELD_CHILD = obj;\
            rfalse;\
+           #endif;\
          ]", "", "", "", "", ""
     },
 
@@ -1928,6 +2152,14 @@ static VeneerRoutine VRs_g[VENEER_ROUTINES] =
            par = obj-->GOBJFIELD_PARENT;\
            if (par == 0)\
              rfalse;\
+           #ifdef GOBJFIELD_PREVSIB;\
+           chi = obj-->GOBJFIELD_PREVSIB;\
+           sib = obj-->GOBJFIELD_SIBLING;\
+           if (chi == 0) par-->GOBJFIELD_CHILD = sib;\
+           else chi-->GOBJFIELD_SIBLING = sib;\
+           if (sib ~= 0) sib-->GOBJFIELD_PREVSIB = chi;\
+           obj-->GOBJFIELD_PREVSIB = 0;\
+           #ifnot;\
            chi = par-->GOBJFIELD_CHILD;\
            if (chi == obj) {\
              par-->GOBJFIELD_CHILD = obj-->GOBJFIELD_SIBLING;\
@@ -1941,6 +2173,7 @@ static VeneerRoutine VRs_g[VENEER_ROUTINES] =
              }\
              chi-->GOBJFIELD_SIBLING = obj-->GOBJFIELD_SIBLING;\
            }\
+           #endif;\
            obj-->GOBJFIELD_SIBLING = 0;\
            obj-->GOBJFIELD_PARENT = 0;\
            rfalse;\
@@ -2015,10 +2248,22 @@ static void mark_as_needed_z(int code)
                 mark_as_needed_z(RT__Err_VR);
                 return;
             case CA__Pr_VR:
+            case CA__Pr0_VR: case CA__Pr1_VR: case CA__Pr2_VR:
+            case CA__Pr3_VR: case CA__Pr4_VR: case CA__Pr5_VR:
+            case CA__Pr6_VR:
                 mark_as_needed_z(Z__Region_VR);
                 mark_as_needed_z(Cl__Ms_VR);
                 mark_as_needed_z(RT__Err_VR);
                 return;
+            case Grammar__Mask_VR:
+                mark_as_needed_z(Unsigned__Compare_VR);
+                return;
+            case Grammar__Line_Ok_VR:
+                mark_as_needed_z(Grammar__Mask_VR);
+                return;
+            case Name__Search_VR:
+                mark_as_needed_z(Unsigned__Compare_VR);
+                return;
             case IB__Pr_VR:
             case IA__Pr_VR:
             case DB__Pr_VR:
@@ -2212,6 +2457,14 @@ static void mark_as_needed_g(int code)
             case Dynam__String_VR:
                 mark_as_needed_g(RT__Err_VR);
                 return;
+            case CA__Pr0_VR: case CA__Pr1_VR: case CA__Pr2_VR:
+            case CA__Pr3_VR: case CA__Pr4_VR: case CA__Pr5_VR:
+            case CA__Pr6_VR:
+                mark_as_needed_g(CA__Pr_VR);
+                return;
+            case Grammar__Line_Ok_VR:
+                mark_as_needed_g(Grammar__Mask_VR);
+                return;
         }
     }
 }
@@ -2244,6 +2497,141 @@ extern char *veneer_routine_name(int code)
     }
 }
 
+/* ------------------------------------------------------------------------- */
+/*   Property read stubs (only if $SPECIALISE_PROPERTY_READS)                */
+/*                                                                           */
+/*   A read "obj.prop" of a named property would otherwise call RV__Pr,      */
+/*   which sorts out at run time what kind of identifier it has been given.  */
+/*   Instead each property read this way gets a stub RV__Pr_<n>, taking the  */
+/*   same two arguments but with the property number n compiled in: so the  */
+/*   common/individual decision, the class-qualified case and the "Class"    */
+/*   restrictions are settled once, at compile time, and the search for the  */
+/*   property is made directly rather than through RA__Pr and RL__Pr (or     */
+/*   CP__Tab).  Stubs are referred to by symbol, like forward routine        */
+/*   names, and compiled with the rest of the veneer.                        */
+/* ------------------------------------------------------------------------- */
+
+int no_property_read_stubs;            /* Number of stubs needed so far     */
+static int32 *property_read_stubs;     /* Their property numbers            */
+static memory_list property_read_stubs_memlist;
+
+extern assembly_operand property_read_routine(assembly_operand prop)
+{   /*  The routine to call to read property "prop" of an object.        */
+
+    char name[32];
+    int j, created;
+    assembly_operand AO;
+
+    if ((!SPECIALISE_PROPERTY_READS) || veneer_mode
+        || (!is_constant_ot(prop.type)) || (prop.marker != 0))
+        return veneer_routine(RV__Pr_VR);
+
+    /*  Z-code common properties never get this far; individual ones run
+        from 64 up to the $4000 bit which marks a class-qualified value.
+        Glulx keeps the class in the top half of the word.                   */
+
+    if (!glulx_mode)
+    {   if ((prop.value < 64) || (prop.value >= 0x4000))
+            return veneer_routine(RV__Pr_VR);
+    }
+    else
+    {   if ((prop.value <= 0) || (prop.value >= 0x10000))
+            return veneer_routine(RV__Pr_VR);
+    }
+
+    sprintf(name, "RV__Pr_%d", prop.value);
+    j = symbol_index(name, -1, &created);
+    if (created)
+    {   ensure_memory_list_available(&property_read_stubs_memlist,
+            no_property_read_stubs+1);
+        property_read_stubs[no_property_read_stubs++] = prop.value;
+        if (!glulx_mode) mark_as_needed_z(RT__Err_VR);
+        else
+        {   mark_as_needed_g(RT__Err_VR);
+            mark_as_needed_g(Z__Region_VR);
+        }
+        if (track_unused_routines) df_note_function_symbol(j);
+    }
+
+    INITAOTV(&AO, (!glulx_mode) ? LONG_CONSTANT_OT : CONSTANT_OT, j);
+    AO.marker = SYMBOL_MV;
+    return AO;
+}
+
+static void compile_property_read_stubs(void)
+{   int i, j;
+    int32 n;
+    char name[32];
+
+    for (i=0; i<no_property_read_stubs; i++)
+    {   n = property_read_stubs[i];
+        sprintf(name, "RV__Pr_%d", n);
+        j = symbol_index(name, -1, NULL);
+        if (!(symbols[j].flags & UNKNOWN_SFLAG))
+        {   if (symbols[j].type != ROUTINE_T)
+                error_named("The following name is reserved by Inform for its \
+own use as a routine name; you can use it as a routine name yourself (to \
+override the standard definition) but cannot use it for anything else:",
+                    name);
+            continue;
+        }
+
+        if (!glulx_mode)
+            sprintf(veneer_source_area,
+               "obj id x otherid;\
+                if (obj == 0) jump Fail__;\
+                if (obj.&3 == 0) jump Fail__;\
+                %s\
+                if (self == obj) otherid = %ld;\
+                x = obj.3;\
+                while (x-->0 ~= 0)\
+                {   if (x-->0 == %ld or otherid) jump Found__;\
+                    x = x + x->2 + 3;\
+                }\
+                .Fail__; RT__Err(\"read\", obj, id); return;\
+                .Found__;\
+                if (x->2 > 2) RT__Err(\"read\", obj, id%s);\
+                return (x+3)-->0;\
+                ]",
+                (n >= 72) ? "if (obj in 1) jump Fail__;" : "",
+                (long int) (n | 0x8000), (long int) n,
+                (version_number == 3) ? "" : ", 2");
+        else
+            sprintf(veneer_source_area,
+               "obj id prop ix;\
+                if (Z__Region(obj) ~= 1) { RT__Err(23, obj); jump Fail__; }\
+                prop = obj-->GOBJFIELD_PROPTAB;\
+                if (prop == 0) jump Fail__;\
+                ix = prop-->0;\
+                prop = prop + 4;\
+                @binarysearch %ld 2 prop 10 ix 0 0 prop;\
+                if (prop == 0) jump Fail__;\
+                %s\
+                if (self ~= obj) {\
+                  @aloadbit prop 72 ix;\
+                  if (ix) jump Fail__;\
+                }\
+                prop = prop-->1;\
+                return prop-->0;\
+                .Fail__;\
+                %s\
+                ]",
+                (long int) n,
+                (n < INDIV_PROP_START || n >= INDIV_PROP_START+8)
+                    ? "if (obj in Class) jump Fail__;" : "",
+                (n < INDIV_PROP_START) ? "return #cpv__start-->id;"
+                    : "RT__Err(\"read\", obj, id); return 0;");
+
+        veneer_mode = TRUE;
+        assign_symbol(j,
+            parse_routine(veneer_source_area, FALSE, symbols[j].name,
+                TRUE, j),
+            ROUTINE_T);
+        veneer_mode = FALSE;
+        if (trace_fns_setting==3) symbols[j].flags |= STAR_SFLAG;
+    }
+}
+
 static void compile_symbol_table_routine(void)
 {   int32 j, nl, arrays_l, routines_l, constants_l;
     assembly_operand AO, AO2, AO3;
@@ -2398,6 +2786,31 @@ extern void compile_veneer(void)
 
     veneer_symbols_base = no_symbols;
 
+    /*  The grammar index readers are only ever called by name, from the
+        game's own source, so they are compiled if so referred to.  */
+
+    if (GRAMMAR_INDEX)
+    {   for (i=Grammar__Mask_VR; i<=Grammar__Line_Ok_VR; i++)
+        {   j = get_symbol_index(VRs[i].name);
+            if (j >= 0 && (symbols[j].flags & UNKNOWN_SFLAG))
+            {   if (!glulx_mode) mark_as_needed_z(i);
+                else mark_as_needed_g(i);
+            }
+        }
+    }
+
+    /*  And so is the name list search.  */
+
+    if (SORT_NAME_PROPERTIES)
+    {   j = get_symbol_index(VRs[Name__Search_VR].name);
+        if (j >= 0 && (symbols[j].flags & UNKNOWN_SFLAG))
+        {   if (!glulx_mode) mark_as_needed_z(Name__Search_VR);
+            else mark_as_needed_g(Name__Search_VR);
+        }
+    }
+
+    compile_property_read_stubs();
+
     /*  for (i=0; i<VENEER_ROUTINES; i++)
         printf("%s %d %d %d %d %d %d\n", VRs[i].name,
             strlen(VRs[i].source1), strlen(VRs[i].source2),
@@ -2449,12 +2862,13 @@ override the standard definition) but cannot use it for anything else:",
 /* ------------------------------------------------------------------------- */
 
 extern void init_veneer_vars(void)
-{
+{   property_read_stubs = NULL;
 }
 
 extern void veneer_begin_pass(void)
 {   int i;
     veneer_mode = FALSE;
+    no_property_read_stubs = 0;
     for (i=0; i<VENEER_ROUTINES; i++)
     {   veneer_routine_needs_compilation[i] = VR_UNUSED;
         veneer_routine_address[i] = 0;
@@ -2463,10 +2877,14 @@ extern void veneer_begin_pass(void)
 
 extern void veneer_allocate_arrays(void)
 {   veneer_source_area = my_malloc(16384, "veneer source code area");
+    initialise_memory_list(&property_read_stubs_memlist,
+        sizeof(int32), 64, (void**)&property_read_stubs,
+        "property read stubs");
 }
 
 extern void veneer_free_arrays(void)
 {   my_free(&veneer_source_area, "veneer source code area");
+    deallocate_memory_list(&property_read_stubs_memlist);
 }
 
 /* ========================================================================= */